@@ -0,0 +1,134 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "kwin_wayland_test.h"
+
+#include "abstract_client.h"
+#include "composite.h"
+#include "effectloader.h"
+#include "effects.h"
+#include "platform.h"
+#include "renderbackend.h"
+#include "wayland_server.h"
+
+#include <KConfigGroup>
+
+#include <QElapsedTimer>
+
+#include <DWayland/Client/shm_pool.h>
+#include <DWayland/Client/surface.h>
+
+using namespace KWin;
+
+static const QString s_socketName = QStringLiteral("wayland_test_effects_multitaskview_frame_callback-0");
+
+class MultitaskViewFrameCallbackTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void testFrameCallbacks();
+};
+
+void MultitaskViewFrameCallbackTest::initTestCase()
+{
+    qRegisterMetaType<KWin::AbstractClient *>();
+    QSignalSpy applicationStartedSpy(kwinApp(), &Application::started);
+    QVERIFY(applicationStartedSpy.isValid());
+    kwinApp()->platform()->setInitialWindowSize(QSize(1280, 1024));
+    QVERIFY(waylandServer()->init(s_socketName));
+
+    auto config = KSharedConfig::openConfig(QString(), KConfig::SimpleConfig);
+    KConfigGroup plugins(config, QStringLiteral("Plugins"));
+    const auto builtinNames = EffectLoader().listOfKnownEffects();
+    for (const QString &name : builtinNames) {
+        plugins.writeEntry(name + QStringLiteral("Enabled"), false);
+    }
+    config->sync();
+    kwinApp()->setConfig(config);
+
+    qputenv("KWIN_COMPOSE", QByteArrayLiteral("O2"));
+    qputenv("KWIN_EFFECTS_FORCE_ANIMATIONS", QByteArrayLiteral("1"));
+
+    kwinApp()->start();
+    QVERIFY(applicationStartedSpy.wait());
+    Test::initWaylandWorkspace();
+
+    QCOMPARE(Compositor::self()->backend()->compositingType(), KWin::OpenGLCompositing);
+}
+
+void MultitaskViewFrameCallbackTest::init()
+{
+    QVERIFY(Test::setupWaylandConnection());
+}
+
+void MultitaskViewFrameCallbackTest::cleanup()
+{
+    auto effectsImpl = qobject_cast<EffectsHandlerImpl *>(effects);
+    QVERIFY(effectsImpl);
+    effectsImpl->unloadAllEffects();
+    QVERIFY(effectsImpl->loadedEffects().isEmpty());
+
+    Test::destroyWaylandConnection();
+}
+
+void MultitaskViewFrameCallbackTest::testFrameCallbacks()
+{
+    // This test verifies that a window shown as a preview in the multitask view keeps
+    // getting a frame callback for every frame it is drawn in, rather than only the
+    // throttled one for windows that are not painted.
+
+    QScopedPointer<KWayland::Client::Surface> surface(Test::createSurface());
+    QVERIFY(!surface.isNull());
+    QScopedPointer<Test::XdgToplevel> shellSurface(Test::createXdgToplevelSurface(surface.data()));
+    QVERIFY(!shellSurface.isNull());
+    AbstractClient *client = Test::renderAndWaitForShown(surface.data(), QSize(400, 300), Qt::blue);
+    QVERIFY(client);
+
+    const QString effectName = QStringLiteral("multitaskview");
+    auto effectsImpl = qobject_cast<EffectsHandlerImpl *>(effects);
+    QVERIFY(effectsImpl);
+    QVERIFY(effectsImpl->loadEffect(effectName));
+    Effect *effect = effectsImpl->findEffect(effectName);
+    QVERIFY(effect);
+    QVERIFY(!effect->isActive());
+
+    QVERIFY(QMetaObject::invokeMethod(effect, "toggle"));
+    QVERIFY(effect->isActive());
+    QCOMPARE(effects->activeFullScreenEffect(), effect);
+
+    // Let the opening animation settle so that only the client drives repaints.
+    QTest::qWait(1000);
+
+    QSignalSpy frameRenderedSpy(surface.data(), &KWayland::Client::Surface::frameRendered);
+    QVERIFY(frameRenderedSpy.isValid());
+
+    // Throttled frame callbacks are sent once per second, so ten frames well below that
+    // prove that the preview counts as painted.
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < 10; ++i) {
+        QImage image(QSize(400, 300), QImage::Format_ARGB32_Premultiplied);
+        image.fill(i % 2 ? Qt::red : Qt::blue);
+        surface->attachBuffer(Test::waylandShmPool()->createBuffer(image));
+        surface->damage(image.rect());
+        surface->commit(KWayland::Client::Surface::CommitFlag::FrameCallback);
+        QVERIFY(frameRenderedSpy.wait());
+    }
+    QVERIFY(timer.elapsed() < 5000);
+    QVERIFY(effect->isActive());
+
+    surface.reset();
+    QVERIFY(Test::waitForWindowDestroyed(client));
+}
+
+WAYLANDTEST_MAIN(MultitaskViewFrameCallbackTest)
+#include "multitaskview_frame_callback_test.moc"
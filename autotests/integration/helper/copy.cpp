@@ -8,6 +8,7 @@
 */
 #include <QClipboard>
 #include <QGuiApplication>
+#include <QMimeData>
 #include <QPainter>
 #include <QRasterWindow>
 #include <QTimer>
@@ -16,16 +17,20 @@ class Window : public QRasterWindow
 {
     Q_OBJECT
 public:
-    explicit Window();
+    explicit Window(qint64 payloadSize);
     ~Window() override;
 
 protected:
     void paintEvent(QPaintEvent *event) override;
     void focusInEvent(QFocusEvent *event) override;
+
+private:
+    qint64 m_payloadSize;
 };
 
-Window::Window()
+Window::Window(qint64 payloadSize)
     : QRasterWindow()
+    , m_payloadSize(payloadSize)
 {
 }
 
@@ -42,15 +47,29 @@ void Window::focusInEvent(QFocusEvent *event)
 {
     QRasterWindow::focusInEvent(event);
     // TODO: make it work without singleshot
-    QTimer::singleShot(100,[] {
-        qApp->clipboard()->setText(QStringLiteral("test"));
+    QTimer::singleShot(100,[this] {
+        if (m_payloadSize <= 0) {
+            qApp->clipboard()->setText(QStringLiteral("test"));
+            return;
+        }
+        // the same pattern is verified by the paste helper
+        QByteArray payload(m_payloadSize, Qt::Uninitialized);
+        for (qint64 i = 0; i < m_payloadSize; ++i) {
+            payload[i] = char(i % 251);
+        }
+        QMimeData *mimeData = new QMimeData;
+        mimeData->setData(QStringLiteral("application/x-kwin-test-payload"), payload);
+        qApp->clipboard()->setMimeData(mimeData);
     });
 }
 
 int main(int argc, char *argv[])
 {
     QGuiApplication app(argc, argv);
-    QScopedPointer<Window> w(new Window);
+    // optional argument: size of a binary payload to copy instead of the text
+    const QStringList arguments = app.arguments();
+    const qint64 payloadSize = arguments.count() > 1 ? arguments.at(1).toLongLong() : 0;
+    QScopedPointer<Window> w(new Window(payloadSize));
     w->setGeometry(QRect(0, 0, 100, 200));
     w->show();
 
@@ -7,11 +7,15 @@
     SPDX-License-Identifier: GPL-2.0-or-later
 */
 #include <QClipboard>
+#include <QElapsedTimer>
 #include <QGuiApplication>
+#include <QMimeData>
 #include <QPainter>
 #include <QRasterWindow>
 #include <QTimer>
 
+#include <stdio.h>
+
 class Window : public QRasterWindow
 {
     Q_OBJECT
@@ -37,14 +41,52 @@ void Window::paintEvent(QPaintEvent *event)
     p.fillRect(0, 0, width(), height(), Qt::blue);
 }
 
+static bool verifyPayload(const QByteArray &payload, qint64 payloadSize)
+{
+    if (payload.size() != payloadSize) {
+        return false;
+    }
+    for (qint64 i = 0; i < payloadSize; ++i) {
+        if (payload.at(i) != char(i % 251)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 int main(int argc, char *argv[])
 {
     QGuiApplication app(argc, argv);
+    // optional argument: size of the binary payload the copy helper offers, the time
+    // it took to read it is written to stdout in milliseconds
+    const QStringList arguments = app.arguments();
+    const qint64 payloadSize = arguments.count() > 1 ? arguments.at(1).toLongLong() : 0;
     QObject::connect(app.clipboard(), &QClipboard::changed, &app,
-        [] {
-            if (qApp->clipboard()->text() == QLatin1String("test")) {
-                QTimer::singleShot(100, qApp, &QCoreApplication::quit);
+        [payloadSize] {
+            if (payloadSize <= 0) {
+                if (qApp->clipboard()->text() == QLatin1String("test")) {
+                    QTimer::singleShot(100, qApp, &QCoreApplication::quit);
+                }
+                return;
+            }
+            static bool done = false;
+            const QMimeData *mimeData = qApp->clipboard()->mimeData();
+            if (done || !mimeData || !mimeData->hasFormat(QStringLiteral("application/x-kwin-test-payload"))) {
+                return;
             }
+            done = true;
+
+            QElapsedTimer timer;
+            timer.start();
+            const QByteArray payload = mimeData->data(QStringLiteral("application/x-kwin-test-payload"));
+            const qint64 elapsed = timer.elapsed();
+
+            const bool valid = verifyPayload(payload, payloadSize);
+            printf("%lld\n", elapsed);
+            fflush(stdout);
+            QTimer::singleShot(100, qApp, [valid] {
+                qApp->exit(valid ? 0 : 1);
+            });
         }
     );
     QScopedPointer<Window> w(new Window);
@@ -42,6 +42,7 @@ private Q_SLOTS:
     void testCursorMoving();
     void testWindow();
     void testWindowScaled();
+    void testOccludedWindow();
     void testCompositorRestart();
     void testX11Window();
 };
@@ -235,6 +236,57 @@ void SceneQPainterTest::testWindowScaled()
     QCOMPARE(referenceImage, *scene->qpainterRenderBuffer(outputs.constFirst()));
 }
 
+void SceneQPainterTest::testOccludedWindow()
+{
+    // this test verifies that a window covered by an opaque window is culled and
+    // rendered correctly once it becomes visible again
+    KWin::Cursors::self()->mouse()->setPos(400, 400);
+    using namespace KWayland::Client;
+    QVERIFY(Test::setupWaylandConnection());
+    QScopedPointer<KWayland::Client::Surface> bottomSurface(Test::createSurface());
+    QScopedPointer<Test::XdgToplevel> bottomShellSurface(Test::createXdgToplevelSurface(bottomSurface.data()));
+    AbstractClient *bottom = Test::renderAndWaitForShown(bottomSurface.data(), QSize(200, 300), Qt::red, QImage::Format_RGB32);
+    QVERIFY(bottom);
+    bottom->move(QPoint(0, 0));
+
+    QScopedPointer<KWayland::Client::Surface> topSurface(Test::createSurface());
+    QScopedPointer<Test::XdgToplevel> topShellSurface(Test::createXdgToplevelSurface(topSurface.data()));
+    AbstractClient *top = Test::renderAndWaitForShown(topSurface.data(), QSize(200, 300), Qt::blue, QImage::Format_RGB32);
+    QVERIFY(top);
+    top->move(QPoint(0, 0));
+
+    auto scene = KWin::Compositor::self()->scene();
+    QVERIFY(scene);
+    QSignalSpy frameRenderedSpy(scene, &Scene::frameRendered);
+    QVERIFY(frameRenderedSpy.isValid());
+    const quint64 totalCulled = scene->totalCulledWindowCount();
+    scene->addRepaintFull();
+    QVERIFY(frameRenderedSpy.wait());
+    QCOMPARE(scene->culledWindowCount(), 1);
+    QCOMPARE(scene->totalCulledWindowCount(), totalCulled + 1);
+    QVERIFY(scene->paintedWindows().value(bottom));
+    QVERIFY(!scene->paintedWindows().value(top));
+
+    QImage referenceImage(QSize(1280, 1024), QImage::Format_RGB32);
+    referenceImage.fill(Qt::black);
+    QPainter painter(&referenceImage);
+    painter.fillRect(0, 0, 200, 300, Qt::blue);
+    auto cursor = Cursors::self()->mouse();
+    const QImage cursorImage = cursor->image();
+    QVERIFY(!cursorImage.isNull());
+    painter.drawImage(QPoint(400, 400) - cursor->hotspot(), cursorImage);
+    const auto outputs = kwinApp()->platform()->enabledOutputs();
+    QCOMPARE(referenceImage, *scene->qpainterRenderBuffer(outputs.constFirst()));
+
+    // uncovering the bottom window has to paint it again
+    top->move(QPoint(600, 0));
+    QVERIFY(frameRenderedSpy.wait());
+    QCOMPARE(scene->culledWindowCount(), 0);
+    painter.fillRect(0, 0, 200, 300, Qt::red);
+    painter.fillRect(600, 0, 200, 300, Qt::blue);
+    QCOMPARE(referenceImage, *scene->qpainterRenderBuffer(outputs.constFirst()));
+}
+
 void SceneQPainterTest::testCompositorRestart()
 {
     // this test verifies that the compositor/SceneQPainter survive a restart of the compositor and still render correctly
@@ -0,0 +1,199 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "kwin_wayland_test.h"
+
+#include "abstract_client.h"
+#include "composite.h"
+#include "effectloader.h"
+#include "platform.h"
+#include "renderbackend.h"
+#include "scene.h"
+#include "thumbnailtexturecache.h"
+#include "wayland_server.h"
+
+#include <deepin_kwingltexture.h>
+
+#include <KConfigGroup>
+
+#include <DWayland/Client/surface.h>
+
+namespace KWin
+{
+
+static const QString s_socketName = QStringLiteral("wayland_test_kwin_thumbnail_texture_cache-0");
+
+class ThumbnailTextureCacheTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void testCacheHit();
+    void testInvalidate();
+    void testEvict();
+    void testWindowClosed();
+
+private:
+    QSharedPointer<GLTexture> thumbnail(AbstractClient *client, const QSize &size);
+};
+
+void ThumbnailTextureCacheTest::initTestCase()
+{
+    qRegisterMetaType<KWin::AbstractClient *>();
+    QSignalSpy applicationStartedSpy(kwinApp(), &Application::started);
+    QVERIFY(applicationStartedSpy.isValid());
+    kwinApp()->platform()->setInitialWindowSize(QSize(1280, 1024));
+    QVERIFY(waylandServer()->init(s_socketName));
+
+    // disable all effects - we don't want to have it interact with the rendering
+    auto config = KSharedConfig::openConfig(QString(), KConfig::SimpleConfig);
+    KConfigGroup plugins(config, QStringLiteral("Plugins"));
+    const auto builtinNames = EffectLoader().listOfKnownEffects();
+    for (const QString &name : builtinNames) {
+        plugins.writeEntry(name + QStringLiteral("Enabled"), false);
+    }
+    config->sync();
+    kwinApp()->setConfig(config);
+
+    qputenv("KWIN_COMPOSE", QByteArrayLiteral("O2"));
+
+    kwinApp()->start();
+    QVERIFY(applicationStartedSpy.wait());
+    Test::initWaylandWorkspace();
+
+    QCOMPARE(Compositor::self()->backend()->compositingType(), KWin::OpenGLCompositing);
+    QVERIFY(ThumbnailTextureCache::self());
+}
+
+void ThumbnailTextureCacheTest::init()
+{
+    QVERIFY(Test::setupWaylandConnection());
+}
+
+void ThumbnailTextureCacheTest::cleanup()
+{
+    Test::destroyWaylandConnection();
+}
+
+QSharedPointer<GLTexture> ThumbnailTextureCacheTest::thumbnail(AbstractClient *client, const QSize &size)
+{
+    Scene *scene = Compositor::self()->scene();
+    if (!scene->makeOpenGLContextCurrent()) {
+        return QSharedPointer<GLTexture>();
+    }
+    const QSharedPointer<GLTexture> texture = ThumbnailTextureCache::self()->texture(client, size);
+    scene->doneOpenGLContextCurrent();
+    return texture;
+}
+
+static QColor thumbnailColor(const QSharedPointer<GLTexture> &texture)
+{
+    Scene *scene = Compositor::self()->scene();
+    scene->makeOpenGLContextCurrent();
+    const QImage image = texture->toImage();
+    scene->doneOpenGLContextCurrent();
+    return image.pixelColor(image.width() / 2, image.height() / 2);
+}
+
+void ThumbnailTextureCacheTest::testCacheHit()
+{
+    QScopedPointer<KWayland::Client::Surface> surface(Test::createSurface());
+    QScopedPointer<Test::XdgToplevel> shellSurface(Test::createXdgToplevelSurface(surface.data()));
+    AbstractClient *client = Test::renderAndWaitForShown(surface.data(), QSize(400, 200), Qt::blue);
+    QVERIFY(client);
+
+    // the thumbnail is halved as long as it stays at least as large as requested
+    const QSharedPointer<GLTexture> texture = thumbnail(client, QSize(100, 50));
+    QVERIFY(texture);
+    QCOMPARE(texture->size(), QSize(100, 50));
+    QCOMPARE(thumbnailColor(texture), QColor(Qt::blue));
+
+    // the same and smaller sizes are served from the cache
+    QCOMPARE(thumbnail(client, QSize(100, 50)), texture);
+    QCOMPARE(thumbnail(client, QSize(60, 30)), texture);
+
+    // a larger size needs a new thumbnail
+    const QSharedPointer<GLTexture> larger = thumbnail(client, QSize(150, 75));
+    QVERIFY(larger);
+    QVERIFY(larger != texture);
+    QCOMPARE(larger->size(), QSize(200, 100));
+}
+
+void ThumbnailTextureCacheTest::testInvalidate()
+{
+    QScopedPointer<KWayland::Client::Surface> surface(Test::createSurface());
+    QScopedPointer<Test::XdgToplevel> shellSurface(Test::createXdgToplevelSurface(surface.data()));
+    AbstractClient *client = Test::renderAndWaitForShown(surface.data(), QSize(400, 200), Qt::blue);
+    QVERIFY(client);
+
+    const QSharedPointer<GLTexture> texture = thumbnail(client, QSize(100, 50));
+    QVERIFY(texture);
+    QCOMPARE(thumbnailColor(texture), QColor(Qt::blue));
+
+    // damage renders the thumbnail again, into the same texture
+    QSignalSpy damagedSpy(client, &Toplevel::damaged);
+    QVERIFY(damagedSpy.isValid());
+    Test::render(surface.data(), QSize(400, 200), Qt::red);
+    QVERIFY(damagedSpy.wait());
+    QCOMPARE(thumbnail(client, QSize(100, 50)), texture);
+    QCOMPARE(thumbnailColor(texture), QColor(Qt::red));
+
+    // a new size needs a new texture
+    QSignalSpy frameGeometryChangedSpy(client, &Toplevel::frameGeometryChanged);
+    QVERIFY(frameGeometryChangedSpy.isValid());
+    Test::render(surface.data(), QSize(200, 200), Qt::green);
+    QVERIFY(frameGeometryChangedSpy.wait());
+    const QSharedPointer<GLTexture> resized = thumbnail(client, QSize(100, 100));
+    QVERIFY(resized);
+    QVERIFY(resized != texture);
+    QCOMPARE(resized->size(), QSize(100, 100));
+    QCOMPARE(thumbnailColor(resized), QColor(Qt::green));
+}
+
+void ThumbnailTextureCacheTest::testEvict()
+{
+    QScopedPointer<KWayland::Client::Surface> surface(Test::createSurface());
+    QScopedPointer<Test::XdgToplevel> shellSurface(Test::createXdgToplevelSurface(surface.data()));
+    AbstractClient *client = Test::renderAndWaitForShown(surface.data(), QSize(400, 200), Qt::blue);
+    QVERIFY(client);
+
+    QWeakPointer<GLTexture> texture = thumbnail(client, QSize(100, 50));
+    QVERIFY(texture);
+
+    // thumbnails that aren't requested for a few seconds are released
+    QTRY_VERIFY_WITH_TIMEOUT(texture.isNull(), 15000);
+
+    // and rendered again when they are needed
+    QVERIFY(thumbnail(client, QSize(100, 50)));
+}
+
+void ThumbnailTextureCacheTest::testWindowClosed()
+{
+    QScopedPointer<KWayland::Client::Surface> surface(Test::createSurface());
+    QScopedPointer<Test::XdgToplevel> shellSurface(Test::createXdgToplevelSurface(surface.data()));
+    AbstractClient *client = Test::renderAndWaitForShown(surface.data(), QSize(400, 200), Qt::blue);
+    QVERIFY(client);
+
+    QWeakPointer<GLTexture> texture = thumbnail(client, QSize(100, 50));
+    QVERIFY(texture);
+
+    QSignalSpy windowClosedSpy(client, &AbstractClient::windowClosed);
+    QVERIFY(windowClosedSpy.isValid());
+    shellSurface.reset();
+    surface.reset();
+    QVERIFY(windowClosedSpy.wait());
+    QVERIFY(texture.isNull());
+}
+
+} // namespace KWin
+
+WAYLANDTEST_MAIN(KWin::ThumbnailTextureCacheTest)
+#include "thumbnail_texture_cache_test.moc"
@@ -24,6 +24,9 @@
 #include <netwm.h>
 #include <xcb/xcb_icccm.h>
 
+#include <algorithm>
+#include <random>
+
 using namespace KWin;
 using namespace KWayland::Client;
 static const QString s_socketName = QStringLiteral("wayland_test_x11_client-0");
@@ -51,6 +54,9 @@ private Q_SLOTS:
     void testFullscreenWindowGroups();
     void testActivateFocusedWindow();
     void testReentrantMoveResize();
+    void testFindClientIndex();
+    void benchmarkFindClient_data();
+    void benchmarkFindClient();
 };
 
 void X11ClientTest::initTestCase()
@@ -1099,5 +1105,119 @@ void X11ClientTest::testReentrantMoveResize()
     QVERIFY(Test::waitForWindowDestroyed(client));
 }
 
+static QVector<xcb_window_t> createX11Windows(xcb_connection_t *c, int count)
+{
+    QVector<xcb_window_t> windows;
+    for (int i = 0; i < count; ++i) {
+        const QRect windowGeometry(i % 100, i % 100, 100, 200);
+        xcb_window_t w = xcb_generate_id(c);
+        xcb_create_window(c, XCB_COPY_FROM_PARENT, w, rootWindow(),
+                          windowGeometry.x(),
+                          windowGeometry.y(),
+                          windowGeometry.width(),
+                          windowGeometry.height(),
+                          0, XCB_WINDOW_CLASS_INPUT_OUTPUT, XCB_COPY_FROM_PARENT, 0, nullptr);
+        xcb_size_hints_t hints;
+        memset(&hints, 0, sizeof(hints));
+        xcb_icccm_size_hints_set_position(&hints, 1, windowGeometry.x(), windowGeometry.y());
+        xcb_icccm_size_hints_set_size(&hints, 1, windowGeometry.width(), windowGeometry.height());
+        xcb_icccm_set_wm_normal_hints(c, w, &hints);
+        xcb_map_window(c, w);
+        windows << w;
+    }
+    xcb_flush(c);
+    return windows;
+}
+
+void X11ClientTest::testFindClientIndex()
+{
+    // verifies that the lookup tables behind findClient(Predicate, xcb_window_t) follow
+    // clients being managed and released
+    QScopedPointer<xcb_connection_t, XcbConnectionDeleter> c(xcb_connect(nullptr, nullptr));
+    QVERIFY(!xcb_connection_has_error(c.data()));
+    const QVector<xcb_window_t> windows = createX11Windows(c.data(), 3);
+    QTRY_VERIFY(std::all_of(windows.begin(), windows.end(), [](xcb_window_t w) {
+        return workspace()->findClient(Predicate::WindowMatch, w);
+    }));
+
+    for (xcb_window_t w : windows) {
+        X11Client *client = workspace()->findClient(Predicate::WindowMatch, w);
+        QCOMPARE(client->window(), w);
+        QCOMPARE(workspace()->findClient(Predicate::WrapperIdMatch, client->wrapperId()), client);
+        QCOMPARE(workspace()->findClient(Predicate::FrameIdMatch, client->frameId()), client);
+        if (client->inputId() != XCB_WINDOW_NONE) {
+            QCOMPARE(workspace()->findClient(Predicate::InputIdMatch, client->inputId()), client);
+        }
+        QCOMPARE(workspace()->findToplevel(client->internalId()), client);
+        QCOMPARE(workspace()->findAbstractClient(client->internalId()), client);
+    }
+    QVERIFY(!workspace()->findClient(Predicate::WindowMatch, XCB_WINDOW_NONE));
+    QVERIFY(!workspace()->findClient(Predicate::InputIdMatch, XCB_WINDOW_NONE));
+
+    // destroy the windows again, they must disappear from the lookup tables
+    X11Client *client = workspace()->findClient(Predicate::WindowMatch, windows.first());
+    const xcb_window_t frameId = client->frameId();
+    const xcb_window_t wrapperId = client->wrapperId();
+    const QUuid internalId = client->internalId();
+    for (xcb_window_t w : windows) {
+        xcb_destroy_window(c.data(), w);
+    }
+    xcb_flush(c.data());
+    QVERIFY(Test::waitForWindowDestroyed(client));
+    QVERIFY(!workspace()->findClient(Predicate::WindowMatch, windows.first()));
+    QVERIFY(!workspace()->findClient(Predicate::FrameIdMatch, frameId));
+    QVERIFY(!workspace()->findClient(Predicate::WrapperIdMatch, wrapperId));
+    QVERIFY(!workspace()->findToplevel(internalId));
+    QTRY_VERIFY(std::none_of(windows.begin(), windows.end(), [](xcb_window_t w) {
+        return workspace()->findClient(Predicate::WindowMatch, w);
+    }));
+}
+
+void X11ClientTest::benchmarkFindClient_data()
+{
+    QTest::addColumn<int>("windowCount");
+
+    QTest::newRow("10") << 10;
+    QTest::newRow("150") << 150;
+}
+
+void X11ClientTest::benchmarkFindClient()
+{
+    // replays a synthetic stream of X events the way events.cpp looks up their windows
+    QFETCH(int, windowCount);
+    QScopedPointer<xcb_connection_t, XcbConnectionDeleter> c(xcb_connect(nullptr, nullptr));
+    QVERIFY(!xcb_connection_has_error(c.data()));
+    const QVector<xcb_window_t> windows = createX11Windows(c.data(), windowCount);
+    QTRY_VERIFY_WITH_TIMEOUT(std::all_of(windows.begin(), windows.end(), [](xcb_window_t w) {
+        return workspace()->findClient(Predicate::WindowMatch, w);
+    }), 30000);
+
+    QVector<xcb_window_t> events;
+    for (xcb_window_t w : windows) {
+        X11Client *client = workspace()->findClient(Predicate::WindowMatch, w);
+        events << client->window() << client->wrapperId() << client->frameId() << rootWindow();
+    }
+    std::shuffle(events.begin(), events.end(), std::mt19937(windowCount));
+
+    QBENCHMARK {
+        for (xcb_window_t w : qAsConst(events)) {
+            // mirrors the lookup order in Workspace::workspaceEvent()
+            const bool found = workspace()->findClient(Predicate::WindowMatch, w)
+                || workspace()->findClient(Predicate::WrapperIdMatch, w)
+                || workspace()->findClient(Predicate::FrameIdMatch, w)
+                || workspace()->findClient(Predicate::InputIdMatch, w)
+                || workspace()->findUnmanaged(w);
+            Q_UNUSED(found)
+        }
+    }
+
+    X11Client *last = workspace()->findClient(Predicate::WindowMatch, windows.last());
+    for (xcb_window_t w : windows) {
+        xcb_destroy_window(c.data(), w);
+    }
+    xcb_flush(c.data());
+    QVERIFY(Test::waitForWindowDestroyed(last));
+}
+
 WAYLANDTEST_MAIN(X11ClientTest)
 #include "x11_client_test.moc"
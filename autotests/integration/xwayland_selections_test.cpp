@@ -41,6 +41,11 @@ private Q_SLOTS:
     void initTestCase();
     void testSync_data();
     void testSync();
+    void testThroughput_data();
+    void testThroughput();
+
+private:
+    void copyAndPaste(const QStringList &arguments, int timeout, QByteArray *pasteOutput);
 };
 
 void XwaylandSelectionsTest::initTestCase()
@@ -81,6 +86,44 @@ void XwaylandSelectionsTest::testSync_data()
 void XwaylandSelectionsTest::testSync()
 {
     // this test verifies the syncing of X11 to Wayland clipboard
+    copyAndPaste(QStringList(), 5000, nullptr);
+}
+
+void XwaylandSelectionsTest::testThroughput_data()
+{
+    QTest::addColumn<QString>("copyPlatform");
+    QTest::addColumn<QString>("pastePlatform");
+    QTest::addColumn<int>("size");
+
+    for (int size : {1, 16, 100, 500}) {
+        QTest::addRow("x11->wayland %dMB", size) << QStringLiteral("xcb") << QStringLiteral("wayland") << size;
+        QTest::addRow("wayland->x11 %dMB", size) << QStringLiteral("wayland") << QStringLiteral("xcb") << size;
+    }
+}
+
+void XwaylandSelectionsTest::testThroughput()
+{
+    // this test measures how fast large selections are transferred between X11 and Wayland
+    QFETCH(int, size);
+    if (size > 16 && qEnvironmentVariableIsEmpty("KWIN_TEST_LARGE_SELECTIONS")) {
+        QSKIP("Set KWIN_TEST_LARGE_SELECTIONS to transfer selections larger than 16MB");
+    }
+
+    QByteArray output;
+    copyAndPaste({QString::number(qint64(size) * 1024 * 1024)}, 5000 + size * 200, &output);
+    if (QTest::currentTestFailed()) {
+        return;
+    }
+
+    bool ok = false;
+    const qint64 elapsed = output.trimmed().toLongLong(&ok);
+    QVERIFY(ok);
+    QTest::setBenchmarkResult(elapsed, QTest::WalltimeMilliseconds);
+    qInfo() << size << "MB transferred in" << elapsed << "ms," << size * 1000.0 / qMax(elapsed, qint64(1)) << "MB/s";
+}
+
+void XwaylandSelectionsTest::copyAndPaste(const QStringList &arguments, int timeout, QByteArray *pasteOutput)
+{
     const QString copy = QFINDTESTDATA(QStringLiteral("copy"));
     QVERIFY(!copy.isEmpty());
     const QString paste = QFINDTESTDATA(QStringLiteral("paste"));
@@ -101,6 +144,7 @@ void XwaylandSelectionsTest::testSync()
     copyProcess->setProcessEnvironment(environment);
     copyProcess->setProcessChannelMode(QProcess::ForwardedChannels);
     copyProcess->setProgram(copy);
+    copyProcess->setArguments(arguments);
     copyProcess->start();
     QVERIFY(copyProcess->waitForStarted());
 
@@ -121,8 +165,9 @@ void XwaylandSelectionsTest::testSync()
     QFETCH(QString, pastePlatform);
     environment.insert(QStringLiteral("QT_QPA_PLATFORM"), pastePlatform);
     pasteProcess->setProcessEnvironment(environment);
-    pasteProcess->setProcessChannelMode(QProcess::ForwardedChannels);
+    pasteProcess->setProcessChannelMode(pasteOutput ? QProcess::ForwardedErrorChannel : QProcess::ForwardedChannels);
     pasteProcess->setProgram(paste);
+    pasteProcess->setArguments(arguments);
     pasteProcess->start();
     QVERIFY(pasteProcess->waitForStarted());
 
@@ -140,8 +185,11 @@ void XwaylandSelectionsTest::testSync()
         QVERIFY(clientActivatedSpy.wait());
     }
     QTRY_COMPARE(workspace()->activeClient(), pasteClient);
-    QVERIFY(finishedSpy.wait());
+    QVERIFY(finishedSpy.wait(timeout));
     QCOMPARE(finishedSpy.first().first().toInt(), 0);
+    if (pasteOutput) {
+        *pasteOutput = pasteProcess->readAllStandardOutput();
+    }
 }
 
 WAYLANDTEST_MAIN(XwaylandSelectionsTest)
@@ -0,0 +1,245 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#include <kwinpixelconversion_p.h>
+
+#include <QTest>
+
+#include <cmath>
+#include <random>
+
+using namespace KWin;
+
+Q_DECLARE_METATYPE(KWin::PixelConversion)
+Q_DECLARE_METATYPE(KWin::PixelConversionBackend)
+
+static QByteArray generatePixels(int count)
+{
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> byte(0, 255);
+
+    QByteArray pixels(count * 4, Qt::Uninitialized);
+    for (int i = 0; i < pixels.size(); ++i) {
+        pixels[i] = char(byte(generator));
+    }
+    // Mix in the opaque and transparent runs the vector kernels take shortcuts for.
+    for (int i = 0; i < count; ++i) {
+        switch ((i / 16) % 4) {
+        case 0:
+            pixels[i * 4 + 3] = char(255);
+            break;
+        case 1:
+            pixels[i * 4 + 3] = 0;
+            break;
+        default:
+            break;
+        }
+    }
+    return pixels;
+}
+
+static int bytesPerPixel(PixelConversion conversion)
+{
+    return conversion == PixelConversion::PackRgb || conversion == PixelConversion::PackSwapRedBlue ? 3 : 4;
+}
+
+static QByteArray convert(const QByteArray &pixels, PixelConversion conversion)
+{
+    const int count = pixels.size() / 4;
+    QByteArray result(count * bytesPerPixel(conversion), Qt::Uninitialized);
+    convertPixels(reinterpret_cast<const uchar *>(pixels.constData()), reinterpret_cast<uchar *>(result.data()),
+                  count, conversion);
+    return result;
+}
+
+static const char *backendName(PixelConversionBackend backend)
+{
+    switch (backend) {
+    case PixelConversionBackend::Scalar:
+        return "scalar";
+    case PixelConversionBackend::SSE2:
+        return "sse2";
+    case PixelConversionBackend::AVX2:
+        return "avx2";
+    case PixelConversionBackend::Neon:
+        return "neon";
+    }
+    return "unknown";
+}
+
+class PixelConversionTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void cleanup();
+    void testScalar();
+    void testBackends_data();
+    void testBackends();
+    void testInPlace_data();
+    void testInPlace();
+    void testFlipVertically();
+    void benchmarkConversion_data();
+    void benchmarkConversion();
+};
+
+void PixelConversionTest::cleanup()
+{
+    setPixelConversionBackend(supportedPixelConversionBackends().constLast());
+}
+
+void PixelConversionTest::testScalar()
+{
+    setPixelConversionBackend(PixelConversionBackend::Scalar);
+
+    const uchar rgba[] = {10, 20, 30, 128, 255, 0, 64, 255};
+    uchar result[8];
+
+    convertPixels(rgba, result, 2, PixelConversion::SwapRedBlue);
+    QCOMPARE(QByteArray(reinterpret_cast<char *>(result), 8), QByteArray("\x1e\x14\x0a\x80\x40\x00\xff\xff", 8));
+
+    convertPixels(rgba, result, 2, PixelConversion::PackRgb);
+    QCOMPARE(QByteArray(reinterpret_cast<char *>(result), 6), QByteArray("\x0a\x14\x1e\xff\x00\x40", 6));
+
+    convertPixels(rgba, result, 2, PixelConversion::PackSwapRedBlue);
+    QCOMPARE(QByteArray(reinterpret_cast<char *>(result), 6), QByteArray("\x1e\x14\x0a\x40\x00\xff", 6));
+
+    // premultiplying rounds to the nearest value for every color and alpha
+    for (int alpha = 0; alpha < 256; ++alpha) {
+        for (int color = 0; color < 256; ++color) {
+            const uchar pixel[] = {uchar(color), uchar(color), uchar(color), uchar(alpha)};
+            convertPixels(pixel, result, 1, PixelConversion::Premultiply);
+            QCOMPARE(int(result[0]), int(std::lround(color * alpha / 255.0)));
+            QCOMPARE(int(result[3]), alpha);
+
+            // unpremultiplying a premultiplied color is off by at most the rounding error
+            if (alpha) {
+                const uchar premultiplied[] = {result[0], result[1], result[2], uchar(alpha)};
+                convertPixels(premultiplied, result, 1, PixelConversion::Unpremultiply);
+                QVERIFY(std::abs(int(result[0]) - color) <= int(std::ceil(255.0 / alpha)));
+            }
+        }
+    }
+
+    const uchar transparent[] = {12, 34, 56, 0};
+    convertPixels(transparent, result, 1, PixelConversion::Unpremultiply);
+    QCOMPARE(QByteArray(reinterpret_cast<char *>(result), 4), QByteArray(4, 0));
+}
+
+void PixelConversionTest::testBackends_data()
+{
+    QTest::addColumn<PixelConversionBackend>("backend");
+    QTest::addColumn<PixelConversion>("conversion");
+    QTest::addColumn<int>("count");
+
+    const QVector<PixelConversion> conversions{
+        PixelConversion::SwapRedBlue,
+        PixelConversion::PackRgb,
+        PixelConversion::PackSwapRedBlue,
+        PixelConversion::Premultiply,
+        PixelConversion::Unpremultiply,
+    };
+
+    // counts around the vector widths cover the scalar tails
+    const auto backends = supportedPixelConversionBackends();
+    for (PixelConversionBackend backend : backends) {
+        for (PixelConversion conversion : conversions) {
+            for (int count : {1, 3, 4, 7, 8, 9, 10, 15, 16, 17, 33, 1000, 1920}) {
+                QTest::addRow("%s-%d-%d", backendName(backend), int(conversion), count) << backend << conversion << count;
+            }
+        }
+    }
+}
+
+void PixelConversionTest::testBackends()
+{
+    QFETCH(PixelConversionBackend, backend);
+    QFETCH(PixelConversion, conversion);
+    QFETCH(int, count);
+
+    const QByteArray pixels = generatePixels(count);
+    setPixelConversionBackend(PixelConversionBackend::Scalar);
+    const QByteArray expected = convert(pixels, conversion);
+
+    setPixelConversionBackend(backend);
+    QCOMPARE(pixelConversionBackend(), backend);
+    QCOMPARE(convert(pixels, conversion), expected);
+}
+
+void PixelConversionTest::testInPlace_data()
+{
+    QTest::addColumn<PixelConversion>("conversion");
+
+    QTest::newRow("swap") << PixelConversion::SwapRedBlue;
+    QTest::newRow("premultiply") << PixelConversion::Premultiply;
+    QTest::newRow("unpremultiply") << PixelConversion::Unpremultiply;
+}
+
+void PixelConversionTest::testInPlace()
+{
+    QFETCH(PixelConversion, conversion);
+
+    const QByteArray pixels = generatePixels(333);
+    const QByteArray expected = convert(pixels, conversion);
+
+    QByteArray result = pixels;
+    convertPixels(reinterpret_cast<uchar *>(result.data()), reinterpret_cast<uchar *>(result.data()), 333, conversion);
+    QCOMPARE(result, expected);
+}
+
+void PixelConversionTest::testFlipVertically()
+{
+    const QSize size(37, 5);
+    const int stride = size.width() * 4;
+    const QByteArray pixels = generatePixels(size.width() * size.height());
+
+    QByteArray flipped(pixels.size(), Qt::Uninitialized);
+    convertPixels(reinterpret_cast<const uchar *>(pixels.constData()), stride,
+                  reinterpret_cast<uchar *>(flipped.data()), stride, size, PixelConversion::SwapRedBlue, true);
+
+    const QByteArray swapped = convert(pixels, PixelConversion::SwapRedBlue);
+    for (int y = 0; y < size.height(); ++y) {
+        QCOMPARE(flipped.mid(y * stride, stride), swapped.mid((size.height() - 1 - y) * stride, stride));
+    }
+
+    QByteArray inPlace = pixels;
+    convertPixels(reinterpret_cast<const uchar *>(inPlace.constData()), stride,
+                  reinterpret_cast<uchar *>(inPlace.data()), stride, size, PixelConversion::SwapRedBlue, true);
+    QCOMPARE(inPlace, flipped);
+}
+
+void PixelConversionTest::benchmarkConversion_data()
+{
+    QTest::addColumn<PixelConversionBackend>("backend");
+    QTest::addColumn<PixelConversion>("conversion");
+
+    const auto backends = supportedPixelConversionBackends();
+    for (PixelConversionBackend backend : backends) {
+        QTest::addRow("%s swap", backendName(backend)) << backend << PixelConversion::SwapRedBlue;
+        QTest::addRow("%s pack", backendName(backend)) << backend << PixelConversion::PackSwapRedBlue;
+        QTest::addRow("%s premultiply", backendName(backend)) << backend << PixelConversion::Premultiply;
+        QTest::addRow("%s unpremultiply", backendName(backend)) << backend << PixelConversion::Unpremultiply;
+    }
+}
+
+void PixelConversionTest::benchmarkConversion()
+{
+    QFETCH(PixelConversionBackend, backend);
+    QFETCH(PixelConversion, conversion);
+
+    // a 4K frame
+    const int count = 3840 * 2160;
+    const QByteArray pixels = generatePixels(count);
+    QByteArray result(count * 4, Qt::Uninitialized);
+
+    setPixelConversionBackend(backend);
+    QBENCHMARK {
+        convertPixels(reinterpret_cast<const uchar *>(pixels.constData()), reinterpret_cast<uchar *>(result.data()),
+                      count, conversion);
+    }
+}
+
+QTEST_GUILESS_MAIN(PixelConversionTest)
+#include "pixelconversiontest.moc"
@@ -0,0 +1,80 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <QObject>
+#include <QTest>
+
+#include "effects/blur/blurbatchplanner.h"
+
+using namespace KWin;
+
+static QRegion expanded(const QRect &rect)
+{
+    return rect.adjusted(-10, -10, 10, 10);
+}
+
+class TestBlurBatchPlanner : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void batchesIndependentWindows();
+    void splitsOverlappingWindows();
+    void splitsAtUndamagedWindow();
+    void splitsAtTransformedWindow();
+};
+
+void TestBlurBatchPlanner::batchesIndependentWindows()
+{
+    BlurBatchPlanner planner;
+    const QRect first(0, 0, 100, 100);
+    const QRect second(500, 0, 100, 100);
+    QCOMPARE(planner.add(first, first, expanded(first), false), 0);
+    // a window that isn't blurred and doesn't overlap the blurred windows doesn't matter
+    QCOMPARE(planner.add(QRect(0, 500, 100, 100), QRegion(), QRegion(), false), -1);
+    QCOMPARE(planner.add(second, second, expanded(second), false), 0);
+    QCOMPARE(planner.batchCount(), 1);
+}
+
+void TestBlurBatchPlanner::splitsOverlappingWindows()
+{
+    BlurBatchPlanner planner;
+    const QRect first(0, 0, 100, 100);
+    const QRect second(50, 50, 100, 100);
+    QCOMPARE(planner.add(first, first, expanded(first), false), 0);
+    QCOMPARE(planner.add(second, second, expanded(second), false), 1);
+    QCOMPARE(planner.batchCount(), 2);
+}
+
+void TestBlurBatchPlanner::splitsAtUndamagedWindow()
+{
+    BlurBatchPlanner planner;
+    const QRect bottom(0, 0, 100, 100);
+    const QRect top(300, 0, 100, 100);
+    QCOMPARE(planner.add(bottom, bottom, expanded(bottom), false), 0);
+    // the window in between has no damage, but it is repainted below the top window, so the
+    // blur of the top window can't be computed before it is painted
+    QCOMPARE(planner.add(QRect(250, 0, 200, 200), QRegion(), QRegion(), false), -1);
+    QCOMPARE(planner.add(top, top, expanded(top), false), 1);
+    QCOMPARE(planner.batchCount(), 2);
+}
+
+void TestBlurBatchPlanner::splitsAtTransformedWindow()
+{
+    BlurBatchPlanner planner;
+    const QRect bottom(0, 0, 100, 100);
+    const QRect top(500, 0, 100, 100);
+    QCOMPARE(planner.add(bottom, bottom, expanded(bottom), false), 0);
+    QCOMPARE(planner.add(QRect(800, 0, 100, 100), QRegion(), QRegion(), true), -1);
+    QCOMPARE(planner.add(top, top, expanded(top), false), 1);
+
+    planner.clear();
+    QCOMPARE(planner.batchCount(), 0);
+    QCOMPARE(planner.add(bottom, bottom, expanded(bottom), false), 0);
+}
+
+QTEST_GUILESS_MAIN(TestBlurBatchPlanner)
+#include "test_blurbatchplanner.moc"
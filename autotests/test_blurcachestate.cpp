@@ -0,0 +1,106 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <QObject>
+#include <QTest>
+
+#include "effects/blur/blurcachestate.h"
+
+using namespace KWin;
+
+class TestBlurCacheState : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void startsStale();
+    void completesWhenValidated();
+    void invalidatesPaintedBackground();
+    void resetsOnLayoutChange();
+    void resetsOnNewTexture();
+};
+
+static const QRect s_screen(0, 0, 1920, 1080);
+
+void TestBlurCacheState::startsStale()
+{
+    BlurCacheState state;
+    const QRegion area(100, 100, 200, 200);
+    QVERIFY(!state.setLayout(area, area, s_screen));
+    QVERIFY(state.valid().isEmpty());
+    QVERIFY(!state.isComplete(area));
+}
+
+void TestBlurCacheState::completesWhenValidated()
+{
+    BlurCacheState state;
+    const QRegion area(100, 100, 200, 200);
+    state.setLayout(area, area, s_screen);
+    state.validate(QRect(100, 100, 200, 100));
+    QVERIFY(!state.isComplete(area));
+    state.validate(QRect(100, 200, 200, 100));
+    QVERIFY(state.isComplete(area));
+    // the same layout keeps the cache
+    QVERIFY(state.setLayout(area, area, s_screen));
+    QVERIFY(state.isComplete(area));
+    // but it doesn't stand in for another blur region
+    QVERIFY(!state.isComplete(QRegion(100, 100, 200, 250)));
+}
+
+void TestBlurCacheState::invalidatesPaintedBackground()
+{
+    BlurCacheState state;
+    const QRegion area(100, 100, 200, 200);
+    state.setLayout(area, area, s_screen);
+    state.validate(area);
+    QVERIFY(state.isComplete(area));
+
+    // something painted below the window next to it doesn't matter
+    state.invalidate(QRect(400, 100, 100, 100));
+    QVERIFY(state.isComplete(area));
+
+    state.invalidate(QRect(250, 250, 100, 100));
+    QVERIFY(!state.isComplete(area));
+    QCOMPARE(state.valid(), area - QRect(250, 250, 100, 100));
+}
+
+void TestBlurCacheState::resetsOnLayoutChange()
+{
+    const QRegion area(100, 100, 200, 200);
+
+    BlurCacheState moved;
+    moved.setLayout(area, area, s_screen);
+    moved.validate(area);
+    QVERIFY(!moved.setLayout(area.translated(10, 0), area.translated(10, 0), s_screen));
+    QVERIFY(moved.valid().isEmpty());
+
+    // e.g. the rounded corners of the shape changed
+    BlurCacheState reshaped;
+    reshaped.setLayout(area, area, s_screen);
+    reshaped.validate(area);
+    QVERIFY(!reshaped.setLayout(area, area - QRect(100, 100, 8, 8), s_screen));
+    QVERIFY(reshaped.valid().isEmpty());
+
+    BlurCacheState otherScreen;
+    otherScreen.setLayout(area, area, s_screen);
+    otherScreen.validate(area);
+    QVERIFY(!otherScreen.setLayout(area, area, QRect(0, 0, 3840, 1080)));
+    QVERIFY(otherScreen.valid().isEmpty());
+}
+
+void TestBlurCacheState::resetsOnNewTexture()
+{
+    BlurCacheState state;
+    const QRegion area(100, 100, 200, 200);
+    state.setLayout(area, area, s_screen);
+    state.validate(area);
+    state.reset();
+    QVERIFY(!state.isComplete(area));
+    QCOMPARE(state.area(), area);
+}
+
+QTEST_GUILESS_MAIN(TestBlurCacheState)
+#include "test_blurcachestate.moc"
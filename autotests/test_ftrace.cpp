@@ -10,9 +10,44 @@
 #include <QObject>
 #include <QTemporaryFile>
 #include <QTest>
+#include <QThread>
 
 #include "ftrace.h"
 
+static void readBinaryTrace(const QByteArray &data, QHash<quint32, QString> &strings, QVector<KWin::FTraceRecord> &records, QVector<quint32> *threadIds = nullptr)
+{
+    int offset = 16;
+    auto readInt = [&data, &offset]() {
+        quint32 value;
+        memcpy(&value, data.constData() + offset, sizeof(value));
+        offset += sizeof(value);
+        return value;
+    };
+    while (offset < data.size()) {
+        const quint32 type = readInt();
+        if (type == 1) {
+            const quint32 id = readInt();
+            const quint32 size = readInt();
+            strings.insert(id, QString::fromUtf8(data.mid(offset, size)));
+            offset += size;
+        } else {
+            QCOMPARE(type, 2u);
+            const quint32 threadId = readInt();
+            const quint32 count = readInt();
+            readInt();
+            for (quint32 i = 0; i < count; ++i) {
+                KWin::FTraceRecord record;
+                memcpy(&record, data.constData() + offset, sizeof(record));
+                offset += sizeof(record);
+                records.append(record);
+                if (threadIds) {
+                    threadIds->append(threadId);
+                }
+            }
+        }
+    }
+}
+
 class TestFTrace : public QObject
 {
     Q_OBJECT
@@ -22,6 +57,9 @@ private Q_SLOTS:
     void benchmarkTraceOff();
     void benchmarkTraceDurationOff();
     void enable();
+    void binary();
+    void binaryFullBuffers();
+    void benchmarkTraceBinary();
 
 private:
     QTemporaryFile m_tempFile;
@@ -67,6 +105,107 @@ void TestFTrace::enable()
     QCOMPARE(m_tempFile.readLine(), "TEST_DURATIONboo end_ctx=1\n");
 }
 
+void TestFTrace::binary()
+{
+    QTemporaryFile binaryFile;
+    QVERIFY(binaryFile.open());
+
+    KWin::FTraceLogger::self()->startBinaryTrace(binaryFile.fileName());
+    QVERIFY(KWin::FTraceLogger::self()->isEnabled());
+    QCOMPARE(KWin::FTraceLogger::self()->mode(), KWin::FTraceLogger::Mode::Binary);
+
+    {
+        fTrace("TEST", 123, "foo");
+        fTraceDuration("TEST_DURATION", QStringLiteral("boo"));
+        fTrace("TEST", 123, "foo");
+    }
+    {
+        // a reused buffer must not be interned by its address
+        char buffer[8];
+        const char *name = buffer;
+        qstrcpy(buffer, "bar");
+        fTrace("TEST", name);
+        qstrcpy(buffer, "baz");
+        fTrace("TEST", name);
+    }
+
+    KWin::FTraceLogger::self()->setEnabled(false);
+    QVERIFY(!KWin::FTraceLogger::self()->isEnabled());
+    QCOMPARE(KWin::FTraceLogger::self()->mode(), KWin::FTraceLogger::Mode::Text);
+
+    const QByteArray data = binaryFile.readAll();
+    QVERIFY(data.startsWith("KWINTRC1"));
+
+    QHash<quint32, QString> strings;
+    QVector<KWin::FTraceRecord> records;
+    readBinaryTrace(data, strings, records);
+
+    QCOMPARE(records.count(), 6);
+    QCOMPARE(records[0].type, quint8(KWin::FTraceRecord::Instant));
+    QCOMPARE(records[0].argumentCount, quint8(3));
+    QCOMPARE(strings.value(quint32(records[0].arguments[0])), QStringLiteral("TEST"));
+    QCOMPARE(records[0].argumentKinds[1], quint8(KWin::FTraceRecord::Integer));
+    QCOMPARE(records[0].arguments[1], qint64(123));
+    QCOMPARE(strings.value(quint32(records[0].arguments[2])), QStringLiteral("foo"));
+    QCOMPARE(records[1].type, quint8(KWin::FTraceRecord::Begin));
+    QCOMPARE(strings.value(quint32(records[1].arguments[1])), QStringLiteral("boo"));
+    QCOMPARE(records[2].type, quint8(KWin::FTraceRecord::Instant));
+    QCOMPARE(records[3].type, quint8(KWin::FTraceRecord::End));
+    QCOMPARE(records[3].context, records[1].context);
+    QVERIFY(records[0].timestamp <= records[3].timestamp);
+    QCOMPARE(strings.value(quint32(records[4].arguments[1])), QStringLiteral("bar"));
+    QCOMPARE(strings.value(quint32(records[5].arguments[1])), QStringLiteral("baz"));
+}
+
+void TestFTrace::binaryFullBuffers()
+{
+    // Full buffers are handed to the writer thread, all records must still end up in the
+    // file in the order in which each thread traced them.
+    QTemporaryFile binaryFile;
+    QVERIFY(binaryFile.open());
+    KWin::FTraceLogger::self()->startBinaryTrace(binaryFile.fileName());
+
+    const int recordCount = 10000;
+    auto traceRecords = [recordCount]() {
+        for (int i = 0; i < recordCount; ++i) {
+            fTrace("TEST", i);
+        }
+    };
+    QScopedPointer<QThread> thread(QThread::create(traceRecords));
+    thread->start();
+    traceRecords();
+    QVERIFY(thread->wait());
+
+    KWin::FTraceLogger::self()->setEnabled(false);
+
+    const QByteArray data = binaryFile.readAll();
+    QHash<quint32, QString> strings;
+    QVector<KWin::FTraceRecord> records;
+    QVector<quint32> threadIds;
+    readBinaryTrace(data, strings, records, &threadIds);
+
+    QCOMPARE(records.count(), 2 * recordCount);
+    QHash<quint32, qint64> nextValue;
+    for (int i = 0; i < records.count(); ++i) {
+        QCOMPARE(strings.value(quint32(records[i].arguments[0])), QStringLiteral("TEST"));
+        QCOMPARE(records[i].arguments[1], nextValue[threadIds[i]]++);
+    }
+    QCOMPARE(nextValue.count(), 2);
+}
+
+void TestFTrace::benchmarkTraceBinary()
+{
+    QTemporaryFile binaryFile;
+    QVERIFY(binaryFile.open());
+    KWin::FTraceLogger::self()->startBinaryTrace(binaryFile.fileName());
+
+    QBENCHMARK {
+        fTraceDuration("BENCH", 123, QStringLiteral("foo"));
+    }
+
+    KWin::FTraceLogger::self()->setEnabled(false);
+}
+
 QTEST_MAIN(TestFTrace)
 
 #include "test_ftrace.moc"
@@ -0,0 +1,392 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <QFile>
+#include <QObject>
+#include <QTest>
+
+#include "utils/hittestgrid.h"
+
+#include <random>
+
+using namespace KWin;
+
+enum class Layout {
+    Cascaded,
+    Tiled,
+    Maximized,
+};
+Q_DECLARE_METATYPE(Layout)
+
+static const QVector<QRect> s_outputs{
+    QRect(0, 0, 3840, 2160),
+    QRect(3840, 0, 1920, 1080),
+};
+
+/**
+ * Generates window bounds in test order, i.e. top-most first.
+ */
+static QVector<QRect> generateLayout(Layout layout, int count)
+{
+    std::mt19937 generator(42);
+    QVector<QRect> bounds;
+    bounds.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        const QRect &output = s_outputs[i % s_outputs.count()];
+        switch (layout) {
+        case Layout::Cascaded: {
+            std::uniform_int_distribution<int> width(300, output.width() / 2);
+            std::uniform_int_distribution<int> height(200, output.height() / 2);
+            const int offset = (i * 40) % (output.height() / 2);
+            bounds.append(QRect(output.topLeft() + QPoint(offset, offset), QSize(width(generator), height(generator))));
+            break;
+        }
+        case Layout::Tiled: {
+            const int columns = 4;
+            const QSize size(output.width() / columns, output.height() / columns);
+            const int tile = (i / s_outputs.count()) % (columns * columns);
+            bounds.append(QRect(output.topLeft() + QPoint(tile % columns * size.width(), tile / columns * size.height()), size));
+            break;
+        }
+        case Layout::Maximized:
+            bounds.append(output);
+            break;
+        }
+    }
+    return bounds;
+}
+
+/**
+ * Replays a pointer trace recorded at 1000 Hz, one "x y" pair per line, from the file named
+ * by KWIN_TEST_POINTER_TRACE. Without a recording, a random walk over all outputs is used.
+ */
+static QVector<QPoint> pointerTrace()
+{
+    QVector<QPoint> trace;
+
+    QFile file(qEnvironmentVariable("KWIN_TEST_POINTER_TRACE"));
+    if (!file.fileName().isEmpty() && file.open(QIODevice::ReadOnly)) {
+        while (!file.atEnd()) {
+            const QList<QByteArray> coordinates = file.readLine().simplified().split(' ');
+            if (coordinates.count() == 2) {
+                trace.append(QPoint(coordinates[0].toInt(), coordinates[1].toInt()));
+            }
+        }
+        return trace;
+    }
+
+    std::mt19937 generator(42);
+    std::normal_distribution<double> step(0, 8);
+    QPoint pos(1920, 1080);
+    for (int i = 0; i < 10000; ++i) {
+        pos += QPoint(qRound(step(generator)), qRound(step(generator)));
+        pos.setX(qBound(0, pos.x(), 5759));
+        pos.setY(qBound(0, pos.y(), 2159));
+        trace.append(pos);
+    }
+    return trace;
+}
+
+static int findLinear(const QVector<QRect> &bounds, const QPoint &pos, int rejected = -1)
+{
+    for (int i = 0; i < bounds.count(); ++i) {
+        if (i != rejected && bounds[i].contains(pos)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+class TestHitTestGrid : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void findsTopMost();
+    void spansOutputs();
+    void outsideOutputs();
+    void matchesLinearSearch_data();
+    void matchesLinearSearch();
+    void movedWindows();
+    void matchesLinearSearchWhileMoving_data();
+    void matchesLinearSearchWhileMoving();
+    void benchmarkTrace_data();
+    void benchmarkTrace();
+    void benchmarkMove_data();
+    void benchmarkMove();
+};
+
+void TestHitTestGrid::findsTopMost()
+{
+    const QVector<QRect> bounds{
+        QRect(100, 100, 200, 200),
+        QRect(0, 0, 1000, 1000),
+        QRect(150, 150, 10, 10),
+    };
+    HitTestGrid grid;
+    grid.build(s_outputs, bounds);
+
+    auto acceptAll = [](int) {
+        return true;
+    };
+    QCOMPARE(grid.find(QPoint(155, 155), acceptAll), 0);
+    QCOMPARE(grid.find(QPoint(50, 50), acceptAll), 1);
+    QCOMPARE(grid.find(QPoint(299, 299), acceptAll), 0);
+    QCOMPARE(grid.find(QPoint(300, 300), acceptAll), 1);
+    QCOMPARE(grid.find(QPoint(2000, 2000), acceptAll), -1);
+
+    // a window that rejects the point lets it through to the windows below
+    QCOMPARE(grid.find(QPoint(155, 155), [](int index) {
+        return index != 0;
+    }), 1);
+    QCOMPARE(grid.find(QPoint(155, 155), [](int index) {
+        return index == 2;
+    }), 2);
+    QCOMPARE(grid.candidateCount(QPoint(2000, 2000)), 0);
+}
+
+void TestHitTestGrid::spansOutputs()
+{
+    const QVector<QRect> bounds{
+        QRect(3000, 500, 2000, 300),
+    };
+    HitTestGrid grid;
+    grid.build(s_outputs, bounds);
+
+    auto acceptAll = [](int) {
+        return true;
+    };
+    QCOMPARE(grid.find(QPoint(3500, 600), acceptAll), 0);
+    QCOMPARE(grid.find(QPoint(4500, 600), acceptAll), 0);
+    QCOMPARE(grid.find(QPoint(4999, 799), acceptAll), 0);
+    QCOMPARE(grid.find(QPoint(5000, 600), acceptAll), -1);
+}
+
+void TestHitTestGrid::outsideOutputs()
+{
+    // the second output is shorter, the bottom right area is not covered by any output
+    const QVector<QRect> bounds{
+        QRect(5000, 1000, 500, 500),
+        QRect(-100, -100, 50, 50),
+    };
+    HitTestGrid grid;
+    grid.build(s_outputs, bounds);
+
+    auto acceptAll = [](int) {
+        return true;
+    };
+    QCOMPARE(grid.find(QPoint(5100, 1050), acceptAll), 0);
+    QCOMPARE(grid.find(QPoint(5100, 1200), acceptAll), 0);
+    QCOMPARE(grid.find(QPoint(-80, -80), acceptAll), 1);
+    QCOMPARE(grid.find(QPoint(-10, -10), acceptAll), -1);
+}
+
+void TestHitTestGrid::matchesLinearSearch_data()
+{
+    QTest::addColumn<Layout>("layout");
+    QTest::addColumn<int>("count");
+
+    for (int count : {1, 10, 50, 200}) {
+        QTest::addRow("cascaded %d", count) << Layout::Cascaded << count;
+        QTest::addRow("tiled %d", count) << Layout::Tiled << count;
+        QTest::addRow("maximized %d", count) << Layout::Maximized << count;
+    }
+}
+
+void TestHitTestGrid::matchesLinearSearch()
+{
+    QFETCH(Layout, layout);
+    QFETCH(int, count);
+
+    const QVector<QRect> bounds = generateLayout(layout, count);
+    HitTestGrid grid;
+    grid.build(s_outputs, bounds);
+
+    // reject one of the windows to check that the search continues below it
+    const int rejected = count / 2;
+    const QVector<QPoint> trace = pointerTrace();
+    for (const QPoint &pos : trace) {
+        QCOMPARE(grid.find(pos, [rejected](int index) {
+            return index != rejected;
+        }), findLinear(bounds, pos, rejected));
+    }
+}
+
+void TestHitTestGrid::movedWindows()
+{
+    QVector<QRect> bounds{
+        QRect(0, 0, 100, 100),
+        QRect(0, 0, 1000, 1000),
+        QRect(2000, 0, 100, 100),
+    };
+    HitTestGrid grid;
+    grid.build(s_outputs, bounds);
+
+    auto acceptAll = [](int) {
+        return true;
+    };
+    // moved to a cell it wasn't in before, and away from the cells it was in
+    QVERIFY(grid.move(0, QRect(3000, 1000, 100, 100)));
+    QCOMPARE(grid.find(QPoint(3050, 1050), acceptAll), 0);
+    QCOMPARE(grid.find(QPoint(50, 50), acceptAll), 1);
+
+    // moved back on top of a window it was above before
+    QVERIFY(grid.move(0, QRect(500, 500, 100, 100)));
+    QCOMPARE(grid.find(QPoint(550, 550), acceptAll), 0);
+    QCOMPARE(grid.find(QPoint(3050, 1050), acceptAll), -1);
+
+    // windows below the moved window are still found in order
+    QVERIFY(grid.move(2, QRect(400, 400, 300, 300)));
+    QCOMPARE(grid.find(QPoint(550, 550), acceptAll), 0);
+    QCOMPARE(grid.find(QPoint(450, 450), acceptAll), 1);
+    QCOMPARE(grid.find(QPoint(450, 450), [](int index) {
+        return index != 1;
+    }), 2);
+    QCOMPARE(grid.find(QPoint(2050, 50), acceptAll), -1);
+
+    // too many moved windows need a rebuild, but moving the same ones again doesn't
+    bounds = generateLayout(Layout::Cascaded, 20);
+    grid.build(s_outputs, bounds);
+    for (int i = 0; i < 8; ++i) {
+        QVERIFY(grid.move(i, bounds[i]));
+    }
+    QVERIFY(grid.move(0, bounds[0]));
+    QVERIFY(!grid.move(8, bounds[8]));
+    grid.build(s_outputs, bounds);
+    QVERIFY(grid.move(8, bounds[8]));
+}
+
+void TestHitTestGrid::matchesLinearSearchWhileMoving_data()
+{
+    QTest::addColumn<Layout>("layout");
+    QTest::addColumn<int>("count");
+
+    for (int count : {1, 10, 50, 200}) {
+        QTest::addRow("cascaded %d", count) << Layout::Cascaded << count;
+        QTest::addRow("tiled %d", count) << Layout::Tiled << count;
+        QTest::addRow("maximized %d", count) << Layout::Maximized << count;
+    }
+}
+
+void TestHitTestGrid::matchesLinearSearchWhileMoving()
+{
+    QFETCH(Layout, layout);
+    QFETCH(int, count);
+
+    QVector<QRect> bounds = generateLayout(layout, count);
+    HitTestGrid grid;
+    grid.build(s_outputs, bounds);
+
+    // the window is dragged by its center, so the pointer stays on top of it
+    const int dragged = count / 3;
+    const int rejected = count / 2;
+    const QVector<QPoint> trace = pointerTrace();
+    for (const QPoint &pos : trace) {
+        bounds[dragged].moveCenter(pos);
+        QVERIFY(grid.move(dragged, bounds[dragged]));
+        const QPoint probe = pos + QPoint(bounds[dragged].width(), 0);
+        for (const QPoint &point : {pos, probe}) {
+            QCOMPARE(grid.find(point, [rejected](int index) {
+                return index != rejected;
+            }), findLinear(bounds, point, rejected));
+        }
+    }
+}
+
+void TestHitTestGrid::benchmarkTrace_data()
+{
+    QTest::addColumn<Layout>("layout");
+    QTest::addColumn<int>("count");
+    QTest::addColumn<bool>("indexed");
+
+    for (int count : {10, 50, 200}) {
+        for (bool indexed : {false, true}) {
+            const char *method = indexed ? "grid" : "linear";
+            QTest::addRow("cascaded %d %s", count, method) << Layout::Cascaded << count << indexed;
+            QTest::addRow("tiled %d %s", count, method) << Layout::Tiled << count << indexed;
+        }
+    }
+}
+
+void TestHitTestGrid::benchmarkTrace()
+{
+    QFETCH(Layout, layout);
+    QFETCH(int, count);
+    QFETCH(bool, indexed);
+
+    const QVector<QRect> bounds = generateLayout(layout, count);
+    const QVector<QPoint> trace = pointerTrace();
+    HitTestGrid grid;
+    grid.build(s_outputs, bounds);
+
+    int hits = 0;
+    QBENCHMARK {
+        for (const QPoint &pos : trace) {
+            if (indexed) {
+                hits += grid.find(pos, [](int) {
+                    return true;
+                }) != -1;
+            } else {
+                hits += findLinear(bounds, pos) != -1;
+            }
+        }
+    }
+    QVERIFY(hits >= 0);
+}
+
+void TestHitTestGrid::benchmarkMove_data()
+{
+    QTest::addColumn<Layout>("layout");
+    QTest::addColumn<int>("count");
+    QTest::addColumn<QString>("method");
+
+    for (int count : {10, 50, 200}) {
+        for (const char *method : {"linear", "rebuild", "move"}) {
+            QTest::addRow("cascaded %d %s", count, method) << Layout::Cascaded << count << QString::fromLatin1(method);
+            QTest::addRow("tiled %d %s", count, method) << Layout::Tiled << count << QString::fromLatin1(method);
+        }
+    }
+}
+
+void TestHitTestGrid::benchmarkMove()
+{
+    // A window is dragged along the trace, i.e. its geometry changes with every pointer
+    // motion and the window under the pointer is looked up afterwards.
+    QFETCH(Layout, layout);
+    QFETCH(int, count);
+    QFETCH(QString, method);
+
+    QVector<QRect> bounds = generateLayout(layout, count);
+    const QVector<QPoint> trace = pointerTrace();
+    HitTestGrid grid;
+    grid.build(s_outputs, bounds);
+
+    auto acceptAll = [](int) {
+        return true;
+    };
+    const int dragged = count / 3;
+    int hits = 0;
+    QBENCHMARK {
+        for (const QPoint &pos : trace) {
+            bounds[dragged].moveCenter(pos);
+            if (method == QLatin1String("linear")) {
+                hits += findLinear(bounds, pos) != -1;
+            } else if (method == QLatin1String("rebuild")) {
+                grid.build(s_outputs, bounds);
+                hits += grid.find(pos, acceptAll) != -1;
+            } else {
+                if (!grid.move(dragged, bounds[dragged])) {
+                    grid.build(s_outputs, bounds);
+                }
+                hits += grid.find(pos, acceptAll) != -1;
+            }
+        }
+    }
+    QVERIFY(hits >= 0);
+}
+
+QTEST_MAIN(TestHitTestGrid)
+#include "test_hittestgrid.moc"
@@ -0,0 +1,69 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <QObject>
+#include <QTest>
+
+#include "scenes/opengl/overlaycandidatefilter.h"
+
+using namespace KWin;
+
+class TestOverlayCandidateFilter : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void acceptsUncoveredOpaqueItems();
+    void rejectsTranslucentItems();
+    void rejectsCoveredItems();
+    void rejectsItemsOutsideOutput();
+    void rejectsItemsBelowCursor();
+};
+
+void TestOverlayCandidateFilter::acceptsUncoveredOpaqueItems()
+{
+    OverlayCandidateFilter filter(QRect(0, 0, 1920, 1080));
+    QVERIFY(filter.offer(QRect(100, 100, 640, 480), true));
+    // items next to each other don't cover each other
+    QVERIFY(filter.offer(QRect(800, 100, 640, 480), true));
+}
+
+void TestOverlayCandidateFilter::rejectsTranslucentItems()
+{
+    OverlayCandidateFilter filter(QRect(0, 0, 1920, 1080));
+    QVERIFY(!filter.offer(QRect(100, 100, 640, 480), false));
+    // the translucent item is painted on top of the items below it
+    QVERIFY(!filter.offer(QRect(0, 0, 1920, 1080), true));
+}
+
+void TestOverlayCandidateFilter::rejectsCoveredItems()
+{
+    OverlayCandidateFilter filter(QRect(0, 0, 1920, 1080));
+    // e.g. the controls of a video player above its video surface
+    QVERIFY(filter.offer(QRect(100, 500, 640, 80), true));
+    QVERIFY(!filter.offer(QRect(100, 100, 640, 480), true));
+    // the covered item still covers the items below it
+    QVERIFY(!filter.offer(QRect(500, 300, 400, 400), true));
+    QVERIFY(filter.offer(QRect(1000, 100, 640, 480), true));
+}
+
+void TestOverlayCandidateFilter::rejectsItemsOutsideOutput()
+{
+    OverlayCandidateFilter filter(QRect(1920, 0, 1920, 1080));
+    QVERIFY(!filter.offer(QRect(0, 0, 640, 480), true));
+    QVERIFY(!filter.offer(QRect(1800, 100, 640, 480), true));
+    QVERIFY(filter.offer(QRect(2000, 600, 640, 480), true));
+}
+
+void TestOverlayCandidateFilter::rejectsItemsBelowCursor()
+{
+    OverlayCandidateFilter filter(QRect(0, 0, 1920, 1080), QRect(400, 300, 24, 24));
+    QVERIFY(!filter.offer(QRect(100, 100, 640, 480), true));
+    QVERIFY(filter.offer(QRect(1000, 100, 640, 480), true));
+}
+
+QTEST_GUILESS_MAIN(TestOverlayCandidateFilter)
+#include "test_overlaycandidatefilter.moc"
@@ -0,0 +1,134 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <QObject>
+#include <QTest>
+
+#include "renderjournal.h"
+
+using namespace KWin;
+
+class TestRenderJournal : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void timelineStages();
+    void presentationOrder();
+    void ringBufferWraps();
+    void costModelPerWorkload();
+    void benchmarkFrame();
+};
+
+void TestRenderJournal::timelineStages()
+{
+    RenderJournal journal;
+    QVERIFY(journal.timeline().isEmpty());
+
+    journal.markStage(RenderJournal::Stage::Composite);
+    journal.beginFrame();
+    journal.markStage(RenderJournal::Stage::PrePaint);
+    journal.markStage(RenderJournal::Stage::Paint);
+    journal.endFrame();
+    journal.markStage(RenderJournal::Stage::Submit);
+    journal.notifyFramePresented(std::chrono::steady_clock::now().time_since_epoch());
+
+    const QVector<RenderJournal::FrameTimings> timeline = journal.timeline();
+    QCOMPARE(timeline.count(), 1);
+    const RenderJournal::FrameTimings &frame = timeline.first();
+    QCOMPARE(frame.sequence, quint64(1));
+    QVERIFY(!frame.failed);
+    for (int i = 1; i < int(RenderJournal::Stage::Count); ++i) {
+        QVERIFY(frame.stages[i] != std::chrono::nanoseconds::zero());
+        QVERIFY(frame.stages[i - 1] <= frame.stages[i]);
+    }
+}
+
+void TestRenderJournal::presentationOrder()
+{
+    RenderJournal journal;
+
+    journal.beginFrame();
+    journal.endFrame();
+    journal.beginFrame();
+    journal.endFrame();
+
+    journal.notifyFrameFailed();
+    journal.notifyFramePresented(std::chrono::nanoseconds(42));
+    // nothing is pending anymore, so this must not touch any frame
+    journal.notifyFramePresented(std::chrono::nanoseconds(43));
+
+    const QVector<RenderJournal::FrameTimings> timeline = journal.timeline();
+    QCOMPARE(timeline.count(), 2);
+    QVERIFY(timeline[0].failed);
+    QCOMPARE(timeline[0].at(RenderJournal::Stage::Presented), std::chrono::nanoseconds::zero());
+    QVERIFY(!timeline[1].failed);
+    QCOMPARE(timeline[1].at(RenderJournal::Stage::Presented), std::chrono::nanoseconds(42));
+}
+
+void TestRenderJournal::ringBufferWraps()
+{
+    RenderJournal journal;
+    for (int i = 0; i < 1000; ++i) {
+        journal.beginFrame();
+        journal.endFrame();
+    }
+
+    const QVector<RenderJournal::FrameTimings> timeline = journal.timeline();
+    QVERIFY(!timeline.isEmpty());
+    QVERIFY(timeline.count() < 1000);
+    QCOMPARE(timeline.last().sequence, quint64(1000));
+    for (int i = 1; i < timeline.count(); ++i) {
+        QCOMPARE(timeline[i].sequence, timeline[i - 1].sequence + 1);
+    }
+}
+
+void TestRenderJournal::costModelPerWorkload()
+{
+    using namespace std::chrono_literals;
+
+    RenderJournal journal;
+    // without enough samples, the prediction falls back to the maximum
+    journal.add(2ms, RenderJournal::Workload::Idle);
+    journal.add(8ms, RenderJournal::Workload::Effects);
+    QCOMPARE(journal.predict(RenderJournal::Workload::Idle), std::chrono::nanoseconds(8ms));
+
+    for (int i = 0; i < 100; ++i) {
+        journal.add(2ms, RenderJournal::Workload::Idle);
+        journal.add(8ms, RenderJournal::Workload::Effects);
+    }
+    QCOMPARE(journal.workload(), RenderJournal::Workload::Effects);
+    QVERIFY(journal.predict(RenderJournal::Workload::Idle) >= 2ms);
+    QVERIFY(journal.predict(RenderJournal::Workload::Idle) < 2100us);
+    QVERIFY(journal.predict(RenderJournal::Workload::Effects) >= 8ms);
+    QVERIFY(journal.predict(RenderJournal::Workload::Effects) < 8100us);
+
+    // frames are tagged as idle unless the scene says otherwise
+    journal.beginFrame();
+    journal.endFrame();
+    QCOMPARE(journal.workload(), RenderJournal::Workload::Idle);
+    journal.beginFrame();
+    journal.setWorkload(RenderJournal::Workload::Effects);
+    journal.endFrame();
+    QCOMPARE(journal.workload(), RenderJournal::Workload::Effects);
+}
+
+void TestRenderJournal::benchmarkFrame()
+{
+    RenderJournal journal;
+    QBENCHMARK {
+        journal.markStage(RenderJournal::Stage::Composite);
+        journal.beginFrame();
+        journal.markStage(RenderJournal::Stage::PrePaint);
+        journal.markStage(RenderJournal::Stage::Paint);
+        journal.endFrame();
+        journal.markStage(RenderJournal::Stage::Submit);
+        journal.notifyFramePresented(std::chrono::nanoseconds(1));
+    }
+}
+
+QTEST_MAIN(TestRenderJournal)
+#include "test_renderjournal.moc"
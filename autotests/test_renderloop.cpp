@@ -0,0 +1,154 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <QObject>
+#include <QTest>
+
+#include "renderloop.h"
+#include "renderloop_p.h"
+
+#include <random>
+
+using namespace KWin;
+using namespace std::chrono_literals;
+
+struct SyntheticFrame
+{
+    std::chrono::nanoseconds cost;
+    RenderJournal::Workload workload;
+};
+
+struct SimulationResult
+{
+    int missedFrames = 0;
+    std::chrono::nanoseconds averageLatency = 0ns;
+};
+
+/**
+ * Drives a render loop at 144Hz with the given synthetic frame costs, without any timers.
+ * After the cpu part of a frame, the submission takes @a hiddenCost that is not visible
+ * to the render journal, like the gpu does in reality.
+ */
+static SimulationResult simulate(RenderLoop *loop, RenderTimeEstimator estimator,
+                                 const QVector<SyntheticFrame> &frames,
+                                 std::chrono::nanoseconds hiddenCost)
+{
+    RenderLoopPrivate *d = RenderLoopPrivate::get(loop);
+    d->renderTimeEstimator = estimator;
+    d->latencyPolicy = LatencyMedium;
+
+    const std::chrono::nanoseconds vblankInterval(1'000'000'000'000ull / loop->refreshRate());
+    d->lastPresentationTimestamp = vblankInterval * 1000;
+
+    SimulationResult result;
+    std::chrono::nanoseconds totalLatency = 0ns;
+    for (const SyntheticFrame &frame : frames) {
+        // The compositor asks for a new frame shortly after the previous one is presented.
+        const std::chrono::nanoseconds currentTime = d->lastPresentationTimestamp + 100us;
+        const std::chrono::nanoseconds renderTimestamp = d->computeNextRenderTimestamp(currentTime);
+        const std::chrono::nanoseconds readyTimestamp = renderTimestamp + frame.cost + hiddenCost;
+
+        std::chrono::nanoseconds presentationTimestamp = d->lastPresentationTimestamp + vblankInterval;
+        while (presentationTimestamp < readyTimestamp) {
+            presentationTimestamp += vblankInterval;
+        }
+        if (presentationTimestamp > d->nextPresentationTimestamp) {
+            result.missedFrames++;
+        }
+        totalLatency += presentationTimestamp - renderTimestamp;
+
+        d->pendingFrameCount++;
+        d->renderJournal.add(frame.cost, frame.workload);
+        d->notifyFrameCompleted(presentationTimestamp);
+    }
+
+    result.averageLatency = totalLatency / frames.count();
+    return result;
+}
+
+static QVector<SyntheticFrame> generateFrames(int count, std::chrono::microseconds cost,
+                                              std::chrono::microseconds jitter,
+                                              RenderJournal::Workload workload, std::mt19937 &generator)
+{
+    std::uniform_int_distribution<int> distribution(-int(jitter.count()), int(jitter.count()));
+
+    QVector<SyntheticFrame> frames;
+    frames.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        frames.append(SyntheticFrame{cost + std::chrono::microseconds(distribution(generator)), workload});
+    }
+    return frames;
+}
+
+class TestRenderLoop : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void predictiveReducesLatency();
+    void safetyMarginAdapts();
+    void workloadSwitch();
+};
+
+void TestRenderLoop::predictiveReducesLatency()
+{
+    std::mt19937 generator(42);
+    const QVector<SyntheticFrame> frames = generateFrames(2000, 2100us, 300us, RenderJournal::Workload::Idle, generator);
+
+    RenderLoop maximumLoop;
+    maximumLoop.setRefreshRate(144000);
+    const SimulationResult maximum = simulate(&maximumLoop, RenderTimeEstimatorMaximum, frames, 500us);
+
+    RenderLoop predictiveLoop;
+    predictiveLoop.setRefreshRate(144000);
+    const SimulationResult predictive = simulate(&predictiveLoop, RenderTimeEstimatorPredictive, frames, 500us);
+
+    QVERIFY(predictive.missedFrames <= maximum.missedFrames);
+    QVERIFY(predictive.averageLatency < maximum.averageLatency);
+    QCOMPARE(RenderLoopPrivate::get(&predictiveLoop)->safetyMargin, RenderLoopPrivate::minimumSafetyMargin);
+}
+
+void TestRenderLoop::safetyMarginAdapts()
+{
+    // The hidden cost is larger than the minimum safety margin, the margin has to grow.
+    std::mt19937 generator(42);
+    const QVector<SyntheticFrame> frames = generateFrames(3000, 2100us, 300us, RenderJournal::Workload::Idle, generator);
+
+    RenderLoop loop;
+    loop.setRefreshRate(144000);
+    const SimulationResult result = simulate(&loop, RenderTimeEstimatorPredictive, frames, 2ms);
+
+    QVERIFY(result.missedFrames > 0);
+    QVERIFY(result.missedFrames <= frames.count() / 100);
+    QVERIFY(RenderLoopPrivate::get(&loop)->safetyMargin > RenderLoopPrivate::minimumSafetyMargin);
+}
+
+void TestRenderLoop::workloadSwitch()
+{
+    std::mt19937 generator(42);
+    QVector<SyntheticFrame> frames;
+    const int switchCount = 4;
+    for (int i = 0; i < switchCount; ++i) {
+        frames += generateFrames(300, 1500us, 200us, RenderJournal::Workload::Idle, generator);
+        frames += generateFrames(300, 4500us, 200us, RenderJournal::Workload::Effects, generator);
+    }
+    frames += generateFrames(10, 1500us, 200us, RenderJournal::Workload::Idle, generator);
+
+    RenderLoop loop;
+    loop.setRefreshRate(144000);
+    const SimulationResult result = simulate(&loop, RenderTimeEstimatorPredictive, frames, 500us);
+
+    // Only the first frame after an effect has started may miss its vblank.
+    QVERIFY(result.missedFrames <= switchCount);
+
+    // The expensive frames must not leak into the estimate for idle frames.
+    const RenderJournal &journal = RenderLoopPrivate::get(&loop)->renderJournal;
+    QVERIFY(journal.predict(RenderJournal::Workload::Idle) < 2500us);
+    QVERIFY(journal.predict(RenderJournal::Workload::Effects) > 4ms);
+}
+
+QTEST_MAIN(TestRenderLoop)
+#include "test_renderloop.moc"
@@ -0,0 +1,103 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <QObject>
+#include <QTest>
+
+#include "utils/spscqueue.h"
+
+#include <thread>
+
+using namespace KWin;
+
+class TestSpscQueue : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void roundsCapacity();
+    void pushPop();
+    void wrapsAround();
+    void crossThread();
+};
+
+void TestSpscQueue::roundsCapacity()
+{
+    QCOMPARE(SpscQueue<int>(1).capacity(), 1u);
+    QCOMPARE(SpscQueue<int>(5).capacity(), 8u);
+    QCOMPARE(SpscQueue<int>(1024).capacity(), 1024u);
+}
+
+void TestSpscQueue::pushPop()
+{
+    SpscQueue<int> queue(4);
+    QVERIFY(queue.isEmpty());
+    QVERIFY(!queue.peek());
+
+    for (int i = 0; i < 4; ++i) {
+        QVERIFY(queue.push(i));
+    }
+    // a full queue rejects values without overwriting the oldest one
+    QVERIFY(!queue.push(4));
+    QCOMPARE(*queue.peek(), 0);
+
+    int value = -1;
+    for (int i = 0; i < 4; ++i) {
+        QVERIFY(queue.pop(value));
+        QCOMPARE(value, i);
+    }
+    QVERIFY(!queue.pop(value));
+    QVERIFY(queue.isEmpty());
+}
+
+void TestSpscQueue::wrapsAround()
+{
+    SpscQueue<int> queue(4);
+    int value = -1;
+    for (int i = 0; i < 100; ++i) {
+        QVERIFY(queue.push(i));
+        QVERIFY(queue.push(i + 1000));
+        QVERIFY(queue.pop(value));
+        QCOMPARE(value, i);
+        QVERIFY(queue.pop(value));
+        QCOMPARE(value, i + 1000);
+    }
+    QVERIFY(queue.isEmpty());
+}
+
+void TestSpscQueue::crossThread()
+{
+    const int count = 1000000;
+    SpscQueue<int> queue(64);
+
+    std::thread producer([&queue, count]() {
+        for (int i = 0; i < count; ++i) {
+            while (!queue.push(i)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    // the values arrive complete and in order
+    int expected = 0;
+    int value = -1;
+    bool ordered = true;
+    while (expected < count) {
+        if (queue.pop(value)) {
+            ordered = ordered && value == expected;
+            ++expected;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+
+    QVERIFY(ordered);
+    QVERIFY(queue.isEmpty());
+}
+
+QTEST_MAIN(TestSpscQueue)
+#include "test_spscqueue.moc"
@@ -0,0 +1,151 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <QObject>
+#include <QTest>
+
+#include "effects/multitaskview/windowgridlayout.h"
+
+#include <random>
+
+using namespace KWin;
+
+static QVector<QSize> generateSizes(int count)
+{
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> width(300, 1920);
+    std::uniform_int_distribution<int> height(200, 1080);
+
+    QVector<QSize> sizes;
+    sizes.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        sizes.append(QSize(width(generator), height(generator)));
+    }
+    return sizes;
+}
+
+static QVector<const void *> generateWindows(int count)
+{
+    QVector<const void *> windows;
+    windows.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        windows.append(reinterpret_cast<const void *>(quintptr(i + 1) * 64));
+    }
+    return windows;
+}
+
+static WindowGridParameters parametersFor4K()
+{
+    WindowGridParameters parameters;
+    parameters.area = QRect(0, 300, 3840, 1820);
+    parameters.maxHeight = 2160 * 720.0 / 1080.0;
+    parameters.spacingWidth = 40;
+    parameters.spacingHeight = 40;
+    return parameters;
+}
+
+class TestWindowGridLayout : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void layoutFitsArea_data();
+    void layoutFitsArea();
+    void cacheReusesLayout();
+    void benchmarkLayout_data();
+    void benchmarkLayout();
+    void benchmarkCachedLayout_data();
+    void benchmarkCachedLayout();
+};
+
+void TestWindowGridLayout::layoutFitsArea_data()
+{
+    QTest::addColumn<int>("count");
+
+    for (int count : {1, 10, 50, 100, 200}) {
+        QTest::addRow("%d windows", count) << count;
+    }
+}
+
+void TestWindowGridLayout::layoutFitsArea()
+{
+    QFETCH(int, count);
+    const WindowGridParameters parameters = parametersFor4K();
+    const QVector<WindowGridCell> cells = computeWindowGridLayout(generateSizes(count), parameters);
+    QCOMPARE(cells.count(), count);
+
+    for (int i = 0; i < cells.count(); ++i) {
+        QVERIFY(!cells[i].geometry.isEmpty());
+        QVERIFY(cells[i].geometry.top() >= parameters.area.top());
+        QVERIFY(cells[i].geometry.bottom() <= parameters.area.bottom());
+        for (int j = i + 1; j < cells.count(); ++j) {
+            QVERIFY(!cells[i].geometry.intersects(cells[j].geometry));
+        }
+    }
+}
+
+void TestWindowGridLayout::cacheReusesLayout()
+{
+    const WindowGridParameters parameters = parametersFor4K();
+    QVector<QSize> sizes = generateSizes(20);
+    const QVector<const void *> windows = generateWindows(20);
+
+    WindowGridLayoutCache cache;
+    const QVector<WindowGridCell> *first = &cache.layout(1, nullptr, windows, sizes, parameters);
+    const QVector<WindowGridCell> *second = &cache.layout(1, nullptr, windows, sizes, parameters);
+    QCOMPARE(first, second);
+    QCOMPARE(first->constData(), second->constData());
+
+    // a resized window invalidates the layout of its desktop only
+    const QVector<WindowGridCell> otherDesktop = cache.layout(2, nullptr, windows, sizes, parameters);
+    sizes[3] = QSize(100, 100);
+    const QVector<WindowGridCell> &resized = cache.layout(1, nullptr, windows, sizes, parameters);
+    QCOMPARE(resized.count(), 20);
+    QVERIFY(resized[3].geometry != otherDesktop[3].geometry);
+    QCOMPARE(cache.layout(2, nullptr, windows, generateSizes(20), parameters).constData(), otherDesktop.constData());
+}
+
+void TestWindowGridLayout::benchmarkLayout_data()
+{
+    QTest::addColumn<int>("count");
+
+    for (int count : {10, 50, 100, 200}) {
+        QTest::addRow("%d windows", count) << count;
+    }
+}
+
+void TestWindowGridLayout::benchmarkLayout()
+{
+    QFETCH(int, count);
+    const WindowGridParameters parameters = parametersFor4K();
+    const QVector<QSize> sizes = generateSizes(count);
+
+    QBENCHMARK {
+        computeWindowGridLayout(sizes, parameters);
+    }
+}
+
+void TestWindowGridLayout::benchmarkCachedLayout_data()
+{
+    benchmarkLayout_data();
+}
+
+void TestWindowGridLayout::benchmarkCachedLayout()
+{
+    QFETCH(int, count);
+    const WindowGridParameters parameters = parametersFor4K();
+    const QVector<QSize> sizes = generateSizes(count);
+    const QVector<const void *> windows = generateWindows(count);
+
+    WindowGridLayoutCache cache;
+    cache.layout(1, nullptr, windows, sizes, parameters);
+    QBENCHMARK {
+        cache.layout(1, nullptr, windows, sizes, parameters);
+    }
+}
+
+QTEST_MAIN(TestWindowGridLayout)
+#include "test_windowgridlayout.moc"
@@ -320,6 +320,11 @@ bool DrmGpu::updateOutputs()
             pipeline->revertPendingChanges();
         }
     }
+    for (const auto &pipeline : qAsConst(m_pipelines)) {
+        if (pipeline->output()) {
+            pipeline->output()->updateCursor();
+        }
+    }
     m_leaseDevice->setDrmMaster(true);
     return true;
 }
@@ -374,6 +379,12 @@ bool DrmGpu::checkCrtcAssignment(QVector<DrmConnector*> connectors, QVector<DrmC
 
 bool DrmGpu::testPendingConfiguration(TestMode mode)
 {
+    // the crtcs may be reassigned, don't let the libinput thread move their cursors meanwhile
+    for (const auto &pipeline : qAsConst(m_pipelines)) {
+        if (pipeline->output()) {
+            pipeline->output()->withdrawCursorPlane();
+        }
+    }
     if (!m_atomicModeSetting) {
         waitIdle();
     }
@@ -578,6 +589,11 @@ const QVector<DrmPipeline*> DrmGpu::pipelines() const
     return m_pipelines;
 }
 
+const QVector<DrmPlane*> DrmGpu::planes() const
+{
+    return m_planes;
+}
+
 DrmVirtualOutput *DrmGpu::createVirtualOutput(const QString &name, const QSize &size, double scale, VirtualOutputMode mode)
 {
     auto output = new DrmVirtualOutput(name, this, size);
@@ -765,6 +781,9 @@ QVector<DrmObject*> DrmGpu::unusedObjects() const
             ret.removeOne(pipeline->pending.crtc);
             ret.removeOne(pipeline->pending.crtc->primaryPlane());
             ret.removeOne(pipeline->pending.crtc->cursorPlane());
+            for (const auto &overlay : qAsConst(pipeline->pending.overlays)) {
+                ret.removeOne(overlay.plane);
+            }
         }
     }
     return ret;
@@ -42,6 +42,7 @@ DrmPlane::DrmPlane(DrmGpu *gpu, uint32_t planeId)
             QByteArrayLiteral("reflect-x"),
             QByteArrayLiteral("reflect-y")}),
         PropertyDefinition(QByteArrayLiteral("IN_FORMATS"), Requirement::Optional),
+        PropertyDefinition(QByteArrayLiteral("zpos"), Requirement::Optional),
         }, DRM_MODE_OBJECT_PLANE)
 {
 }
@@ -164,7 +165,8 @@ void DrmPlane::setBuffer(DrmBuffer *buffer)
 
 bool DrmPlane::needsModeset() const
 {
-    if (!gpu()->atomicModeSetting() || type() == TypeIndex::Cursor) {
+    // enabling and disabling cursor and overlay planes doesn't require a modeset
+    if (!gpu()->atomicModeSetting() || type() == TypeIndex::Cursor || type() == TypeIndex::Overlay) {
         return false;
     }
     auto rotation = getProp(PropertyIndex::Rotation);
@@ -184,6 +186,26 @@ QMap<uint32_t, QVector<uint64_t>> DrmPlane::formats() const
     return m_supportedFormats;
 }
 
+bool DrmPlane::isFormatSupported(uint32_t drmFormat, uint64_t modifier) const
+{
+    const auto it = m_supportedFormats.constFind(drmFormat);
+    if (it == m_supportedFormats.constEnd()) {
+        return false;
+    }
+    if (modifier == DRM_FORMAT_MOD_INVALID) {
+        return true;
+    }
+    return it->contains(modifier);
+}
+
+int DrmPlane::zpos() const
+{
+    if (const auto prop = getProp(PropertyIndex::Zpos)) {
+        return prop->pending();
+    }
+    return -1;
+}
+
 QSharedPointer<DrmBuffer> DrmPlane::current() const
 {
     return m_current;
@@ -40,6 +40,7 @@ public:
         CrtcId,
         Rotation,
         In_Formats,
+        Zpos,
         Count
     };
     Q_ENUM(PropertyIndex)
@@ -70,6 +71,12 @@ public:
 
     bool isCrtcSupported(int pipeIndex) const;
     QMap<uint32_t, QVector<uint64_t>> formats() const;
+    bool isFormatSupported(uint32_t drmFormat, uint64_t modifier) const;
+    /**
+     * The position of the plane in the stack of planes of a crtc, higher values are
+     * closer to the viewer. Returns -1 if the driver doesn't expose it.
+     */
+    int zpos() const;
 
     QSharedPointer<DrmBuffer> current() const;
     QSharedPointer<DrmBuffer> next() const;
@@ -16,6 +16,7 @@
 
 #include "composite.h"
 #include "cursor.h"
+#include "cursorfastpath.h"
 #include "logging.h"
 #include "main.h"
 #include "renderloop.h"
@@ -78,6 +79,7 @@ DrmOutput::DrmOutput(DrmPipeline *pipeline)
 
 DrmOutput::~DrmOutput()
 {
+    withdrawCursorPlane();
     m_pipeline->setOutput(nullptr);
 }
 
@@ -93,6 +95,8 @@ static bool isCursorSpriteCompatible(const QImage *buffer, const QImage *sprite)
 
 void DrmOutput::updateCursor()
 {
+    // published again by moveCursor() once the new cursor is set
+    withdrawCursorPlane();
     static bool valid;
     static const bool forceSoftwareCursor = qEnvironmentVariableIntValue("KWIN_FORCE_SW_CURSOR", &valid) == 1 && valid;
     if (forceSoftwareCursor) {
@@ -163,14 +167,48 @@ void DrmOutput::updateCursor()
 void DrmOutput::moveCursor()
 {
     if (!m_setCursorSuccessful || !m_pipeline->pending.crtc) {
+        withdrawCursorPlane();
         return;
     }
     Cursor *cursor = Cursors::self()->currentCursor();
     const QMatrix4x4 monitorMatrix = logicalToNativeMatrix(geometry(), scale(), transform());
     const QMatrix4x4 hotspotMatrix = logicalToNativeMatrix(cursor->rect(), scale(), transform());
-    m_moveCursorSuccessful = m_pipeline->moveCursor(monitorMatrix.map(cursor->pos()) - hotspotMatrix.map(cursor->hotspot()));
+    const QPoint hotspot = hotspotMatrix.map(cursor->hotspot());
+    QPoint pos = monitorMatrix.map(cursor->pos()) - hotspot;
+
+    // the plane is only published while the crtc shows it
+    CursorFastPath *fastPath = isEnabled() && dpmsMode() == DpmsMode::On ? CursorFastPath::self() : nullptr;
+    if (!fastPath) {
+        withdrawCursorPlane();
+    } else {
+        const int fd = m_gpu->fd();
+        const uint32_t crtcId = m_pipeline->pending.crtc->id();
+        CursorFastPath::Plane plane;
+        plane.geometry = geometry();
+        plane.logicalToNative = monitorMatrix;
+        plane.hotspot = hotspot;
+        plane.cursorSize = m_gpu->cursorSize();
+        plane.modeSize = modeSize();
+        // the legacy cursor ioctl doesn't wait for pending page flips, unlike atomic commits
+        plane.move = [fd, crtcId](const QPoint &pos) {
+            return drmModeMoveCursor(fd, crtcId, pos.x(), pos.y()) == 0;
+        };
+        fastPath->setPlane(this, plane);
+        // don't move the cursor back if the libinput thread is ahead of us
+        fastPath->planePosition(this, &pos);
+    }
+
+    m_moveCursorSuccessful = m_pipeline->moveCursor(pos);
     if (!m_moveCursorSuccessful) {
         m_pipeline->setCursor(nullptr);
+        withdrawCursorPlane();
+    }
+}
+
+void DrmOutput::withdrawCursorPlane()
+{
+    if (CursorFastPath *fastPath = CursorFastPath::self()) {
+        fastPath->removePlane(this);
     }
 }
 
@@ -248,10 +286,15 @@ bool DrmOutput::setDrmDpmsMode(DpmsMode mode)
         return true;
     }
     m_pipeline->pending.active = active;
+    if (!active) {
+        // the crtc may drive another connector once it's off
+        withdrawCursorPlane();
+    }
     if (DrmPipeline::commitPipelines({m_pipeline}, active ? DrmPipeline::CommitMode::Test : DrmPipeline::CommitMode::CommitModeset)) {
         m_pipeline->applyPendingChanges();
         setDpmsModeInternal(mode);
         if (active) {
+            updateCursor();
             m_renderLoop->uninhibit();
             m_gpu->platform()->checkOutputsAreOn();
             if (Compositor::compositing()) {
@@ -265,6 +308,7 @@ bool DrmOutput::setDrmDpmsMode(DpmsMode mode)
     } else {
         qCWarning(KWIN_DRM) << "Setting dpms mode failed!";
         m_pipeline->revertPendingChanges();
+        updateCursor();
         if (isEnabled() && isActive && !active) {
             m_gpu->platform()->checkOutputsAreOn();
         }
@@ -456,6 +500,7 @@ void DrmOutput::applyQueuedChanges(const WaylandOutputConfig &config)
     setOverscanInternal(m_pipeline->pending.overscan);
     setRgbRangeInternal(m_pipeline->pending.rgbRange);
     setVrrPolicy(props->vrrPolicy);
+    updateCursor();
 
     m_renderLoop->scheduleRepaint();
     Q_EMIT changed();
@@ -464,6 +509,7 @@ void DrmOutput::applyQueuedChanges(const WaylandOutputConfig &config)
 void DrmOutput::revertQueuedChanges()
 {
     m_pipeline->revertPendingChanges();
+    updateCursor();
 }
 
 void DrmOutput::pageFlipped(std::chrono::nanoseconds timestamp)
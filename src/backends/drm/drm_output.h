@@ -64,6 +64,16 @@ public:
     void presentFailed();
     bool usesSoftwareCursor() const override;
 
+    /**
+     * Sets the cursor on the pipeline again and publishes it to the CursorFastPath.
+     */
+    void updateCursor();
+    /**
+     * Stops the CursorFastPath from moving the cursor, e.g. while the crtc, mode or transform
+     * of the pipeline changes. It is published again by updateCursor() or moveCursor().
+     */
+    void withdrawCursorPlane();
+
 private:
     void initOutputDevice();
 
@@ -75,7 +85,6 @@ private:
 
     int gammaRampSize() const override;
     bool setGammaRamp(const GammaRamp &gamma) override;
-    void updateCursor();
     void moveCursor();
 
     DrmPipeline *m_pipeline;
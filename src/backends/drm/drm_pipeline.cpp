@@ -9,6 +9,7 @@
 
 #include "drm_pipeline.h"
 
+#include <algorithm>
 #include <errno.h>
 
 #include "logging.h"
@@ -18,6 +19,7 @@
 #include "drm_object_plane.h"
 #include "drm_buffer.h"
 #include "cursor.h"
+#include "cursorfastpath.h"
 #include "session.h"
 #include "drm_output.h"
 #include "drm_backend.h"
@@ -71,6 +73,9 @@ bool DrmPipeline::present(const QSharedPointer<DrmBuffer> &buffer)
                 if (pending.crtc->cursorPlane()) {
                     pending.crtc->cursorPlane()->updateProperties();
                 }
+                for (const auto &overlay : qAsConst(pending.overlays)) {
+                    overlay.plane->updateProperties();
+                }
             }
             if (!commitPipelines({this}, CommitMode::Commit)) {
                 if (directScanout) {
@@ -196,10 +201,25 @@ bool DrmPipeline::populateAtomicValues(drmModeAtomicReq *req, uint32_t &flags)
         pending.crtc->primaryPlane()->setBuffer(activePending() ? m_primaryBuffer.get() : nullptr);
 
         if (pending.crtc->cursorPlane()) {
+            // the cursor may have been moved from the libinput thread since the last moveCursor()
+            CursorFastPath *fastPath = CursorFastPath::self();
+            if (fastPath && m_output) {
+                fastPath->planePosition(m_output, &pending.cursorPos);
+            }
             pending.crtc->cursorPlane()->set(QPoint(0, 0), gpu()->cursorSize(), pending.cursorPos, gpu()->cursorSize());
             pending.crtc->cursorPlane()->setBuffer(activePending() ? pending.cursorBo.get() : nullptr);
             pending.crtc->cursorPlane()->setPending(DrmPlane::PropertyIndex::CrtcId, (activePending() && pending.cursorBo) ? pending.crtc->id() : 0);
         }
+        for (const auto &overlay : qAsConst(pending.overlays)) {
+            overlay.plane->set(overlay.source.topLeft(), overlay.source.size(), overlay.destination.topLeft(), overlay.destination.size());
+            overlay.plane->setBuffer(activePending() ? overlay.buffer.get() : nullptr);
+            overlay.plane->setPending(DrmPlane::PropertyIndex::CrtcId, activePending() ? pending.crtc->id() : 0);
+            overlay.plane->setTransformation(DrmPlane::Transformation::Rotate0);
+        }
+        const auto retiredPlanes = retiredOverlayPlanes();
+        for (DrmPlane *plane : retiredPlanes) {
+            plane->disable();
+        }
     }
     if (!m_connector->atomicPopulate(req)) {
         return false;
@@ -214,6 +234,17 @@ bool DrmPipeline::populateAtomicValues(drmModeAtomicReq *req, uint32_t &flags)
         if (pending.crtc->cursorPlane() && !pending.crtc->cursorPlane()->atomicPopulate(req)) {
             return false;
         }
+        for (const auto &overlay : qAsConst(pending.overlays)) {
+            if (!overlay.plane->atomicPopulate(req)) {
+                return false;
+            }
+        }
+        const auto retiredPlanes = retiredOverlayPlanes();
+        for (DrmPlane *plane : retiredPlanes) {
+            if (!plane->atomicPopulate(req)) {
+                return false;
+            }
+        }
     }
     return true;
 }
@@ -279,6 +310,13 @@ void DrmPipeline::atomicCommitFailed()
         if (pending.crtc->cursorPlane()) {
             pending.crtc->cursorPlane()->rollbackPending();
         }
+        for (const auto &overlay : qAsConst(pending.overlays)) {
+            overlay.plane->rollbackPending();
+        }
+        const auto retiredPlanes = retiredOverlayPlanes();
+        for (DrmPlane *plane : retiredPlanes) {
+            plane->rollbackPending();
+        }
     }
 }
 
@@ -286,12 +324,19 @@ void DrmPipeline::atomicCommitSuccessful(CommitMode mode)
 {
     m_oldTestBuffer = nullptr;
     m_connector->commitPending();
+    const auto retiredPlanes = pending.crtc ? retiredOverlayPlanes() : QVector<DrmPlane*>();
     if (pending.crtc) {
         pending.crtc->commitPending();
         pending.crtc->primaryPlane()->commitPending();
         if (pending.crtc->cursorPlane()) {
             pending.crtc->cursorPlane()->commitPending();
         }
+        for (const auto &overlay : qAsConst(pending.overlays)) {
+            overlay.plane->commitPending();
+        }
+        for (DrmPlane *plane : retiredPlanes) {
+            plane->commitPending();
+        }
     }
     if (mode != CommitMode::Test) {
         if (activePending()) {
@@ -306,6 +351,17 @@ void DrmPipeline::atomicCommitSuccessful(CommitMode mode)
                 pending.crtc->cursorPlane()->setNext(pending.cursorBo);
                 pending.crtc->cursorPlane()->commit();
             }
+            m_flippingOverlayPlanes.clear();
+            for (const auto &overlay : qAsConst(pending.overlays)) {
+                overlay.plane->setNext(overlay.buffer);
+                overlay.plane->commit();
+                m_flippingOverlayPlanes << overlay.plane;
+            }
+            for (DrmPlane *plane : retiredPlanes) {
+                plane->setNext(nullptr);
+                plane->commit();
+                m_flippingOverlayPlanes << plane;
+            }
         }
         m_current = pending;
         if (mode == CommitMode::CommitModeset && activePending()) {
@@ -412,12 +468,155 @@ bool DrmPipeline::moveCursor(QPoint pos)
     return result;
 }
 
+int DrmPipeline::setOverlays(const QVector<Overlay> &overlays)
+{
+    if (overlays.isEmpty() && pending.overlays.isEmpty()) {
+        return 0;
+    }
+    if (!gpu()->atomicModeSetting() || !pending.crtc || needsModeset()
+        || pending.bufferTransformation != DrmPlane::Transformations(DrmPlane::Transformation::Rotate0)) {
+        pending.overlays.clear();
+        m_next.overlays.clear();
+        return 0;
+    }
+    const QVector<Overlay> assigned = assignOverlayPlanes(overlays);
+    if (!m_testedOverlays.isEmpty() && isSameOverlayConfiguration(assigned, m_testedOverlays)) {
+        // only the buffers changed, the result of the last test still applies
+        pending.overlays = assigned.mid(0, m_testedOverlayCount);
+        m_next = pending;
+        return pending.overlays.count();
+    }
+    m_testedOverlays = assigned;
+    pending.overlays = assigned;
+    while (!pending.overlays.isEmpty()) {
+        if (commitPipelines({this}, CommitMode::Test)) {
+            m_next = pending;
+            m_testedOverlayCount = pending.overlays.count();
+            return m_testedOverlayCount;
+        }
+        pending.overlays.removeLast();
+    }
+    m_next.overlays.clear();
+    m_testedOverlayCount = 0;
+    return 0;
+}
+
+bool DrmPipeline::isSameOverlayConfiguration(const QVector<Overlay> &a, const QVector<Overlay> &b)
+{
+    return std::equal(a.constBegin(), a.constEnd(), b.constBegin(), b.constEnd(), [](const Overlay &first, const Overlay &second) {
+        return first.plane == second.plane
+            && first.buffer->format() == second.buffer->format()
+            && first.buffer->modifier() == second.buffer->modifier()
+            && first.buffer->size() == second.buffer->size()
+            && first.source == second.source
+            && first.destination == second.destination;
+    });
+}
+
+int DrmPipeline::overlayPlaneCount() const
+{
+    if (!gpu()->atomicModeSetting() || !pending.crtc) {
+        return 0;
+    }
+    const auto planes = gpu()->planes();
+    return std::count_if(planes.constBegin(), planes.constEnd(), [this](DrmPlane *plane) {
+        return plane->type() == DrmPlane::TypeIndex::Overlay && plane->isCrtcSupported(pending.crtc->pipeIndex());
+    });
+}
+
+QVector<DrmPipeline::Overlay> DrmPipeline::assignOverlayPlanes(const QVector<Overlay> &overlays) const
+{
+    // planes that are in use by the other pipelines of the gpu
+    QVector<DrmPlane*> claimedPlanes;
+    const auto pipelines = gpu()->pipelines();
+    for (const DrmPipeline *pipeline : pipelines) {
+        if (pipeline == this) {
+            continue;
+        }
+        for (const auto &overlay : qAsConst(pipeline->pending.overlays)) {
+            claimedPlanes << overlay.plane;
+        }
+        for (const auto &overlay : qAsConst(pipeline->m_current.overlays)) {
+            claimedPlanes << overlay.plane;
+        }
+    }
+
+    // Only planes that are stacked above the primary plane can be used. Without the zpos
+    // property the order of the planes is unknown, most drivers put overlay planes above the
+    // primary plane but multiple overlays can't be stacked reliably.
+    const int primaryZpos = pending.crtc->primaryPlane()->zpos();
+    QVector<DrmPlane*> candidates;
+    bool knownOrder = primaryZpos >= 0;
+    const auto planes = gpu()->planes();
+    for (DrmPlane *plane : planes) {
+        if (plane->type() != DrmPlane::TypeIndex::Overlay
+            || !plane->isCrtcSupported(pending.crtc->pipeIndex())
+            || claimedPlanes.contains(plane)) {
+            continue;
+        }
+        const int zpos = plane->zpos();
+        if (zpos >= 0 && primaryZpos >= 0 && zpos <= primaryZpos) {
+            continue;
+        }
+        knownOrder &= zpos >= 0;
+        candidates << plane;
+    }
+    std::stable_sort(candidates.begin(), candidates.end(), [](DrmPlane *a, DrmPlane *b) {
+        return a->zpos() > b->zpos();
+    });
+
+    QVector<Overlay> ret;
+    for (const auto &overlay : overlays) {
+        if (!knownOrder && !ret.isEmpty()) {
+            break;
+        }
+        // overlays further down the stack have to use planes with a lower zpos
+        auto it = std::find_if(candidates.begin(), candidates.end(), [&overlay](DrmPlane *plane) {
+            return plane->isFormatSupported(overlay.buffer->format(), overlay.buffer->modifier());
+        });
+        if (it == candidates.end()) {
+            break;
+        }
+        Overlay assigned = overlay;
+        assigned.plane = *it;
+        ret << assigned;
+        candidates.erase(candidates.begin(), it + 1);
+    }
+    return ret;
+}
+
+QVector<DrmPlane*> DrmPipeline::retiredOverlayPlanes() const
+{
+    QVector<DrmPlane*> ret;
+    const auto &addIfUnused = [this, &ret](const QVector<Overlay> &overlays) {
+        for (const auto &overlay : overlays) {
+            const bool used = std::any_of(pending.overlays.constBegin(), pending.overlays.constEnd(), [&overlay](const Overlay &o) {
+                return o.plane == overlay.plane;
+            });
+            if (!used && !ret.contains(overlay.plane)) {
+                ret << overlay.plane;
+            }
+        }
+    };
+    addIfUnused(m_current.overlays);
+    addIfUnused(m_next.overlays);
+    return ret;
+}
+
+QSharedPointer<DrmBuffer> DrmPipeline::primaryBuffer() const
+{
+    return m_primaryBuffer;
+}
+
 void DrmPipeline::applyPendingChanges()
 {
     if (!pending.crtc) {
         pending.active = false;
     }
     m_next = pending;
+    // the configuration the overlays have been tested with has changed
+    m_testedOverlays.clear();
+    m_testedOverlayCount = 0;
 }
 
 QSize DrmPipeline::bufferSize() const
@@ -463,6 +662,10 @@ void DrmPipeline::pageFlipped(std::chrono::nanoseconds timestamp)
     if (m_current.crtc->cursorPlane()) {
         m_current.crtc->cursorPlane()->flipBuffer();
     }
+    for (DrmPlane *plane : qAsConst(m_flippingOverlayPlanes)) {
+        plane->flipBuffer();
+    }
+    m_flippingOverlayPlanes.clear();
     m_pageflipPending = false;
     if (m_output) {
         m_output->pageFlipped(timestamp);
@@ -663,6 +866,9 @@ void DrmPipeline::printDebugInfo() const
         if (pending.crtc->cursorPlane()) {
             printProps(pending.crtc->cursorPlane(), PrintMode::All);
         }
+        for (const auto &overlay : pending.overlays) {
+            printProps(overlay.plane, PrintMode::All);
+        }
     }
 }
 
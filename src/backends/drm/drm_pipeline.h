@@ -10,6 +10,7 @@
 #pragma once
 
 #include <QPoint>
+#include <QRect>
 #include <QSize>
 #include <QVector>
 #include <QSharedPointer>
@@ -68,6 +69,33 @@ public:
     bool setCursor(const QSharedPointer<DrmDumbBuffer> &buffer, const QPoint &hotspot = QPoint());
     bool moveCursor(QPoint pos);
 
+    /**
+     * A buffer that is scanned out by an overlay plane on top of the primary plane
+     */
+    struct Overlay {
+        DrmPlane *plane = nullptr;
+        QSharedPointer<DrmBuffer> buffer;
+        // in buffer coordinates
+        QRect source;
+        // in device coordinates of the output
+        QRect destination;
+    };
+    /**
+     * Assigns overlay planes to @p overlays, which have to be sorted from top to bottom, and
+     * checks the configuration with test commits. Overlays that don't fit are dropped from the
+     * bottom until the test passes.
+     * @returns the number of overlays that will be shown with the next present
+     */
+    int setOverlays(const QVector<Overlay> &overlays);
+    /**
+     * The number of overlay planes that can be used with the crtc of the pipeline
+     */
+    int overlayPlaneCount() const;
+    /**
+     * The buffer that has been presented last on the primary plane
+     */
+    QSharedPointer<DrmBuffer> primaryBuffer() const;
+
     DrmConnector *connector() const;
     DrmCrtc *currentCrtc() const;
     DrmGpu *gpu() const;
@@ -107,6 +135,8 @@ public:
         QPoint cursorHotspot;
         QSharedPointer<DrmDumbBuffer> cursorBo;
 
+        QVector<Overlay> overlays;
+
         // the transformation that this pipeline will apply to submitted buffers
         DrmPlane::Transformations bufferTransformation = DrmPlane::Transformation::Rotate0;
         // the transformation that buffers submitted to the pipeline should have
@@ -127,6 +157,9 @@ private:
     bool activePending() const;
     bool isCursorVisible() const;
     uint32_t calculateUnderscan();
+    QVector<Overlay> assignOverlayPlanes(const QVector<Overlay> &overlays) const;
+    QVector<DrmPlane*> retiredOverlayPlanes() const;
+    static bool isSameOverlayConfiguration(const QVector<Overlay> &a, const QVector<Overlay> &b);
 
     // legacy only
     bool presentLegacy();
@@ -155,6 +188,12 @@ private:
     QSharedPointer<DrmBuffer> m_oldTestBuffer;
     bool m_pageflipPending = false;
     bool m_modesetPresentPending = false;
+    // overlay planes that have to flip their buffers with the next page flip
+    QVector<DrmPlane*> m_flippingOverlayPlanes;
+    // the last assignment that has been checked with test commits and how many of its
+    // overlays passed, so that new buffers with the same configuration skip the test
+    QVector<Overlay> m_testedOverlays;
+    int m_testedOverlayCount = 0;
 
     // the state that will be applied at the next real atomic commit
     State m_next;
@@ -34,6 +34,7 @@
 #include <deepin_kwinglplatform.h>
 #include <kwineglimagetexture.h>
 // system
+#include <cmath>
 #include <gbm.h>
 #include <unistd.h>
 #include <errno.h>
@@ -652,6 +653,7 @@ void EglGbmBackend::endFrame(AbstractOutput *drmOutput, const QRegion &renderedR
     }
 
     output.output->present(buffer, dirty);
+    drmOutput->renderLoop()->renderJournal()->markStage(RenderJournal::Stage::Submit);
 }
 
 void EglGbmBackend::updateBufferAge(Output &output, const QRegion &dirty)
@@ -733,36 +735,12 @@ bool EglGbmBackend::scanout(AbstractOutput *drmOutput, SurfaceItem *surfaceItem)
         return false;
     }
 
-    gbm_bo *importedBuffer;
-    if (planes.first().modifier != DRM_FORMAT_MOD_INVALID
-        || planes.first().offset > 0
-        || planes.count() > 1) {
-        if (!m_gpu->addFB2ModifiersSupported() || !output.output->supportedModifiers(buffer->format()).contains(planes.first().modifier)) {
-            sendFeedback();
-            return false;
-        }
-        gbm_import_fd_modifier_data data = {};
-        data.format = buffer->format();
-        data.width = (uint32_t) buffer->size().width();
-        data.height = (uint32_t) buffer->size().height();
-        data.num_fds = planes.count();
-        data.modifier = planes.first().modifier;
-        for (int i = 0; i < planes.count(); i++) {
-            data.fds[i] = planes[i].fd;
-            data.offsets[i] = planes[i].offset;
-            data.strides[i] = planes[i].stride;
-        }
-        importedBuffer = gbm_bo_import(m_gpu->gbmDevice(), GBM_BO_IMPORT_FD_MODIFIER, &data, GBM_BO_USE_SCANOUT);
-    } else {
-        auto plane = planes.first();
-        gbm_import_fd_data data = {};
-        data.fd = plane.fd;
-        data.width = (uint32_t) buffer->size().width();
-        data.height = (uint32_t) buffer->size().height();
-        data.stride = plane.stride;
-        data.format = buffer->format();
-        importedBuffer = gbm_bo_import(m_gpu->gbmDevice(), GBM_BO_IMPORT_FD, &data, GBM_BO_USE_SCANOUT);
+    if ((planes.first().modifier != DRM_FORMAT_MOD_INVALID || planes.first().offset > 0 || planes.count() > 1)
+        && (!m_gpu->addFB2ModifiersSupported() || !output.output->supportedModifiers(buffer->format()).contains(planes.first().modifier))) {
+        sendFeedback();
+        return false;
     }
+    gbm_bo *importedBuffer = importDmabuf(buffer);
     if (!importedBuffer) {
         sendFeedback();
         if (errno != EINVAL) {
@@ -792,6 +770,10 @@ bool EglGbmBackend::scanout(AbstractOutput *drmOutput, SurfaceItem *surfaceItem)
     }
     // ensure that a context is current like with normal presentation
     makeCurrent();
+    // the fullscreen surface covers everything, overlays would only be in the way
+    if (const auto drmOutput = qobject_cast<DrmOutput *>(output.output)) {
+        drmOutput->pipeline()->setOverlays({});
+    }
     if (output.output->present(bo, damage)) {
         if (output.scanoutSurface != surface) {
             auto path = surface->client()->executablePath();
@@ -809,6 +791,136 @@ bool EglGbmBackend::scanout(AbstractOutput *drmOutput, SurfaceItem *surfaceItem)
     }
 }
 
+gbm_bo *EglGbmBackend::importDmabuf(KWaylandServer::LinuxDmaBufV1ClientBuffer *buffer) const
+{
+    const auto planes = buffer->planes();
+    if (planes.first().modifier != DRM_FORMAT_MOD_INVALID
+        || planes.first().offset > 0
+        || planes.count() > 1) {
+        if (!m_gpu->addFB2ModifiersSupported()) {
+            return nullptr;
+        }
+        gbm_import_fd_modifier_data data = {};
+        data.format = buffer->format();
+        data.width = (uint32_t) buffer->size().width();
+        data.height = (uint32_t) buffer->size().height();
+        data.num_fds = planes.count();
+        data.modifier = planes.first().modifier;
+        for (int i = 0; i < planes.count(); i++) {
+            data.fds[i] = planes[i].fd;
+            data.offsets[i] = planes[i].offset;
+            data.strides[i] = planes[i].stride;
+        }
+        return gbm_bo_import(m_gpu->gbmDevice(), GBM_BO_IMPORT_FD_MODIFIER, &data, GBM_BO_USE_SCANOUT);
+    } else {
+        auto plane = planes.first();
+        gbm_import_fd_data data = {};
+        data.fd = plane.fd;
+        data.width = (uint32_t) buffer->size().width();
+        data.height = (uint32_t) buffer->size().height();
+        data.stride = plane.stride;
+        data.format = buffer->format();
+        return gbm_bo_import(m_gpu->gbmDevice(), GBM_BO_IMPORT_FD, &data, GBM_BO_USE_SCANOUT);
+    }
+}
+
+QVector<SurfaceItem *> EglGbmBackend::assignOverlays(AbstractOutput *drmOutput, const QVector<SurfaceItem *> &candidates)
+{
+    static bool valid;
+    static const bool overlaysDisabled = qEnvironmentVariableIntValue("KWIN_DRM_NO_OVERLAYS", &valid) == 1 && valid;
+    Q_ASSERT(m_outputs.contains(drmOutput));
+    Output &output = m_outputs[drmOutput];
+    const auto pipelineOutput = qobject_cast<DrmOutput *>(output.output);
+    if (!pipelineOutput) {
+        return {};
+    }
+
+    QVector<DrmPipeline::Overlay> overlays;
+    QVector<SurfaceItem *> items;
+    QHash<KWaylandServer::ClientBuffer *, QSharedPointer<DrmBuffer>> overlayBuffers;
+    // client buffers are only imported on the rendering gpu and the planes can't rotate them
+    const bool usable = !overlaysDisabled && isPrimary()
+        && !output.output->needsSoftwareTransformation()
+        && output.output->transform() == AbstractWaylandOutput::Transform::Normal;
+    const int planeCount = usable ? pipelineOutput->pipeline()->overlayPlaneCount() : 0;
+    for (SurfaceItem *surfaceItem : candidates) {
+        if (overlays.count() >= planeCount) {
+            break;
+        }
+        SurfaceItemWayland *item = qobject_cast<SurfaceItemWayland *>(surfaceItem);
+        if (!item || !item->surface()) {
+            continue;
+        }
+        auto buffer = qobject_cast<KWaylandServer::LinuxDmaBufV1ClientBuffer *>(item->surface()->buffer());
+        if (!buffer || buffer->planes().isEmpty()) {
+            continue;
+        }
+
+        // the buffer may be cropped and scaled, but not rotated or flipped
+        const QRectF rect = surfaceItem->rect();
+        const QMatrix4x4 matrix = surfaceItem->surfaceToBufferMatrix();
+        const QPointF topLeft = matrix.map(rect.topLeft());
+        const QPointF topRight = matrix.map(rect.topRight());
+        const QPointF bottomRight = matrix.map(rect.bottomRight());
+        if (topLeft.x() >= bottomRight.x() || topLeft.y() >= bottomRight.y() || topLeft.y() != topRight.y()) {
+            continue;
+        }
+        const QRect source = QRectF(topLeft, bottomRight).toRect();
+
+        const QRect outputGeometry = output.output->geometry();
+        const QRect geometry = surfaceItem->mapToGlobal(surfaceItem->rect());
+        if (!outputGeometry.contains(geometry)) {
+            continue;
+        }
+        const qreal scale = output.output->scale();
+        const QRect destination(QPoint(std::round((geometry.x() - outputGeometry.x()) * scale),
+                                       std::round((geometry.y() - outputGeometry.y()) * scale)),
+                                QSize(std::round(geometry.width() * scale), std::round(geometry.height() * scale)));
+
+        // the surface keeps its buffer between frames in which only other surfaces changed
+        QSharedPointer<DrmBuffer> bo = output.overlayBuffers.value(buffer);
+        if (!bo) {
+            gbm_bo *importedBuffer = importDmabuf(buffer);
+            if (!importedBuffer) {
+                continue;
+            }
+            bo = QSharedPointer<DrmGbmBuffer>::create(m_gpu, importedBuffer, buffer);
+            if (!bo->bufferId()) {
+                continue;
+            }
+        }
+        overlayBuffers.insert(buffer, bo);
+        overlays << DrmPipeline::Overlay{nullptr, bo, source, destination};
+        items << surfaceItem;
+    }
+    // the framebuffers hold a reference to the client buffers, keep only the current ones
+    output.overlayBuffers = overlayBuffers;
+    const int assigned = pipelineOutput->pipeline()->setOverlays(overlays);
+    items.resize(assigned);
+    return items;
+}
+
+bool EglGbmBackend::presentOverlays(AbstractOutput *drmOutput)
+{
+    Q_ASSERT(m_outputs.contains(drmOutput));
+    const Output &output = m_outputs[drmOutput];
+    const auto pipelineOutput = qobject_cast<DrmOutput *>(output.output);
+    // a buffer of a directly scanned out client can't be presented again
+    if (!pipelineOutput || !isPrimary() || output.scanoutBuffer) {
+        return false;
+    }
+    DrmPipeline *pipeline = pipelineOutput->pipeline();
+    const QSharedPointer<DrmBuffer> buffer = pipeline->primaryBuffer();
+    if (!buffer || pipeline->pending.overlays.isEmpty()) {
+        return false;
+    }
+    if (!output.output->present(buffer, QRegion())) {
+        return false;
+    }
+    drmOutput->renderLoop()->renderJournal()->markStage(RenderJournal::Stage::Submit);
+    return true;
+}
+
 QSharedPointer<DrmBuffer> EglGbmBackend::renderTestFrame(DrmAbstractOutput *output)
 {
     beginFrame(output);
@@ -14,6 +14,7 @@
 
 #include <deepin_kwinglutils.h>
 
+#include <QHash>
 #include <QPointer>
 #include <QSharedPointer>
 #include <optional>
@@ -23,6 +24,8 @@ struct gbm_bo;
 
 namespace KWaylandServer
 {
+class ClientBuffer;
+class LinuxDmaBufV1ClientBuffer;
 class SurfaceInterface;
 }
 
@@ -66,6 +69,8 @@ public:
     void endFrame(AbstractOutput *output, const QRegion &renderedRegion, const QRegion &damagedRegion) override;
     void init() override;
     bool scanout(AbstractOutput *output, SurfaceItem *surfaceItem) override;
+    QVector<SurfaceItem *> assignOverlays(AbstractOutput *output, const QVector<SurfaceItem *> &candidates) override;
+    bool presentOverlays(AbstractOutput *output) override;
     bool prefer10bpc() const override;
 
     QSharedPointer<GLTexture> textureForOutput(AbstractOutput *requestedOutput) const override;
@@ -117,6 +122,8 @@ private:
         } scanoutCandidate;
         QSharedPointer<DrmBuffer> scanoutBuffer;
         QPointer<KWaylandServer::SurfaceInterface> oldScanoutCandidate;
+        // the framebuffers of the client buffers that were offered for overlay planes last
+        QHash<KWaylandServer::ClientBuffer *, QSharedPointer<DrmBuffer>> overlayBuffers;
     };
 
     bool doesRenderFit(const Output &output, const Output::RenderData &render);
@@ -131,6 +138,7 @@ private:
     QRegion prepareRenderingForOutput(Output &output);
     QSharedPointer<DrmBuffer> importFramebuffer(Output &output, const QRegion &dirty) const;
     QSharedPointer<DrmBuffer> endFrameWithBuffer(AbstractOutput *output, const QRegion &dirty);
+    gbm_bo *importDmabuf(KWaylandServer::LinuxDmaBufV1ClientBuffer *buffer) const;
     void updateBufferAge(Output &output, const QRegion &dirty);
     std::optional<GbmFormat> chooseFormat(Output &output) const;
 
@@ -67,6 +67,16 @@ bool EglMultiBackend::scanout(AbstractOutput *output, SurfaceItem *surfaceItem)
     return findBackend(output)->scanout(output, surfaceItem);
 }
 
+QVector<SurfaceItem *> EglMultiBackend::assignOverlays(AbstractOutput *output, const QVector<SurfaceItem *> &candidates)
+{
+    return findBackend(output)->assignOverlays(output, candidates);
+}
+
+bool EglMultiBackend::presentOverlays(AbstractOutput *output)
+{
+    return findBackend(output)->presentOverlays(output);
+}
+
 bool EglMultiBackend::makeCurrent()
 {
     return m_backends[0]->makeCurrent();
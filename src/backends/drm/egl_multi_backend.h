@@ -31,6 +31,8 @@ public:
     QRegion beginFrame(AbstractOutput *output) override;
     void endFrame(AbstractOutput *output, const QRegion &renderedRegion, const QRegion &damagedRegion) override;
     bool scanout(AbstractOutput *output, SurfaceItem *surfaceItem) override;
+    QVector<SurfaceItem *> assignOverlays(AbstractOutput *output, const QVector<SurfaceItem *> &candidates) override;
+    bool presentOverlays(AbstractOutput *output) override;
 
     bool makeCurrent() override;
     void doneCurrent() override;
@@ -20,6 +20,8 @@
 #include "abstract_client.h"
 #endif
 
+#include "cursorfastpath.h"
+#include "ftrace.h"
 #include "input_event.h"
 #include "session.h"
 #include "udev.h"
@@ -30,6 +32,7 @@
 #include <QSocketNotifier>
 
 #include <libinput.h>
+#include <chrono>
 #include <cmath>
 
 namespace KWin
@@ -83,6 +86,23 @@ Connection *Connection::s_self = nullptr;
 static ConnectionAdaptor *s_adaptor = nullptr;
 static Context *s_context = nullptr;
 
+// a second of events from a 1000 Hz device, motion is coalesced before it is queued
+static const quint32 s_eventQueueCapacity = 1024;
+
+static qint64 monotonicNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void traceQueueLatency(libinput_event_type type, qint64 enqueueTime)
+{
+    // the logger is created with the compositor, input can arrive before that
+    FTraceLogger *logger = FTraceLogger::self();
+    if (logger && logger->isEnabled()) {
+        logger->trace("libinput event ", int(type), " queue_usec=", (monotonicNanoseconds() - enqueueTime) / 1000);
+    }
+}
+
 Connection::Connection(QObject *parent)
     : Connection(nullptr, parent)
 {
@@ -127,6 +147,8 @@ Connection::Connection(Context *input, QObject *parent)
     , m_input(input)
     , m_notifier(nullptr)
     , m_mutex(QMutex::Recursive)
+    , m_eventQueue(s_eventQueueCapacity)
+    , m_releaseQueue(s_eventQueueCapacity)
 {
     Q_ASSERT(m_input);
     // need to connect to KGlobalSettings as the mouse KCM does not emit a dedicated signal
@@ -136,6 +158,15 @@ Connection::Connection(Context *input, QObject *parent)
 
 Connection::~Connection()
 {
+    QueuedEvent queued;
+    while (m_eventQueue.pop(queued)) {
+        delete queued.event;
+    }
+    for (const QueuedEvent &overflow : qAsConst(m_overflow)) {
+        delete overflow.event;
+    }
+    delete m_pendingMotion.event;
+    releaseEvents();
     delete s_adaptor;
     s_adaptor = nullptr;
     s_self = nullptr;
@@ -180,20 +211,91 @@ void Connection::deactivate()
 void Connection::handleEvent()
 {
     QMutexLocker locker(&m_mutex);
-    const bool wasEmpty = m_eventQueue.isEmpty();
+    releaseEvents();
+    flushOverflow();
     do {
         m_input->dispatch();
         Event *event = m_input->event();
         if (!event) {
             break;
         }
-        m_eventQueue << event;
+        queueEvent(event);
     } while (true);
-    if (wasEmpty && !m_eventQueue.isEmpty()) {
+    publishPendingMotion();
+
+    // one notification is enough until the main thread starts draining the queue
+    if (!m_eventQueue.isEmpty() && !m_processScheduled.exchange(true)) {
         Q_EMIT eventsRead();
     }
 }
 
+void Connection::queueEvent(Event *event)
+{
+    if (event->type() != LIBINPUT_EVENT_POINTER_MOTION) {
+        publishPendingMotion();
+        publishEvent({event, monotonicNanoseconds()});
+        return;
+    }
+
+    PointerEvent *pe = static_cast<PointerEvent*>(event);
+    if (!m_pendingMotion.event) {
+        m_pendingMotion = {event, monotonicNanoseconds(), pe->delta(), pe->deltaUnaccelerated(), pe->time(), pe->timeMicroseconds()};
+        return;
+    }
+    // the first motion event of the batch stands in for the others
+    m_pendingMotion.delta += pe->delta();
+    m_pendingMotion.deltaNonAccel += pe->deltaUnaccelerated();
+    m_pendingMotion.time = pe->time();
+    m_pendingMotion.timeUsec = pe->timeMicroseconds();
+    delete event;
+}
+
+void Connection::publishPendingMotion()
+{
+    if (m_pendingMotion.event) {
+        if (CursorFastPath *fastPath = CursorFastPath::self()) {
+            fastPath->move(m_pendingMotion.delta);
+        }
+        publishEvent(m_pendingMotion);
+        m_pendingMotion = QueuedEvent();
+    }
+}
+
+void Connection::publishEvent(const QueuedEvent &queued)
+{
+    // keep the order of events if the main thread falls behind
+    if (!m_overflow.isEmpty() || !m_eventQueue.push(queued)) {
+        m_overflow.append(queued);
+        m_overflowed = true;
+    }
+}
+
+void Connection::flushOverflow()
+{
+    int published = 0;
+    while (published < m_overflow.count() && m_eventQueue.push(m_overflow.at(published))) {
+        ++published;
+    }
+    m_overflow.remove(0, published);
+}
+
+void Connection::releaseEvents()
+{
+    Event *event;
+    while (m_releaseQueue.pop(event)) {
+        delete event;
+    }
+}
+
+void Connection::releaseEvent(Event *event)
+{
+    // libinput is not thread-safe, events are destroyed on the libinput thread
+    if (!m_releaseQueue.push(event)) {
+        QMutexLocker locker(&m_mutex);
+        delete event;
+    }
+}
+
 #ifndef KWIN_BUILD_TESTING
 QPointF devicePointToGlobalPosition(const QPointF &devicePos, const AbstractWaylandOutput *output)
 {
@@ -281,11 +383,16 @@ KWin::TabletToolId createTabletId(libinput_tablet_tool *tool, void *userData)
 
 void Connection::processEvents()
 {
-    QMutexLocker locker(&m_mutex);
-    while (!m_eventQueue.isEmpty()) {
-        QScopedPointer<Event> event(m_eventQueue.takeFirst());
+    // events queued from now on need another notification
+    m_processScheduled = false;
+
+    QueuedEvent queued;
+    while (m_eventQueue.pop(queued)) {
+        Event *event = queued.event;
+        traceQueueLatency(event->type(), queued.enqueueTime);
         switch (event->type()) {
             case LIBINPUT_EVENT_DEVICE_ADDED: {
+                QMutexLocker locker(&m_mutex);
                 auto device = new Device(event->nativeDevice());
                 device->moveToThread(thread());
                 m_devices << device;
@@ -297,6 +404,7 @@ void Connection::processEvents()
                 break;
             }
             case LIBINPUT_EVENT_DEVICE_REMOVED: {
+                QMutexLocker locker(&m_mutex);
                 auto it = std::find_if(m_devices.begin(), m_devices.end(), [&event] (Device *d) { return event->device() == d; } );
                 if (it == m_devices.end()) {
                     // we don't know this device
@@ -309,12 +417,12 @@ void Connection::processEvents()
                 break;
             }
             case LIBINPUT_EVENT_KEYBOARD_KEY: {
-                KeyEvent *ke = static_cast<KeyEvent*>(event.data());
+                KeyEvent *ke = static_cast<KeyEvent*>(event);
                 Q_EMIT ke->device()->keyChanged(ke->key(), ke->state(), ke->time(), ke->device());
                 break;
             }
             case LIBINPUT_EVENT_POINTER_AXIS: {
-                PointerEvent *pe = static_cast<PointerEvent*>(event.data());
+                PointerEvent *pe = static_cast<PointerEvent*>(event);
                 const auto axes = pe->axis();
                 for (const InputRedirection::PointerAxis &axis : axes) {
                     Q_EMIT pe->device()->pointerAxisChanged(axis, pe->axisValue(axis), pe->discreteAxisValue(axis),
@@ -323,40 +431,48 @@ void Connection::processEvents()
                 break;
             }
             case LIBINPUT_EVENT_POINTER_BUTTON: {
-                PointerEvent *pe = static_cast<PointerEvent*>(event.data());
+                PointerEvent *pe = static_cast<PointerEvent*>(event);
                 Q_EMIT pe->device()->pointerButtonChanged(pe->button(), pe->buttonState(), pe->time(), pe->device());
                 break;
             }
             case LIBINPUT_EVENT_POINTER_MOTION: {
-                PointerEvent *pe = static_cast<PointerEvent*>(event.data());
-                auto delta = pe->delta();
-                auto deltaNonAccel = pe->deltaUnaccelerated();
-                quint32 latestTime = pe->time();
-                quint64 latestTimeUsec = pe->timeMicroseconds();
-                auto it = m_eventQueue.begin();
-                while (it != m_eventQueue.end()) {
-                    if ((*it)->type() == LIBINPUT_EVENT_POINTER_MOTION) {
-                        QScopedPointer<PointerEvent> p(static_cast<PointerEvent*>(*it));
-                        delta += p->delta();
-                        deltaNonAccel += p->deltaUnaccelerated();
-                        latestTime = p->time();
-                        latestTimeUsec = p->timeMicroseconds();
-                        it = m_eventQueue.erase(it);
-                    } else {
+                PointerEvent *pe = static_cast<PointerEvent*>(event);
+                auto delta = queued.delta;
+                auto deltaNonAccel = queued.deltaNonAccel;
+                quint32 latestTime = queued.time;
+                quint64 latestTimeUsec = queued.timeUsec;
+                // motion published by later batches of the libinput thread
+                while (QueuedEvent *next = m_eventQueue.peek()) {
+                    if (next->event->type() != LIBINPUT_EVENT_POINTER_MOTION) {
                         break;
                     }
+                    QueuedEvent motion;
+                    m_eventQueue.pop(motion);
+                    traceQueueLatency(LIBINPUT_EVENT_POINTER_MOTION, motion.enqueueTime);
+                    delta += motion.delta;
+                    deltaNonAccel += motion.deltaNonAccel;
+                    latestTime = motion.time;
+                    latestTimeUsec = motion.timeUsec;
+                    releaseEvent(motion.event);
+                }
+                CursorFastPath *fastPath = CursorFastPath::self();
+                if (fastPath) {
+                    fastPath->beginMotion(delta);
                 }
                 Q_EMIT pe->device()->pointerMotion(delta, deltaNonAccel, latestTime, latestTimeUsec, pe->device());
+                if (fastPath) {
+                    fastPath->endMotion();
+                }
                 break;
             }
             case LIBINPUT_EVENT_POINTER_MOTION_ABSOLUTE: {
-                PointerEvent *pe = static_cast<PointerEvent*>(event.data());
+                PointerEvent *pe = static_cast<PointerEvent*>(event);
                 Q_EMIT pe->device()->pointerMotionAbsolute(pe->absolutePos(workspace()->geometry().size()), pe->time(), pe->device());
                 break;
             }
             case LIBINPUT_EVENT_TOUCH_DOWN: {
 #ifndef KWIN_BUILD_TESTING
-                TouchEvent *te = static_cast<TouchEvent*>(event.data());
+                TouchEvent *te = static_cast<TouchEvent*>(event);
                 const auto *output = static_cast<AbstractWaylandOutput *>(te->device()->output());
                 const QPointF globalPos =
                         devicePointToGlobalPosition(te->absolutePos(output->modeSize()),
@@ -366,13 +482,13 @@ void Connection::processEvents()
 #endif
             }
             case LIBINPUT_EVENT_TOUCH_UP: {
-                TouchEvent *te = static_cast<TouchEvent*>(event.data());
+                TouchEvent *te = static_cast<TouchEvent*>(event);
                 Q_EMIT te->device()->touchUp(te->id(), te->time(), te->device());
                 break;
             }
             case LIBINPUT_EVENT_TOUCH_MOTION: {
 #ifndef KWIN_BUILD_TESTING
-                TouchEvent *te = static_cast<TouchEvent*>(event.data());
+                TouchEvent *te = static_cast<TouchEvent*>(event);
                 const auto *output = static_cast<AbstractWaylandOutput *>(te->device()->output());
                 const QPointF globalPos =
                         devicePointToGlobalPosition(te->absolutePos(output->modeSize()),
@@ -390,17 +506,17 @@ void Connection::processEvents()
                 break;
             }
             case LIBINPUT_EVENT_GESTURE_PINCH_BEGIN: {
-                PinchGestureEvent *pe = static_cast<PinchGestureEvent*>(event.data());
+                PinchGestureEvent *pe = static_cast<PinchGestureEvent*>(event);
                 Q_EMIT pe->device()->pinchGestureBegin(pe->fingerCount(), pe->time(), pe->device());
                 break;
             }
             case LIBINPUT_EVENT_GESTURE_PINCH_UPDATE: {
-                PinchGestureEvent *pe = static_cast<PinchGestureEvent*>(event.data());
+                PinchGestureEvent *pe = static_cast<PinchGestureEvent*>(event);
                 Q_EMIT pe->device()->pinchGestureUpdate(pe->scale(), pe->angleDelta(), pe->delta(), pe->time(), pe->device());
                 break;
             }
             case LIBINPUT_EVENT_GESTURE_PINCH_END: {
-                PinchGestureEvent *pe = static_cast<PinchGestureEvent*>(event.data());
+                PinchGestureEvent *pe = static_cast<PinchGestureEvent*>(event);
                 if (pe->isCancelled()) {
                     Q_EMIT pe->device()->pinchGestureCancelled(pe->time(), pe->device());
                 } else {
@@ -409,17 +525,17 @@ void Connection::processEvents()
                 break;
             }
             case LIBINPUT_EVENT_GESTURE_SWIPE_BEGIN: {
-                SwipeGestureEvent *se = static_cast<SwipeGestureEvent*>(event.data());
+                SwipeGestureEvent *se = static_cast<SwipeGestureEvent*>(event);
                 Q_EMIT se->device()->swipeGestureBegin(se->fingerCount(), se->time(), se->device());
                 break;
             }
             case LIBINPUT_EVENT_GESTURE_SWIPE_UPDATE: {
-                SwipeGestureEvent *se = static_cast<SwipeGestureEvent*>(event.data());
+                SwipeGestureEvent *se = static_cast<SwipeGestureEvent*>(event);
                 Q_EMIT se->device()->swipeGestureUpdate(se->delta(), se->time(), se->device());
                 break;
             }
             case LIBINPUT_EVENT_GESTURE_SWIPE_END: {
-                SwipeGestureEvent *se = static_cast<SwipeGestureEvent*>(event.data());
+                SwipeGestureEvent *se = static_cast<SwipeGestureEvent*>(event);
                 if (se->isCancelled()) {
                     Q_EMIT se->device()->swipeGestureCancelled(se->time(), se->device());
                 } else {
@@ -428,12 +544,12 @@ void Connection::processEvents()
                 break;
             }
             case LIBINPUT_EVENT_GESTURE_HOLD_BEGIN: {
-                HoldGestureEvent *he = static_cast<HoldGestureEvent*>(event.data());
+                HoldGestureEvent *he = static_cast<HoldGestureEvent*>(event);
                 Q_EMIT he->device()->holdGestureBegin(he->fingerCount(), he->time(), he->device());
                 break;
             }
             case LIBINPUT_EVENT_GESTURE_HOLD_END: {
-                HoldGestureEvent *he = static_cast<HoldGestureEvent*>(event.data());
+                HoldGestureEvent *he = static_cast<HoldGestureEvent*>(event);
                 if (he->isCancelled()) {
                     Q_EMIT he->device()->holdGestureCancelled(he->time(), he->device());
                 } else {
@@ -442,7 +558,7 @@ void Connection::processEvents()
                 break;
             }
             case LIBINPUT_EVENT_SWITCH_TOGGLE: {
-                SwitchEvent *se = static_cast<SwitchEvent*>(event.data());
+                SwitchEvent *se = static_cast<SwitchEvent*>(event);
                 switch (se->state()) {
                 case SwitchEvent::State::Off:
                     Q_EMIT se->device()->switchToggledOff(se->time(), se->timeMicroseconds(), se->device());
@@ -458,7 +574,7 @@ void Connection::processEvents()
             case LIBINPUT_EVENT_TABLET_TOOL_AXIS:
             case LIBINPUT_EVENT_TABLET_TOOL_PROXIMITY:
             case LIBINPUT_EVENT_TABLET_TOOL_TIP: {
-                auto *tte = static_cast<TabletToolEvent *>(event.data());
+                auto *tte = static_cast<TabletToolEvent *>(event);
 
                 KWin::InputRedirection::TabletEventType tabletEventType;
                 switch (event->type()) {
@@ -497,21 +613,21 @@ void Connection::processEvents()
                 break;
             }
             case LIBINPUT_EVENT_TABLET_TOOL_BUTTON: {
-                auto *tabletEvent = static_cast<TabletToolButtonEvent *>(event.data());
+                auto *tabletEvent = static_cast<TabletToolButtonEvent *>(event);
                 Q_EMIT event->device()->tabletToolButtonEvent(tabletEvent->buttonId(),
                                                               tabletEvent->isButtonPressed(),
                                                               createTabletId(tabletEvent->tool(), event->device()->groupUserData()));
                 break;
             }
             case LIBINPUT_EVENT_TABLET_PAD_BUTTON: {
-                auto *tabletEvent = static_cast<TabletPadButtonEvent *>(event.data());
+                auto *tabletEvent = static_cast<TabletPadButtonEvent *>(event);
                 Q_EMIT event->device()->tabletPadButtonEvent(tabletEvent->buttonId(),
                                                              tabletEvent->isButtonPressed(),
                                                              { event->device()->groupUserData() });
                 break;
             }
             case LIBINPUT_EVENT_TABLET_PAD_RING: {
-                auto *tabletEvent = static_cast<TabletPadRingEvent *>(event.data());
+                auto *tabletEvent = static_cast<TabletPadRingEvent *>(event);
                 tabletEvent->position();
                 Q_EMIT event->device()->tabletPadRingEvent(tabletEvent->number(),
                                                            tabletEvent->position(),
@@ -520,7 +636,7 @@ void Connection::processEvents()
                 break;
             }
             case LIBINPUT_EVENT_TABLET_PAD_STRIP: {
-                auto *tabletEvent = static_cast<TabletPadStripEvent *>(event.data());
+                auto *tabletEvent = static_cast<TabletPadStripEvent *>(event);
                 Q_EMIT event->device()->tabletPadStripEvent(tabletEvent->number(),
                                                             tabletEvent->position(),
                                                             tabletEvent->source() == LIBINPUT_TABLET_PAD_STRIP_SOURCE_FINGER,
@@ -531,6 +647,12 @@ void Connection::processEvents()
                 // nothing
                 break;
         }
+        releaseEvent(event);
+    }
+
+    if (m_overflowed.exchange(false)) {
+        // let the libinput thread move the events that did not fit into the queue
+        QMetaObject::invokeMethod(this, &Connection::handleEvent, Qt::QueuedConnection);
     }
 }
 
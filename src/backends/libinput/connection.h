@@ -10,16 +10,20 @@
 #define KWIN_LIBINPUT_CONNECTION_H
 
 #include <deepin_kwinglobals.h>
+#include "utils/spscqueue.h"
 
 #include <KSharedConfig>
 
 #include <QObject>
 #include <QPointer>
 #include <QSize>
+#include <QSizeF>
 #include <QMutex>
 #include <QVector>
 #include <QStringList>
 
+#include <atomic>
+
 class QSocketNotifier;
 class QThread;
 
@@ -61,14 +65,43 @@ private Q_SLOTS:
     void slotKGlobalSettingsNotifyChange(int type, int arg);
 
 private:
+    /**
+     * An event passed from the libinput thread to the main thread. Consecutive motion
+     * events are folded into one entry, which then carries the summed deltas and the
+     * timestamp of the latest event.
+     */
+    struct QueuedEvent {
+        Event *event = nullptr;
+        qint64 enqueueTime = 0;
+        QSizeF delta;
+        QSizeF deltaNonAccel;
+        quint32 time = 0;
+        quint64 timeUsec = 0;
+    };
+
     Connection(Context *input, QObject *parent = nullptr);
     void handleEvent();
+    void queueEvent(Event *event);
+    void publishEvent(const QueuedEvent &queued);
+    void publishPendingMotion();
+    void flushOverflow();
+    void releaseEvents();
+    void releaseEvent(Event *event);
     void applyDeviceConfig(Device *device);
     void applyScreenToDevice(Device *device);
     Context *m_input;
     QSocketNotifier *m_notifier;
+    // serializes calls into libinput, it is only contended by device configuration
     QMutex m_mutex;
-    QVector<Event*> m_eventQueue;
+    // events read on the libinput thread and processed on the main thread
+    SpscQueue<QueuedEvent> m_eventQueue;
+    // processed events handed back to the libinput thread to be destroyed there
+    SpscQueue<Event *> m_releaseQueue;
+    std::atomic<bool> m_overflowed{false};
+    std::atomic<bool> m_processScheduled{false};
+    // only used on the libinput thread
+    QueuedEvent m_pendingMotion;
+    QVector<QueuedEvent> m_overflow;
     QVector<Device*> m_devices;
     KSharedConfigPtr m_config;
 
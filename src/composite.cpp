@@ -19,6 +19,7 @@
 #include "overlaywindow.h"
 #include "platform.h"
 #include "qpainterbackend.h"
+#include "renderjournal.h"
 #include "renderloop.h"
 #include "scene.h"
 #include "scenes/opengl/scene_opengl.h"
@@ -150,6 +151,7 @@ Compositor::Compositor(QObject* workspace)
 
     // register DBus
     new CompositorDBusInterface(this);
+    new RenderJournalDBusInterface(this);
     FTraceLogger::create();
 }
 
@@ -410,6 +412,7 @@ void Compositor::unregisterRenderLoop(RenderLoop *renderLoop)
 {
     Q_ASSERT(m_renderLoops.contains(renderLoop));
     m_renderLoops.remove(renderLoop);
+    m_lastThrottledFrameCallbacks.remove(renderLoop);
     disconnect(renderLoop, &RenderLoop::frameRequested, this, &Compositor::handleFrameRequested);
 }
 
@@ -496,6 +499,7 @@ void Compositor::stop()
 
     delete m_scene;
     m_scene = nullptr;
+    m_renderList = RenderList();
 
     delete m_backend;
     m_backend = nullptr;
@@ -585,33 +589,65 @@ void Compositor::handleFrameRequested(RenderLoop *renderLoop)
 
 QList<Toplevel *> Compositor::windowsToRender() const
 {
+    // The stacking serial must be checked first, a changed stacking order is the only
+    // guarantee that the pending windows have not been destroyed in the meantime.
+    const uint stackingSerial = Workspace::self()->xStackingOrderSerial();
+    const QList<EffectWindow *> elevatedList = static_cast<EffectsHandlerImpl *>(effects)->elevatedWindows();
+    const bool screenLocked = waylandServer() && waylandServer()->isScreenLocked();
+
+    if (m_renderList.valid
+            && m_renderList.stackingSerial == stackingSerial
+            && m_renderList.screenLocked == screenLocked
+            && m_renderList.elevatedWindows == elevatedList
+            && std::none_of(m_renderList.pendingWindows.constBegin(), m_renderList.pendingWindows.constEnd(),
+                            [](const Toplevel *window) { return window->readyForPainting(); })) {
+        return m_renderList.windows;
+    }
+
     // Create a list of all windows in the stacking order
-    QList<Toplevel *> windows = Workspace::self()->xStackingOrder();
+    const QList<Toplevel *> stacking = Workspace::self()->xStackingOrder();
 
-    // Move elevated windows to the top of the stacking order
-    const QList<EffectWindow *> elevatedList = static_cast<EffectsHandlerImpl *>(effects)->elevatedWindows();
+    // Elevated windows are moved to the top of the stacking order
+    QList<Toplevel *> elevated;
+    elevated.reserve(elevatedList.count());
     for (EffectWindow *c : elevatedList) {
-        Toplevel *t = static_cast<EffectWindowImpl *>(c)->window();
-        windows.removeAll(t);
-        windows.append(t);
+        elevated.append(static_cast<EffectWindowImpl *>(c)->window());
     }
 
+    QList<Toplevel *> windows;
+    windows.reserve(stacking.count() + elevated.count());
+    m_renderList.pendingWindows.clear();
+
     // Skip windows that are not yet ready for being painted and if screen is locked skip windows
     // that are neither lockscreen nor inputmethod windows.
     //
     // TODO? This cannot be used so carelessly - needs protections against broken clients, the
     // window should not get focus before it's displayed, handle unredirected windows properly and
     // so on.
-    for (Toplevel *win : windows) {
+    auto maybeAppend = [&windows, screenLocked, this](Toplevel *win) {
         if (!win->readyForPainting()) {
-            windows.removeAll(win);
+            m_renderList.pendingWindows.append(win);
+            return;
         }
-        if (waylandServer() && waylandServer()->isScreenLocked()) {
-            if(!win->isLockScreen() && !win->isInputMethod()) {
-                windows.removeAll(win);
-            }
+        if (screenLocked && !win->isLockScreen() && !win->isInputMethod()) {
+            return;
+        }
+        windows.append(win);
+    };
+    for (Toplevel *win : stacking) {
+        if (!elevated.contains(win)) {
+            maybeAppend(win);
         }
     }
+    for (Toplevel *win : qAsConst(elevated)) {
+        maybeAppend(win);
+    }
+
+    m_renderList.valid = true;
+    m_renderList.stackingSerial = stackingSerial;
+    m_renderList.elevatedWindows = elevatedList;
+    m_renderList.screenLocked = screenLocked;
+    m_renderList.windows = windows;
     return windows;
 }
 
@@ -626,6 +662,7 @@ void Compositor::composite(RenderLoop *renderLoop)
 
     const auto &output = m_renderLoops[renderLoop];
     fTraceDuration("Paint (", output ? output->name() : QStringLiteral("screens"), ")");
+    renderLoop->renderJournal()->markStage(RenderJournal::Stage::Composite);
 
     const auto windows = windowsToRender();
 
@@ -638,20 +675,41 @@ void Compositor::composite(RenderLoop *renderLoop)
         const std::chrono::milliseconds frameTime =
                 std::chrono::duration_cast<std::chrono::milliseconds>(renderLoop->lastPresentationTimestamp());
 
-        for (Toplevel *window : windows) {
-            if (!window->readyForPainting()) {
-                continue;
-            }
+        // Only windows that actually made it to the screen, also as previews or thumbnails
+        // drawn by effects, get a frame callback for every frame. Windows that are occluded
+        // or hidden by an effect still get one about once per second so that they don't
+        // stall completely.
+        const QHash<Toplevel *, bool> &paintedWindows = m_scene->paintedWindows();
+        const auto lastThrottled = m_lastThrottledFrameCallbacks.constFind(renderLoop);
+        const bool throttledFrame = lastThrottled == m_lastThrottledFrameCallbacks.constEnd()
+                || frameTime - *lastThrottled >= std::chrono::seconds(1);
+        if (throttledFrame) {
+            m_lastThrottledFrameCallbacks[renderLoop] = frameTime;
+        }
+
+        auto sendFrameCallback = [&frameTime](Toplevel *window) {
             if (waylandServer()->isScreenLocked() &&
                     !(window->isLockScreen() || window->isInputMethod())) {
-                continue;
-            }
-            if (!window->isOnOutput(output)) {
-                continue;
+                return;
             }
             if (auto surface = window->surface()) {
                 surface->frameRendered(frameTime.count());
             }
+        };
+
+        if (throttledFrame) {
+            for (Toplevel *window : windows) {
+                if (window->readyForPainting() && window->isOnOutput(output)) {
+                    sendFrameCallback(window);
+                }
+            }
+        } else {
+            // the scene collected the windows it painted on this output
+            for (auto it = paintedWindows.constBegin(); it != paintedWindows.constEnd(); ++it) {
+                if (!it.value()) {
+                    sendFrameCallback(it.key());
+                }
+            }
         }
         if (!Cursors::self()->isCursorHidden()) {
             Cursor *cursor = Cursors::self()->currentCursor();
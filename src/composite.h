@@ -11,15 +11,20 @@
 
 #include <deepin_kwinglobals.h>
 
+#include <QHash>
 #include <QObject>
 #include <QTimer>
 #include <QRegion>
+#include <QVector>
+
+#include <chrono>
 
 namespace KWin
 {
 
 class AbstractOutput;
 class CompositorSelectionOwner;
+class EffectWindow;
 class RenderBackend;
 class RenderLoop;
 class Scene;
@@ -72,6 +77,14 @@ public:
         return m_backend;
     }
 
+    /**
+     * Returns the render loops that drive compositing, mapped to the output they belong to.
+     * The output is @c null if a single render loop drives all screens.
+     */
+    const QMap<RenderLoop *, AbstractOutput *> &renderLoops() const {
+        return m_renderLoops;
+    }
+
     /**
      * @brief Static check to test whether the Compositor is available and active.
      *
@@ -143,6 +156,24 @@ private:
     Scene *m_scene = nullptr;
     RenderBackend *m_backend = nullptr;
     QMap<RenderLoop *, AbstractOutput *> m_renderLoops;
+    // when windows that were not painted on the output last received a frame callback
+    QHash<RenderLoop *, std::chrono::milliseconds> m_lastThrottledFrameCallbacks;
+
+    /**
+     * The result of windowsToRender() together with the state it has been computed from.
+     * It is reused as long as the stacking order, the elevated windows and the screen
+     * lock state don't change and no pending window became ready for painting.
+     */
+    struct RenderList
+    {
+        bool valid = false;
+        uint stackingSerial = 0;
+        QList<EffectWindow *> elevatedWindows;
+        bool screenLocked = false;
+        QVector<Toplevel *> pendingWindows;
+        QList<Toplevel *> windows;
+    };
+    mutable RenderList m_renderList;
 };
 
 class KWIN_EXPORT WaylandCompositor final : public Compositor
@@ -0,0 +1,191 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "cursorfastpath.h"
+#include "abstract_output.h"
+#include "cursor.h"
+#include "effects.h"
+#include "input.h"
+#include "main.h"
+#include "platform.h"
+#include "pointer_input.h"
+
+namespace KWin
+{
+
+CursorFastPath *CursorFastPath::self()
+{
+    static const bool enabled = qEnvironmentVariableIntValue("KWIN_CURSOR_FAST_PATH") == 1;
+    // lives until exit, long after the libinput thread has been stopped
+    static CursorFastPath fastPath;
+    return enabled ? &fastPath : nullptr;
+}
+
+static QPoint nativePosition(const CursorFastPath::Plane &plane, const QPointF &position)
+{
+    return plane.logicalToNative.map(position.toPoint()) - plane.hotspot;
+}
+
+void CursorFastPath::setPlane(const void *output, const Plane &plane)
+{
+    QMutexLocker locker(&m_mutex);
+    PlaneState &state = m_planes[output];
+    state.plane = plane;
+    // make sure the next move reaches the plane, even if it leaves the output
+    state.visible = true;
+    updateArmed();
+}
+
+void CursorFastPath::removePlane(const void *output)
+{
+    QMutexLocker locker(&m_mutex);
+    m_planes.remove(output);
+    updateArmed();
+}
+
+bool CursorFastPath::planePosition(const void *output, QPoint *position) const
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = m_planes.constFind(output);
+    if (!m_armed || it == m_planes.constEnd()) {
+        return false;
+    }
+    QPointF predicted = predictedPosition();
+    if (!confine(predicted)) {
+        return false;
+    }
+    *position = nativePosition(it->plane, predicted);
+    return true;
+}
+
+void CursorFastPath::beginMotion(const QSizeF &delta)
+{
+    QMutexLocker locker(&m_mutex);
+    m_processingMotion += QPointF(delta.width(), delta.height());
+}
+
+void CursorFastPath::endMotion()
+{
+    // the motion may not have changed the position, e.g. at the edge of the screen
+    QMutexLocker locker(&m_mutex);
+    publish();
+}
+
+void CursorFastPath::setPosition(const QPointF &position)
+{
+    QMutexLocker locker(&m_mutex);
+    m_position = position;
+    m_hasPosition = true;
+    publish();
+}
+
+void CursorFastPath::publish()
+{
+    m_processedMotion += m_processingMotion;
+    m_processingMotion = QPointF();
+    updateArmed();
+
+    // correct what the libinput thread got wrong, e.g. because the pointer got warped
+    QPointF predicted = predictedPosition();
+    const bool confined = confine(predicted);
+    for (PlaneState &state : m_planes) {
+        if (m_armed && confined) {
+            movePlane(state, predicted);
+        } else if (state.moved) {
+            movePlane(state, m_position);
+            state.moved = false;
+        }
+    }
+}
+
+void CursorFastPath::move(const QSizeF &delta)
+{
+    QMutexLocker locker(&m_mutex);
+    m_readMotion += QPointF(delta.width(), delta.height());
+    if (!m_armed) {
+        return;
+    }
+    QPointF predicted = predictedPosition();
+    if (!confine(predicted)) {
+        return;
+    }
+    for (PlaneState &state : m_planes) {
+        movePlane(state, predicted);
+    }
+}
+
+QPointF CursorFastPath::predictedPosition() const
+{
+    return m_position + m_readMotion - m_processedMotion;
+}
+
+bool CursorFastPath::confine(QPointF &position) const
+{
+    QRect bounds;
+    for (const PlaneState &state : m_planes) {
+        if (state.plane.geometry.contains(position.toPoint())) {
+            return true;
+        }
+        bounds |= state.plane.geometry;
+    }
+    position = QPointF(qBound<qreal>(bounds.left(), position.x(), bounds.right()),
+                       qBound<qreal>(bounds.top(), position.y(), bounds.bottom()));
+    for (const PlaneState &state : m_planes) {
+        if (state.plane.geometry.contains(position.toPoint())) {
+            return true;
+        }
+    }
+    // the main thread knows better which output the pointer has to stay on
+    return false;
+}
+
+void CursorFastPath::movePlane(PlaneState &state, const QPointF &position)
+{
+    const QPoint native = nativePosition(state.plane, position);
+    const bool visible = QRect(native, state.plane.cursorSize).intersects(QRect(QPoint(), state.plane.modeSize));
+    if (!visible && !state.visible) {
+        return;
+    }
+    if (state.moved && state.position == native) {
+        return;
+    }
+    if (state.plane.move(native)) {
+        state.position = native;
+        state.visible = visible;
+        state.moved = true;
+    }
+}
+
+void CursorFastPath::updateArmed()
+{
+    if (!m_hasPosition) {
+        m_armed = false;
+        return;
+    }
+    // without a hardware cursor on every output the position can't be confined correctly
+    if (m_planes.isEmpty() || m_planes.count() != kwinApp()->platform()->enabledOutputs().count()) {
+        m_armed = false;
+        return;
+    }
+    if (Cursors::self()->isCursorHidden()) {
+        m_armed = false;
+        return;
+    }
+    // constrained pointers don't follow the motion
+    if (!input() || !input()->pointer()->inited() || input()->pointer()->isConstrained()) {
+        m_armed = false;
+        return;
+    }
+    // effects that intercept the pointer may move or hide the cursor themselves
+    if (effects && static_cast<EffectsHandlerImpl *>(effects)->isMouseInterception()) {
+        m_armed = false;
+        return;
+    }
+    m_armed = true;
+}
+
+} // namespace KWin
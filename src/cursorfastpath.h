@@ -0,0 +1,120 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <deepin_kwinglobals.h>
+
+#include <QHash>
+#include <QMatrix4x4>
+#include <QMutex>
+#include <QPointF>
+#include <QRect>
+#include <QSizeF>
+
+#include <functional>
+
+namespace KWin
+{
+
+/**
+ * The CursorFastPath moves the hardware cursor directly from the libinput thread, so the
+ * cursor keeps up with the pointer while the main thread is busy, e.g. with an expensive
+ * frame.
+ *
+ * The libinput thread predicts the pointer position from the position last published by the
+ * main thread plus the motion that the main thread has not processed yet. The main thread
+ * stays the owner of the pointer state: it publishes the position whenever it changes, so
+ * warps and confinement are picked up with the next motion and the prediction never drifts.
+ *
+ * The fast path is only armed while the libinput thread can predict the position, i.e. no
+ * pointer constraint is active, no effect intercepts the pointer, the cursor is shown and all
+ * outputs use a hardware cursor. It is opt-in with KWIN_CURSOR_FAST_PATH=1.
+ */
+class KWIN_EXPORT CursorFastPath
+{
+public:
+    /**
+     * A cursor plane that can be moved from any thread.
+     */
+    struct Plane {
+        /**
+         * The logical geometry of the output.
+         */
+        QRect geometry;
+        QMatrix4x4 logicalToNative;
+        /**
+         * The hotspot of the cursor image in device pixels.
+         */
+        QPoint hotspot;
+        QSize cursorSize;
+        QSize modeSize;
+        /**
+         * Moves the top left corner of the cursor image to the given device position.
+         */
+        std::function<bool(const QPoint &)> move;
+    };
+
+    /**
+     * Returns the fast path, or @c nullptr if it is not enabled.
+     */
+    static CursorFastPath *self();
+
+    // called on the main thread
+
+    /**
+     * Publishes or updates the cursor plane of an output, e.g. after the cursor image changed.
+     */
+    void setPlane(const void *output, const Plane &plane);
+    void removePlane(const void *output);
+    /**
+     * Returns in @p position where the fast path puts the cursor of @p output, so commits done
+     * by the main thread don't move the cursor back to an older position.
+     */
+    bool planePosition(const void *output, QPoint *position) const;
+    /**
+     * Brackets the processing of relative motion read from libinput.
+     */
+    void beginMotion(const QSizeF &delta);
+    void endMotion();
+    void setPosition(const QPointF &position);
+
+    // called on the libinput thread
+
+    /**
+     * Moves the cursor by @p delta ahead of the main thread.
+     */
+    void move(const QSizeF &delta);
+
+private:
+    struct PlaneState {
+        Plane plane;
+        QPoint position;
+        bool moved = false;
+        bool visible = false;
+    };
+
+    void publish();
+    QPointF predictedPosition() const;
+    bool confine(QPointF &position) const;
+    void movePlane(PlaneState &state, const QPointF &position);
+    void updateArmed();
+
+    mutable QMutex m_mutex;
+    QHash<const void *, PlaneState> m_planes;
+    // the position published by the main thread and the motion it has processed so far
+    QPointF m_position;
+    QPointF m_processedMotion;
+    // the motion that is being processed but not published yet
+    QPointF m_processingMotion;
+    // the motion read by the libinput thread
+    QPointF m_readMotion;
+    bool m_hasPosition = false;
+    bool m_armed = false;
+};
+
+} // namespace KWin
@@ -15,6 +15,7 @@
 
 // kwin
 #include "abstract_client.h"
+#include "abstract_output.h"
 #include "atoms.h"
 #include "composite.h"
 #include "cursor.h"
@@ -24,6 +25,8 @@
 #include "platform.h"
 #include "pluginmanager.h"
 #include "renderbackend.h"
+#include "renderjournal.h"
+#include "renderloop.h"
 #include "kwinadaptor.h"
 #include "unmanaged.h"
 #include "workspace.h"
@@ -408,6 +411,63 @@ QStringList CompositorDBusInterface::supportedOpenGLPlatformInterfaces() const
     return interfaces;
 }
 
+RenderJournalDBusInterface::RenderJournalDBusInterface(Compositor *parent)
+    : QObject(parent)
+    , m_compositor(parent)
+{
+    QDBusConnection::sessionBus().registerObject(QStringLiteral("/RenderJournal"), this, QDBusConnection::ExportScriptableContents);
+}
+
+static QString renderLoopName(AbstractOutput *output)
+{
+    return output ? output->name() : QStringLiteral("screens");
+}
+
+QStringList RenderJournalDBusInterface::outputs() const
+{
+    QStringList names;
+    const auto &renderLoops = m_compositor->renderLoops();
+    for (auto it = renderLoops.constBegin(); it != renderLoops.constEnd(); ++it) {
+        names << renderLoopName(it.value());
+    }
+    return names;
+}
+
+QVariantList RenderJournalDBusInterface::frameTimeline(const QString &output) const
+{
+    static const QString stageNames[] = {
+        QStringLiteral("composite"),
+        QStringLiteral("renderBegin"),
+        QStringLiteral("prePaint"),
+        QStringLiteral("paint"),
+        QStringLiteral("renderEnd"),
+        QStringLiteral("submit"),
+        QStringLiteral("presented"),
+    };
+    static_assert(std::size(stageNames) == int(RenderJournal::Stage::Count));
+
+    QVariantList frames;
+    const auto &renderLoops = m_compositor->renderLoops();
+    for (auto it = renderLoops.constBegin(); it != renderLoops.constEnd(); ++it) {
+        if (renderLoopName(it.value()) != output) {
+            continue;
+        }
+        const QVector<RenderJournal::FrameTimings> timeline = it.key()->renderJournal()->timeline();
+        frames.reserve(timeline.count());
+        for (const RenderJournal::FrameTimings &timings : timeline) {
+            QVariantMap frame;
+            frame.insert(QStringLiteral("sequence"), timings.sequence);
+            frame.insert(QStringLiteral("failed"), timings.failed);
+            for (int i = 0; i < int(RenderJournal::Stage::Count); ++i) {
+                frame.insert(stageNames[i], qlonglong(timings.stages[i].count()));
+            }
+            frames.append(frame);
+        }
+        break;
+    }
+    return frames;
+}
+
 
 
 
@@ -209,6 +209,38 @@ private:
     Compositor *m_compositor;
 };
 
+/**
+ * @brief This class exports the frame timelines recorded by the RenderJournal of each render loop.
+ *
+ * The object is exported as /RenderJournal with the org.kde.kwin.RenderJournal interface,
+ * next to /FTrace. Each frame is reported as a map with the monotonic timestamps (in nanoseconds)
+ * of the compositing stages, see RenderJournal::Stage.
+ */
+class RenderJournalDBusInterface : public QObject
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.kde.kwin.RenderJournal")
+
+public:
+    explicit RenderJournalDBusInterface(Compositor *parent);
+    ~RenderJournalDBusInterface() override = default;
+
+public Q_SLOTS:
+    /**
+     * Returns the names of the outputs that have a frame timeline. If a single render loop
+     * drives all screens, it is called "screens".
+     */
+    Q_SCRIPTABLE QStringList outputs() const;
+
+    /**
+     * Returns the recorded frames of the given @a output, ordered from the oldest to the newest.
+     */
+    Q_SCRIPTABLE QVariantList frameTimeline(const QString &output) const;
+
+private:
+    Compositor *m_compositor;
+};
+
 //TODO: disable all of this in case of kiosk?
 
 class VirtualDesktopManagerDBusInterface : public QObject
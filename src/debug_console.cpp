@@ -644,10 +644,31 @@ DebugConsole::DebugConsole()
     setWindowFlags(Qt::X11BypassWindowManagerHint);
 
     initGLTab();
+    initCulledWindowsLabel();
 }
 
 DebugConsole::~DebugConsole() = default;
 
+void DebugConsole::initCulledWindowsLabel()
+{
+    auto connectScene = [this] {
+        Scene *scene = Compositor::self() ? Compositor::self()->scene() : nullptr;
+        if (!scene) {
+            m_ui->culledWindowsLabel->setText(i18n("Occlusion culling: compositing is not active"));
+            return;
+        }
+        connect(scene, &Scene::frameRendered, m_ui->culledWindowsLabel, [this, scene] {
+            m_ui->culledWindowsLabel->setText(i18n("Culled windows: %1 in the last frame, %2 in total",
+                                                   scene->culledWindowCount(),
+                                                   scene->totalCulledWindowCount()));
+        });
+    };
+    connectScene();
+    if (Compositor::self()) {
+        connect(Compositor::self(), &Compositor::sceneCreated, this, connectScene);
+    }
+}
+
 void DebugConsole::initGLTab()
 {
     if (!effects || !effects->isOpenGLCompositing()) {
@@ -108,6 +108,7 @@ protected:
 
 private:
     void initGLTab();
+    void initCulledWindowsLabel();
     void updateKeyboardTab();
 
     QScopedPointer<Ui::DebugConsole> m_ui;
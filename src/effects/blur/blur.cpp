@@ -20,6 +20,7 @@
 #include <QTime>
 #include <QTimer>
 #include <QWindow>
+#include <algorithm>
 #include <cmath> // for ceil()
 
 #include <DWayland/Server/surface_interface.h>
@@ -119,6 +120,7 @@ bool BlurEffect::renderTargetsValid() const
 
 void BlurEffect::deleteFBOs()
 {
+    m_blurCaches.clear();
     qDeleteAll(m_renderTargets);
 
     m_renderTargets.clear();
@@ -364,6 +366,8 @@ void BlurEffect::slotWindowAdded(EffectWindow *w)
 
 void BlurEffect::slotWindowDeleted(EffectWindow *w)
 {
+    m_blurCaches.erase(w);
+
     auto it = windowBlurChangedConnections.find(w);
     if (it == windowBlurChangedConnections.end()) {
         return;
@@ -466,41 +470,47 @@ QRegion BlurEffect::blurRegion(const EffectWindow *w) const
     return region;
 }
 
-void BlurEffect::uploadRegion(QVector2D *&map, const QRegion &region, const int downSampleIterations)
+void BlurEffect::uploadRegion(QVector2D *&map, const QRegion &region, const int level)
 {
-    for (int i = 0; i <= downSampleIterations; i++) {
-        const int divisionRatio = (1 << i);
-
-        for (const QRect &r : region) {
-            const QVector2D topLeft(     r.x() / divisionRatio,               r.y() / divisionRatio);
-            const QVector2D topRight(   (r.x() + r.width()) / divisionRatio,  r.y() / divisionRatio);
-            const QVector2D bottomLeft(  r.x() / divisionRatio,              (r.y() + r.height()) / divisionRatio);
-            const QVector2D bottomRight((r.x() + r.width()) / divisionRatio, (r.y() + r.height()) / divisionRatio);
-
-            // First triangle
-            *(map++) = topRight;
-            *(map++) = topLeft;
-            *(map++) = bottomLeft;
-
-            // Second triangle
-            *(map++) = bottomLeft;
-            *(map++) = bottomRight;
-            *(map++) = topRight;
-        }
+    const int divisionRatio = (1 << level);
+
+    for (const QRect &r : region) {
+        const QVector2D topLeft(     r.x() / divisionRatio,               r.y() / divisionRatio);
+        const QVector2D topRight(   (r.x() + r.width()) / divisionRatio,  r.y() / divisionRatio);
+        const QVector2D bottomLeft(  r.x() / divisionRatio,              (r.y() + r.height()) / divisionRatio);
+        const QVector2D bottomRight((r.x() + r.width()) / divisionRatio, (r.y() + r.height()) / divisionRatio);
+
+        // First triangle
+        *(map++) = topRight;
+        *(map++) = topLeft;
+        *(map++) = bottomLeft;
+
+        // Second triangle
+        *(map++) = bottomLeft;
+        *(map++) = bottomRight;
+        *(map++) = topRight;
     }
 }
 
-void BlurEffect::uploadGeometry(GLVertexBuffer *vbo, const QRegion &blurRegion, const QRegion &windowRegion)
+void BlurEffect::uploadGeometry(GLVertexBuffer *vbo, const QVector<QRegion> &regions, const int downSampleIterations)
 {
-    const int vertexCount = ((blurRegion.rectCount() * (m_downSampleIterations + 1)) + windowRegion.rectCount()) * 6;
+    int rectCount = 0;
+    for (const QRegion &region : regions) {
+        rectCount += region.rectCount();
+    }
+    const int vertexCount = rectCount * (downSampleIterations + 1) * 6;
 
     if (!vertexCount)
         return;
 
     QVector2D *map = (QVector2D *) vbo->map(vertexCount * sizeof(QVector2D));
 
-    uploadRegion(map, blurRegion, m_downSampleIterations);
-    uploadRegion(map, windowRegion, 0);
+    // The regions of one iteration are next to each other, so every iteration is a single draw
+    for (int i = 0; i <= downSampleIterations; i++) {
+        for (const QRegion &region : regions) {
+            uploadRegion(map, region, i);
+        }
+    }
 
     vbo->unmap();
 
@@ -516,6 +526,10 @@ void BlurEffect::prePaintScreen(ScreenPrePaintData &data, std::chrono::milliseco
 {
     m_paintedArea = QRegion();
     m_currentBlur = QRegion();
+    m_batchPlanner.clear();
+    m_batches.clear();
+    m_frame++;
+    m_windowBatches.clear();
 
     effects->prePaintScreen(data, presentTime);
 }
@@ -527,6 +541,8 @@ void BlurEffect::prePaintWindow(EffectWindow* w, WindowPrePaintData& data, std::
     effects->prePaintWindow(w, data, presentTime);
 
     if (!w->isPaintingEnabled()) {
+        // whatever happens below the window now can't be tracked
+        m_blurCaches.erase(w);
         return;
     }
     if (!m_shader || !m_shader->isValid()) {
@@ -553,12 +569,20 @@ void BlurEffect::prePaintWindow(EffectWindow* w, WindowPrePaintData& data, std::
 
     // in case this window has regions to be blurred
     const QRect screen = effects->virtualScreenGeometry();
-    const QRegion blurArea = blurRegion(w).translated(w->pos()) & screen;
+    const QRegion area = blurRegion(w).translated(w->pos());
+    const QRegion blurArea = area & screen;
     const QRegion expandedBlur = (w->isDock() ? blurArea : expand(blurArea)) & screen;
 
+    // the cached blur is stale wherever it could have sampled a window painted below
+    auto cache = m_blurCaches.find(w);
+    if (cache != m_blurCaches.end()) {
+        cache->second.state.invalidate(expand(m_paintedArea & expandedBlur));
+    }
+
     // if this window or a window underneath the blurred area is painted again we have to
-    // blur everything
-    if (m_paintedArea.intersects(expandedBlur) || data.paint.intersects(blurArea)) {
+    // blur everything, unless only the window changed and its background is still cached
+    const bool backgroundCached = cache != m_blurCaches.end() && cache->second.state.isComplete(area);
+    if (m_paintedArea.intersects(expandedBlur) || (data.paint.intersects(blurArea) && !backgroundCached)) {
         data.paint |= expandedBlur;
         // we have to check again whether we do not damage a blurred area
         // of a window
@@ -569,11 +593,63 @@ void BlurEffect::prePaintWindow(EffectWindow* w, WindowPrePaintData& data, std::
 
     m_currentBlur |= expandedBlur;
 
+    planBatch(w, data, blurArea);
+
     m_paintedArea -= data.clip;
     m_paintedArea |= data.paint;
 }
 
-bool BlurEffect::shouldBlur(const EffectWindow *w, int mask, const WindowPaintData &data) const
+void BlurEffect::planBatch(EffectWindow *w, const WindowPrePaintData &data, const QRegion &blurArea)
+{
+    const QRegion shape = canBlur(w) ? data.paint & blurArea : QRegion();
+    const int index = m_batchPlanner.add(w->expandedGeometry(), shape, expand(shape), data.mask & PAINT_WINDOW_TRANSFORMED);
+    if (index == -1) {
+        return;
+    }
+
+    if (m_batches.count() <= index) {
+        m_batches.resize(index + 1);
+    }
+    BlurBatch &batch = m_batches[index];
+    batch.windows.append(w);
+    batch.shapes.append(shape);
+    m_windowBatches[w] = index;
+}
+
+void BlurEffect::blurBatch(const EffectWindow *w, const QRect &screen)
+{
+    const auto it = m_windowBatches.constFind(w);
+    if (it == m_windowBatches.constEnd()) {
+        return;
+    }
+
+    BlurBatch &batch = m_batches[*it];
+    if (batch.done) {
+        return;
+    }
+    batch.done = true;
+
+    // a single window takes the regular path
+    if (batch.windows.count() < 2) {
+        return;
+    }
+
+    // The results end up in the caches of the windows, drawWindow() then finds their
+    // backgrounds up to date. Windows that turn out to be transformed when they are
+    // painted take the full pass as usual.
+    QVector<BlurTarget> targets;
+    targets.reserve(batch.windows.count());
+    for (int i = 0; i < batch.windows.count(); ++i) {
+        EffectWindow *window = batch.windows[i];
+        BlurCache *cache = blurCache(window, screen);
+        if (cache) {
+            targets.append(BlurTarget{batch.shapes[i] & cache->state.shape(), cache, blursAsDock(window)});
+        }
+    }
+    computeBlur(targets, screen);
+}
+
+bool BlurEffect::canBlur(const EffectWindow *w) const
 {
     if (!m_renderTargetsValid || !m_shader || !m_shader->isValid())
         return false;
@@ -584,19 +660,36 @@ bool BlurEffect::shouldBlur(const EffectWindow *w, int mask, const WindowPaintDa
     if (w->isDesktop())
         return false;
 
+    bool blurBehindDecos = effects->decorationsHaveAlpha() &&
+                effects->decorationSupportsBlurBehind();
+
+    if (!w->hasAlpha() && w->opacity() >= 1.0 && !(blurBehindDecos && w->hasDecoration()))
+        return false;
+
+    return true;
+}
+
+bool BlurEffect::shouldBlur(const EffectWindow *w, int mask, const WindowPaintData &data) const
+{
+    if (!canBlur(w))
+        return false;
+
     bool scaled = !qFuzzyCompare(data.xScale(), 1.0) && !qFuzzyCompare(data.yScale(), 1.0);
     bool translated = data.xTranslation() || data.yTranslation();
 
     if ((scaled || (translated || (mask & PAINT_WINDOW_TRANSFORMED))) && !w->data(WindowForceBlurRole).toBool())
         return false;
 
-    bool blurBehindDecos = effects->decorationsHaveAlpha() &&
-                effects->decorationSupportsBlurBehind();
+    return true;
+}
 
-    if (!w->hasAlpha() && w->opacity() >= 1.0 && !(blurBehindDecos && w->hasDecoration()))
+bool BlurEffect::blursAsDock(EffectWindow *w) const
+{
+    if (w->data(WindowClipPathRole).isValid() && !w->isDock()) {
         return false;
-
-    return true;
+    }
+    EffectWindow *modal = w->transientFor();
+    return w->isDock() || (modal && modal->isDock());
 }
 
 void BlurEffect::drawWindow(EffectWindow *w, int mask, const QRegion &region, WindowPaintData &data)
@@ -626,11 +719,16 @@ void BlurEffect::drawWindow(EffectWindow *w, int mask, const QRegion &region, Wi
             shape = shape & region;
         }
 
-        EffectWindow* modal = w->transientFor();
-        const bool transientForIsDock = (modal ? modal->isDock() : false);
-
         if (!shape.isEmpty()) {
             const QVariant &data_clip_path = w->data(WindowClipPathRole);
+
+            // The cache is laid out in screen coordinates, so transformed windows always take the full pass.
+            BlurCache *cache = nullptr;
+            if (!scaled && !translated && !(mask & PAINT_WINDOW_TRANSFORMED)) {
+                blurBatch(w, screen);
+                cache = blurCache(w, screen);
+            }
+
             if (data_clip_path.isValid() && !w->isDock()) {
                 const QPainterPath path = qvariant_cast<QPainterPath>(data_clip_path);
                 QImage img(w->size(), QImage::Format_RGBA8888);
@@ -643,15 +741,17 @@ void BlurEffect::drawWindow(EffectWindow *w, int mask, const QRegion &region, Wi
                 m_noiseTexture->setFilter(GL_LINEAR);
                 m_noiseTexture->setWrapMode(GL_REPEAT);
                 m_noiseStrength = -1;
-                doBlur(shape, screen, data.opacity(), data.screenProjectionMatrix(), false, w->frameGeometry());
+                doBlur(shape, screen, data.opacity(), data.screenProjectionMatrix(), false, w->frameGeometry(), cache);
             } else {
                 m_noiseStrength = -2;
                 const QVariant valueRadius = w->data(WindowRadiusRole);
-                if (valueRadius.isValid()) {
+                if (cache) {
+                    shape = region & cache->state.shape();
+                } else if (valueRadius.isValid()) {
                     int cornerRadius = w->data(WindowRadiusRole).toPointF().x();
                     shape = rounded(shape, cornerRadius);
                 }
-                doBlur(shape, screen, data.opacity(), data.screenProjectionMatrix(), w->isDock() || transientForIsDock, w->frameGeometry());
+                doBlur(shape, screen, data.opacity(), data.screenProjectionMatrix(), blursAsDock(w), w->frameGeometry(), cache);
             }
         }
     }
@@ -700,29 +800,116 @@ void BlurEffect::generateNoiseTexture()
     m_noiseTexture->setWrapMode(GL_REPEAT);
 }
 
-void BlurEffect::doBlur(const QRegion& shape, const QRect& screen, const float opacity, const QMatrix4x4 &screenProjection, bool isDock, QRect windowRect)
+BlurCache *BlurEffect::blurCache(const EffectWindow *w, const QRect &screen)
+{
+    const QRegion area = blurRegion(w).translated(w->pos());
+    QRegion shape = area & screen;
+    if (shape.isEmpty()) {
+        return nullptr;
+    }
+
+    // The shape is rounded as a whole rather than per repainted region
+    const QVariant valueRadius = w->data(WindowRadiusRole);
+    if (valueRadius.isValid() && !(w->data(WindowClipPathRole).isValid() && !w->isDock())) {
+        shape = rounded(shape, valueRadius.toPointF().x());
+    }
+
+    const GLTexture &blurTexture = m_renderTextures[1];
+    if (m_blurCaches.find(w) == m_blurCaches.end() && !reserveBlurCache(blurTexture.size())) {
+        return nullptr;
+    }
+    BlurCache &cache = m_blurCaches[w];
+    cache.lastUsed = m_frame;
+
+    if (!cache.texture || cache.texture->size() != blurTexture.size()) {
+        cache.texture.reset(new GLTexture(blurTexture.internalFormat(), blurTexture.size()));
+        cache.texture->setFilter(GL_LINEAR);
+        cache.texture->setWrapMode(GL_CLAMP_TO_EDGE);
+        cache.state.reset();
+    }
+    cache.state.setLayout(area, shape, screen);
+
+    return &cache;
+}
+
+bool BlurEffect::reserveBlurCache(const QSize &textureSize)
+{
+    // Every cache is as large as the half sized blur texture, so their number is limited to
+    // stay within a fixed amount of memory. The least recently used caches are released first,
+    // but never one that is in use in the current frame.
+    static const qint64 budget = 64 * 1024 * 1024;
+    const qint64 textureBytes = qint64(textureSize.width()) * textureSize.height() * 4;
+    const size_t capacity = size_t(qMax<qint64>(2, budget / qMax<qint64>(1, textureBytes)));
+    while (m_blurCaches.size() >= capacity) {
+        auto oldest = std::min_element(m_blurCaches.begin(), m_blurCaches.end(), [](const auto &a, const auto &b) {
+            return a.second.lastUsed < b.second.lastUsed;
+        });
+        if (oldest->second.lastUsed == m_frame) {
+            return false;
+        }
+        m_blurCaches.erase(oldest);
+    }
+    return true;
+}
+
+void BlurEffect::updateBlurCache(BlurCache *cache, const QRegion &region, const QPoint &translation)
+{
+    // The final pass samples a little around each pixel, so copy a small border as well.
+    // The border is well inside the expanded area and thus blurred correctly.
+    const int border = m_offset + 2;
+    const QRect bounds(QPoint(0, 0), cache->texture->size());
+
+    GLRenderTarget::pushRenderTarget(m_renderTargets[1]);
+    cache->texture->bind();
+    for (const QRect &rect : region) {
+        const QRect r = rect.adjusted(-border, -border, border, border).translated(translation);
+        const QRect texels = QRect(QPoint(r.left() / 2, r.top() / 2), QPoint(r.right() / 2 + 1, r.bottom() / 2 + 1)) & bounds;
+        if (texels.isEmpty()) {
+            continue;
+        }
+        const int y = bounds.height() - texels.y() - texels.height();
+        glCopyTexSubImage2D(cache->texture->target(), 0, texels.x(), y, texels.x(), y, texels.width(), texels.height());
+    }
+    cache->texture->unbind();
+    GLRenderTarget::popRenderTarget();
+
+    cache->state.validate(region);
+}
+
+void BlurEffect::computeBlur(const QVector<BlurTarget> &targets, const QRect &screen)
 {
     // Blur would not render correctly on a secondary monitor because of wrong coordinates
     // BUG: 393723
     const int xTranslate = -screen.x();
     const int yTranslate = effects->virtualScreenSize().height() - screen.height() - screen.y();
 
-    const QRegion expandedBlurRegion = expand(shape) & expand(screen);
+    // With a cache, only the part of the shape whose background has changed is blurred again.
+    QVector<QRegion> blurShapes;
+    QVector<QRegion> expandedBlurRegions;
+    blurShapes.reserve(targets.count());
+    expandedBlurRegions.reserve(targets.count());
+    int blurRectCount = 0;
+    for (const BlurTarget &target : targets) {
+        const QRegion blurShape = target.cache ? target.shape - target.cache->state.valid() : target.shape;
+        const QRegion expandedBlurRegion = blurShape.isEmpty() ? QRegion() : expand(blurShape) & expand(screen);
+        blurShapes.append(blurShape);
+        expandedBlurRegions.append(expandedBlurRegion.translated(xTranslate, yTranslate));
+        blurRectCount += expandedBlurRegion.rectCount() * 6;
+    }
+    if (!blurRectCount) {
+        return;
+    }
 
     const bool useSRGB = m_renderTextures.first().internalFormat() == GL_SRGB8_ALPHA8;
 
-    // Upload geometry for the down and upsample iterations
+    // Upload geometry for the down and upsample iterations of all targets at once
     GLVertexBuffer *vbo = GLVertexBuffer::streamingBuffer();
     vbo->reset();
 
-    uploadGeometry(vbo, expandedBlurRegion.translated(xTranslate, yTranslate), shape);
+    uploadGeometry(vbo, expandedBlurRegions, m_downSampleIterations);
     vbo->bindArrays();
 
-    const QRect sourceRect = expandedBlurRegion.boundingRect() & screen;
-    const QRect destRect = sourceRect.translated(xTranslate, yTranslate);
-
     GLRenderTarget::pushRenderTargets(m_renderTargetStack);
-    int blurRectCount = expandedBlurRegion.rectCount() * 6;
 
     /*
      * If the window is a dock or panel we avoid the "extended blur" effect.
@@ -731,31 +918,70 @@ void BlurEffect::doBlur(const QRegion& shape, const QRect& screen, const float o
      * We want to avoid this on panels, because it looks really weird and ugly
      * when maximized windows or windows near the panel affect the dock blur.
      */
-    if (isDock) {
-        m_renderTargets.last()->blitFromFramebuffer(sourceRect, destRect);
-
-        if (useSRGB) {
-            glEnable(GL_FRAMEBUFFER_SRGB);
+    for (int i = 0; i < targets.count(); ++i) {
+        if (expandedBlurRegions[i].isEmpty()) {
+            continue;
+        }
+        const QRect destRect = expandedBlurRegions[i].boundingRect() & screen.translated(xTranslate, yTranslate);
+        const QRect sourceRect = destRect.translated(-xTranslate, -yTranslate);
+        if (targets[i].isDock) {
+            m_renderTargets.last()->blitFromFramebuffer(sourceRect, destRect);
+        } else {
+            m_renderTargets.first()->blitFromFramebuffer(sourceRect, destRect);
         }
+    }
 
-        const QRect screenRect = effects->virtualScreenGeometry();
-        QMatrix4x4 mvp;
-        mvp.ortho(0, screenRect.width(), screenRect.height(), 0, 0, 65535);
-        copyScreenSampleTexture(vbo, blurRectCount, shape.translated(xTranslate, yTranslate), mvp);
-    } else {
-        m_renderTargets.first()->blitFromFramebuffer(sourceRect, destRect);
+    if (useSRGB) {
+        glEnable(GL_FRAMEBUFFER_SRGB);
+    }
 
-        if (useSRGB) {
-            glEnable(GL_FRAMEBUFFER_SRGB);
+    const QRect screenRect = effects->virtualScreenGeometry();
+    QMatrix4x4 mvp;
+    mvp.ortho(0, screenRect.width(), screenRect.height(), 0, 0, 65535);
+    int vboStart = 0;
+    for (int i = 0; i < targets.count(); ++i) {
+        const int rectCount = expandedBlurRegions[i].rectCount() * 6;
+        if (rectCount && targets[i].isDock) {
+            const QRegion clampShape = targets[i].cache ? targets[i].cache->state.shape() : targets[i].shape;
+            copyScreenSampleTexture(vbo, vboStart, rectCount, clampShape.translated(xTranslate, yTranslate), mvp);
         }
-
-        // Remove the m_renderTargets[0] from the top of the stack that we will not use
-        GLRenderTarget::popRenderTarget();
+        vboStart += rectCount;
     }
 
+    // Remove the m_renderTargets[0] from the top of the stack, it's filled now
+    GLRenderTarget::popRenderTarget();
+
     downSampleTexture(vbo, blurRectCount);
     upSampleTexture(vbo, blurRectCount);
 
+    if (useSRGB) {
+        glDisable(GL_FRAMEBUFFER_SRGB);
+    }
+
+    vbo->unbindArrays();
+
+    for (int i = 0; i < targets.count(); ++i) {
+        if (targets[i].cache && !blurShapes[i].isEmpty()) {
+            updateBlurCache(targets[i].cache, blurShapes[i], QPoint(xTranslate, yTranslate));
+        }
+    }
+}
+
+void BlurEffect::paintBlur(const QRegion &shape, const QRect &screen, const float opacity, const QMatrix4x4 &screenProjection, QRect windowRect, GLTexture &blurredTexture)
+{
+    const bool useSRGB = m_renderTextures.first().internalFormat() == GL_SRGB8_ALPHA8;
+    const int shapeRectCount = shape.rectCount() * 6;
+
+    GLVertexBuffer *vbo = GLVertexBuffer::streamingBuffer();
+    vbo->reset();
+
+    uploadGeometry(vbo, {shape}, 0);
+    vbo->bindArrays();
+
+    if (useSRGB) {
+        glEnable(GL_FRAMEBUFFER_SRGB);
+    }
+
     // Modulate the blurred texture with the window opacity if the window isn't opaque
     if (opacity < 1.0) {
         glEnable(GL_BLEND);
@@ -775,7 +1001,7 @@ void BlurEffect::doBlur(const QRegion& shape, const QRect& screen, const float o
         glEnable(GL_BLEND);
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
         glActiveTexture(GL_TEXTURE1); m_noiseTexture->bind();
-        glActiveTexture(GL_TEXTURE0); m_renderTextures[1].bind();
+        glActiveTexture(GL_TEXTURE0); blurredTexture.bind();
         m_shader->bind(BlurShader::UpSampleType);
         m_shader->setTargetTextureSize(m_renderTextures[0].size() * GLRenderTarget::virtualScreenScale());
         m_shader->setOffset(m_offset);
@@ -785,15 +1011,15 @@ void BlurEffect::doBlur(const QRegion& shape, const QRect& screen, const float o
         shader->setUniform("texUnit", 0);
         shader->setUniform("texClip", 1);
         shader->setUniform("rect", QVector4D(windowRect.x(), screen.height() - windowRect.y(), windowRect.width(), windowRect.height()));
-        vbo->draw(GL_TRIANGLES, blurRectCount * (m_downSampleIterations + 1), blurRectCount);
+        vbo->draw(GL_TRIANGLES, 0, shapeRectCount);
         shader->setUniform("clip", false);
         m_shader->unbind();
         glActiveTexture(GL_TEXTURE1); m_noiseTexture->unbind();
-        glActiveTexture(GL_TEXTURE0); m_renderTextures[1].unbind();
+        glActiveTexture(GL_TEXTURE0); blurredTexture.unbind();
         glDisable(GL_BLEND);
         m_noiseStrength = 0;
     } else {
-        upscaleRenderToScreen(vbo, blurRectCount * (m_downSampleIterations + 1), shape.rectCount() * 6, screenProjection, windowRect.topLeft());
+        upscaleRenderToScreen(blurredTexture, vbo, 0, shapeRectCount, screenProjection, windowRect.topLeft());
     }
 
     if (useSRGB) {
@@ -821,16 +1047,22 @@ void BlurEffect::doBlur(const QRegion& shape, const QRect& screen, const float o
             // Add the shader's output directly to the pixels in framebuffer.
             glBlendFunc(GL_ONE, GL_ONE);
         }
-        applyNoise(vbo, blurRectCount * (m_downSampleIterations + 1), shape.rectCount() * 6, screenProjection, windowRect.topLeft());
+        applyNoise(vbo, 0, shapeRectCount, screenProjection, windowRect.topLeft());
         glDisable(GL_BLEND);
     }
 
     vbo->unbindArrays();
 }
 
-void BlurEffect::upscaleRenderToScreen(GLVertexBuffer *vbo, int vboStart, int blurRectCount, const QMatrix4x4 &screenProjection, QPoint windowPosition)
+void BlurEffect::doBlur(const QRegion& shape, const QRect& screen, const float opacity, const QMatrix4x4 &screenProjection, bool isDock, QRect windowRect, BlurCache *cache)
 {
-    m_renderTextures[1].bind();
+    computeBlur({BlurTarget{shape, cache, isDock}}, screen);
+    paintBlur(shape, screen, opacity, screenProjection, windowRect, cache ? *cache->texture : m_renderTextures[1]);
+}
+
+void BlurEffect::upscaleRenderToScreen(GLTexture &texture, GLVertexBuffer *vbo, int vboStart, int blurRectCount, const QMatrix4x4 &screenProjection, QPoint windowPosition)
+{
+    texture.bind();
 
     m_shader->bind(BlurShader::UpSampleType);
     m_shader->setTargetTextureSize(m_renderTextures[0].size() * GLRenderTarget::virtualScreenScale());
@@ -912,7 +1144,7 @@ void BlurEffect::upSampleTexture(GLVertexBuffer *vbo, int blurRectCount)
     m_shader->unbind();
 }
 
-void BlurEffect::copyScreenSampleTexture(GLVertexBuffer *vbo, int blurRectCount, QRegion blurShape, const QMatrix4x4 &screenProjection)
+void BlurEffect::copyScreenSampleTexture(GLVertexBuffer *vbo, int vboStart, int blurRectCount, QRegion blurShape, const QMatrix4x4 &screenProjection)
 {
     m_shader->bind(BlurShader::CopySampleType);
 
@@ -926,8 +1158,7 @@ void BlurEffect::copyScreenSampleTexture(GLVertexBuffer *vbo, int blurRectCount,
     m_shader->setBlurRect(blurShape.boundingRect().adjusted(1, 1, -1, -1), effects->virtualScreenSize());
     m_renderTextures.last().bind();
 
-    vbo->draw(GL_TRIANGLES, 0, blurRectCount);
-    GLRenderTarget::popRenderTarget();
+    vbo->draw(GL_TRIANGLES, vboStart, blurRectCount);
 
     m_shader->unbind();
 }
@@ -8,14 +8,20 @@
 #ifndef BLUR_H
 #define BLUR_H
 
+#include "blurbatchplanner.h"
+#include "blurcachestate.h"
+
 #include <deepin_kwineffects.h>
 #include <deepin_kwinglplatform.h>
 #include <deepin_kwinglutils.h>
 
+#include <QHash>
 #include <QVector>
 #include <QVector2D>
 #include <QStack>
 
+#include <map>
+
 #include <DWayland/Server/blur_interface.h>
 
 namespace KWin
@@ -25,6 +31,17 @@ static const int borderSize = 5;
 
 class BlurShader;
 
+/**
+ * The blurred background of a window, kept in the same layout as the half sized blur texture
+ * so it can be sampled in place of it. Only the valid part of the state is up to date.
+ */
+struct BlurCache
+{
+    QScopedPointer<GLTexture> texture;
+    BlurCacheState state;
+    quint64 lastUsed = 0; ///< the last frame in which the cache has been used
+};
+
 class BlurEffect : public KWin::Effect
 {
     Q_OBJECT
@@ -73,18 +90,33 @@ private:
     void initBlurStrengthValues();
     void updateTexture();
     QRegion blurRegion(const EffectWindow *w) const;
+    bool canBlur(const EffectWindow *w) const;
     bool shouldBlur(const EffectWindow *w, int mask, const WindowPaintData &data) const;
+    bool blursAsDock(EffectWindow *w) const;
     void updateBlurRegion(EffectWindow *w) const;
-    void doBlur(const QRegion &shape, const QRect &screen, const float opacity, const QMatrix4x4 &screenProjection, bool isDock, QRect windowRect);
-    void uploadRegion(QVector2D *&map, const QRegion &region, const int downSampleIterations);
-    void uploadGeometry(GLVertexBuffer *vbo, const QRegion &blurRegion, const QRegion &windowRegion);
+    struct BlurTarget {
+        QRegion shape;
+        BlurCache *cache;
+        bool isDock;
+    };
+
+    void doBlur(const QRegion &shape, const QRect &screen, const float opacity, const QMatrix4x4 &screenProjection, bool isDock, QRect windowRect, BlurCache *cache = nullptr);
+    void computeBlur(const QVector<BlurTarget> &targets, const QRect &screen);
+    void paintBlur(const QRegion &shape, const QRect &screen, const float opacity, const QMatrix4x4 &screenProjection, QRect windowRect, GLTexture &blurredTexture);
+    BlurCache *blurCache(const EffectWindow *w, const QRect &screen);
+    bool reserveBlurCache(const QSize &textureSize);
+    void updateBlurCache(BlurCache *cache, const QRegion &region, const QPoint &translation);
+    void planBatch(EffectWindow *w, const WindowPrePaintData &data, const QRegion &blurArea);
+    void blurBatch(const EffectWindow *w, const QRect &screen);
+    void uploadRegion(QVector2D *&map, const QRegion &region, const int level);
+    void uploadGeometry(GLVertexBuffer *vbo, const QVector<QRegion> &regions, const int downSampleIterations);
     void generateNoiseTexture();
 
-    void upscaleRenderToScreen(GLVertexBuffer *vbo, int vboStart, int blurRectCount, const QMatrix4x4 &screenProjection, QPoint windowPosition);
+    void upscaleRenderToScreen(GLTexture &texture, GLVertexBuffer *vbo, int vboStart, int blurRectCount, const QMatrix4x4 &screenProjection, QPoint windowPosition);
     void applyNoise(GLVertexBuffer *vbo, int vboStart, int blurRectCount, const QMatrix4x4 &screenProjection, QPoint windowPosition);
     void downSampleTexture(GLVertexBuffer *vbo, int blurRectCount);
     void upSampleTexture(GLVertexBuffer *vbo, int blurRectCount);
-    void copyScreenSampleTexture(GLVertexBuffer *vbo, int blurRectCount, QRegion blurShape, const QMatrix4x4 &screenProjection);
+    void copyScreenSampleTexture(GLVertexBuffer *vbo, int vboStart, int blurRectCount, QRegion blurShape, const QMatrix4x4 &screenProjection);
 
 private:
     BlurShader *m_shader;
@@ -121,6 +153,19 @@ private:
     QVector <BlurValuesStruct> blurStrengthValues;
 
     QMap <EffectWindow*, QMetaObject::Connection> windowBlurChangedConnections;
+    std::map<const EffectWindow *, BlurCache> m_blurCaches;
+    quint64 m_frame = 0;
+
+    // Blurred windows that are computed in a single pass, planned from bottom to top in
+    // prePaintWindow() and computed when the first of them is drawn.
+    struct BlurBatch {
+        QVector<EffectWindow *> windows;
+        QVector<QRegion> shapes; ///< the predicted blur shape of every window
+        bool done = false;
+    };
+    BlurBatchPlanner m_batchPlanner;
+    QVector<BlurBatch> m_batches;
+    QHash<const EffectWindow *, int> m_windowBatches;
 
     static KWaylandServer::BlurManagerInterface *s_blurManager;
     static QTimer *s_blurManagerRemoveTimer;
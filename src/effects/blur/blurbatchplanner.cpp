@@ -0,0 +1,50 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "blurbatchplanner.h"
+
+namespace KWin
+{
+
+void BlurBatchPlanner::clear()
+{
+    m_batches.clear();
+}
+
+int BlurBatchPlanner::add(const QRect &geometry, const QRegion &shape, const QRegion &expandedShape, bool transformed)
+{
+    if (m_batches.isEmpty()) {
+        m_batches.append(Batch());
+    }
+
+    if (transformed) {
+        // a transformed window can paint anywhere, so nothing above it can be blurred
+        // together with anything below it
+        m_batches.append(Batch());
+        return -1;
+    }
+
+    int index = -1;
+    if (!shape.isEmpty()) {
+        if (expandedShape.intersects(m_batches.last().blocked) || expandedShape.intersects(m_batches.last().expanded)) {
+            m_batches.append(Batch());
+        }
+        m_batches.last().expanded |= expandedShape;
+        index = m_batches.count() - 1;
+    }
+
+    // windows that aren't damaged are repainted as well if a window above them is
+    m_batches.last().blocked |= geometry;
+    return index;
+}
+
+int BlurBatchPlanner::batchCount() const
+{
+    return m_batches.count();
+}
+
+} // namespace KWin
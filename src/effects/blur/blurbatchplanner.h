@@ -0,0 +1,51 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QRect>
+#include <QRegion>
+#include <QVector>
+
+namespace KWin
+{
+
+/**
+ * The BlurBatchPlanner groups the blurred windows of a frame into batches whose blur can be
+ * computed in a single pass. The windows are added from bottom to top; the blur of a window
+ * joins the current batch only if nothing that may be painted since the start of the batch
+ * shows through it and if it doesn't sample from the same area as the other windows.
+ *
+ * A batch is computed when its lowest window is drawn, i.e. before any window above it is
+ * painted. Since the paint region of a window can still grow after the pre-paint pass, every
+ * window blocks its whole geometry rather than only its damage.
+ */
+class BlurBatchPlanner
+{
+public:
+    void clear();
+
+    /**
+     * Adds the next window, which may be painted anywhere in @p geometry. The window blurs
+     * @p shape, sampling from @p expandedShape; the shape is empty if the window isn't blurred.
+     * Returns the batch in which the blur of the window is computed, or @c -1 if it isn't
+     * blurred in a batch.
+     */
+    int add(const QRect &geometry, const QRegion &shape, const QRegion &expandedShape, bool transformed);
+
+    int batchCount() const;
+
+private:
+    struct Batch
+    {
+        QRegion expanded; ///< the area the windows sample from
+        QRegion blocked; ///< the area that may be painted since the first window of the batch
+    };
+    QVector<Batch> m_batches;
+};
+
+} // namespace KWin
@@ -0,0 +1,67 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "blurcachestate.h"
+
+namespace KWin
+{
+
+bool BlurCacheState::setLayout(const QRegion &area, const QRegion &shape, const QRect &screen)
+{
+    // Docks clamp the blur to their shape, and the screen decides where the background is
+    // placed in the texture, so the cached background can't be reused if either changes.
+    if (m_area == area && m_shape == shape && m_screen == screen) {
+        return true;
+    }
+    m_area = area;
+    m_shape = shape;
+    m_screen = screen;
+    m_valid = QRegion();
+    return false;
+}
+
+void BlurCacheState::invalidate(const QRegion &region)
+{
+    m_valid -= region;
+}
+
+void BlurCacheState::validate(const QRegion &region)
+{
+    m_valid |= region;
+}
+
+void BlurCacheState::reset()
+{
+    m_valid = QRegion();
+}
+
+bool BlurCacheState::isComplete(const QRegion &area) const
+{
+    return m_area == area && (m_shape - m_valid).isEmpty();
+}
+
+QRegion BlurCacheState::area() const
+{
+    return m_area;
+}
+
+QRegion BlurCacheState::shape() const
+{
+    return m_shape;
+}
+
+QRegion BlurCacheState::valid() const
+{
+    return m_valid;
+}
+
+QRect BlurCacheState::screen() const
+{
+    return m_screen;
+}
+
+} // namespace KWin
@@ -0,0 +1,63 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QRect>
+#include <QRegion>
+
+namespace KWin
+{
+
+/**
+ * The BlurCacheState keeps track of which part of the cached blurred background of a window
+ * is still up to date. The background is stale wherever the blur could have sampled
+ * something that has been painted below the window since, and completely whenever the
+ * blurred area of the window or the screen it is laid out for changes.
+ */
+class BlurCacheState
+{
+public:
+    /**
+     * Sets the blur region @p area of the window, the part @p shape of it that gets blurred
+     * and the @p screen the cache is laid out for. Returns @c true if the cache is kept,
+     * @c false if it is stale as a whole.
+     */
+    bool setLayout(const QRegion &area, const QRegion &shape, const QRect &screen);
+
+    /**
+     * Marks the background in @p region as stale, e.g. since a window below it has been painted.
+     */
+    void invalidate(const QRegion &region);
+    /**
+     * Marks the background in @p region as up to date after it has been blurred again.
+     */
+    void validate(const QRegion &region);
+    /**
+     * Marks the whole background as stale, e.g. since the cache texture has been recreated.
+     */
+    void reset();
+
+    /**
+     * Returns whether the whole background of the blur region @p area is up to date, so that
+     * changes of the window itself don't require blurring anything.
+     */
+    bool isComplete(const QRegion &area) const;
+
+    QRegion area() const;
+    QRegion shape() const;
+    QRegion valid() const;
+    QRect screen() const;
+
+private:
+    QRegion m_area;
+    QRegion m_shape;
+    QRegion m_valid;
+    QRect m_screen;
+};
+
+} // namespace KWin
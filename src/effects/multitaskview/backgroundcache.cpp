@@ -0,0 +1,221 @@
+// SPDX-FileCopyrightText: 2018 - 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "backgroundcache.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace KWin
+{
+
+static const quint32 s_thumbnailMagic = 0x5457444b; // "KDWT"
+static const quint32 s_thumbnailVersion = 1;
+static const int s_maxMemoryCost = 128 * 1024; // KiB
+static const int s_maxUnusedDays = 30;
+
+struct ThumbnailHeader {
+    quint32 magic;
+    quint32 version;
+    qint32 width;
+    qint32 height;
+    qint32 bytesPerLine;
+    qint32 format;
+    quint32 reserved[2];
+};
+static_assert(sizeof(ThumbnailHeader) == 32, "the pixel data must stay aligned");
+
+static int memoryCost(const QImage &image)
+{
+    return qMax(1, int(image.sizeInBytes() / 1024));
+}
+
+BackgroundThumbnailCache::BackgroundThumbnailCache()
+    : m_directory(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + QStringLiteral("/deepin-kwin/multitaskview"))
+    , m_images(s_maxMemoryCost)
+{
+    QDir().mkpath(m_directory);
+}
+
+QImage BackgroundThumbnailCache::thumbnail(const QString &file, const QSize &size)
+{
+    if (size.isEmpty()) {
+        return QImage();
+    }
+    const QByteArray hash = contentHash(file);
+    if (hash.isEmpty()) {
+        return QImage();
+    }
+    const QByteArray key = hash + '-' + QByteArray::number(size.width()) + 'x' + QByteArray::number(size.height());
+
+    {
+        QMutexLocker locker(&m_mutex);
+        while (m_pending.contains(key)) {
+            m_decoded.wait(&m_mutex);
+        }
+        if (const QImage *image = m_images.object(key)) {
+            return *image;
+        }
+        m_pending.insert(key);
+    }
+
+    const QString path = thumbnailPath(key);
+    QImage image = load(path);
+    if (image.isNull()) {
+        image = decode(file, size);
+        if (!image.isNull()) {
+            save(path, image);
+        }
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_pending.remove(key);
+    if (!image.isNull()) {
+        m_images.insert(key, new QImage(image), memoryCost(image));
+    }
+    m_decoded.wakeAll();
+    return image;
+}
+
+void BackgroundThumbnailCache::prune()
+{
+    const QDateTime expiry = QDateTime::currentDateTime().addDays(-s_maxUnusedDays);
+    QDirIterator it(m_directory, {QStringLiteral("*.thumbnail")}, QDir::Files);
+    while (it.hasNext()) {
+        it.next();
+        if (it.fileInfo().lastModified() < expiry) {
+            QFile::remove(it.filePath());
+        }
+    }
+}
+
+QByteArray BackgroundThumbnailCache::contentHash(const QString &file)
+{
+    const QFileInfo info(file);
+    if (!info.isFile()) {
+        return QByteArray();
+    }
+
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_contentHashes.constFind(file);
+        if (it != m_contentHashes.constEnd() && it->lastModified == info.lastModified() && it->size == info.size()) {
+            return it->hash;
+        }
+    }
+
+    // Hashing is an order of magnitude cheaper than decoding, and only happens once per
+    // wallpaper and session.
+    QFile source(file);
+    if (!source.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    QCryptographicHash hasher(QCryptographicHash::Sha1);
+    if (!hasher.addData(&source)) {
+        return QByteArray();
+    }
+
+    ContentHash contentHash;
+    contentHash.lastModified = info.lastModified();
+    contentHash.size = info.size();
+    contentHash.hash = hasher.result().toHex();
+
+    QMutexLocker locker(&m_mutex);
+    m_contentHashes.insert(file, contentHash);
+    return contentHash.hash;
+}
+
+QString BackgroundThumbnailCache::thumbnailPath(const QByteArray &key) const
+{
+    return m_directory + QLatin1Char('/') + QString::fromLatin1(key) + QStringLiteral(".thumbnail");
+}
+
+QImage BackgroundThumbnailCache::load(const QString &path) const
+{
+    QFile *file = new QFile(path);
+    if (!file->open(QIODevice::ReadOnly)) {
+        delete file;
+        return QImage();
+    }
+
+    const qint64 fileSize = file->size();
+    const uchar *data = fileSize >= qint64(sizeof(ThumbnailHeader)) ? file->map(0, fileSize) : nullptr;
+    if (!data) {
+        delete file;
+        return QImage();
+    }
+
+    ThumbnailHeader header;
+    memcpy(&header, data, sizeof(header));
+    const bool valid = header.magic == s_thumbnailMagic
+        && header.version == s_thumbnailVersion
+        && header.width > 0 && header.height > 0
+        && (header.format == QImage::Format_RGB32 || header.format == QImage::Format_ARGB32_Premultiplied)
+        && header.bytesPerLine >= header.width * 4
+        && qint64(sizeof(header)) + qint64(header.bytesPerLine) * header.height <= fileSize;
+    if (!valid) {
+        delete file;
+        QFile::remove(path);
+        return QImage();
+    }
+
+    // The modification time doubles as the last use time for prune().
+    file->setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+
+    // The image references the mapped pages directly, the mapping lives as long as the image.
+    return QImage(data + sizeof(header), header.width, header.height, header.bytesPerLine,
+                  QImage::Format(header.format),
+                  [](void *file) {
+                      delete static_cast<QFile *>(file);
+                  },
+                  file);
+}
+
+void BackgroundThumbnailCache::save(const QString &path, const QImage &image) const
+{
+    ThumbnailHeader header = {};
+    header.magic = s_thumbnailMagic;
+    header.version = s_thumbnailVersion;
+    header.width = image.width();
+    header.height = image.height();
+    header.bytesPerLine = image.bytesPerLine();
+    header.format = image.format();
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(image.constBits()), image.sizeInBytes());
+    file.commit();
+}
+
+QImage BackgroundThumbnailCache::decode(const QString &file, const QSize &size)
+{
+    QImageReader imageReader;
+    imageReader.setFileName(file);
+    imageReader.setAutoTransform(true);
+    auto imageSize = imageReader.size();
+    auto targetScaleSize = imageSize.scaled(size, Qt::KeepAspectRatioByExpanding);
+
+    imageReader.setScaledSize(targetScaleSize);
+    QImage image = imageReader.read();
+    if (image.isNull()) {
+        return image;
+    }
+
+    if (image.width() > size.width() || image.height() > size.height()) {
+        image = image.copy(QRect(static_cast<int>((image.width() - size.width()) / 2.0),
+                                 static_cast<int>((image.height() - size.height()) / 2.0), size.width(), size.height()));
+    }
+
+    return image.convertToFormat(image.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+}
+
+} // namespace KWin
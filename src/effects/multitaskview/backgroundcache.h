@@ -0,0 +1,71 @@
+// SPDX-FileCopyrightText: 2018 - 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef KWIN_MULTITASKVIEW_BACKGROUNDCACHE_H
+#define KWIN_MULTITASKVIEW_BACKGROUNDCACHE_H
+
+#include <QCache>
+#include <QDateTime>
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QSet>
+#include <QSize>
+#include <QString>
+#include <QWaitCondition>
+
+namespace KWin
+{
+
+/**
+ * Keeps pre-scaled wallpaper thumbnails in memory and on disk.
+ *
+ * Thumbnails are keyed by a hash of the wallpaper's content and the target size, so a
+ * renamed or re-downloaded wallpaper still hits the cache while a wallpaper that has been
+ * replaced in place does not. On disk a thumbnail is stored as raw pixels behind a small
+ * header, loading it maps the file instead of decoding anything.
+ *
+ * All methods are thread-safe. Concurrent requests for the same thumbnail are coalesced,
+ * only one of them decodes the wallpaper.
+ */
+class BackgroundThumbnailCache
+{
+public:
+    BackgroundThumbnailCache();
+
+    /**
+     * Returns the wallpaper @a file scaled to cover @a size and cropped to it, or a null
+     * image if the file can't be read.
+     */
+    QImage thumbnail(const QString &file, const QSize &size);
+
+    /**
+     * Removes thumbnails that haven't been used for a while from the disk.
+     */
+    void prune();
+
+private:
+    struct ContentHash {
+        QDateTime lastModified;
+        qint64 size = 0;
+        QByteArray hash;
+    };
+
+    QByteArray contentHash(const QString &file);
+    QString thumbnailPath(const QByteArray &key) const;
+    QImage load(const QString &path) const;
+    void save(const QString &path, const QImage &image) const;
+    static QImage decode(const QString &file, const QSize &size);
+
+    QString m_directory;
+    QMutex m_mutex;
+    QWaitCondition m_decoded;
+    QHash<QString, ContentHash> m_contentHashes;
+    QCache<QByteArray, QImage> m_images;
+    QSet<QByteArray> m_pending;
+};
+
+} // namespace KWin
+
+#endif
@@ -17,9 +17,10 @@
 #include <qdbusconnection.h>
 #include <qdbusinterface.h>
 #include <qdbusreply.h>
-#include <QImageReader>
 #include "deepin_kwineffects.h"
 #include "workspace.h"
+#include "thumbnailtexturecache.h"
+#include "toplevel.h"
 //#include "multitouchgesture.h"       //to do
 
 #define BRIGHTNESS  0.4
@@ -29,6 +30,7 @@
 #define MOUSE_MOVE_MIN_DISTANCE 2
 
 #define MAX_DESKTOP_COUNT   6
+#define MAX_BACKGROUND_THREADS  4
 
 #define FIRST_WIN_SCALE     (float)(720.0 / 1080.0)
 #define WORKSPACE_SCALE     (float)(240.0 / 1920.0)
@@ -48,6 +50,8 @@
 #define EFFECT_DURATION_DEFAULT 300
 #define SCISSOR_HOFFU 200
 #define SCISSOR_HOFFD 400
+#define SHADER_PRECOMPILE_DELAY     5000
+#define SHADER_PRECOMPILE_INTERVAL  100
 
 const char screen_recorder[] = "deepin-screen-recorder deepin-screen-recorder";
 const char fallback_background_name[] = "file:///usr/share/wallpapers/deepin/desktop.jpg";
@@ -55,6 +59,23 @@ const char previous_default_background_name[] = "file:///usr/share/backgrounds/d
 const char add_workspace_png[] = ":/effects/multitaskview/buttons/add-light.png";//":/resources/themes/add-light.svg";
 const char delete_workspace_png[] = ":/effects/multitaskview/buttons/workspace_delete.png";
 
+struct PrecompiledShader
+{
+    KWin::ShaderTraits traits;
+    const char *vertexFile;
+    const char *fragmentFile;
+};
+
+// The shaders that are built the first time the view is shown.
+static const PrecompiledShader precompiled_shaders[] = {
+    {KWin::ShaderTrait::MapTexture, nullptr, ":/effects/multitaskview/shaders/workspacehover.frag"},
+    {KWin::ShaderTrait::MapTexture, ":/effects/multitaskview/shaders/bk.vert", ":/effects/multitaskview/shaders/bk.frag"},
+    {KWin::ShaderTrait::MapTexture, ":/effects/multitaskview/shaders/wbk.vert", ":/effects/multitaskview/shaders/wbk.frag"},
+    {KWin::ShaderTrait::MapTexture | KWin::ShaderTrait::Modulate, nullptr, ":/effects/multitaskview/shaders/windowfill.frag"},
+    {KWin::ShaderTrait::MapTexture | KWin::ShaderTrait::Modulate, nullptr, ":/effects/multitaskview/shaders/windowtext.frag"},
+    {KWin::ShaderTrait::UniformColor, ":/effects/multitaskview/shaders/dottedline.vert", ":/effects/multitaskview/shaders/dottedline.frag"},
+};
+
 static void ensureResources()
 {
     // Must initialize resources manually because the effect is a static lib.
@@ -94,18 +115,6 @@ QPoint calculateOffSet(const QRect& rect, const QSize screenArea, const int maxH
     return point;
 }
 
-CustomThread::CustomThread(BgInfo_st &st)
-    : QThread()
-    , m_st(st)
-{
-
-}
-
-void CustomThread::run()
-{
-    MultiViewBackgroundManager::instance()->cacheWorkspaceBg(m_st);
-}
-
 MultiViewBackgroundManager *MultiViewBackgroundManager::_instance = new MultiViewBackgroundManager();
 MultiViewBackgroundManager *MultiViewBackgroundManager::instance()
 {
@@ -114,16 +123,21 @@ MultiViewBackgroundManager *MultiViewBackgroundManager::instance()
 
 MultiViewBackgroundManager::MultiViewBackgroundManager()
     : QObject()
-    , m_bgmutex(QMutex::Recursive)
 {
     QStringList lst = QStandardPaths::standardLocations(QStandardPaths::GenericConfigLocation);
     if (lst.size() > 0) {
         m_deepinwmrcIni = new QSettings(lst[0] + "/deepinwmrc", QSettings::IniFormat);
     }
+
+    // Decoding is memory bound, a couple of workers are enough to saturate it without
+    // starving the compositor.
+    m_threadPool.setMaxThreadCount(qBound(1, QThread::idealThreadCount() / 2, MAX_BACKGROUND_THREADS));
 }
 
 MultiViewBackgroundManager::~MultiViewBackgroundManager()
 {
+    m_threadPool.clear();
+    m_threadPool.waitForDone();
     if (m_deepinwmrcIni) {
         delete m_deepinwmrcIni;
         m_deepinwmrcIni = nullptr;
@@ -146,21 +160,7 @@ static QString toRealPath(const QString &path)
 
 QPixmap MultiViewBackgroundManager::cutBackgroundPix(const QSize &size, const QString &file)
 {
-    QImageReader imageReader;
-    imageReader.setFileName(file);
-    imageReader.setAutoTransform(true);
-    auto imageSize = imageReader.size();
-    auto targetScaleSize = imageSize.scaled(size, Qt::KeepAspectRatioByExpanding);
-
-    imageReader.setScaledSize(targetScaleSize);
-    QPixmap pixmap = QPixmap::fromImageReader(&imageReader);
-
-    if(pixmap.width() > size.width() || pixmap.height() > size.height()) {
-        pixmap = pixmap.copy(QRect(static_cast<int>((pixmap.width() - size.width()) / 2.0),
-                                    static_cast<int>((pixmap.height() - size.height()) / 2.0), size.width(), size.height()));
-    }
-
-    return pixmap;
+    return QPixmap::fromImage(m_thumbnailCache.thumbnail(file, size));
 }
 
 QPixmap MultiViewBackgroundManager::getCachePix(const QSize &size, QPair<QSize, QPixmap> &pair)
@@ -214,23 +214,39 @@ void MultiViewBackgroundManager::getWorkspaceBgPath(BgInfo_st &st, QPixmap &desk
     }
 }
 
-void MultiViewBackgroundManager::cacheWorkspaceBg(BgInfo_st &st)
+void MultiViewBackgroundManager::cacheWorkspaceBg(const QVector<BgInfo_st> &list)
 {
-    QMutexLocker locker(&m_bgmutex);
-    if (m_deepinwmrcIni) {
-        QString backgroundUri;
-        QString strBackgroundPath = QString("%1@%2").arg(st.desktop).arg(st.screenName);
-        backgroundUri = m_deepinwmrcIni->value("WorkspaceBackground/" + strBackgroundPath).toString();
-        QString strBackgroundPathkey = QString("%1%2").arg(st.desktop).arg(st.screenName);
+    if (!m_deepinwmrcIni) {
+        return;
+    }
 
-        if (!backgroundUri.isEmpty()) {
-            backgroundUri = toRealPath(backgroundUri);
-            QPixmap pixmap = cutBackgroundPix(st.desktopSize, backgroundUri);
-            m_bgCachedPixmaps[backgroundUri + strBackgroundPathkey] = qMakePair(st.desktopSize, pixmap);
-            pixmap = cutBackgroundPix(st.workspaceSize, backgroundUri);
-            m_wpCachedPixmaps[backgroundUri + strBackgroundPathkey] = qMakePair(st.workspaceSize, pixmap);
+    if (!m_thumbnailCachePruned) {
+        m_thumbnailCachePruned = true;
+        m_threadPool.start([this]() {
+            m_thumbnailCache.prune();
+        });
+    }
+
+    // Screens and desktops often share a wallpaper, decode each (file, size) pair once.
+    QHash<QString, QPair<QString, QSize>> thumbnails;
+    for (const BgInfo_st &st : list) {
+        QString strBackgroundPath = QString("%1@%2").arg(st.desktop).arg(st.screenName);
+        QString backgroundUri = m_deepinwmrcIni->value("WorkspaceBackground/" + strBackgroundPath).toString();
+        if (backgroundUri.isEmpty()) {
+            continue;
+        }
+        backgroundUri = toRealPath(backgroundUri);
+        for (const QSize &size : {st.desktopSize, st.workspaceSize}) {
+            const QString key = QString("%1@%2x%3").arg(backgroundUri).arg(size.width()).arg(size.height());
+            thumbnails.insert(key, qMakePair(backgroundUri, size));
         }
     }
+
+    for (const auto &thumbnail : thumbnails) {
+        m_threadPool.start([this, thumbnail]() {
+            m_thumbnailCache.thumbnail(thumbnail.first, thumbnail.second);
+        });
+    }
 }
 
 void MultiViewBackgroundManager::clearCurrentBackgroundList()
@@ -636,6 +652,10 @@ MultitaskViewEffect::MultitaskViewEffect()
 
     cacheWorkspaceBackground();
 
+    if (ShaderManager::instance()->isProgramCacheEnabled()) {
+        QTimer::singleShot(SHADER_PRECOMPILE_DELAY, this, &MultitaskViewEffect::precompileShaders);
+    }
+
     char *ver = (char *)glGetString(GL_VERSION);
     char *rel = strstr(ver, "OpenGL ES");
     if (rel != NULL) {
@@ -645,6 +665,20 @@ MultitaskViewEffect::MultitaskViewEffect()
                                         "ShowWorkspaceChanged", this, SLOT(toggle()));
 }
 
+void MultitaskViewEffect::precompileShaders()
+{
+    // Build one shader at a time while the view is hidden, so that the compositor keeps
+    // painting frames in between. Once the view has been shown they are all built.
+    if (m_activated || m_precompiledShaderCount >= int(std::size(precompiled_shaders))) {
+        return;
+    }
+    const PrecompiledShader &shader = precompiled_shaders[m_precompiledShaderCount++];
+    effects->makeOpenGLContextCurrent();
+    ShaderManager::instance()->precompileShaderFromFile(shader.traits, QString::fromLatin1(shader.vertexFile),
+                                                        QString::fromLatin1(shader.fragmentFile));
+    QTimer::singleShot(SHADER_PRECOMPILE_INTERVAL, this, &MultitaskViewEffect::precompileShaders);
+}
+
 MultitaskViewEffect::~MultitaskViewEffect()
 {
     if (m_showAction) {
@@ -1252,15 +1286,66 @@ void MultitaskViewEffect::paintWindow(EffectWindow *w, int mask, QRegion region,
                 d.setScale(QVector2D((float)geo.width() / w->width(), (float)geo.height() / w->height()));
                 mask |= PAINT_SCREEN_TRANSFORMED;
                 MultiViewWorkspace *wkobj = getWorkspaceObject(w->screen(), paintingDesktop - 1);
-                if (wkobj)
-                    effects->paintWindow(w, mask, wkobj->getCurrentRect(), d);
-                else
-                    effects->paintWindow(w, mask, area, d);
+                const QRect clip = wkobj ? wkobj->getCurrentRect() : area;
+                if (!drawWindowThumbnail(w, geo, clip, d))
+                    effects->paintWindow(w, mask, clip, d);
             }
         }
     }
 }
 
+bool MultitaskViewEffect::drawWindowThumbnail(EffectWindow *w, const QRectF &geo, const QRect &clip, const WindowPaintData &data)
+{
+    if (!effects->isOpenGLCompositing() || w->isDeleted()) {
+        return false;
+    }
+    ThumbnailTextureCache *cache = ThumbnailTextureCache::self();
+    if (!cache) {
+        return false;
+    }
+
+    // The workspace previews are a tenth of the screen, sample a downscaled copy of the
+    // window that is only rendered again when the window is damaged.
+    const qreal xScale = geo.width() / w->width();
+    const qreal yScale = geo.height() / w->height();
+    Toplevel *toplevel = static_cast<EffectWindowImpl *>(w)->window();
+    const QRect visible = toplevel->visibleGeometry();
+    const QRect target(qRound(geo.x() + (visible.x() - w->x()) * xScale),
+                       qRound(geo.y() + (visible.y() - w->y()) * yScale),
+                       qRound(visible.width() * xScale), qRound(visible.height() * yScale));
+    if (target.isEmpty()) {
+        return false;
+    }
+
+    const QSharedPointer<GLTexture> texture = cache->texture(toplevel, target.size());
+    if (!texture) {
+        return false;
+    }
+
+    const qreal opacity = data.opacity();
+    ShaderTraits traits = ShaderTrait::MapTexture;
+    if (opacity < 1.0) {
+        traits |= ShaderTrait::Modulate;
+    }
+    GLShader *shader = ShaderManager::instance()->pushShader(traits);
+    QMatrix4x4 mvp = data.screenProjectionMatrix();
+    mvp.translate(target.x(), target.y());
+    shader->setUniform(GLShader::ModelViewProjectionMatrix, mvp);
+    if (opacity < 1.0) {
+        shader->setUniform(GLShader::ModulationConstant, QVector4D(opacity, opacity, opacity, opacity));
+    }
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    texture->bind();
+    texture->render(clip, target, true);
+    texture->unbind();
+    glDisable(GL_BLEND);
+
+    ShaderManager::instance()->popShader();
+    return true;
+}
+
 void MultitaskViewEffect::handlerAfterTimeLine()
 {
     if (m_isRemoveWorkspace) {
@@ -2520,107 +2605,47 @@ void MultitaskViewEffect::calculateWindowTransformationsClosest(EffectWindowList
 
     QRect screenRect = effects->clientArea(MaximizeFullArea, screen, desktop);
 
-    float scaleHeight = screenRect.height() * FIRST_WIN_SCALE;
-    int minSpacingH = m_scale[screen].spacingHeight;
-    int totalw = m_scale[screen].spacingWidth;
-    QRect clientRect = desktopRect;
-    clientRect.setY(clientRect.y() + m_scale[screen].workspaceMgrHeight);
-
-    QList<int> centerList;
-    int row = 1;
-    int index = 1;
-    int xpos = 0;
-    bool overlap;
-    do {
-        overlap = false;
-        for (int i = windowlist.size() - 1; i >= 0; i--) {
-            EffectWindow *w = windowlist[i];
-            if (splitlist.contains(w) && splitwin != w) {
-                continue;
-            }
-            QRect *target = &targets[w];
-            float width = target->width();
-            if (target->height() > scaleHeight) {
-                float scale = (float)(scaleHeight / target->height());
-                width = target->width() * scale;
-            }
-            totalw += width;
-            totalw += m_scale[screen].spacingWidth;
-
-            if (totalw > clientRect.width()) {
-                index ++;
-                if (index > row)
-                    break;
-                xpos = ((clientRect.width() - totalw + width + m_scale[screen].spacingWidth) / 2) + m_scale[screen].spacingWidth + clientRect.x();
-                centerList.push_back(xpos);
-                totalw = m_scale[screen].spacingWidth;
-                totalw += width;
-                totalw += m_scale[screen].spacingWidth;
-            }
-        }
-        xpos = ((clientRect.width() - totalw) / 2) + m_scale[screen].spacingWidth + clientRect.x();
-        centerList.push_back(xpos);
-
-        if (totalw > clientRect.width()) {
-            centerList.clear();
-            overlap = true;
-            scaleHeight -= 15;
-            float critical = (float)(clientRect.height() - (row + 2) * minSpacingH) / (float)(row + 1);
-            if (scaleHeight <= critical) {
-                row++;
-            }
-            index = 1;
-            totalw = m_scale[screen].spacingWidth;
-        }
-    } while (overlap);  //calculation layout row
-
-    float winYPos = (clientRect.height() - (index - 1) * minSpacingH - index * scaleHeight) / 2 + clientRect.y();
-    row = 1;
-    int x = centerList[row - 1];
-    totalw = m_scale[screen].spacingWidth;
+    WindowGridParameters parameters;
+    parameters.area = desktopRect;
+    parameters.area.setY(desktopRect.y() + m_scale[screen].workspaceMgrHeight);
+    parameters.maxHeight = screenRect.height() * FIRST_WIN_SCALE;
+    parameters.spacingWidth = m_scale[screen].spacingWidth;
+    parameters.spacingHeight = m_scale[screen].spacingHeight;
+
+    // the grid is filled from the top of the stacking order
+    EffectWindowList order;
+    QVector<const void *> windows;
+    QVector<QSize> sizes;
+    order.reserve(windowlist.size());
+    windows.reserve(windowlist.size());
+    sizes.reserve(windowlist.size());
     for (int i = windowlist.size() - 1; i >= 0; i--) {
         EffectWindow *w = windowlist[i];
         if (splitlist.contains(w) && splitwin != w) {
             continue;
         }
-        QRect *target = &targets[w];
-        float width = 0.0, height = 0.0;
-        bool isFill = false;
-        if (target->height() > scaleHeight) {
-            float scale = (float)(scaleHeight / target->height());
-            width = target->width() * scale;
-            height = scaleHeight;
-        } else {
-            width = target->width();
-            height = target->height();
-            isFill = true;
-        }
-        totalw += width;
-        totalw += m_scale[screen].spacingWidth;
-        if (totalw > clientRect.width()) {
-            row++;
-            totalw = m_scale[screen].spacingWidth;
-            totalw += width;
-            totalw += m_scale[screen].spacingWidth;
-            x = centerList[row - 1];
-            winYPos += minSpacingH;
-            winYPos += scaleHeight;
-        }
+        order.append(w);
+        windows.append(w);
+        sizes.append(targets.value(w).size());
+    }
+
+    const QVector<WindowGridCell> &cells = m_gridLayoutCache.layout(desktop, screen, windows, sizes, parameters);
+    for (int i = 0; i < order.size(); i++) {
+        EffectWindow *w = order[i];
+        const WindowGridCell &cell = cells[i];
 
         if (isReLayout) {
             motionManager.resetWindowFill(w);
             removeBackgroundFill(w, desktop);
         }
 
-        target->setRect(x, winYPos + (scaleHeight - height) / 2, width, height);
+        QRect *target = &targets[w];
+        *target = cell.geometry;
 
-        if (isFill) {
-            QRect rect(x, winYPos, width, scaleHeight);
-            motionManager.setWindowFill(w, true, rect);
-            createBackgroundFill(w, rect, desktop);
+        if (cell.fill) {
+            motionManager.setWindowFill(w, true, cell.fillArea);
+            createBackgroundFill(w, cell.fillArea, desktop);
         }
-        x += width;
-        x += m_scale[screen].spacingWidth;
 
         if (splitlist.contains(w)) {
             if (wmobj)
@@ -2853,6 +2878,7 @@ void MultitaskViewEffect::cacheWorkspaceBackground()
 {
     getScreenInfo();
     int count = effects->numberOfDesktops();
+    QVector<BgInfo_st> list;
     QHash<QString, ScreenInfo_st>::iterator it = m_screenInfoList.begin();
     for (; it != m_screenInfoList.end(); it++) {
         for (int i = 1; i <= count; i++) {
@@ -2862,11 +2888,10 @@ void MultitaskViewEffect::cacheWorkspaceBackground()
             st.screenName = it.value().name;
             st.desktopSize = it.value().screenrect.size();
             st.workspaceSize = rect.size();
-            CustomThread *thread = new CustomThread(st);
-            connect(thread, &QThread::finished, thread, &QObject::deleteLater);
-            thread->start();
+            list.append(st);
         }
     }
+    MultiViewBackgroundManager::instance()->cacheWorkspaceBg(list);
 }
 
 void MultitaskViewEffect::updateWorkspacePos(int num)
@@ -9,12 +9,14 @@
 #include "deepin_kwinglutils.h"
 #include "scene.h"
 #include "multitask_effect.h"
+#include "backgroundcache.h"
+#include "windowgridlayout.h"
 #include <QHash>
 //#include <utils.h>
 #include <QMutex>
 #include <map>
 #include <QSettings>
-#include <QThread>
+#include <QThreadPool>
 
 namespace KWin
 {
@@ -58,18 +60,6 @@ typedef struct backgroundInfo {
     QSize   desktopSize;
 } BgInfo_st;
 
-class CustomThread : public QThread
-{
-    Q_OBJECT
-public:
-    CustomThread(BgInfo_st &st);
-
-protected:
-    void run() override;
-
-    BgInfo_st m_st;
-};
-
 class MultiViewBackgroundManager: public QObject
 {
     Q_OBJECT
@@ -85,7 +75,7 @@ public:
     }
 
     void getWorkspaceBgPath(BgInfo_st &st, QPixmap &desktopBg, QPixmap &workspaceBg);
-    void cacheWorkspaceBg(BgInfo_st &st);
+    void cacheWorkspaceBg(const QVector<BgInfo_st> &list);
     void getBackgroundList();
     void updateBackgroundList(const QString &file);
     void setNewBackground(BgInfo_st &st, QPixmap &desktopBg, QPixmap &workspaceBg);
@@ -117,8 +107,10 @@ private:
     QList<QString>   m_screenNamelist;
     QString          m_previewFile = "";
     EffectScreen    *m_previewScreen = nullptr;
-    QMutex          m_bgmutex;
     QSettings *m_deepinwmrcIni = nullptr;
+    BackgroundThumbnailCache m_thumbnailCache;
+    QThreadPool      m_threadPool;
+    bool             m_thumbnailCachePruned = false;
 
     QHash<QString, QPair<QSize, QPixmap>> m_wpCachedPixmaps;
     QHash<QString, QPair<QSize, QPixmap>> m_bgCachedPixmaps;
@@ -491,6 +483,7 @@ private:
     void renderWindowMove(KWin::ScreenPaintData &data);
     void renderSlidingWorkspace(MultiViewWorkspace *wkobj, EffectScreen *screen, int desktop, KWin::ScreenPaintData &data);
     void renderHover(const EffectWindow *w, const QRect &rect, int order = 0);
+    bool drawWindowThumbnail(EffectWindow *w, const QRectF &geo, const QRect &clip, const WindowPaintData &data);
     void renderWorkspaceHover(EffectScreen *screen);
     void renderDragWorkspacePrompt(EffectScreen *screen);
     void drawDottedLine(const QRect &geo, EffectScreen *screen);
@@ -518,6 +511,7 @@ private:
     EffectWindow *getNextSameTypeWindow(EffectWindow *w);
     EffectWindow *getPreSameTypeWindow(EffectWindow *w);
     void motionRepeat();
+    void precompileShaders();
 
 private:
     QAction *m_showAction = nullptr;
@@ -567,6 +561,7 @@ private:
     QHash<EffectScreen *, MultiViewWorkspace *>     m_workspaceBackgroundsTmp;
     QVector<MultiViewWinManager *>                  m_motionManagers;
     QVector<MultiViewWinManager *>                  m_workspaceWinMgr;
+    WindowGridLayoutCache                           m_gridLayoutCache;
     QRect m_backgroundRect;
     QRect m_windowMoveGeometry;
 
@@ -631,6 +626,7 @@ private:
     Qt::MouseButton m_sendDockButton = Qt::NoButton;
     QPoint          m_cursorPos;
     int             m_buttonType = 0;
+    int             m_precompiledShaderCount = 0;
 };
 
 } // namespace KWin
@@ -0,0 +1,148 @@
+// SPDX-FileCopyrightText: 2018 - 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "windowgridlayout.h"
+
+#include <QList>
+
+namespace KWin
+{
+
+QVector<WindowGridCell> computeWindowGridLayout(const QVector<QSize> &sizes, const WindowGridParameters &parameters)
+{
+    QVector<WindowGridCell> cells;
+    if (sizes.isEmpty()) {
+        return cells;
+    }
+
+    const QRect &clientRect = parameters.area;
+    float scaleHeight = parameters.maxHeight;
+    const int minSpacingH = parameters.spacingHeight;
+    const int spacingW = parameters.spacingWidth;
+    int totalw = spacingW;
+
+    QList<int> centerList;
+    int row = 1;
+    int index = 1;
+    int xpos = 0;
+    bool overlap;
+    do {
+        overlap = false;
+        for (const QSize &size : sizes) {
+            float width = size.width();
+            if (size.height() > scaleHeight) {
+                float scale = (float)(scaleHeight / size.height());
+                width = size.width() * scale;
+            }
+            totalw += width;
+            totalw += spacingW;
+
+            if (totalw > clientRect.width()) {
+                index ++;
+                if (index > row)
+                    break;
+                xpos = ((clientRect.width() - totalw + width + spacingW) / 2) + spacingW + clientRect.x();
+                centerList.push_back(xpos);
+                totalw = spacingW;
+                totalw += width;
+                totalw += spacingW;
+            }
+        }
+        xpos = ((clientRect.width() - totalw) / 2) + spacingW + clientRect.x();
+        centerList.push_back(xpos);
+
+        if (totalw > clientRect.width()) {
+            centerList.clear();
+            overlap = true;
+            scaleHeight -= 15;
+            float critical = (float)(clientRect.height() - (row + 2) * minSpacingH) / (float)(row + 1);
+            if (scaleHeight <= critical) {
+                row++;
+            }
+            index = 1;
+            totalw = spacingW;
+        }
+    } while (overlap);  //calculation layout row
+
+    float winYPos = (clientRect.height() - (index - 1) * minSpacingH - index * scaleHeight) / 2 + clientRect.y();
+    row = 1;
+    int x = centerList[row - 1];
+    totalw = spacingW;
+    cells.reserve(sizes.size());
+    for (const QSize &size : sizes) {
+        float width = 0.0, height = 0.0;
+        bool isFill = false;
+        if (size.height() > scaleHeight) {
+            float scale = (float)(scaleHeight / size.height());
+            width = size.width() * scale;
+            height = scaleHeight;
+        } else {
+            width = size.width();
+            height = size.height();
+            isFill = true;
+        }
+        totalw += width;
+        totalw += spacingW;
+        if (totalw > clientRect.width()) {
+            row++;
+            totalw = spacingW;
+            totalw += width;
+            totalw += spacingW;
+            x = centerList[row - 1];
+            winYPos += minSpacingH;
+            winYPos += scaleHeight;
+        }
+
+        WindowGridCell cell;
+        cell.geometry.setRect(x, winYPos + (scaleHeight - height) / 2, width, height);
+        if (isFill) {
+            cell.fill = true;
+            cell.fillArea = QRect(x, winYPos, width, scaleHeight);
+        }
+        cells.append(cell);
+
+        x += width;
+        x += spacingW;
+    }
+    return cells;
+}
+
+static uint hashInputs(const QVector<const void *> &windows, const QVector<QSize> &sizes, const WindowGridParameters &parameters)
+{
+    uint hash = qHash(parameters.area.x()) ^ qHash(parameters.area.y() << 16) ^ qHash(parameters.area.width() << 8)
+        ^ qHash(parameters.area.height() << 24) ^ qHash(parameters.maxHeight)
+        ^ qHash(parameters.spacingWidth << 4) ^ qHash(parameters.spacingHeight << 12);
+    for (int i = 0; i < windows.size(); ++i) {
+        hash = 31 * hash + qHash(windows[i]);
+        hash = 31 * hash + qHash(sizes[i].width());
+        hash = 31 * hash + qHash(sizes[i].height());
+    }
+    return hash;
+}
+
+const QVector<WindowGridCell> &WindowGridLayoutCache::layout(int desktop, const void *screen, const QVector<const void *> &windows,
+                                                             const QVector<QSize> &sizes, const WindowGridParameters &parameters)
+{
+    Q_ASSERT(windows.size() == sizes.size());
+    const uint hash = hashInputs(windows, sizes, parameters);
+
+    Entry &entry = m_entries[qMakePair(desktop, screen)];
+    if (entry.hash == hash && entry.windows == windows && entry.sizes == sizes && entry.parameters == parameters) {
+        return entry.cells;
+    }
+
+    entry.hash = hash;
+    entry.windows = windows;
+    entry.sizes = sizes;
+    entry.parameters = parameters;
+    entry.cells = computeWindowGridLayout(sizes, parameters);
+    return entry.cells;
+}
+
+void WindowGridLayoutCache::clear()
+{
+    m_entries.clear();
+}
+
+} // namespace KWin
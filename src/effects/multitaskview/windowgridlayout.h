@@ -0,0 +1,77 @@
+// SPDX-FileCopyrightText: 2018 - 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef KWIN_MULTITASKVIEW_WINDOWGRIDLAYOUT_H
+#define KWIN_MULTITASKVIEW_WINDOWGRIDLAYOUT_H
+
+#include <QHash>
+#include <QPair>
+#include <QRect>
+#include <QSize>
+#include <QVector>
+
+namespace KWin
+{
+
+struct WindowGridParameters
+{
+    QRect area; ///< the rows are centered in this area
+    float maxHeight = 0; ///< the height of a row before it is shrunk to fit all windows
+    int spacingWidth = 0;
+    int spacingHeight = 0;
+
+    bool operator==(const WindowGridParameters &other) const
+    {
+        return area == other.area && maxHeight == other.maxHeight
+            && spacingWidth == other.spacingWidth && spacingHeight == other.spacingHeight;
+    }
+};
+
+struct WindowGridCell
+{
+    QRect geometry;
+    /**
+     * Windows lower than a row are centered in it, the rest of the row is filled with
+     * the background.
+     */
+    bool fill = false;
+    QRect fillArea;
+};
+
+/**
+ * Lays out windows of the given @a sizes in rows, in the given order. The row height
+ * shrinks from WindowGridParameters::maxHeight until all windows fit into the area.
+ */
+QVector<WindowGridCell> computeWindowGridLayout(const QVector<QSize> &sizes, const WindowGridParameters &parameters);
+
+/**
+ * Remembers the last layout computed for every desktop and screen.
+ *
+ * A layout is reused as long as the same windows with the same sizes are laid out with
+ * the same parameters, so only the desktop a window was added to, removed from or resized
+ * on is computed again.
+ */
+class WindowGridLayoutCache
+{
+public:
+    const QVector<WindowGridCell> &layout(int desktop, const void *screen, const QVector<const void *> &windows,
+                                          const QVector<QSize> &sizes, const WindowGridParameters &parameters);
+    void clear();
+
+private:
+    struct Entry
+    {
+        uint hash = 0;
+        QVector<const void *> windows;
+        QVector<QSize> sizes;
+        WindowGridParameters parameters;
+        QVector<WindowGridCell> cells;
+    };
+
+    QHash<QPair<int, const void *>, Entry> m_entries;
+};
+
+} // namespace KWin
+
+#endif
@@ -0,0 +1,36 @@
+#version 140
+
+uniform sampler2D sampler, msk1;
+uniform vec2 windowSize;
+uniform vec4 clipRect;
+uniform float cornerSize;
+
+in vec2 texcoord0;
+out vec4 fragColor;
+
+void main() {
+    vec4 c = texture(sampler, texcoord0);
+    vec2 p = texcoord0 * windowSize - clipRect.xy;
+    if (any(lessThan(p, vec2(0.0))) || any(greaterThan(p, clipRect.zw))) {
+        c = vec4(0.0);
+    } else {
+        // msk1 holds the four corners of the path, the straight edges in between
+        // are sampled from the seam of the corners
+        vec2 farCorner = p - clipRect.zw + 2.0 * cornerSize;
+        vec2 m = vec2(cornerSize);
+        if (p.x < cornerSize) {
+            m.x = p.x;
+        } else if (p.x > clipRect.z - cornerSize) {
+            m.x = farCorner.x;
+        }
+        if (p.y < cornerSize) {
+            m.y = p.y;
+        } else if (p.y > clipRect.w - cornerSize) {
+            m.y = farCorner.y;
+        }
+        c *= texture(msk1, m / (2.0 * cornerSize)).a;
+    }
+    fragColor = c;
+}
+
+// vim: set ft=glsl:
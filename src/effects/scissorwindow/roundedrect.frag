@@ -0,0 +1,31 @@
+#version 300 es
+precision highp float;
+
+uniform sampler2D sampler;
+uniform vec2 windowSize;
+uniform vec4 clipRect;
+uniform float radius;
+
+in vec2 texcoord0;
+out vec4 fragColor;
+
+// signed distance to the rounded rectangle, negative inside
+float roundedRectDistance(vec2 p) {
+    vec2 halfSize = clipRect.zw * 0.5;
+    vec2 q = abs(p - clipRect.xy - halfSize) - halfSize + radius;
+    return min(max(q.x, q.y), 0.0) + length(max(q, 0.0)) - radius;
+}
+
+void main() {
+    vec4 c = texture(sampler, texcoord0);
+    float d = roundedRectDistance(texcoord0 * windowSize);
+    // in screen pixels, so the edge stays crisp when the window is scaled
+    d /= max(length(vec2(dFdx(d), dFdy(d))), 0.0001);
+    // same coverage as the painted mask: the filled path with a faint 2px outline
+    float fill = clamp(0.5 - d, 0.0, 1.0);
+    float outline = 0.235 * clamp(1.5 - abs(d), 0.0, 1.0);
+    c *= outline + fill * (1.0 - outline);
+    fragColor = c;
+}
+
+// vim: set ft=glsl:
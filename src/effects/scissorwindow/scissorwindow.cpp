@@ -15,9 +15,14 @@
 #include <QPainter>
 #include <QPainterPath>
 #include <QTextStream>
+#include <QVector2D>
+#include <QVector4D>
 
 Q_DECLARE_METATYPE(QPainterPath)
 
+// the outline painted around clip paths reaches 1px beyond the path
+static const qreal s_clipOutlineMargin = 2;
+
 static void ensureResources()
 {
     // Must initialize resources manually because the effect is a static lib.
@@ -26,6 +31,40 @@ static void ensureResources()
 
 namespace KWin {
 
+static void paintClipPath(QPainter *painter, const QPainterPath &path)
+{
+    painter->setRenderHint(QPainter::Antialiasing);
+    painter->fillPath(path, QColor(255, 255, 255, 255));
+    painter->strokePath(path, QPen(QColor(80, 80, 80, 60), 2));
+}
+
+// Recognizes the paths built with QPainterPath::addRect() and addRoundedRect() with
+// circular corners, which is what clients set in most cases.
+static bool isRoundedRect(const QPainterPath &path, QRectF *rect, qreal *radius)
+{
+    if (path.elementCount() < 5) {
+        return false;
+    }
+    const QRectF bounds = path.boundingRect();
+    qreal r = 0;
+    if (path.elementAt(1).isCurveTo()) {
+        r = path.elementAt(3).x - bounds.x();
+        if (!qFuzzyCompare(r, path.elementAt(0).y - bounds.y())) {
+            return false;
+        }
+    }
+
+    QPainterPath roundedRect;
+    roundedRect.setFillRule(path.fillRule());
+    roundedRect.addRoundedRect(bounds, r, r);
+    if (roundedRect != path) {
+        return false;
+    }
+    *rect = bounds;
+    *radius = r;
+    return true;
+}
+
 ScissorWindow::ScissorWindow() : Effect() {
     ensureResources();
 
@@ -47,6 +86,16 @@ ScissorWindow::ScissorWindow() : Effect() {
                                                                                ":/effects/scissor/fillet.frag"
                                                                             );
 
+    m_roundedRectShader = ShaderManager::instance()->generateShaderFromFile(ShaderTrait::MapTexture,
+                                                                            QByteArray(),
+                                                                            ":/effects/scissor/roundedrect.frag"
+                                                                         );
+
+    m_cornerMaskShader = ShaderManager::instance()->generateShaderFromFile(ShaderTrait::MapTexture,
+                                                                           QByteArray(),
+                                                                           ":/effects/scissor/cornermask.frag"
+                                                                        );
+
     {
         for (int i = 0; i < KWindowSystem::windows().count(); ++i) {
             if (EffectWindow *win = effects->findWindow(KWindowSystem::windows().at(i)))
@@ -60,6 +109,8 @@ ScissorWindow::ScissorWindow() : Effect() {
 ScissorWindow::~ScissorWindow() {
     if (m_maskShader) delete m_maskShader;
     if (m_filletOptimizeShader) delete m_filletOptimizeShader;
+    if (m_roundedRectShader) delete m_roundedRectShader;
+    if (m_cornerMaskShader) delete m_cornerMaskShader;
     for (auto itr = m_texMaskMap.begin(); itr != m_texMaskMap.end(); itr++) {
         delete itr->second;
     }
@@ -126,25 +177,10 @@ void ScissorWindow::drawWindow(EffectWindow *w, int mask, const QRegion& region,
     const QVariant &data_clip_path = w->data(WindowClipPathRole);
     if (data_clip_path.isValid()) {
         const QPainterPath path = qvariant_cast<QPainterPath>(data_clip_path);
-        static const int extraWindowFrame = 100;
-
-        if (!m_clipMaskMap.count(w) || m_clipMaskMap[w].maskPath != path) {
-            QImage maskImage(w->size() * 2, QImage::Format_RGBA8888);
-            maskImage.fill(QColor(0, 0, 0, 0));
-            QPainter pa(&maskImage);
-            pa.setRenderHint(QPainter::Antialiasing);
-            pa.scale(2, 2);
-            pa.fillPath(path, QColor(255, 255, 255, 255));
-            pa.strokePath(path, QPen(QColor(80, 80, 80, 60), 2));
-            pa.end();
-
-            m_clipMaskMap[w] = WindowMaskCache {
-                .maskPath = path,
-                .maskTexture = std::make_shared<GLTexture>(maskImage),
-            };
-
-            m_clipMaskMap[w].maskTexture->setFilter(GL_LINEAR);
-            m_clipMaskMap[w].maskTexture->setWrapMode(GL_CLAMP_TO_EDGE);
+
+        auto it = m_clipMaskMap.find(w);
+        if (it == m_clipMaskMap.end() || it->second.maskPath != path) {
+            updateClipMask(w, m_clipMaskMap[w], path);
         }
 
         const WindowMaskCache& cache = m_clipMaskMap[w];
@@ -152,19 +188,35 @@ void ScissorWindow::drawWindow(EffectWindow *w, int mask, const QRegion& region,
         glEnable(GL_BLEND);
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-        QRect rect = w->rect();
-        rect.adjust(-extraWindowFrame, -extraWindowFrame, extraWindowFrame, extraWindowFrame);
-
         {
-            auto shader = m_maskShader;
+            GLShader *shader = m_maskShader;
+            if (cache.mode == ClipMode::RoundedRect) {
+                shader = m_roundedRectShader;
+            } else if (cache.mode == ClipMode::CornerMask) {
+                shader = m_cornerMaskShader;
+            }
             ShaderManager::instance()->pushShader(shader);
             shader->setUniform("sampler", 0);
-            shader->setUniform("msk1", 2);
+            if (cache.mode == ClipMode::RoundedRect) {
+                shader->setUniform("radius", float(cache.clipSize));
+            } else {
+                shader->setUniform("msk1", 2);
+            }
+            if (cache.mode == ClipMode::CornerMask) {
+                shader->setUniform("cornerSize", float(cache.clipSize));
+            }
+            if (cache.mode != ClipMode::WindowMask) {
+                shader->setUniform("windowSize", QVector2D(w->width(), w->height()));
+                shader->setUniform("clipRect", QVector4D(cache.clipRect.x(), cache.clipRect.y(),
+                                                         cache.clipRect.width(), cache.clipRect.height()));
+            }
             auto old_shader = data.shader;
             data.shader = shader;
 
             std::shared_ptr<GLTexture> maskTexture = cache.maskTexture;
-            glActiveTexture(GL_TEXTURE2); maskTexture->bind();
+            if (maskTexture) {
+                glActiveTexture(GL_TEXTURE2); maskTexture->bind();
+            }
 
             glActiveTexture(GL_TEXTURE0);
             effects->drawWindow(w, mask, region, data);
@@ -172,10 +224,11 @@ void ScissorWindow::drawWindow(EffectWindow *w, int mask, const QRegion& region,
             ShaderManager::instance()->popShader();
             data.shader = old_shader;
 
-            glActiveTexture(GL_TEXTURE2);
-            glActiveTexture(GL_TEXTURE0);
-
-            maskTexture->unbind();
+            if (maskTexture) {
+                glActiveTexture(GL_TEXTURE2);
+                maskTexture->unbind();
+                glActiveTexture(GL_TEXTURE0);
+            }
         }
 
         return;
@@ -244,6 +297,82 @@ void ScissorWindow::drawWindow(EffectWindow *w, int mask, const QRegion& region,
     }
 }
 
+void ScissorWindow::updateClipMask(EffectWindow *w, WindowMaskCache &cache, const QPainterPath &path)
+{
+    cache.maskPath = path;
+
+    if (isRoundedRect(path, &cache.clipRect, &cache.clipSize)) {
+        cache.mode = ClipMode::RoundedRect;
+        cache.maskTexture.reset();
+        return;
+    }
+
+    // If the path covers its bounding rect apart from the corners, only the corners need to
+    // be painted. The edges in between are straight, the shader stretches them from the mask.
+    const QRectF bounds = path.boundingRect();
+    const QRectF clipRect = bounds.adjusted(-s_clipOutlineMargin, -s_clipOutlineMargin,
+                                            s_clipOutlineMargin, s_clipOutlineMargin);
+    for (qreal cornerSize : {8.0, 16.0, 32.0, 64.0}) {
+        if (clipRect.width() < cornerSize * 2 || clipRect.height() < cornerSize * 2) {
+            break;
+        }
+        const qreal inset = cornerSize / 2 - s_clipOutlineMargin;
+        if (path.contains(bounds.adjusted(inset, 0.5, -inset, -0.5))
+                && path.contains(bounds.adjusted(0.5, inset, -0.5, -inset))) {
+            cache.mode = ClipMode::CornerMask;
+            cache.clipRect = clipRect;
+            cache.clipSize = cornerSize;
+            updateCornerMask(cache, path);
+            return;
+        }
+    }
+
+    QImage maskImage(w->size() * 2, QImage::Format_RGBA8888);
+    maskImage.fill(QColor(0, 0, 0, 0));
+    QPainter pa(&maskImage);
+    pa.scale(2, 2);
+    paintClipPath(&pa, path);
+    pa.end();
+
+    cache.mode = ClipMode::WindowMask;
+    cache.maskTexture = std::make_shared<GLTexture>(maskImage);
+    cache.maskTexture->setFilter(GL_LINEAR);
+    cache.maskTexture->setWrapMode(GL_CLAMP_TO_EDGE);
+}
+
+void ScissorWindow::updateCornerMask(WindowMaskCache &cache, const QPainterPath &path)
+{
+    const qreal cornerSize = cache.clipSize;
+    const QRectF &rect = cache.clipRect;
+
+    QImage maskImage(QSize(cornerSize * 4, cornerSize * 4), QImage::Format_RGBA8888);
+    maskImage.fill(QColor(0, 0, 0, 0));
+    QPainter pa(&maskImage);
+    pa.scale(2, 2);
+    // the corners of the clip rect are painted next to each other
+    for (int corner = 0; corner < NCorners; ++corner) {
+        const bool right = corner == TopRight || corner == BottomRight;
+        const bool bottom = corner == BottomLeft || corner == BottomRight;
+        const QPointF target(right ? cornerSize : 0, bottom ? cornerSize : 0);
+        const QPointF source(right ? rect.right() - cornerSize : rect.left(),
+                             bottom ? rect.bottom() - cornerSize : rect.top());
+        pa.save();
+        pa.setClipRect(QRectF(target, QSizeF(cornerSize, cornerSize)));
+        pa.translate(target - source);
+        paintClipPath(&pa, path);
+        pa.restore();
+    }
+    pa.end();
+
+    if (cache.maskTexture && cache.maskTexture->size() == maskImage.size()) {
+        cache.maskTexture->update(maskImage);
+        return;
+    }
+    cache.maskTexture = std::make_shared<GLTexture>(maskImage);
+    cache.maskTexture->setFilter(GL_LINEAR);
+    cache.maskTexture->setWrapMode(GL_CLAMP_TO_EDGE);
+}
+
 bool ScissorWindow::enabledByDefault() { return supported(); }
 
 bool ScissorWindow::supported() {
@@ -19,8 +19,17 @@ class ScissorWindow : public Effect
 {
     Q_OBJECT
 
+    enum class ClipMode {
+        RoundedRect,    // clipped analytically in the shader
+        CornerMask,     // only the corners of the path are painted into a mask
+        WindowMask,     // the whole path is painted into a mask
+    };
+
     struct WindowMaskCache {
         QPainterPath maskPath;
+        ClipMode mode = ClipMode::WindowMask;
+        QRectF clipRect;
+        qreal clipSize = 0; // the corner radius or the size of the painted corners
         std::shared_ptr<GLTexture> maskTexture;
     };
 
@@ -59,6 +68,9 @@ protected Q_SLOTS:
     void windowDeleted(EffectWindow *window);
 
 private:
+    void updateClipMask(EffectWindow *w, WindowMaskCache &cache, const QPainterPath &path);
+    void updateCornerMask(WindowMaskCache &cache, const QPainterPath &path);
+
     enum { TopLeft = 0, TopRight, BottomRight, BottomLeft, NCorners };
     int m_radius;
     QSize m_cornerSize;
@@ -66,6 +78,7 @@ private:
     GLTexture *m_texMask[NCorners];
     //GLTexture *m_maskTexture;
     GLShader *m_maskShader, *m_filletOptimizeShader;
+    GLShader *m_roundedRectShader, *m_cornerMaskShader;
     std::map<int, GLTexture*> m_texMaskMap;
     std::map<EffectWindow*, WindowMaskCache> m_clipMaskMap;
 };
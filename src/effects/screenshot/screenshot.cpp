@@ -14,8 +14,10 @@
 
 #include <deepin_kwinglplatform.h>
 #include <deepin_kwinglutils.h>
+#include <kwinpixelconversion_p.h>
 
 #include <QPainter>
+#include <QtConcurrent>
 
 namespace KWin
 {
@@ -27,6 +29,12 @@ struct ScreenShotWindowData
     EffectWindow *window = nullptr;
 };
 
+struct ScreenShotCursor
+{
+    QImage image;
+    QPoint position;
+};
+
 struct ScreenShotAreaData
 {
     QFutureInterface<QImage> promise;
@@ -34,6 +42,9 @@ struct ScreenShotAreaData
     QRect area;
     QImage result;
     QList<EffectScreen *> screens;
+    int pendingReadbacks = 0;
+    ScreenShotCursor cursor; ///< grabbed when the first screen is captured
+    bool cursorGrabbed = false;
 };
 
 struct ScreenShotScreenData
@@ -51,35 +62,172 @@ struct ScreenShotWindowSizedData
     EffectWindow *window = nullptr;
 };
 
-static void convertFromGLImage(QImage &img, int w, int h)
-{
-    // from QtOpenGL/qgl.cpp
-    // SPDX-FileCopyrightText: 2010 Nokia Corporation and /or its subsidiary(-ies)
-    // see https://github.com/qt/qtbase/blob/dev/src/opengl/qgl.cpp
-    if (QSysInfo::ByteOrder == QSysInfo::BigEndian) {
-        // OpenGL gives RGBA; Qt wants ARGB
-        uint *p = reinterpret_cast<uint *>(img.bits());
-        uint *end = p + w * h;
-        while (p < end) {
-            uint a = *p << 24;
-            *p = (*p >> 8) | a;
-            p++;
-        }
+/**
+ * Copies the contents of the current framebuffer into a pixel buffer object. The copy
+ * happens asynchronously, the pixels are fetched after the fence has been signalled,
+ * usually a frame later. Without sync objects, the pixels are read back immediately.
+ */
+class ScreenShotReadback
+{
+public:
+    ScreenShotReadback(const QFutureInterface<QImage> &promise, const QSize &size, qreal devicePixelRatio,
+                       std::function<void(const QImage &)> callback);
+    ~ScreenShotReadback();
+
+    bool isReady() const;
+    void finish();
+
+private:
+    QFutureInterface<QImage> m_promise;
+    std::function<void(const QImage &)> m_callback;
+    QSize m_size;
+    qreal m_devicePixelRatio;
+    QImage m_image;
+    GLuint m_buffer = 0;
+    GLsync m_fence = nullptr;
+    bool m_finished = false;
+};
+
+static bool asyncReadbackSupported()
+{
+    if (GLPlatform::instance()->isGLES()) {
+        return hasGLVersion(3, 0);
+    }
+    return (hasGLVersion(3, 2) || hasGLExtension(QByteArrayLiteral("GL_ARB_sync")))
+        && (hasGLVersion(3, 0) || hasGLExtension(QByteArrayLiteral("GL_ARB_map_buffer_range")));
+}
+
+static QImage::Format readbackFormat()
+{
+    // Desktop GL packs the pixels exactly like QImage::Format_ARGB32 on any byte order. GLES
+    // only guarantees GL_RGBA, which is swizzled to it while the rows are flipped.
+    if (GLPlatform::instance()->isGLES() && Q_BYTE_ORDER == Q_BIG_ENDIAN) {
+        return QImage::Format_RGBA8888_Premultiplied;
+    }
+    return QImage::Format_ARGB32_Premultiplied;
+}
+
+static PixelConversion readbackConversion()
+{
+    if (GLPlatform::instance()->isGLES() && Q_BYTE_ORDER == Q_LITTLE_ENDIAN) {
+        return PixelConversion::SwapRedBlue;
+    }
+    return PixelConversion::Copy;
+}
+
+static void readPixels(const QSize &size, GLvoid *pixels)
+{
+    if (GLPlatform::instance()->isGLES()) {
+        glReadPixels(0, 0, size.width(), size.height(), GL_RGBA, GL_UNSIGNED_BYTE, pixels);
     } else {
-        // OpenGL gives ABGR (i.e. RGBA backwards); Qt wants ARGB
-        for (int y = 0; y < h; y++) {
-            uint *q = reinterpret_cast<uint *>(img.scanLine(y));
-            for (int x = 0; x < w; ++x) {
-                const uint pixel = *q;
-                *q = ((pixel << 16) & 0xff0000) | ((pixel >> 16) & 0xff)
-                     | (pixel & 0xff00ff00);
-
-                q++;
-            }
+        glReadPixels(0, 0, size.width(), size.height(), GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, pixels);
+    }
+}
+
+ScreenShotReadback::ScreenShotReadback(const QFutureInterface<QImage> &promise, const QSize &size, qreal devicePixelRatio,
+                                       std::function<void(const QImage &)> callback)
+    : m_promise(promise)
+    , m_callback(std::move(callback))
+    , m_size(size)
+    , m_devicePixelRatio(devicePixelRatio)
+{
+    if (asyncReadbackSupported()) {
+        glGenBuffers(1, &m_buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, m_buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, size.width() * size.height() * 4, nullptr, GL_STREAM_READ);
+        readPixels(size, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        m_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    } else {
+        m_image = QImage(size, readbackFormat());
+        readPixels(size, m_image.bits());
+        convertPixels(m_image.bits(), m_image.bytesPerLine(), m_image.bits(), m_image.bytesPerLine(),
+                      size, readbackConversion(), true);
+    }
+}
+
+ScreenShotReadback::~ScreenShotReadback()
+{
+    if (m_fence) {
+        glDeleteSync(m_fence);
+    }
+    if (m_buffer) {
+        glDeleteBuffers(1, &m_buffer);
+    }
+    if (!m_finished) {
+        m_promise.reportCanceled();
+    }
+}
+
+bool ScreenShotReadback::isReady() const
+{
+    if (!m_fence) {
+        return true;
+    }
+    return glClientWaitSync(m_fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) != GL_TIMEOUT_EXPIRED;
+}
+
+void ScreenShotReadback::finish()
+{
+    m_finished = true;
+
+    if (m_buffer) {
+        m_image = QImage(m_size, readbackFormat());
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, m_buffer);
+        const auto pixels = static_cast<const uchar *>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, m_image.sizeInBytes(), GL_MAP_READ_BIT));
+        if (pixels) {
+            // OpenGL stores the rows bottom to top, flip them while copying.
+            convertPixels(pixels, m_size.width() * 4, m_image.bits(), m_image.bytesPerLine(),
+                          m_size, readbackConversion(), true);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        } else {
+            m_image = QImage();
         }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
 
+    if (m_image.isNull()) {
+        m_promise.reportCanceled();
+        return;
     }
-    img = img.mirrored();
+    m_image.setDevicePixelRatio(m_devicePixelRatio);
+    m_callback(m_image);
+}
+
+static ScreenShotCursor grabCursor(int xOffset, int yOffset)
+{
+    const PlatformCursorImage cursor = effects->cursorImage();
+    return ScreenShotCursor{cursor.image(), effects->cursorPos() - cursor.hotSpot() - QPoint(xOffset, yOffset)};
+}
+
+static void drawCursor(QImage &snapshot, const ScreenShotCursor &cursor)
+{
+    if (cursor.image.isNull() || snapshot.isNull()) {
+        return;
+    }
+
+    QPainter painter(&snapshot);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    painter.drawImage(cursor.position, cursor.image);
+}
+
+static void finishScreenShot(QFutureInterface<QImage> promise, const QImage &snapshot, const ScreenShotCursor &cursor)
+{
+    // The format conversion touches every pixel, keep it off the compositor thread.
+    QtConcurrent::run([promise, snapshot, cursor]() mutable {
+        QImage image;
+        if (snapshot.format() == QImage::Format_ARGB32_Premultiplied) {
+            image = QImage(snapshot.size(), QImage::Format_ARGB32);
+            image.setDevicePixelRatio(snapshot.devicePixelRatio());
+            convertPixels(snapshot.constBits(), snapshot.bytesPerLine(), image.bits(), image.bytesPerLine(),
+                          snapshot.size(), PixelConversion::Unpremultiply);
+        } else {
+            image = snapshot.convertToFormat(QImage::Format_ARGB32);
+        }
+        drawCursor(image, cursor);
+        promise.reportResult(image);
+        promise.reportFinished();
+    });
 }
 
 bool ScreenShotEffect::supported()
@@ -98,10 +246,18 @@ ScreenShotEffect::ScreenShotEffect()
     connect(effects, &EffectsHandler::screenAdded, this, &ScreenShotEffect::handleScreenAdded);
     connect(effects, &EffectsHandler::screenRemoved, this, &ScreenShotEffect::handleScreenRemoved);
     connect(effects, &EffectsHandler::windowClosed, this, &ScreenShotEffect::handleWindowClosed);
+
+    m_readbackTimer.setSingleShot(true);
+    m_readbackTimer.setInterval(2);
+    connect(&m_readbackTimer, &QTimer::timeout, this, [this]() {
+        effects->makeOpenGLContextCurrent();
+        processReadbacks();
+    });
 }
 
 ScreenShotEffect::~ScreenShotEffect()
 {
+    cancelReadbacks();
     cancelWindowScreenShots();
     cancelAreaScreenShots();
     cancelScreenScreenShots();
@@ -233,6 +389,15 @@ void ScreenShotEffect::cancelScreenScreenShots()
     }
 }
 
+void ScreenShotEffect::cancelReadbacks()
+{
+    m_readbackTimer.stop();
+    if (!m_readbacks.empty()) {
+        effects->makeOpenGLContextCurrent();
+        m_readbacks.clear();
+    }
+}
+
 void ScreenShotEffect::paintScreen(int mask, const QRegion &region, ScreenPaintData &data)
 {
     m_paintedScreen = data.screen();
@@ -286,9 +451,13 @@ void ScreenShotEffect::takeScreenShot(ScreenShotWindowSizedData *screenshot)
         d.setXTranslation(-geometry.x());
         d.setYTranslation(-geometry.y());
 
+        ScreenShotCursor cursor;
+        if (screenshot->flags & ScreenShotIncludeCursor) {
+            cursor = grabCursor(geometry.x(), geometry.y());
+        }
+
         // render window into offscreen texture
         int mask = PAINT_WINDOW_TRANSFORMED | PAINT_WINDOW_TRANSLUCENT;
-        QImage img;
         if (effects->isOpenGLCompositing()) {
             GLRenderTarget::pushRenderTarget(target.data());
             glClearColor(0.0, 0.0, 0.0, 0.0);
@@ -302,20 +471,15 @@ void ScreenShotEffect::takeScreenShot(ScreenShotWindowSizedData *screenshot)
             effects->drawWindow(window, mask, infiniteRegion(), d);
 
             // copy content from framebuffer into image
-            img = QImage(offscreenTexture->size(), QImage::Format_ARGB32);
-            img.setDevicePixelRatio(devicePixelRatio);
-            glReadnPixels(0, 0, img.width(), img.height(), GL_RGBA, GL_UNSIGNED_BYTE, img.sizeInBytes(),
-                          static_cast<GLvoid *>(img.bits()));
+            const QFutureInterface<QImage> promise = screenshot->promise;
+            auto callback = [promise, cursor](const QImage &snapshot) {
+                finishScreenShot(promise, snapshot, cursor);
+            };
+            m_readbacks.push_back(std::make_unique<ScreenShotReadback>(promise, offscreenTexture->size(), devicePixelRatio, callback));
             GLRenderTarget::popRenderTarget();
-            convertFromGLImage(img, img.width(), img.height());
-        }
-
-        if (screenshot->flags & ScreenShotIncludeCursor) {
-            grabPointerImage(img, geometry.x(), geometry.y());
+        } else {
+            finishScreenShot(screenshot->promise, QImage(), cursor);
         }
-
-        screenshot->promise.reportResult(img);
-        screenshot->promise.reportFinished();
     } else {
         screenshot->promise.reportCanceled();
     }
@@ -325,43 +489,61 @@ bool ScreenShotEffect::takeScreenShot(ScreenShotAreaData *screenshot)
 {
     if (!m_paintedScreen) {
         // On X11, all screens are painted simultaneously and there is no native HiDPI support.
-        QImage snapshot = blitScreenshot(screenshot->area);
+        ScreenShotCursor cursor;
         if (screenshot->flags & ScreenShotIncludeCursor) {
-            grabPointerImage(snapshot, screenshot->area.x(), screenshot->area.y());
-        }
-        screenshot->promise.reportResult(snapshot);
-        screenshot->promise.reportFinished();
-    } else {
-        if (!screenshot->screens.contains(m_paintedScreen)) {
-            return false;
+            cursor = grabCursor(screenshot->area.x(), screenshot->area.y());
         }
-        screenshot->screens.removeOne(m_paintedScreen);
+        const QFutureInterface<QImage> promise = screenshot->promise;
+        blitScreenshot(promise, screenshot->area, 1.0, [promise, cursor](const QImage &snapshot) {
+            finishScreenShot(promise, snapshot, cursor);
+        });
+        return true;
+    }
 
-        const QRect sourceRect = screenshot->area & m_paintedScreen->geometry();
-        qreal sourceDevicePixelRatio = 1.0;
-        if (screenshot->flags & ScreenShotNativeResolution) {
-            sourceDevicePixelRatio = m_paintedScreen->devicePixelRatio();
-        }
+    if (!screenshot->screens.contains(m_paintedScreen)) {
+        return false;
+    }
+    screenshot->screens.removeOne(m_paintedScreen);
 
-        const QImage snapshot = blitScreenshot(sourceRect, sourceDevicePixelRatio);
-        const QRect nativeArea(screenshot->area.topLeft(),
-                               screenshot->area.size() * screenshot->result.devicePixelRatio());
+    if ((screenshot->flags & ScreenShotIncludeCursor) && !screenshot->cursorGrabbed) {
+        screenshot->cursor = grabCursor(screenshot->area.x(), screenshot->area.y());
+        screenshot->cursorGrabbed = true;
+    }
 
-        QPainter painter(&screenshot->result);
-        painter.setWindow(nativeArea);
-        painter.drawImage(sourceRect, snapshot);
-        painter.end();
+    const QRect sourceRect = screenshot->area & m_paintedScreen->geometry();
+    qreal sourceDevicePixelRatio = 1.0;
+    if (screenshot->flags & ScreenShotNativeResolution) {
+        sourceDevicePixelRatio = m_paintedScreen->devicePixelRatio();
+    }
 
-        if (screenshot->screens.isEmpty()) {
-            if (screenshot->flags & ScreenShotIncludeCursor) {
-                grabPointerImage(screenshot->result, screenshot->area.x(), screenshot->area.y());
+    // The area screenshot stays in m_areaScreenShots until the pixels of all screens arrive.
+    screenshot->pendingReadbacks++;
+    const QFutureInterface<QImage> promise = screenshot->promise;
+    blitScreenshot(promise, sourceRect, sourceDevicePixelRatio, [this, promise, sourceRect](const QImage &snapshot) {
+        for (ScreenShotAreaData &data : m_areaScreenShots) {
+            if (data.promise != promise) {
+                continue;
+            }
+            const QRect nativeArea(data.area.topLeft(), data.area.size() * data.result.devicePixelRatio());
+
+            QPainter painter(&data.result);
+            painter.setWindow(nativeArea);
+            painter.drawImage(sourceRect, snapshot);
+            painter.end();
+
+            data.pendingReadbacks--;
+            if (data.screens.isEmpty() && !data.pendingReadbacks) {
+                if (data.flags & ScreenShotIncludeCursor) {
+                    drawCursor(data.result, data.cursor);
+                }
+                data.promise.reportResult(data.result);
+                data.promise.reportFinished();
             }
-            screenshot->promise.reportResult(screenshot->result);
-            screenshot->promise.reportFinished();
+            break;
         }
-    }
+    });
 
-    return screenshot->promise.isFinished();
+    return false;
 }
 
 bool ScreenShotEffect::takeScreenShot(ScreenShotScreenData *screenshot)
@@ -372,18 +554,19 @@ bool ScreenShotEffect::takeScreenShot(ScreenShotScreenData *screenshot)
             devicePixelRatio = screenshot->screen->devicePixelRatio();
         }
 
-        QImage snapshot = blitScreenshot(screenshot->screen->geometry(), devicePixelRatio);
+        ScreenShotCursor cursor;
         if (screenshot->flags & ScreenShotIncludeCursor) {
-            const int xOffset = screenshot->screen->geometry().x();
-            const int yOffset = screenshot->screen->geometry().y();
-            grabPointerImage(snapshot, xOffset, yOffset);
+            cursor = grabCursor(screenshot->screen->geometry().x(), screenshot->screen->geometry().y());
         }
 
-        screenshot->promise.reportResult(snapshot);
-        screenshot->promise.reportFinished();
+        const QFutureInterface<QImage> promise = screenshot->promise;
+        blitScreenshot(promise, screenshot->screen->geometry(), devicePixelRatio, [promise, cursor](const QImage &snapshot) {
+            finishScreenShot(promise, snapshot, cursor);
+        });
+        return true;
     }
 
-    return screenshot->promise.isFinished();
+    return false;
 }
 
 void ScreenShotEffect::postPaintScreen()
@@ -411,47 +594,56 @@ void ScreenShotEffect::postPaintScreen()
             m_screenScreenShots.removeAt(i);
         }
     }
+
+    // Pick up the pixels of screenshots that have been taken in previous frames.
+    processReadbacks();
 }
 
-QImage ScreenShotEffect::blitScreenshot(const QRect &geometry, qreal devicePixelRatio) const
+void ScreenShotEffect::processReadbacks()
 {
-    QImage image;
-
-    if (effects->isOpenGLCompositing()) {
-        const QSize nativeSize = geometry.size() * devicePixelRatio;
-
-        if (GLRenderTarget::blitSupported() && !GLPlatform::instance()->isGLES()) {
-            image = QImage(nativeSize.width(), nativeSize.height(), QImage::Format_ARGB32);
-            GLTexture texture(GL_RGBA8, nativeSize.width(), nativeSize.height());
-            GLRenderTarget target(texture);
-            target.blitFromFramebuffer(geometry);
-            // copy content from framebuffer into image
-            texture.bind();
-            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE,
-                          static_cast<GLvoid *>(image.bits()));
-            texture.unbind();
+    for (auto it = m_readbacks.begin(); it != m_readbacks.end();) {
+        if ((*it)->isReady()) {
+            std::unique_ptr<ScreenShotReadback> readback = std::move(*it);
+            it = m_readbacks.erase(it);
+            readback->finish();
         } else {
-            image = QImage(nativeSize.width(), nativeSize.height(), QImage::Format_ARGB32);
-            glReadPixels(0, 0, nativeSize.width(), nativeSize.height(), GL_RGBA,
-                         GL_UNSIGNED_BYTE, static_cast<GLvoid *>(image.bits()));
+            ++it;
         }
-        convertFromGLImage(image, nativeSize.width(), nativeSize.height());
     }
 
-    image.setDevicePixelRatio(devicePixelRatio);
-    return image;
+    for (int i = m_areaScreenShots.count() - 1; i >= 0; --i) {
+        const QFutureInterface<QImage> &promise = m_areaScreenShots[i].promise;
+        if (promise.isFinished() || promise.isCanceled()) {
+            m_areaScreenShots.removeAt(i);
+        }
+    }
+
+    if (!m_readbacks.empty()) {
+        m_readbackTimer.start();
+    }
 }
 
-void ScreenShotEffect::grabPointerImage(QImage &snapshot, int xOffset, int yOffset) const
+void ScreenShotEffect::blitScreenshot(const QFutureInterface<QImage> &promise, const QRect &geometry, qreal devicePixelRatio,
+                                      std::function<void(const QImage &)> callback)
 {
-    const PlatformCursorImage cursor = effects->cursorImage();
-    if (cursor.image().isNull()) {
+    if (!effects->isOpenGLCompositing()) {
+        callback(QImage());
         return;
     }
 
-    QPainter painter(&snapshot);
-    painter.setRenderHint(QPainter::SmoothPixmapTransform);
-    painter.drawImage(effects->cursorPos() - cursor.hotSpot() - QPoint(xOffset, yOffset), cursor.image());
+    const QSize nativeSize = geometry.size() * devicePixelRatio;
+
+    if (GLRenderTarget::blitSupported() && !GLPlatform::instance()->isGLES()) {
+        GLTexture texture(GL_RGBA8, nativeSize.width(), nativeSize.height());
+        GLRenderTarget target(texture);
+        target.blitFromFramebuffer(geometry);
+        // copy content from framebuffer into image
+        GLRenderTarget::pushRenderTarget(&target);
+        m_readbacks.push_back(std::make_unique<ScreenShotReadback>(promise, nativeSize, devicePixelRatio, std::move(callback)));
+        GLRenderTarget::popRenderTarget();
+    } else {
+        m_readbacks.push_back(std::make_unique<ScreenShotReadback>(promise, nativeSize, devicePixelRatio, std::move(callback)));
+    }
 }
 
 bool ScreenShotEffect::isActive() const
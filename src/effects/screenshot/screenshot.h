@@ -16,6 +16,11 @@
 #include <QFutureInterface>
 #include <QImage>
 #include <QObject>
+#include <QTimer>
+
+#include <functional>
+#include <memory>
+#include <vector>
 
 namespace KWin
 {
@@ -36,6 +41,7 @@ struct ScreenShotWindowData;
 struct ScreenShotAreaData;
 struct ScreenShotScreenData;
 struct ScreenShotWindowSizedData;
+class ScreenShotReadback;
 
 /**
  * The ScreenShotEffect provides a convenient way to capture the contents of a given window,
@@ -104,8 +110,10 @@ private:
     void cancelAreaScreenShots();
     void cancelScreenScreenShots();
 
-    void grabPointerImage(QImage &snapshot, int xOffset, int yOffset) const;
-    QImage blitScreenshot(const QRect &geometry, qreal devicePixelRatio = 1.0) const;
+    void blitScreenshot(const QFutureInterface<QImage> &promise, const QRect &geometry, qreal devicePixelRatio,
+                        std::function<void(const QImage &)> callback);
+    void processReadbacks();
+    void cancelReadbacks();
 
     QVector<ScreenShotWindowData> m_windowScreenShots;
     QVector<ScreenShotAreaData> m_areaScreenShots;
@@ -114,6 +122,8 @@ private:
 
     QScopedPointer<ScreenShotDBusInterface1> m_dbusInterface1;
     QScopedPointer<ScreenShotDBusInterface2> m_dbusInterface2;
+    std::vector<std::unique_ptr<ScreenShotReadback>> m_readbacks;
+    QTimer m_readbackTimer;
     EffectScreen *m_paintedScreen = nullptr;
 };
 
@@ -15,17 +15,235 @@
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
+#include <QHash>
 #include <QScopeGuard>
 #include <QTextStream>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+#include <chrono>
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include <sys/syscall.h>
+#include <unistd.h>
 
 namespace KWin
 {
 KWIN_SINGLETON_FACTORY(KWin::FTraceLogger)
 
+/*
+ * Binary trace file layout, all integers in host byte order:
+ *
+ *  header:       char magic[8] = "KWINTRC1", quint32 version, quint32 sizeof(FTraceRecord)
+ *  string chunk: quint32 type = 1, quint32 id, quint32 size, followed by size bytes of UTF-8
+ *  record chunk: quint32 type = 2, quint32 thread id, quint32 count, quint32 reserved,
+ *                followed by count FTraceRecord structs
+ */
+static const char s_binaryMagic[8] = {'K', 'W', 'I', 'N', 'T', 'R', 'C', '1'};
+static const quint32 s_binaryVersion = 1;
+static const quint32 s_binaryStringChunk = 1;
+static const quint32 s_binaryRecordChunk = 2;
+static const int s_binaryRecordsPerBuffer = 4096;
+
+static QMutex s_stringsMutex;
+static QHash<QString, quint32> s_strings;
+static std::atomic<quint32> s_stringsGeneration{0};
+
+/**
+ * The FTraceWriter writes the chunks of a binary trace to the file on its own thread, so
+ * that the traced threads never wait for file I/O. The record buffers that have been
+ * written are handed out again to threads whose buffer is full.
+ */
+class FTraceWriter : public QThread
+{
+public:
+    explicit FTraceWriter(QFile *file);
+
+    void enqueueString(quint32 id, const QString &string);
+    /**
+     * Queues the first @p count records for writing and replaces @p records with an empty
+     * buffer of the same size.
+     */
+    void enqueueRecords(quint32 threadId, std::vector<FTraceRecord> &records, int count);
+    /**
+     * Writes all queued chunks and stops the thread.
+     */
+    void finish();
+
+protected:
+    void run() override;
+
+private:
+    struct Chunk
+    {
+        quint32 type;
+        quint32 id;
+        QByteArray string;
+        std::vector<FTraceRecord> records;
+        int count = 0;
+    };
+
+    QFile *m_file;
+    QMutex m_mutex;
+    QWaitCondition m_condition;
+    std::deque<Chunk> m_queue;
+    std::vector<std::vector<FTraceRecord>> m_spareRecords;
+    bool m_finishing = false;
+};
+
+FTraceWriter::FTraceWriter(QFile *file)
+    : m_file(file)
+{
+    setObjectName(QStringLiteral("FTraceWriter"));
+}
+
+void FTraceWriter::enqueueString(quint32 id, const QString &string)
+{
+    Chunk chunk{s_binaryStringChunk, id, string.toUtf8()};
+    QMutexLocker lock(&m_mutex);
+    m_queue.push_back(std::move(chunk));
+    m_condition.wakeOne();
+}
+
+void FTraceWriter::enqueueRecords(quint32 threadId, std::vector<FTraceRecord> &records, int count)
+{
+    std::vector<FTraceRecord> spare;
+    {
+        QMutexLocker lock(&m_mutex);
+        m_queue.push_back(Chunk{s_binaryRecordChunk, threadId, QByteArray(), std::move(records), count});
+        if (!m_spareRecords.empty()) {
+            spare = std::move(m_spareRecords.back());
+            m_spareRecords.pop_back();
+        }
+        m_condition.wakeOne();
+    }
+    if (spare.empty()) {
+        // the writer is behind, keep tracing into a new buffer rather than waiting
+        spare.resize(s_binaryRecordsPerBuffer);
+    }
+    records = std::move(spare);
+}
+
+void FTraceWriter::finish()
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        m_finishing = true;
+        m_condition.wakeOne();
+    }
+    wait();
+}
+
+void FTraceWriter::run()
+{
+    std::deque<Chunk> chunks;
+    QMutexLocker lock(&m_mutex);
+    while (true) {
+        while (m_queue.empty() && !m_finishing) {
+            m_condition.wait(&m_mutex);
+        }
+        if (m_queue.empty()) {
+            break;
+        }
+        chunks.swap(m_queue);
+        lock.unlock();
+
+        for (Chunk &chunk : chunks) {
+            if (chunk.type == s_binaryStringChunk) {
+                const quint32 header[] = {s_binaryStringChunk, chunk.id, quint32(chunk.string.size())};
+                m_file->write(reinterpret_cast<const char *>(header), sizeof(header));
+                m_file->write(chunk.string);
+            } else {
+                const quint32 header[] = {s_binaryRecordChunk, chunk.id, quint32(chunk.count), 0};
+                m_file->write(reinterpret_cast<const char *>(header), sizeof(header));
+                m_file->write(reinterpret_cast<const char *>(chunk.records.data()), chunk.count * sizeof(FTraceRecord));
+            }
+        }
+
+        lock.relock();
+        for (Chunk &chunk : chunks) {
+            if (!chunk.records.empty()) {
+                m_spareRecords.push_back(std::move(chunk.records));
+            }
+        }
+        chunks.clear();
+    }
+    lock.unlock();
+    m_file->flush();
+}
+
+/**
+ * The preallocated buffer of binary records of a single thread. Only the owning thread
+ * appends records, other threads only flush the buffer after the tracing has been stopped
+ * and the owner has left appendRecord().
+ */
+class FTraceThreadBuffer
+{
+public:
+    FTraceThreadBuffer();
+    ~FTraceThreadBuffer();
+
+    static FTraceThreadBuffer &current();
+    static QMutex s_buffersMutex;
+    static QVector<FTraceThreadBuffer *> s_buffers;
+
+    void flush();
+
+    std::vector<FTraceRecord> records;
+    int count = 0;
+    quint32 threadId;
+    std::atomic<bool> writing{false};
+};
+
+QMutex FTraceThreadBuffer::s_buffersMutex;
+QVector<FTraceThreadBuffer *> FTraceThreadBuffer::s_buffers;
+
+FTraceThreadBuffer::FTraceThreadBuffer()
+    : records(s_binaryRecordsPerBuffer)
+    , threadId(quint32(syscall(SYS_gettid)))
+{
+    QMutexLocker lock(&s_buffersMutex);
+    s_buffers.append(this);
+}
+
+FTraceThreadBuffer::~FTraceThreadBuffer()
+{
+    QMutexLocker lock(&s_buffersMutex);
+    s_buffers.removeOne(this);
+    flush();
+}
+
+FTraceThreadBuffer &FTraceThreadBuffer::current()
+{
+    static thread_local FTraceThreadBuffer buffer;
+    return buffer;
+}
+
+void FTraceThreadBuffer::flush()
+{
+    if (!count) {
+        return;
+    }
+    FTraceLogger *logger = FTraceLogger::self();
+    if (logger) {
+        QMutexLocker lock(&logger->m_mutex);
+        if (logger->m_writer) {
+            logger->m_writer->enqueueRecords(threadId, records, count);
+        }
+    }
+    count = 0;
+}
+
 FTraceLogger::FTraceLogger(QObject *parent)
     : QObject(parent)
 {
-    if (qEnvironmentVariableIsSet("KWIN_PERF_FTRACE")) {
+    if (qEnvironmentVariableIsSet("KWIN_PERF_FTRACE_BINARY_FILE")) {
+        setEnabled(true);
+        QDBusConnection::sessionBus().registerObject(QStringLiteral("/FTrace"), this, QDBusConnection::ExportScriptableContents);
+    } else if (qEnvironmentVariableIsSet("KWIN_PERF_FTRACE")) {
         setEnabled(true);
     } else {
         QDBusConnection::sessionBus().registerObject(QStringLiteral("/FTrace"), this, QDBusConnection::ExportScriptableContents);
@@ -37,21 +255,170 @@ bool FTraceLogger::isEnabled() const
     return m_file.isOpen();
 }
 
+FTraceLogger::Mode FTraceLogger::mode() const
+{
+    return m_binary.load(std::memory_order_relaxed) ? Mode::Binary : Mode::Text;
+}
+
 void FTraceLogger::setEnabled(bool enabled)
 {
-    QMutexLocker lock(&m_mutex);
     if (enabled == isEnabled()) {
         return;
     }
 
     if (enabled) {
-        open();
+        if (qEnvironmentVariableIsSet("KWIN_PERF_FTRACE_BINARY_FILE")) {
+            openBinary(qEnvironmentVariable("KWIN_PERF_FTRACE_BINARY_FILE"));
+        } else {
+            QMutexLocker lock(&m_mutex);
+            open();
+        }
+    } else if (mode() == Mode::Binary) {
+        closeBinary();
     } else {
+        QMutexLocker lock(&m_mutex);
         m_file.close();
     }
     Q_EMIT enabledChanged();
 }
 
+void FTraceLogger::startBinaryTrace(const QString &fileName)
+{
+    if (isEnabled()) {
+        setEnabled(false);
+    }
+    if (openBinary(fileName)) {
+        Q_EMIT enabledChanged();
+    }
+}
+
+bool FTraceLogger::openBinary(const QString &fileName)
+{
+    {
+        QMutexLocker lock(&s_stringsMutex);
+        s_strings.clear();
+        s_stringsGeneration++;
+    }
+
+    QMutexLocker lock(&m_mutex);
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Can not open binary trace file at:" << fileName;
+        return false;
+    }
+    const quint32 header[] = {s_binaryVersion, quint32(sizeof(FTraceRecord))};
+    m_file.write(s_binaryMagic, sizeof(s_binaryMagic));
+    m_file.write(reinterpret_cast<const char *>(header), sizeof(header));
+    m_writer = new FTraceWriter(&m_file);
+    m_writer->start();
+    m_binary.store(true);
+    return true;
+}
+
+void FTraceLogger::closeBinary()
+{
+    // Together with the writing flag set in appendRecord() this guarantees that either
+    // the owner of a buffer sees that tracing has stopped or we wait until it's done.
+    m_binary.store(false);
+    {
+        QMutexLocker lock(&FTraceThreadBuffer::s_buffersMutex);
+        for (FTraceThreadBuffer *buffer : qAsConst(FTraceThreadBuffer::s_buffers)) {
+            while (buffer->writing.load()) {
+                QThread::yieldCurrentThread();
+            }
+            buffer->flush();
+        }
+    }
+
+    FTraceWriter *writer;
+    {
+        QMutexLocker lock(&m_mutex);
+        writer = std::exchange(m_writer, nullptr);
+    }
+    if (writer) {
+        writer->finish();
+        delete writer;
+    }
+
+    QMutexLocker lock(&m_mutex);
+    m_file.close();
+}
+
+void FTraceLogger::appendRecord(FTraceRecord &record)
+{
+    FTraceThreadBuffer &buffer = FTraceThreadBuffer::current();
+    buffer.writing.store(true);
+    if (m_binary.load()) {
+        record.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        buffer.records[buffer.count++] = record;
+        if (buffer.count == s_binaryRecordsPerBuffer) {
+            buffer.flush();
+        }
+    }
+    buffer.writing.store(false);
+}
+
+quint32 FTraceLogger::internString(const QString &string)
+{
+    thread_local QHash<QString, quint32> cache;
+    thread_local quint32 cacheGeneration = 0;
+
+    const quint32 generation = s_stringsGeneration.load();
+    if (cacheGeneration != generation) {
+        cache.clear();
+        cacheGeneration = generation;
+    }
+
+    auto it = cache.constFind(string);
+    if (it != cache.constEnd()) {
+        return *it;
+    }
+
+    quint32 id;
+    {
+        QMutexLocker lock(&s_stringsMutex);
+        auto globalIt = s_strings.constFind(string);
+        if (globalIt != s_strings.constEnd()) {
+            id = *globalIt;
+        } else {
+            id = s_strings.count() + 1;
+            s_strings.insert(string, id);
+            self()->writeString(id, string);
+        }
+    }
+    cache.insert(string, id);
+    return id;
+}
+
+quint32 FTraceLogger::internLiteral(const char *literal)
+{
+    // string literals have a stable address, so the lookup doesn't need to touch the characters
+    thread_local QHash<const char *, quint32> cache;
+    thread_local quint32 cacheGeneration = 0;
+
+    const quint32 generation = s_stringsGeneration.load();
+    if (cacheGeneration != generation) {
+        cache.clear();
+        cacheGeneration = generation;
+    }
+
+    auto it = cache.constFind(literal);
+    if (it != cache.constEnd()) {
+        return *it;
+    }
+    const quint32 id = internString(QString::fromUtf8(literal));
+    cache.insert(literal, id);
+    return id;
+}
+
+void FTraceLogger::writeString(quint32 id, const QString &string)
+{
+    QMutexLocker lock(&m_mutex);
+    if (m_writer) {
+        m_writer->enqueueString(id, string);
+    }
+}
+
 bool FTraceLogger::open()
 {
     const QString path = filePath();
@@ -115,6 +482,10 @@ QString FTraceLogger::filePath()
 
 FTraceDuration::~FTraceDuration()
 {
+    if (m_binary) {
+        FTraceLogger::self()->traceBinary(FTraceRecord::End, m_context);
+        return;
+    }
     FTraceLogger::self()->trace(m_message, " end_ctx=", m_context);
 }
 
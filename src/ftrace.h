@@ -17,8 +17,42 @@
 #include <QObject>
 #include <QTextStream>
 
+#include <atomic>
+#include <type_traits>
+
 namespace KWin
 {
+
+class FTraceWriter;
+
+/**
+ * A fixed-size event record as written by the binary trace mode.
+ *
+ * String arguments are interned, the record only stores the id of the string. The id to
+ * string mapping is written to the trace file the first time a string is seen.
+ */
+struct FTraceRecord
+{
+    enum Type : quint8 {
+        Instant,
+        Begin,
+        End,
+    };
+    enum ArgumentKind : quint8 {
+        String,
+        Integer,
+    };
+    static constexpr int MaxArguments = 4;
+
+    quint64 timestamp = 0; ///< monotonic clock, in nanoseconds
+    quint32 context = 0; ///< pairs Begin and End records, 0 for Instant records
+    quint8 type = Instant;
+    quint8 argumentCount = 0;
+    quint8 argumentKinds[MaxArguments] = {};
+    qint64 arguments[MaxArguments] = {};
+};
+static_assert(sizeof(FTraceRecord) == 56, "FTraceRecord is part of the binary trace file format");
+
 /**
  * FTraceLogger is a singleton utility for writing log messages using ftrace
  *
@@ -26,6 +60,13 @@ namespace KWin
  *  Set the KWIN_PERF_FTRACE environment variable before starting the application
  *  Calling on DBus /FTrace org.kde.kwin.FTrace.setEnabled true
  * After having created the ftrace mount
+ *
+ * Alternatively, a binary trace can be recorded with either:
+ *  Set the KWIN_PERF_FTRACE_BINARY_FILE environment variable to the output file
+ *  Calling on DBus /FTrace org.kde.kwin.FTrace.startBinaryTrace <file>
+ * Binary traces don't format any strings on the traced thread, events are appended to
+ * preallocated per-thread buffers that are written to the file by a separate thread. Use
+ * deepin-kwin_trace_convert to turn the file into Chrome/Perfetto trace JSON.
  */
 class KWIN_EXPORT FTraceLogger : public QObject
 {
@@ -34,18 +75,33 @@ class KWIN_EXPORT FTraceLogger : public QObject
     Q_PROPERTY(bool isEnabled READ isEnabled NOTIFY enabledChanged)
 
 public:
+    enum class Mode {
+        Text,
+        Binary,
+    };
+
     /**
      * Enabled through DBus and logging has started
      */
     bool isEnabled() const;
 
+    /**
+     * Returns whether messages are written as text into the ftrace marker file or as
+     * binary records into a trace file.
+     */
+    Mode mode() const;
+
     /**
      * Main log function
      * Takes any number of arguments that can be written into QTextStream
      */
-    template<typename... Args> void trace(Args... args)
+    template<typename... Args> void trace(const Args &...args)
     {
         Q_ASSERT(isEnabled());
+        if (mode() == Mode::Binary) {
+            traceBinary(FTraceRecord::Instant, 0, args...);
+            return;
+        }
         QMutexLocker lock(&m_mutex);
         if (!m_file.isOpen()) {
             return;
@@ -54,26 +110,98 @@ public:
         (stream << ... << args) << Qt::endl;
     }
 
+    /**
+     * Appends a binary record of the given @a type to the buffer of the calling thread.
+     * Arguments beyond FTraceRecord::MaxArguments are dropped.
+     */
+    template<typename... Args> void traceBinary(FTraceRecord::Type type, quint32 context, const Args &...args)
+    {
+        FTraceRecord record;
+        record.type = type;
+        record.context = context;
+        (encodeArgument(record, args), ...);
+        appendRecord(record);
+    }
+
 Q_SIGNALS:
     void enabledChanged();
 
 public Q_SLOTS:
     Q_SCRIPTABLE void setEnabled(bool enabled);
+    Q_SCRIPTABLE void startBinaryTrace(const QString &fileName);
 
 private:
     static QString filePath();
     bool open();
+    bool openBinary(const QString &fileName);
+    void closeBinary();
+
+    static quint32 internLiteral(const char *literal);
+    static quint32 internString(const QString &string);
+    void writeString(quint32 id, const QString &string);
+    void appendRecord(FTraceRecord &record);
+
+    static void appendArgument(FTraceRecord &record, FTraceRecord::ArgumentKind kind, qint64 value)
+    {
+        if (record.argumentCount < FTraceRecord::MaxArguments) {
+            record.argumentKinds[record.argumentCount] = kind;
+            record.arguments[record.argumentCount] = value;
+            record.argumentCount++;
+        }
+    }
+    /**
+     * Only string literals are interned by address, any other character pointer may point to
+     * a temporary buffer whose address is reused for another string.
+     */
+    template<size_t N> static void encodeArgument(FTraceRecord &record, const char (&literal)[N])
+    {
+        appendArgument(record, FTraceRecord::String, internLiteral(literal));
+    }
+    static void encodeArgument(FTraceRecord &record, const QString &string)
+    {
+        appendArgument(record, FTraceRecord::String, internString(string));
+    }
+    static void encodeArgument(FTraceRecord &record, const QByteArray &string)
+    {
+        appendArgument(record, FTraceRecord::String, internString(QString::fromUtf8(string)));
+    }
+    template<typename T> static void encodeArgument(FTraceRecord &record, const T &value)
+    {
+        if constexpr (std::is_integral_v<T> || std::is_enum_v<T>) {
+            appendArgument(record, FTraceRecord::Integer, qint64(value));
+        } else if constexpr (std::is_same_v<T, const char *> || std::is_same_v<T, char *>) {
+            appendArgument(record, FTraceRecord::String, internString(QString::fromUtf8(value)));
+        } else {
+            // slow path for everything else that can be written into QTextStream
+            QString text;
+            QTextStream stream(&text);
+            stream << value;
+            stream.flush();
+            appendArgument(record, FTraceRecord::String, internString(text));
+        }
+    }
+
     QFile m_file;
     QMutex m_mutex;
+    std::atomic<bool> m_binary{false};
+    // writes the binary trace file, guarded by m_mutex
+    FTraceWriter *m_writer = nullptr;
+    friend class FTraceThreadBuffer;
     KWIN_SINGLETON(FTraceLogger)
 };
 
 class KWIN_EXPORT FTraceDuration
 {
 public:
-    template<typename... Args> FTraceDuration(Args... args)
+    template<typename... Args> FTraceDuration(const Args &...args)
     {
         static QAtomicInteger<quint32> s_context = 0;
+        if (FTraceLogger::self()->mode() == FTraceLogger::Mode::Binary) {
+            m_binary = true;
+            m_context = ++s_context;
+            FTraceLogger::self()->traceBinary(FTraceRecord::Begin, m_context, args...);
+            return;
+        }
         QTextStream stream(&m_message);
         (stream << ... << args);
         stream.flush();
@@ -86,6 +214,7 @@ public:
 private:
     QByteArray m_message;
     quint32 m_context;
+    bool m_binary = false;
 };
 
 } // namespace KWin
@@ -0,0 +1,184 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+/*
+ * Converts a binary trace written by FTraceLogger into the Chrome trace event JSON format,
+ * which can be loaded into Perfetto (ui.perfetto.dev) or chrome://tracing.
+ */
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFile>
+#include <QHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+
+#include <cstring>
+
+namespace
+{
+
+// Mirrors KWin::FTraceRecord from src/ftrace.h
+struct Record
+{
+    quint64 timestamp;
+    quint32 context;
+    quint8 type;
+    quint8 argumentCount;
+    quint8 argumentKinds[4];
+    qint64 arguments[4];
+};
+static_assert(sizeof(Record) == 56, "Record must match KWin::FTraceRecord");
+
+enum RecordType : quint8 {
+    Instant,
+    Begin,
+    End,
+};
+
+enum ArgumentKind : quint8 {
+    String,
+    Integer,
+};
+
+const char s_magic[8] = {'K', 'W', 'I', 'N', 'T', 'R', 'C', '1'};
+const quint32 s_stringChunk = 1;
+const quint32 s_recordChunk = 2;
+
+template<typename T>
+bool readValue(QFile &file, T *value)
+{
+    return file.read(reinterpret_cast<char *>(value), sizeof(T)) == sizeof(T);
+}
+
+QString recordName(const Record &record, const QHash<quint32, QString> &strings)
+{
+    QString name;
+    for (int i = 0; i < record.argumentCount && i < 4; ++i) {
+        if (record.argumentKinds[i] == String) {
+            name += strings.value(quint32(record.arguments[i]), QStringLiteral("<unknown>"));
+        } else {
+            name += QString::number(record.arguments[i]);
+        }
+    }
+    return name;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("deepin-kwin_trace_convert"));
+    QCoreApplication::setApplicationVersion(QStringLiteral("1.0"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Converts a KWin binary trace into Chrome trace event JSON"));
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument(QStringLiteral("input"), QStringLiteral("Binary trace file"));
+    parser.addPositionalArgument(QStringLiteral("output"), QStringLiteral("JSON file, standard output if omitted"));
+    parser.process(app);
+
+    const QStringList positional = parser.positionalArguments();
+    if (positional.isEmpty()) {
+        parser.showHelp(1);
+    }
+
+    QFile input(positional.at(0));
+    if (!input.open(QIODevice::ReadOnly)) {
+        qWarning("Can not open %s", qPrintable(input.fileName()));
+        return 1;
+    }
+
+    char magic[sizeof(s_magic)];
+    quint32 version = 0;
+    quint32 recordSize = 0;
+    if (input.read(magic, sizeof(magic)) != sizeof(magic) || std::memcmp(magic, s_magic, sizeof(magic)) != 0
+        || !readValue(input, &version) || !readValue(input, &recordSize)) {
+        qWarning("%s is not a KWin binary trace", qPrintable(input.fileName()));
+        return 1;
+    }
+    if (version != 1 || recordSize != sizeof(Record)) {
+        qWarning("Unsupported trace version %u (record size %u)", version, recordSize);
+        return 1;
+    }
+
+    QFile output;
+    if (positional.count() > 1) {
+        output.setFileName(positional.at(1));
+        if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qWarning("Can not open %s", qPrintable(output.fileName()));
+            return 1;
+        }
+    } else if (!output.open(stdout, QIODevice::WriteOnly)) {
+        return 1;
+    }
+
+    const qint64 pid = 1;
+    QHash<quint32, QString> strings;
+    QTextStream stream(&output);
+    stream << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+
+    quint32 chunkType;
+    while (readValue(input, &chunkType)) {
+        if (chunkType == s_stringChunk) {
+            quint32 id;
+            quint32 size;
+            if (!readValue(input, &id) || !readValue(input, &size)) {
+                break;
+            }
+            strings.insert(id, QString::fromUtf8(input.read(size)));
+        } else if (chunkType == s_recordChunk) {
+            quint32 header[3];
+            if (!readValue(input, &header)) {
+                break;
+            }
+            const quint32 threadId = header[0];
+            const quint32 count = header[1];
+            for (quint32 i = 0; i < count; ++i) {
+                Record record;
+                if (!readValue(input, &record)) {
+                    break;
+                }
+                QJsonObject event;
+                event.insert(QStringLiteral("pid"), pid);
+                event.insert(QStringLiteral("tid"), qint64(threadId));
+                event.insert(QStringLiteral("ts"), record.timestamp / 1000.0);
+                switch (record.type) {
+                case Begin:
+                    event.insert(QStringLiteral("ph"), QStringLiteral("B"));
+                    event.insert(QStringLiteral("name"), recordName(record, strings));
+                    event.insert(QStringLiteral("args"), QJsonObject{{QStringLiteral("ctx"), qint64(record.context)}});
+                    break;
+                case End:
+                    event.insert(QStringLiteral("ph"), QStringLiteral("E"));
+                    event.insert(QStringLiteral("args"), QJsonObject{{QStringLiteral("ctx"), qint64(record.context)}});
+                    break;
+                default:
+                    event.insert(QStringLiteral("ph"), QStringLiteral("i"));
+                    event.insert(QStringLiteral("s"), QStringLiteral("t"));
+                    event.insert(QStringLiteral("name"), recordName(record, strings));
+                    break;
+                }
+                if (!first) {
+                    stream << ',';
+                }
+                first = false;
+                stream << '\n' << QJsonDocument(event).toJson(QJsonDocument::Compact);
+            }
+        } else {
+            qWarning("Unknown chunk type %u, the trace is truncated or corrupted", chunkType);
+            break;
+        }
+    }
+
+    stream << "\n]}\n";
+    return 0;
+}
@@ -0,0 +1,120 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "hittestindex.h"
+#include "screens.h"
+#include "toplevel.h"
+#include "unmanaged.h"
+#include "workspace.h"
+
+namespace KWin
+{
+
+HitTestIndex::HitTestIndex(Workspace *workspace)
+    : QObject(workspace)
+    , m_workspace(workspace)
+{
+    connect(workspace, &Workspace::stackingOrderChanged, this, &HitTestIndex::invalidate);
+    connect(workspace, &Workspace::unmanagedAdded, this, &HitTestIndex::invalidate);
+    connect(workspace, &Workspace::unmanagedRemoved, this, &HitTestIndex::invalidate);
+    connect(screens(), &Screens::changed, this, &HitTestIndex::invalidate);
+}
+
+void HitTestIndex::invalidate()
+{
+    m_dirty = true;
+}
+
+/**
+ * Returns the bounds of all points @p toplevel can accept input at: the input geometry covers
+ * the decoration borders, the visible geometry covers sub-surfaces outside of the buffer.
+ */
+QRect HitTestIndex::bounds(Toplevel *toplevel)
+{
+    return toplevel->frameGeometry() | toplevel->bufferGeometry() | toplevel->inputGeometry()
+        | toplevel->visibleGeometry();
+}
+
+void HitTestIndex::watch(Toplevel *toplevel)
+{
+    if (m_watched.contains(toplevel)) {
+        return;
+    }
+    m_watched.insert(toplevel);
+
+    auto geometryChanged = [this, toplevel]() {
+        HitTestIndex::updateBounds(toplevel);
+    };
+    connect(toplevel, &Toplevel::frameGeometryChanged, this, geometryChanged);
+    connect(toplevel, &Toplevel::bufferGeometryChanged, this, geometryChanged);
+    connect(toplevel, &Toplevel::visibleGeometryChanged, this, geometryChanged);
+    // don't keep a dangling pointer until the next stacking order change
+    connect(toplevel, &QObject::destroyed, this, [this, toplevel]() {
+        m_watched.remove(toplevel);
+        invalidate();
+    });
+}
+
+void HitTestIndex::updateBounds(Toplevel *toplevel)
+{
+    if (m_dirty) {
+        return;
+    }
+    const QRect rect = bounds(toplevel);
+    auto it = m_stackingIndices.constFind(toplevel);
+    if (it != m_stackingIndices.constEnd() && !m_stackingGrid.move(*it, rect)) {
+        invalidate();
+        return;
+    }
+    it = m_unmanagedIndices.constFind(toplevel);
+    if (it != m_unmanagedIndices.constEnd() && !m_unmanagedGrid.move(*it, rect)) {
+        invalidate();
+    }
+}
+
+void HitTestIndex::update()
+{
+    if (!m_dirty) {
+        return;
+    }
+    m_dirty = false;
+
+    QVector<QRect> outputs;
+    outputs.reserve(screens()->count());
+    for (int i = 0; i < screens()->count(); ++i) {
+        outputs.append(screens()->geometry(i));
+    }
+
+    const QList<Toplevel *> &stacking = m_workspace->stackingOrder();
+    QVector<QRect> bounds;
+    bounds.reserve(stacking.count());
+    m_stacking.clear();
+    m_stacking.reserve(stacking.count());
+    m_stackingIndices.clear();
+    for (auto it = stacking.crbegin(); it != stacking.crend(); ++it) {
+        watch(*it);
+        m_stackingIndices.insert(*it, m_stacking.count());
+        m_stacking.append(*it);
+        bounds.append(HitTestIndex::bounds(*it));
+    }
+    m_stackingGrid.build(outputs, bounds);
+
+    const QList<Unmanaged *> &unmanaged = m_workspace->unmanagedList();
+    bounds.clear();
+    m_unmanaged.clear();
+    m_unmanaged.reserve(unmanaged.count());
+    m_unmanagedIndices.clear();
+    for (Unmanaged *toplevel : unmanaged) {
+        watch(toplevel);
+        m_unmanagedIndices.insert(toplevel, m_unmanaged.count());
+        m_unmanaged.append(toplevel);
+        bounds.append(HitTestIndex::bounds(toplevel));
+    }
+    m_unmanagedGrid.build(outputs, bounds);
+}
+
+} // namespace KWin
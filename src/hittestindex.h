@@ -0,0 +1,85 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include "utils/hittestgrid.h"
+
+#include <QHash>
+#include <QObject>
+#include <QSet>
+
+namespace KWin
+{
+
+class Toplevel;
+class Workspace;
+
+/**
+ * The HitTestIndex keeps HitTestGrids for the stacking order and for the unmanaged windows
+ * of the workspace, so that finding the window under the pointer only tests the windows
+ * near it.
+ *
+ * The grids only depend on the outputs and the geometries of the windows. They are rebuilt
+ * lazily after the outputs or the windows changed, while a geometry change only updates the
+ * bounds of that window. Everything else that decides whether a window gets input, e.g. its
+ * desktop or whether it is minimized, is checked by the caller.
+ */
+class HitTestIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit HitTestIndex(Workspace *workspace);
+
+    /**
+     * Returns the top-most window in the stacking order whose bounds contain @p pos and
+     * which is accepted by @p accept.
+     */
+    template<typename Predicate>
+    Toplevel *findStacked(const QPoint &pos, Predicate accept)
+    {
+        update();
+        const int index = m_stackingGrid.find(pos, [this, &accept](int index) {
+            return accept(m_stacking[index]);
+        });
+        return index == -1 ? nullptr : m_stacking[index];
+    }
+
+    /**
+     * Returns the first unmanaged window whose bounds contain @p pos and which is accepted
+     * by @p accept.
+     */
+    template<typename Predicate>
+    Toplevel *findUnmanaged(const QPoint &pos, Predicate accept)
+    {
+        update();
+        const int index = m_unmanagedGrid.find(pos, [this, &accept](int index) {
+            return accept(m_unmanaged[index]);
+        });
+        return index == -1 ? nullptr : m_unmanaged[index];
+    }
+
+private:
+    void update();
+    void invalidate();
+    void watch(Toplevel *toplevel);
+    void updateBounds(Toplevel *toplevel);
+    static QRect bounds(Toplevel *toplevel);
+
+    Workspace *m_workspace;
+    HitTestGrid m_stackingGrid;
+    HitTestGrid m_unmanagedGrid;
+    QVector<Toplevel *> m_stacking;
+    QVector<Toplevel *> m_unmanaged;
+    QHash<Toplevel *, int> m_stackingIndices;
+    QHash<Toplevel *, int> m_unmanagedIndices;
+    QSet<Toplevel *> m_watched;
+    bool m_dirty = true;
+};
+
+} // namespace KWin
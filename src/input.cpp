@@ -12,9 +12,11 @@
 #include "backends/fakeinput/fakeinputbackend.h"
 #include "backends/libinput/connection.h"
 #include "backends/libinput/device.h"
+#include "cursorfastpath.h"
 #include "effects.h"
 #include "gestures.h"
 #include "globalshortcuts.h"
+#include "hittestindex.h"
 #include "input_event.h"
 #include "input_event_spy.h"
 #include "inputbackend.h"
@@ -2517,6 +2519,13 @@ void InputRedirection::setupWorkspace()
         m_touch->init();
         m_tablet->init();
 
+        if (CursorFastPath *fastPath = CursorFastPath::self()) {
+            fastPath->setPosition(m_pointer->pos());
+            connect(this, &InputRedirection::globalPointerChanged, this, [fastPath](const QPointF &pos) {
+                fastPath->setPosition(pos);
+            });
+        }
+
         updateLeds(m_keyboard->xkb()->leds());
         connect(m_keyboard, &KeyboardInputRedirection::ledsChanged, this, &InputRedirection::updateLeds);
 
@@ -2981,6 +2990,14 @@ Qt::MouseButtons InputRedirection::qtButtonStates() const
     return m_pointer->buttons();
 }
 
+HitTestIndex *InputRedirection::hitTestIndex()
+{
+    if (!m_hitTestIndex) {
+        m_hitTestIndex = new HitTestIndex(Workspace::self());
+    }
+    return m_hitTestIndex;
+}
+
 Toplevel *InputRedirection::findToplevel(const QPoint &pos)
 {
     if (!Workspace::self()) {
@@ -2993,11 +3010,11 @@ Toplevel *InputRedirection::findToplevel(const QPoint &pos)
         if (effects && static_cast<EffectsHandlerImpl*>(effects)->isMouseInterception()) {
             return nullptr;
         }
-        const QList<Unmanaged *> &unmanaged = Workspace::self()->unmanagedList();
-        for (Unmanaged *u : unmanaged) {
-            if (u->hitTest(pos)) {
-                return u;
-            }
+        Toplevel *u = hitTestIndex()->findUnmanaged(pos, [&pos](Toplevel *u) {
+            return u->hitTest(pos);
+        });
+        if (u) {
+            return u;
         }
     }
     return findManagedToplevel(pos);
@@ -3009,36 +3026,26 @@ Toplevel *InputRedirection::findManagedToplevel(const QPoint &pos)
         return nullptr;
     }
     const bool isScreenLocked = waylandServer() && waylandServer()->isScreenLocked();
-    const QList<Toplevel *> &stacking = Workspace::self()->stackingOrder();
-    if (stacking.isEmpty()) {
-        return nullptr;
-    }
-    auto it = stacking.end();
-    do {
-        --it;
-        Toplevel *t = (*it);
+    return hitTestIndex()->findStacked(pos, [&pos, isScreenLocked](Toplevel *t) {
         if (t->isDeleted()) {
             // a deleted window doesn't get mouse events
-            continue;
+            return false;
         }
         if (AbstractClient *c = dynamic_cast<AbstractClient*>(t)) {
             if (!c->isOnCurrentActivity() || !c->isOnCurrentDesktop() || c->isMinimized() || c->isHiddenInternal()) {
-                continue;
+                return false;
             }
         }
         if (!t->readyForPainting()) {
-            continue;
+            return false;
         }
         if (isScreenLocked) {
             if (!t->isLockScreen() && !t->isInputMethod()) {
-                continue;
+                return false;
             }
         }
-        if (t->hitTest(pos)) {
-            return t;
-        }
-    } while (it != stacking.begin());
-    return nullptr;
+        return t->hitTest(pos);
+    });
 }
 
 bool InputRedirection::isShortcuts(QKeyEvent *event)
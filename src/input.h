@@ -50,6 +50,7 @@ namespace Decoration
 class DecoratedClientImpl;
 }
 
+class HitTestIndex;
 class InputBackend;
 class InputDevice;
 
@@ -306,6 +307,7 @@ private:
     void updateLeds(LEDs leds);
     void updateAvailableInputDevices();
     void addInputBackend(InputBackend *inputBackend);
+    HitTestIndex *hitTestIndex();
     KeyboardInputRedirection *m_keyboard;
     PointerInputRedirection *m_pointer;
     TabletInputRedirection *m_tablet;
@@ -318,6 +320,7 @@ private:
     QList<InputDevice *> m_inputDevices;
 
     WindowSelectorFilter *m_windowSelector = nullptr;
+    QPointer<HitTestIndex> m_hitTestIndex;
 
     QVector<InputEventFilter*> m_filters;
     QVector<InputEventSpy*> m_spies;
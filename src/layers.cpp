@@ -632,6 +632,14 @@ QList<Toplevel *> Workspace::xStackingOrder() const
     return x_stacking;
 }
 
+uint Workspace::xStackingOrderSerial() const
+{
+    if (m_xStackingDirty) {
+        const_cast<Workspace*>(this)->updateXStackingOrder();
+    }
+    return m_xStackingSerial;
+}
+
 void Workspace::updateXStackingOrder()
 {
     // use our own stacking order, not the X one, as they may differ
@@ -660,6 +668,7 @@ void Workspace::updateXStackingOrder()
     }
 
     m_xStackingDirty = false;
+    m_xStackingSerial++;
 }
 
 //*******************************
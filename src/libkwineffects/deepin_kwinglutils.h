@@ -17,6 +17,7 @@
 #include "deepin_kwingltexture.h"
 
 // Qt
+#include <QScopedPointer>
 #include <QSize>
 #include <QStack>
 
@@ -36,6 +37,7 @@ namespace KWin
 
 class GLVertexBuffer;
 class GLVertexBufferPrivate;
+class ShaderProgramCache;
 
 // Initializes OpenGL stuff. This includes resolving function pointers as
 //  well as checking for GL version and extensions
@@ -282,6 +284,27 @@ public:
      */
     GLShader *generateShaderFromFile(ShaderTraits traits, const QString &vertexFile = QString(), const QString &fragmentFile = QString());
 
+    /**
+     * Linked shader programs are cached on disk, keyed by the OpenGL driver and the shader
+     * sources, so that creating a shader again does not compile it. The cache is used if
+     * the driver supports program binaries and can be disabled by setting the environment
+     * variable KWIN_GL_NO_PROGRAM_CACHE.
+     *
+     * @return @c true if shader programs are cached
+     */
+    bool isProgramCacheEnabled() const;
+
+    /**
+     * Builds the shader that generateShaderFromFile() would create for the given arguments
+     * and stores it in the program cache, so that creating it later is cheap. Effects can
+     * use it to prepare their shaders while the compositor is idle, before they are shown
+     * for the first time. The OpenGL context must be current.
+     *
+     * @return @c false if the program cache is disabled or the shader failed to build
+     * @see isProgramCacheEnabled
+     */
+    bool precompileShaderFromFile(ShaderTraits traits, const QString &vertexFile = QString(), const QString &fragmentFile = QString());
+
     /**
      * @return a pointer to the ShaderManager instance
      */
@@ -296,15 +319,15 @@ private:
     ShaderManager();
     ~ShaderManager();
 
-    void bindFragDataLocations(GLShader *shader);
-    void bindAttributeLocations(GLShader *shader) const;
-
     QByteArray generateVertexSource(ShaderTraits traits) const;
     QByteArray generateFragmentSource(ShaderTraits traits) const;
     GLShader *generateShader(ShaderTraits traits);
+    GLShader *createShader(const QByteArray &vertexSource, const QByteArray &fragmentSource,
+                           const char *positionName, const char *texCoordName);
 
     QStack<GLShader*> m_boundShaders;
     QHash<ShaderTraits, GLShader *> m_shaderHash;
+    QScopedPointer<ShaderProgramCache> m_programCache;
     static ShaderManager *s_shaderManager;
 };
 
@@ -10,6 +10,7 @@
 #include "deepin_kwinoffscreenquickview.h"
 
 #include "deepin_kwinglutils.h"
+#include "kwinpixelconversion_p.h"
 #include "logging_p.h"
 
 #include <QGuiApplication>
@@ -80,6 +81,7 @@ public:
     Qt::MouseButton lastMousePressButton = Qt::NoButton;
 
     void releaseResources();
+    QImage grabFramebuffer() const;
 
     void updateTouchState(Qt::TouchPointState state, qint32 id, const QPointF& pos);
 };
@@ -259,7 +261,7 @@ void OffscreenQuickView::update()
     }
 
     if (d->m_useBlit) {
-        d->m_image = d->m_renderControl->grab();
+        d->m_image = usingGl ? d->grabFramebuffer() : d->m_renderControl->grab();
     }
 
     if (usingGl) {
@@ -447,6 +449,31 @@ void OffscreenQuickView::setGeometry(const QRect &rect)
     Q_EMIT geometryChanged(oldGeometry, rect);
 }
 
+QImage OffscreenQuickView::Private::grabFramebuffer() const
+{
+    // QQuickRenderControl::grab() renders the scene once more before reading it back and
+    // swizzles the pixels with generic code, the fbo already holds the rendered scene.
+    const bool isGLES = m_glcontext->isOpenGLES();
+    if (isGLES && Q_BYTE_ORDER == Q_BIG_ENDIAN) {
+        return m_renderControl->grab();
+    }
+
+    QImage image(m_fbo->size(), QImage::Format_ARGB32_Premultiplied);
+    m_fbo->bind();
+    if (isGLES) {
+        glReadPixels(0, 0, image.width(), image.height(), GL_RGBA, GL_UNSIGNED_BYTE, image.bits());
+    } else {
+        glReadPixels(0, 0, image.width(), image.height(), GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, image.bits());
+    }
+    convertPixels(image.bits(), image.bytesPerLine(), image.bits(), image.bytesPerLine(), image.size(),
+                  isGLES ? PixelConversion::SwapRedBlue : PixelConversion::Copy, true);
+
+    if (QQuickRenderControl::renderWindowFor(m_view)) {
+        image.setDevicePixelRatio(m_view->effectiveDevicePixelRatio());
+    }
+    return image;
+}
+
 void OffscreenQuickView::Private::releaseResources()
 {
     if (m_glcontext) {
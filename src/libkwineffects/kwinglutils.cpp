@@ -16,11 +16,16 @@
 #include "deepin_kwineffects.h"
 #include "deepin_kwinglplatform.h"
 #include "logging_p.h"
+#include "config-kwin.h"
 
 #include <QPixmap>
 #include <QImage>
 #include <QHash>
 #include <QFile>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QSaveFile>
+#include <QStandardPaths>
 #include <QVector2D>
 #include <QVector3D>
 #include <QVector4D>
@@ -597,6 +602,199 @@ QMatrix4x4 GLShader::getUniformMatrix4x4(const char* name)
     }
 }
 
+//****************************************
+// ShaderProgramCache
+//****************************************
+
+static const quint32 s_programCacheMagic = 0x4b57494e; // "KWIN"
+static const quint32 s_programCacheVersion = 1;
+
+struct ProgramBinaryHeader
+{
+    quint32 magic;
+    quint32 version;
+    quint32 format;
+    quint32 size;
+};
+
+/**
+ * Keeps the binaries of linked shader programs in memory and in the cache directory. The
+ * binaries of each driver are stored in their own directory, binaries of drivers that are
+ * not in use anymore are removed.
+ */
+class ShaderProgramCache
+{
+public:
+    ShaderProgramCache();
+
+    bool isEnabled() const
+    {
+        return m_enabled;
+    }
+
+    QByteArray key(const QByteArray &vertexSource, const QByteArray &fragmentSource,
+                   const char *positionName, const char *texCoordName) const;
+    bool load(GLuint program, const QByteArray &key);
+    void store(GLuint program, const QByteArray &key);
+
+private:
+    struct Binary
+    {
+        GLenum format = 0;
+        QByteArray data;
+    };
+
+    bool readBinary(const QByteArray &key, Binary *binary) const;
+    QString filePath(const QByteArray &key) const;
+
+    QHash<QByteArray, Binary> m_binaries;
+    QString m_directory;
+    bool m_enabled = false;
+};
+
+ShaderProgramCache::ShaderProgramCache()
+{
+    if (qEnvironmentVariableIsSet("KWIN_GL_NO_PROGRAM_CACHE")) {
+        return;
+    }
+    GLPlatform *platform = GLPlatform::instance();
+    if (platform->isGLES() ? !hasGLVersion(3, 0)
+                           : !hasGLVersion(4, 1) && !hasGLExtension(QByteArrayLiteral("GL_ARB_get_program_binary"))) {
+        return;
+    }
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    if (formatCount <= 0) {
+        return;
+    }
+    m_enabled = true;
+
+    QCryptographicHash driverHash(QCryptographicHash::Sha1);
+    driverHash.addData(KWIN_VERSION_STRING);
+    driverHash.addData(platform->glVendorString());
+    driverHash.addData(platform->glRendererString());
+    driverHash.addData(platform->glVersionString());
+    driverHash.addData(platform->glShadingLanguageVersionString());
+    const QString driver = QString::fromLatin1(driverHash.result().toHex());
+
+    QDir cacheDirectory(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+                        + QStringLiteral("/" KWIN_NAME "/shaders"));
+    const QStringList drivers = cacheDirectory.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString &otherDriver : drivers) {
+        if (otherDriver != driver) {
+            QDir(cacheDirectory.filePath(otherDriver)).removeRecursively();
+        }
+    }
+    if (cacheDirectory.mkpath(driver)) {
+        m_directory = cacheDirectory.filePath(driver);
+    } else {
+        qCWarning(LIBKWINGLUTILS) << "Failed to create the shader cache directory, shaders are cached in memory only";
+    }
+}
+
+QByteArray ShaderProgramCache::key(const QByteArray &vertexSource, const QByteArray &fragmentSource,
+                                   const char *positionName, const char *texCoordName) const
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(vertexSource);
+    hash.addData("\0", 1);
+    hash.addData(fragmentSource);
+    hash.addData("\0", 1);
+    hash.addData(positionName);
+    hash.addData("\0", 1);
+    hash.addData(texCoordName);
+    return hash.result().toHex();
+}
+
+QString ShaderProgramCache::filePath(const QByteArray &key) const
+{
+    return m_directory + QLatin1Char('/') + QString::fromLatin1(key);
+}
+
+bool ShaderProgramCache::readBinary(const QByteArray &key, Binary *binary) const
+{
+    if (m_directory.isEmpty()) {
+        return false;
+    }
+    QFile file(filePath(key));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    ProgramBinaryHeader header;
+    if (file.read(reinterpret_cast<char *>(&header), sizeof(header)) != sizeof(header)
+            || header.magic != s_programCacheMagic || header.version != s_programCacheVersion) {
+        return false;
+    }
+    binary->format = header.format;
+    binary->data = file.read(header.size);
+    return binary->data.size() == int(header.size);
+}
+
+bool ShaderProgramCache::load(GLuint program, const QByteArray &key)
+{
+    Binary binary = m_binaries.value(key);
+    if (binary.data.isEmpty()) {
+        if (!readBinary(key, &binary)) {
+            return false;
+        }
+        m_binaries.insert(key, binary);
+    }
+
+    glProgramBinary(program, binary.format, binary.data.constData(), binary.data.size());
+
+    GLint status = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status == 0) {
+        // Drivers may reject binaries even if their strings did not change, e.g. after
+        // an update of a development build. The program gets compiled and stored again.
+        qCDebug(LIBKWINGLUTILS) << "The driver rejected the cached shader program" << key;
+        m_binaries.remove(key);
+        if (!m_directory.isEmpty()) {
+            QFile::remove(filePath(key));
+        }
+        return false;
+    }
+    return true;
+}
+
+void ShaderProgramCache::store(GLuint program, const QByteArray &key)
+{
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    Binary binary;
+    binary.data.resize(length);
+    glGetProgramBinary(program, length, &length, &binary.format, binary.data.data());
+    if (length <= 0) {
+        return;
+    }
+    binary.data.resize(length);
+    m_binaries.insert(key, binary);
+
+    if (m_directory.isEmpty()) {
+        return;
+    }
+    QSaveFile file(filePath(key));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(LIBKWINGLUTILS) << "Failed to open" << file.fileName() << "for writing";
+        return;
+    }
+    const ProgramBinaryHeader header = {
+        s_programCacheMagic,
+        s_programCacheVersion,
+        quint32(binary.format),
+        quint32(binary.data.size()),
+    };
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(binary.data);
+    if (!file.commit()) {
+        qCWarning(LIBKWINGLUTILS) << "Failed to write" << file.fileName() << file.errorString();
+    }
+}
+
 //****************************************
 // ShaderManager
 //****************************************
@@ -617,6 +815,7 @@ void ShaderManager::cleanup()
 }
 
 ShaderManager::ShaderManager()
+    : m_programCache(new ShaderProgramCache)
 {
 }
 
@@ -766,14 +965,40 @@ GLShader *ShaderManager::generateCustomShader(ShaderTraits traits, const QByteAr
     qCDebug(LIBKWINGLUTILS) << "**************";
 #endif
 
+    return createShader(vertex, fragment, "position", "texcoord");
+}
+
+GLShader *ShaderManager::createShader(const QByteArray &vertexSource, const QByteArray &fragmentSource,
+                                      const char *positionName, const char *texCoordName)
+{
     GLShader *shader = new GLShader(GLShader::ExplicitLinking);
-    shader->load(vertex, fragment);
 
-    shader->bindAttributeLocation("position", VA_Position);
-    shader->bindAttributeLocation("texcoord", VA_TexCoord);
+    QByteArray cacheKey;
+    if (m_programCache->isEnabled()) {
+        cacheKey = m_programCache->key(shader->prepareSource(GL_VERTEX_SHADER, vertexSource),
+                                       shader->prepareSource(GL_FRAGMENT_SHADER, fragmentSource),
+                                       positionName, texCoordName);
+        if (m_programCache->load(shader->mProgram, cacheKey)) {
+            shader->mValid = true;
+            return shader;
+        }
+        // a rejected binary leaves the program in an undefined state
+        glDeleteProgram(shader->mProgram);
+        shader->mProgram = glCreateProgram();
+    }
+
+    shader->load(vertexSource, fragmentSource);
+
+    shader->bindAttributeLocation(positionName, VA_Position);
+    shader->bindAttributeLocation(texCoordName, VA_TexCoord);
     shader->bindFragDataLocation("fragColor", 0);
 
-    shader->link();
+    if (!cacheKey.isEmpty()) {
+        glProgramParameteri(shader->mProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    if (shader->link() && !cacheKey.isEmpty()) {
+        m_programCache->store(shader->mProgram, cacheKey);
+    }
     return shader;
 }
 
@@ -827,6 +1052,20 @@ GLShader *ShaderManager::generateShaderFromFile(ShaderTraits traits, const QStri
     return generateCustomShader(traits, vertexSource, fragmentSource);
 }
 
+bool ShaderManager::isProgramCacheEnabled() const
+{
+    return m_programCache->isEnabled();
+}
+
+bool ShaderManager::precompileShaderFromFile(ShaderTraits traits, const QString &vertexFile, const QString &fragmentFile)
+{
+    if (!isProgramCacheEnabled()) {
+        return false;
+    }
+    QScopedPointer<GLShader> shader(generateShaderFromFile(traits, vertexFile, fragmentFile));
+    return shader->isValid();
+}
+
 GLShader *ShaderManager::shader(ShaderTraits traits)
 {
     GLShader *shader = m_shaderHash.value(traits);
@@ -885,25 +1124,9 @@ void ShaderManager::popShader()
     }
 }
 
-void ShaderManager::bindFragDataLocations(GLShader *shader)
-{
-    shader->bindFragDataLocation("fragColor", 0);
-}
-
-void ShaderManager::bindAttributeLocations(GLShader *shader) const
-{
-    shader->bindAttributeLocation("vertex",   VA_Position);
-    shader->bindAttributeLocation("texCoord", VA_TexCoord);
-}
-
 GLShader *ShaderManager::loadShaderFromCode(const QByteArray &vertexSource, const QByteArray &fragmentSource)
 {
-    GLShader *shader = new GLShader(GLShader::ExplicitLinking);
-    shader->load(vertexSource, fragmentSource);
-    bindAttributeLocations(shader);
-    bindFragDataLocations(shader);
-    shader->link();
-    return shader;
+    return createShader(vertexSource, fragmentSource, "vertex", "texCoord");
 }
 
 /***  GLRenderTarget  ***/
@@ -0,0 +1,531 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#include "kwinpixelconversion_p.h"
+
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KWIN_PIXELCONVERSION_X86 1
+#include <immintrin.h>
+#define KWIN_TARGET_SSE2 __attribute__((target("sse2")))
+#define KWIN_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define KWIN_PIXELCONVERSION_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace KWin
+{
+
+namespace
+{
+
+struct Kernels
+{
+    void (*swapRedBlue)(const uchar *source, uchar *destination, int count);
+    void (*packRgb)(const uchar *source, uchar *destination, int count);
+    void (*packSwapRedBlue)(const uchar *source, uchar *destination, int count);
+    void (*premultiply)(const uchar *source, uchar *destination, int count);
+    void (*unpremultiply)(const uchar *source, uchar *destination, int count);
+};
+
+/**
+ * Fixed point reciprocals of the alpha values, c / a is (c * factors[a] + 0x8000) >> 16.
+ */
+struct UnpremultiplyTable
+{
+    UnpremultiplyTable()
+    {
+        factors[0] = 0;
+        for (uint alpha = 1; alpha < 256; ++alpha) {
+            factors[alpha] = (255u * 65536u + alpha / 2) / alpha;
+        }
+    }
+
+    uint factors[256];
+};
+
+const UnpremultiplyTable s_unpremultiplyTable;
+
+} // namespace
+
+// The exact rounded c * a / 255, the vector kernels compute the same in 16 bit lanes.
+static inline uchar multiplyAlpha(uint color, uint alpha)
+{
+    const uint t = color * alpha + 128;
+    return uchar((t + (t >> 8)) >> 8);
+}
+
+static inline uchar divideAlpha(uint color, uint alpha)
+{
+    return uchar(qMin<uint>(255, (color * s_unpremultiplyTable.factors[alpha] + 0x8000) >> 16));
+}
+
+static void swapRedBlueScalar(const uchar *source, uchar *destination, int count)
+{
+    for (int i = 0; i < count; ++i, source += 4, destination += 4) {
+        const uchar red = source[0];
+        const uchar green = source[1];
+        const uchar blue = source[2];
+        const uchar alpha = source[3];
+        destination[0] = blue;
+        destination[1] = green;
+        destination[2] = red;
+        destination[3] = alpha;
+    }
+}
+
+static void packRgbScalar(const uchar *source, uchar *destination, int count)
+{
+    for (int i = 0; i < count; ++i, source += 4, destination += 3) {
+        destination[0] = source[0];
+        destination[1] = source[1];
+        destination[2] = source[2];
+    }
+}
+
+static void packSwapRedBlueScalar(const uchar *source, uchar *destination, int count)
+{
+    for (int i = 0; i < count; ++i, source += 4, destination += 3) {
+        destination[0] = source[2];
+        destination[1] = source[1];
+        destination[2] = source[0];
+    }
+}
+
+static void premultiplyScalar(const uchar *source, uchar *destination, int count)
+{
+    for (int i = 0; i < count; ++i, source += 4, destination += 4) {
+        const uint alpha = source[3];
+        destination[0] = multiplyAlpha(source[0], alpha);
+        destination[1] = multiplyAlpha(source[1], alpha);
+        destination[2] = multiplyAlpha(source[2], alpha);
+        destination[3] = alpha;
+    }
+}
+
+static void unpremultiplyScalar(const uchar *source, uchar *destination, int count)
+{
+    for (int i = 0; i < count; ++i, source += 4, destination += 4) {
+        const uint alpha = source[3];
+        if (alpha == 255) {
+            std::memmove(destination, source, 4);
+        } else if (alpha == 0) {
+            std::memset(destination, 0, 4);
+        } else {
+            destination[0] = divideAlpha(source[0], alpha);
+            destination[1] = divideAlpha(source[1], alpha);
+            destination[2] = divideAlpha(source[2], alpha);
+            destination[3] = alpha;
+        }
+    }
+}
+
+static const Kernels s_scalarKernels = {
+    swapRedBlueScalar,
+    packRgbScalar,
+    packSwapRedBlueScalar,
+    premultiplyScalar,
+    unpremultiplyScalar,
+};
+
+#if defined(KWIN_PIXELCONVERSION_X86)
+
+KWIN_TARGET_SSE2 static void swapRedBlueSSE2(const uchar *source, uchar *destination, int count)
+{
+    const __m128i alphaGreenMask = _mm_set1_epi32(int(0xff00ff00));
+    const __m128i redBlueMask = _mm_set1_epi32(0x00ff00ff);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i * 4));
+        const __m128i redBlue = _mm_and_si128(pixels, redBlueMask);
+        const __m128i blueRed = _mm_or_si128(_mm_slli_epi32(redBlue, 16), _mm_srli_epi32(redBlue, 16));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(destination + i * 4),
+                         _mm_or_si128(_mm_and_si128(pixels, alphaGreenMask), blueRed));
+    }
+    swapRedBlueScalar(source + i * 4, destination + i * 4, count - i);
+}
+
+// Multiplies two pixels unpacked to 16 bit lanes with their alpha.
+KWIN_TARGET_SSE2 static inline __m128i multiplyAlphaSSE2(__m128i pixels)
+{
+    __m128i alpha = _mm_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 3, 3, 3));
+    alpha = _mm_shufflehi_epi16(alpha, _MM_SHUFFLE(3, 3, 3, 3));
+    const __m128i t = _mm_add_epi16(_mm_mullo_epi16(pixels, alpha), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+KWIN_TARGET_SSE2 static void premultiplySSE2(const uchar *source, uchar *destination, int count)
+{
+    const __m128i alphaMask = _mm_set1_epi32(int(0xff000000));
+    const __m128i zero = _mm_setzero_si128();
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i * 4));
+        const __m128i low = multiplyAlphaSSE2(_mm_unpacklo_epi8(pixels, zero));
+        const __m128i high = multiplyAlphaSSE2(_mm_unpackhi_epi8(pixels, zero));
+        const __m128i colors = _mm_andnot_si128(alphaMask, _mm_packus_epi16(low, high));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(destination + i * 4),
+                         _mm_or_si128(colors, _mm_and_si128(pixels, alphaMask)));
+    }
+    premultiplyScalar(source + i * 4, destination + i * 4, count - i);
+}
+
+// There is no vector division, but most pixels on screen are opaque or fully transparent.
+KWIN_TARGET_SSE2 static void unpremultiplySSE2(const uchar *source, uchar *destination, int count)
+{
+    const __m128i alphaMask = _mm_set1_epi32(int(0xff000000));
+    const __m128i zero = _mm_setzero_si128();
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i * 4));
+        const __m128i alpha = _mm_and_si128(pixels, alphaMask);
+        __m128i *target = reinterpret_cast<__m128i *>(destination + i * 4);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, alphaMask)) == 0xffff) {
+            _mm_storeu_si128(target, pixels);
+        } else if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, zero)) == 0xffff) {
+            _mm_storeu_si128(target, zero);
+        } else {
+            unpremultiplyScalar(source + i * 4, destination + i * 4, 4);
+        }
+    }
+    unpremultiplyScalar(source + i * 4, destination + i * 4, count - i);
+}
+
+static const Kernels s_sse2Kernels = {
+    swapRedBlueSSE2,
+    packRgbScalar,
+    packSwapRedBlueScalar,
+    premultiplySSE2,
+    unpremultiplySSE2,
+};
+
+KWIN_TARGET_AVX2 static void swapRedBlueAVX2(const uchar *source, uchar *destination, int count)
+{
+    const __m256i shuffle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                             2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(source + i * 4));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(destination + i * 4), _mm256_shuffle_epi8(pixels, shuffle));
+    }
+    swapRedBlueScalar(source + i * 4, destination + i * 4, count - i);
+}
+
+// Each 128 bit lane packs four pixels into its low 12 bytes. The lanes are stored with
+// overlapping 16 byte writes, so the loop stops while there is room for the 4 spare bytes.
+KWIN_TARGET_AVX2 static void packAVX2(const uchar *source, uchar *destination, int count, __m256i shuffle,
+                                      void (*packTail)(const uchar *, uchar *, int))
+{
+    int i = 0;
+    for (; i + 10 <= count; i += 8) {
+        const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(source + i * 4));
+        const __m256i packed = _mm256_shuffle_epi8(pixels, shuffle);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(destination + i * 3), _mm256_castsi256_si128(packed));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(destination + i * 3 + 12), _mm256_extracti128_si256(packed, 1));
+    }
+    packTail(source + i * 4, destination + i * 3, count - i);
+}
+
+KWIN_TARGET_AVX2 static void packRgbAVX2(const uchar *source, uchar *destination, int count)
+{
+    packAVX2(source, destination, count,
+             _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                              0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1),
+             packRgbScalar);
+}
+
+KWIN_TARGET_AVX2 static void packSwapRedBlueAVX2(const uchar *source, uchar *destination, int count)
+{
+    packAVX2(source, destination, count,
+             _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                              2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1),
+             packSwapRedBlueScalar);
+}
+
+KWIN_TARGET_AVX2 static inline __m256i multiplyAlphaAVX2(__m256i pixels)
+{
+    __m256i alpha = _mm256_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 3, 3, 3));
+    alpha = _mm256_shufflehi_epi16(alpha, _MM_SHUFFLE(3, 3, 3, 3));
+    const __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(pixels, alpha), _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+KWIN_TARGET_AVX2 static void premultiplyAVX2(const uchar *source, uchar *destination, int count)
+{
+    const __m256i alphaMask = _mm256_set1_epi32(int(0xff000000));
+    const __m256i zero = _mm256_setzero_si256();
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(source + i * 4));
+        // unpack and pack work within 128 bit lanes, so the pixels keep their order
+        const __m256i low = multiplyAlphaAVX2(_mm256_unpacklo_epi8(pixels, zero));
+        const __m256i high = multiplyAlphaAVX2(_mm256_unpackhi_epi8(pixels, zero));
+        const __m256i colors = _mm256_andnot_si256(alphaMask, _mm256_packus_epi16(low, high));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(destination + i * 4),
+                            _mm256_or_si256(colors, _mm256_and_si256(pixels, alphaMask)));
+    }
+    premultiplyScalar(source + i * 4, destination + i * 4, count - i);
+}
+
+KWIN_TARGET_AVX2 static void unpremultiplyAVX2(const uchar *source, uchar *destination, int count)
+{
+    const __m256i alphaMask = _mm256_set1_epi32(int(0xff000000));
+    const __m256i zero = _mm256_setzero_si256();
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(source + i * 4));
+        const __m256i alpha = _mm256_and_si256(pixels, alphaMask);
+        __m256i *target = reinterpret_cast<__m256i *>(destination + i * 4);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(alpha, alphaMask)) == -1) {
+            _mm256_storeu_si256(target, pixels);
+        } else if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(alpha, zero)) == -1) {
+            _mm256_storeu_si256(target, zero);
+        } else {
+            unpremultiplyScalar(source + i * 4, destination + i * 4, 8);
+        }
+    }
+    unpremultiplyScalar(source + i * 4, destination + i * 4, count - i);
+}
+
+static const Kernels s_avx2Kernels = {
+    swapRedBlueAVX2,
+    packRgbAVX2,
+    packSwapRedBlueAVX2,
+    premultiplyAVX2,
+    unpremultiplyAVX2,
+};
+
+#elif defined(KWIN_PIXELCONVERSION_NEON)
+
+static void swapRedBlueNeon(const uchar *source, uchar *destination, int count)
+{
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t pixels = vld4q_u8(source + i * 4);
+        std::swap(pixels.val[0], pixels.val[2]);
+        vst4q_u8(destination + i * 4, pixels);
+    }
+    swapRedBlueScalar(source + i * 4, destination + i * 4, count - i);
+}
+
+static void packRgbNeon(const uchar *source, uchar *destination, int count)
+{
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const uint8x16x4_t pixels = vld4q_u8(source + i * 4);
+        const uint8x16x3_t packed = {{pixels.val[0], pixels.val[1], pixels.val[2]}};
+        vst3q_u8(destination + i * 3, packed);
+    }
+    packRgbScalar(source + i * 4, destination + i * 3, count - i);
+}
+
+static void packSwapRedBlueNeon(const uchar *source, uchar *destination, int count)
+{
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const uint8x16x4_t pixels = vld4q_u8(source + i * 4);
+        const uint8x16x3_t packed = {{pixels.val[2], pixels.val[1], pixels.val[0]}};
+        vst3q_u8(destination + i * 3, packed);
+    }
+    packSwapRedBlueScalar(source + i * 4, destination + i * 3, count - i);
+}
+
+// vraddhn(p, (p + 128) >> 8) is the same rounded division by 255 as multiplyAlpha().
+static inline uint8x8_t multiplyAlphaNeon(uint8x8_t color, uint8x8_t alpha)
+{
+    const uint16x8_t product = vmull_u8(color, alpha);
+    return vraddhn_u16(product, vrshrq_n_u16(product, 8));
+}
+
+static inline uint8x16_t multiplyAlphaNeon(uint8x16_t color, uint8x16_t alpha)
+{
+    return vcombine_u8(multiplyAlphaNeon(vget_low_u8(color), vget_low_u8(alpha)),
+                       multiplyAlphaNeon(vget_high_u8(color), vget_high_u8(alpha)));
+}
+
+static void premultiplyNeon(const uchar *source, uchar *destination, int count)
+{
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t pixels = vld4q_u8(source + i * 4);
+        pixels.val[0] = multiplyAlphaNeon(pixels.val[0], pixels.val[3]);
+        pixels.val[1] = multiplyAlphaNeon(pixels.val[1], pixels.val[3]);
+        pixels.val[2] = multiplyAlphaNeon(pixels.val[2], pixels.val[3]);
+        vst4q_u8(destination + i * 4, pixels);
+    }
+    premultiplyScalar(source + i * 4, destination + i * 4, count - i);
+}
+
+static void unpremultiplyNeon(const uchar *source, uchar *destination, int count)
+{
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const uint8x16x4_t pixels = vld4q_u8(source + i * 4);
+        if (vminvq_u8(pixels.val[3]) == 255) {
+            vst4q_u8(destination + i * 4, pixels);
+        } else if (vmaxvq_u8(pixels.val[3]) == 0) {
+            const uint8x16_t zero = vdupq_n_u8(0);
+            const uint8x16x4_t transparent = {{zero, zero, zero, zero}};
+            vst4q_u8(destination + i * 4, transparent);
+        } else {
+            unpremultiplyScalar(source + i * 4, destination + i * 4, 16);
+        }
+    }
+    unpremultiplyScalar(source + i * 4, destination + i * 4, count - i);
+}
+
+static const Kernels s_neonKernels = {
+    swapRedBlueNeon,
+    packRgbNeon,
+    packSwapRedBlueNeon,
+    premultiplyNeon,
+    unpremultiplyNeon,
+};
+
+#endif
+
+static const Kernels &kernelsFor(PixelConversionBackend backend)
+{
+    switch (backend) {
+#if defined(KWIN_PIXELCONVERSION_X86)
+    case PixelConversionBackend::SSE2:
+        return s_sse2Kernels;
+    case PixelConversionBackend::AVX2:
+        return s_avx2Kernels;
+#elif defined(KWIN_PIXELCONVERSION_NEON)
+    case PixelConversionBackend::Neon:
+        return s_neonKernels;
+#endif
+    default:
+        return s_scalarKernels;
+    }
+}
+
+struct ActiveKernels
+{
+    ActiveKernels()
+        : backend(supportedPixelConversionBackends().constLast())
+        , kernels(&kernelsFor(backend))
+    {
+    }
+
+    PixelConversionBackend backend;
+    const Kernels *kernels;
+};
+
+static ActiveKernels &activeKernels()
+{
+    static ActiveKernels active;
+    return active;
+}
+
+QVector<PixelConversionBackend> supportedPixelConversionBackends()
+{
+    QVector<PixelConversionBackend> backends{PixelConversionBackend::Scalar};
+#if defined(KWIN_PIXELCONVERSION_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        backends.append(PixelConversionBackend::SSE2);
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        backends.append(PixelConversionBackend::AVX2);
+    }
+#elif defined(KWIN_PIXELCONVERSION_NEON)
+    backends.append(PixelConversionBackend::Neon);
+#endif
+    return backends;
+}
+
+PixelConversionBackend pixelConversionBackend()
+{
+    return activeKernels().backend;
+}
+
+void setPixelConversionBackend(PixelConversionBackend backend)
+{
+    if (!supportedPixelConversionBackends().contains(backend)) {
+        return;
+    }
+    ActiveKernels &active = activeKernels();
+    active.backend = backend;
+    active.kernels = &kernelsFor(backend);
+}
+
+void convertPixels(const uchar *source, uchar *destination, int count, PixelConversion conversion)
+{
+    if (count <= 0) {
+        return;
+    }
+
+    const Kernels *kernels = activeKernels().kernels;
+    switch (conversion) {
+    case PixelConversion::Copy:
+        if (source != destination) {
+            std::memcpy(destination, source, size_t(count) * 4);
+        }
+        break;
+    case PixelConversion::SwapRedBlue:
+        kernels->swapRedBlue(source, destination, count);
+        break;
+    case PixelConversion::PackRgb:
+        Q_ASSERT(source != destination);
+        kernels->packRgb(source, destination, count);
+        break;
+    case PixelConversion::PackSwapRedBlue:
+        Q_ASSERT(source != destination);
+        kernels->packSwapRedBlue(source, destination, count);
+        break;
+    case PixelConversion::Premultiply:
+        kernels->premultiply(source, destination, count);
+        break;
+    case PixelConversion::Unpremultiply:
+        kernels->unpremultiply(source, destination, count);
+        break;
+    }
+}
+
+void convertPixels(const uchar *source, int sourceStride, uchar *destination, int destinationStride,
+                   const QSize &size, PixelConversion conversion, bool flipVertically)
+{
+    const int width = size.width();
+    const int height = size.height();
+
+    if (!flipVertically || source != destination) {
+        for (int y = 0; y < height; ++y) {
+            const int sourceRow = flipVertically ? height - 1 - y : y;
+            convertPixels(source + size_t(sourceRow) * sourceStride, destination + size_t(y) * destinationStride,
+                          width, conversion);
+        }
+        return;
+    }
+
+    // Turning the image upside down in place swaps pairs of rows.
+    Q_ASSERT(sourceStride == destinationStride);
+    Q_ASSERT(conversion != PixelConversion::PackRgb && conversion != PixelConversion::PackSwapRedBlue);
+    std::vector<uchar> row(size_t(width) * 4);
+    for (int y = 0; y < height / 2; ++y) {
+        uchar *top = destination + size_t(y) * destinationStride;
+        uchar *bottom = destination + size_t(height - 1 - y) * destinationStride;
+        convertPixels(top, row.data(), width, conversion);
+        convertPixels(bottom, top, width, conversion);
+        std::memcpy(bottom, row.data(), row.size());
+    }
+    if (height % 2) {
+        uchar *middle = destination + size_t(height / 2) * destinationStride;
+        convertPixels(middle, middle, width, conversion);
+    }
+}
+
+} // namespace KWin
@@ -0,0 +1,63 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#pragma once
+
+#include "deepin_kwinglutils_export.h"
+
+#include <QSize>
+#include <QVector>
+
+namespace KWin
+{
+
+/**
+ * Conversions between the 8 bit per channel layouts that are read back from OpenGL and
+ * the layouts handed to QImage and PipeWire. All layouts are described by their byte
+ * order in memory, the alpha channel is always the fourth byte of 32 bit pixels.
+ */
+enum class PixelConversion {
+    Copy, ///< copies 32 bit pixels unchanged
+    SwapRedBlue, ///< RGBA <-> BGRA
+    PackRgb, ///< drops the alpha channel: RGBA -> RGB, BGRA -> BGR
+    PackSwapRedBlue, ///< drops the alpha channel and swaps red and blue: RGBA -> BGR, BGRA -> RGB
+    Premultiply, ///< multiplies the color channels with the alpha channel
+    Unpremultiply, ///< divides the color channels by the alpha channel
+};
+
+/**
+ * The instruction sets the conversions are implemented with. The best one supported by the
+ * cpu is picked at runtime.
+ */
+enum class PixelConversionBackend {
+    Scalar,
+    SSE2,
+    AVX2,
+    Neon,
+};
+
+/**
+ * Converts @p count pixels from @p source to @p destination. The buffers may be the same
+ * unless the pixel size changes.
+ */
+KWINGLUTILS_EXPORT void convertPixels(const uchar *source, uchar *destination, int count, PixelConversion conversion);
+
+/**
+ * Converts an image of the given @p size row by row, optionally turning it upside down,
+ * e.g. to turn the bottom-up rows read back from OpenGL into a QImage.
+ */
+KWINGLUTILS_EXPORT void convertPixels(const uchar *source, int sourceStride, uchar *destination, int destinationStride,
+                                      const QSize &size, PixelConversion conversion, bool flipVertically = false);
+
+KWINGLUTILS_EXPORT QVector<PixelConversionBackend> supportedPixelConversionBackends();
+KWINGLUTILS_EXPORT PixelConversionBackend pixelConversionBackend();
+
+/**
+ * Overrides the backend picked at runtime, for tests and benchmarks.
+ */
+KWINGLUTILS_EXPORT void setPixelConversionBackend(PixelConversionBackend backend);
+
+} // namespace KWin
@@ -60,6 +60,7 @@ enum RenderTimeEstimator {
     RenderTimeEstimatorMinimum,
     RenderTimeEstimatorMaximum,
     RenderTimeEstimatorAverage,
+    RenderTimeEstimatorPredictive,
 };
 
 class Settings;
@@ -754,6 +755,7 @@ public:
         return LatencyMedium;
     }
     static RenderTimeEstimator defaultRenderTimeEstimator() {
+        // the predictive estimator ignores the latency policy, so it is opt-in
         return RenderTimeEstimatorMaximum;
     }
     /**
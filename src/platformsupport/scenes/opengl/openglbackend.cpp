@@ -50,6 +50,19 @@ bool OpenGLBackend::scanout(AbstractOutput *output, SurfaceItem *surfaceItem)
     return false;
 }
 
+QVector<SurfaceItem *> OpenGLBackend::assignOverlays(AbstractOutput *output, const QVector<SurfaceItem *> &candidates)
+{
+    Q_UNUSED(output)
+    Q_UNUSED(candidates)
+    return {};
+}
+
+bool OpenGLBackend::presentOverlays(AbstractOutput *output)
+{
+    Q_UNUSED(output)
+    return false;
+}
+
 void OpenGLBackend::copyPixels(const QRegion &region)
 {
     const int height = screens()->size().height();
@@ -68,6 +68,18 @@ public:
      * @return if the scanout fails (or is not supported on the specified screen)
      */
     virtual bool scanout(AbstractOutput *output, SurfaceItem *surfaceItem);
+    /**
+     * Tries to put the surfaces on overlay planes of the output with the next presented frame.
+     * @p candidates are sorted from top to bottom and nothing is painted above them.
+     * @return the surfaces that have been assigned to an overlay plane
+     */
+    virtual QVector<SurfaceItem *> assignOverlays(AbstractOutput *output, const QVector<SurfaceItem *> &candidates);
+    /**
+     * Presents the last rendered frame again, together with the current buffers of the
+     * overlay planes assigned by assignOverlays().
+     * @return if nothing has been presented and the frame has to be rendered
+     */
+    virtual bool presentOverlays(AbstractOutput *output);
 
     /**
      * @brief Whether the creation of the Backend failed.
@@ -25,6 +25,7 @@
 
 #include <DWayland/Server/display.h>
 #include <DWayland/Server/output_interface.h>
+#include <DWayland/Server/surface_interface.h>
 
 namespace KWin
 {
@@ -58,7 +59,7 @@ private:
         connect(Compositor::self()->scene(), &Scene::frameRendered, this, &WindowStream::bufferToStream);
 
         connect(m_toplevel, &Toplevel::damaged, this, &WindowStream::includeDamage);
-        m_damagedRegion = m_toplevel->visibleGeometry();
+        m_damagedRegion = QRect(QPoint(), m_toplevel->clientGeometry().size());
         m_toplevel->addRepaintFull();
     }
 
@@ -68,7 +69,17 @@ private:
 
     void includeDamage(Toplevel *toplevel, const QRegion &damage) {
         Q_ASSERT(m_toplevel == toplevel);
-        m_damagedRegion |= damage;
+        // The damage is local to the surface that has been damaged, which can only be told
+        // apart from the main surface if the window has no sub-surfaces.
+        // The stream copies only the damaged parts into its buffers, so damage that can't be
+        // mapped exactly onto the frame, e.g. that of scaled buffers, must cover all of it.
+        KWaylandServer::SurfaceInterface *surface = m_toplevel->surface();
+        if (surface && (!surface->below().isEmpty() || !surface->above().isEmpty() || surface->bufferScale() != 1)) {
+            m_damagedRegion = QRect(QPoint(), m_toplevel->clientGeometry().size());
+            return;
+        }
+        const QPoint offset = m_toplevel->bufferGeometry().topLeft() - m_toplevel->clientGeometry().topLeft();
+        m_damagedRegion |= damage.translated(offset);
     }
 
     void bufferToStream () {
@@ -132,9 +143,21 @@ void ScreencastManager::streamOutput(KWaylandServer::ScreencastStreamV1Interface
             return;
         }
 
+        // The damage is in logical coordinates while the frame is in device pixels. Rotated
+        // outputs are damaged completely instead of mapping the damage through the transform.
         const QRect frame({}, streamOutput->modeSize());
-        const QRegion region = streamOutput->pixelSize() != streamOutput->modeSize() ? frame : damagedRegion.translated(-streamOutput->geometry().topLeft()).intersected(frame);
-        stream->recordFrame(region);
+        if (streamOutput->pixelSize() != streamOutput->modeSize()) {
+            stream->recordFrame(frame);
+            return;
+        }
+        const QPoint origin = streamOutput->geometry().topLeft();
+        const qreal scale = streamOutput->scale();
+        QRegion region;
+        for (const QRect &rect : damagedRegion) {
+            const QRect local = rect.translated(-origin);
+            region += QRectF(QPointF(local.topLeft()) * scale, QSizeF(local.size()) * scale).toAlignedRect();
+        }
+        stream->recordFrame(region.intersected(frame));
     };
     connect(stream, &ScreenCastStream::startStreaming, waylandStream, [streamOutput, stream, bufferToStream] {
         Compositor::self()->scene()->addRepaint(streamOutput->geometry());
@@ -20,6 +20,7 @@
 #include "platform.h"
 #include "scene.h"
 #include "screencastsource.h"
+#include "screencastutils.h"
 #include "utils/common.h"
 
 #include <KLocalizedString>
@@ -143,6 +144,9 @@ void ScreenCastStream::onStreamAddBuffer(void *data, pw_buffer *buffer)
     if (spa_data[0].type != SPA_ID_INVALID && spa_data[0].type & (1 << SPA_DATA_DmaBuf))
         dmabuf.reset(kwinApp()->platform()->createDmaBufTexture(stream->m_resolution));
 
+    // A new buffer has no contents yet.
+    stream->m_bufferDamage.insert(buffer, QRect(QPoint(), stream->m_resolution));
+
     if (dmabuf) {
       spa_data->type = SPA_DATA_DmaBuf;
       spa_data->fd = dmabuf->fd();
@@ -195,6 +199,7 @@ void ScreenCastStream::onStreamRemoveBuffer(void *data, pw_buffer *buffer)
 {
     ScreenCastStream *stream = static_cast<ScreenCastStream *>(data);
     stream->m_dmabufDataForPwBuffer.remove(buffer);
+    stream->m_bufferDamage.remove(buffer);
 
     struct spa_buffer *spa_buffer = buffer->buffer;
     struct spa_data *spa_data = spa_buffer->datas;
@@ -211,6 +216,15 @@ ScreenCastStream::ScreenCastStream(ScreenCastSource *source, QObject *parent)
 {
     connect(source, &ScreenCastSource::closed, this, &ScreenCastStream::stopStreaming);
 
+    m_frameTimer.setSingleShot(true);
+    m_frameTimer.setTimerType(Qt::PreciseTimer);
+    connect(&m_frameTimer, &QTimer::timeout, this, [this]() {
+        if (auto scene = Compositor::self()->scene()) {
+            scene->makeOpenGLContextCurrent();
+        }
+        recordFrame(QRegion());
+    });
+
     pwStreamEvents.version = PW_VERSION_STREAM_EVENTS;
     pwStreamEvents.add_buffer = &ScreenCastStream::onStreamAddBuffer;
     pwStreamEvents.remove_buffer = &ScreenCastStream::onStreamRemoveBuffer;
@@ -331,13 +345,26 @@ void ScreenCastStream::recordFrame(const QRegion &damagedRegion)
 {
     Q_ASSERT(!m_stopped);
 
+    m_pendingDamage += damagedRegion;
+    if (m_pendingDamage.isEmpty()) {
+        return;
+    }
+
+    // The damage keeps accumulating while the previous frame is still in flight or the
+    // stream is ahead of the negotiated framerate, the frame is sent later instead.
     if (m_pendingBuffer) {
-        qCWarning(KWIN_SCREENCAST) << "Dropping a screencast frame because the compositor is slow";
         return;
     }
+    const std::chrono::nanoseconds interval = frameInterval();
+    if (m_lastFrameTime.isValid() && std::chrono::nanoseconds(m_lastFrameTime.nsecsElapsed()) < interval) {
+        scheduleFrame();
+        return;
+    }
+    m_frameTimer.stop();
 
     if (m_source->textureSize() != m_resolution) {
         m_resolution = m_source->textureSize();
+        m_pendingDamage = QRect(QPoint(), m_resolution);
         newStreamParams();
         return;
     }
@@ -357,6 +384,12 @@ void ScreenCastStream::recordFrame(const QRegion &damagedRegion)
         return;
     }
 
+    const QRect frame(QPoint(), m_resolution);
+    const QRegion damage = std::exchange(m_pendingDamage, QRegion()) & frame;
+    for (QRegion &bufferDamage : m_bufferDamage) {
+        bufferDamage += damage;
+    }
+
     struct spa_buffer *spa_buffer = buffer->buffer;
     struct spa_data *spa_data = spa_buffer->datas;
 
@@ -384,51 +417,33 @@ void ScreenCastStream::recordFrame(const QRegion &damagedRegion)
         spa_data->chunk->size = dest.sizeInBytes();
         spa_data->chunk->stride = dest.bytesPerLine();
 
-        m_source->render(&dest);
+        // The buffer still holds the frame it was last filled with, only the parts that have
+        // changed since then need to be copied.
+        const QRegion stale = m_bufferDamage.value(buffer, frame) & frame;
+        m_bufferDamage[buffer] = QRegion();
 
-        auto cursor = Cursors::self()->currentCursor();
-        if (m_cursor.mode == KWaylandServer::ScreencastV1Interface::Embedded && m_cursor.viewport.contains(cursor->pos())) {
-            QPainter painter(&dest);
-            const auto position = (cursor->pos() - m_cursor.viewport.topLeft() - cursor->hotspot()) * m_cursor.scale;
-            painter.drawImage(QRect{position, cursor->image().size()}, cursor->image());
+        if (stale == frame && !isCursorEmbedded()) {
+            m_source->render(&dest);
+        } else {
+            // Composite the cursor on the GPU rather than painting it into the cpu copy.
+            GLRenderTarget *target = offscreenTarget();
+            m_source->render(target);
+            if (isCursorEmbedded()) {
+                paintCursor(target);
+            }
+            grabTextureRegion(m_offscreen.texture.data(), target, &dest, stale);
         }
     } else {
         auto &buf = m_dmabufDataForPwBuffer[buffer];
+        m_bufferDamage[buffer] = QRegion();
 
         spa_data->chunk->stride = buf->stride();
         spa_data->chunk->size = spa_data->maxsize;
 
+        // The source renders straight into the buffer shared with the consumer.
         m_source->render(buf->framebuffer());
-
-        auto cursor = Cursors::self()->currentCursor();
-        if (m_cursor.mode == KWaylandServer::ScreencastV1Interface::Embedded && m_cursor.viewport.contains(cursor->pos())) {
-            GLRenderTarget::pushRenderTarget(buf->framebuffer());
-
-            QRect r(QPoint(), size);
-            auto shader = ShaderManager::instance()->pushShader(ShaderTrait::MapTexture);
-
-            QMatrix4x4 mvp;
-            mvp.ortho(r);
-            shader->setUniform(GLShader::ModelViewProjectionMatrix, mvp);
-
-            if (!m_cursor.texture || m_cursor.lastKey != cursor->image().cacheKey())
-                m_cursor.texture.reset(new GLTexture(cursor->image()));
-
-            m_cursor.texture->setYInverted(false);
-            m_cursor.texture->bind();
-            const auto cursorRect = cursorGeometry(cursor);
-            mvp.translate(cursorRect.left(), r.height() - cursorRect.top() - cursor->image().height() * m_cursor.scale);
-            shader->setUniform(GLShader::ModelViewProjectionMatrix, mvp);
-
-            glEnable(GL_BLEND);
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-            m_cursor.texture->render(cursorRect, cursorRect, true);
-            glDisable(GL_BLEND);
-            m_cursor.texture->unbind();
-            m_cursor.lastRect = cursorRect;
-
-            ShaderManager::instance()->popShader();
-            GLRenderTarget::popRenderTarget();
+        if (isCursorEmbedded()) {
+            paintCursor(buf->framebuffer());
         }
     }
 
@@ -441,14 +456,14 @@ void ScreenCastStream::recordFrame(const QRegion &damagedRegion)
         struct spa_meta_region *r = (spa_meta_region *) spa_meta_first(vdMeta);
 
         // If there's too many rectangles, we just send the bounding rect
-        if (damagedRegion.rectCount() > videoDamageRegionCount - 1) {
+        if (damage.rectCount() > videoDamageRegionCount - 1) {
             if (spa_meta_check(r, vdMeta)) {
-                auto rect = damagedRegion.boundingRect();
+                auto rect = damage.boundingRect();
                 r->region = SPA_REGION(rect.x(), rect.y(), quint32(rect.width()), quint32(rect.height()));
                 r++;
             }
         } else {
-            for (const QRect &rect : damagedRegion) {
+            for (const QRect &rect : damage) {
                 if (spa_meta_check(r, vdMeta)) {
                     r->region = SPA_REGION(rect.x(), rect.y(), quint32(rect.width()), quint32(rect.height()));
                     r++;
@@ -499,6 +514,7 @@ void ScreenCastStream::recordCursor()
 void ScreenCastStream::tryEnqueue(pw_buffer *buffer)
 {
     m_pendingBuffer = buffer;
+    m_lastFrameTime.start();
 
     // The GPU doesn't necessarily process draw commands as soon as they are issued. Thus,
     // we need to insert a fence into the command stream and enqueue the pipewire buffer
@@ -536,6 +552,32 @@ void ScreenCastStream::enqueue()
     m_pendingBuffer = nullptr;
     m_pendingFence = nullptr;
     m_pendingNotifier = nullptr;
+
+    // Flush the damage that has piled up while the buffer was in flight.
+    if (!m_pendingDamage.isEmpty()) {
+        scheduleFrame();
+    }
+}
+
+std::chrono::nanoseconds ScreenCastStream::frameInterval() const
+{
+    if (!pwStream || !videoFormat.max_framerate.num) {
+        return std::chrono::nanoseconds::zero();
+    }
+    return std::chrono::nanoseconds(1'000'000'000ll * videoFormat.max_framerate.denom / videoFormat.max_framerate.num);
+}
+
+void ScreenCastStream::scheduleFrame()
+{
+    if (m_frameTimer.isActive()) {
+        return;
+    }
+
+    std::chrono::nanoseconds delay = std::chrono::nanoseconds::zero();
+    if (m_lastFrameTime.isValid()) {
+        delay = std::max(delay, frameInterval() - std::chrono::nanoseconds(m_lastFrameTime.nsecsElapsed()));
+    }
+    m_frameTimer.start(std::chrono::ceil<std::chrono::milliseconds>(delay));
 }
 
 spa_pod *ScreenCastStream::buildFormat(struct spa_pod_builder *b, enum spa_video_format format, struct spa_rectangle *resolution,
@@ -589,6 +631,60 @@ spa_pod *ScreenCastStream::buildFormat(struct spa_pod_builder *b, enum spa_video
     return (spa_pod*)spa_pod_builder_pop(b, &f[0]);
 }
 
+bool ScreenCastStream::isCursorEmbedded() const
+{
+    return m_cursor.mode == KWaylandServer::ScreencastV1Interface::Embedded
+        && m_cursor.viewport.contains(Cursors::self()->currentCursor()->pos());
+}
+
+GLRenderTarget *ScreenCastStream::offscreenTarget()
+{
+    if (!m_offscreen.texture || m_offscreen.texture->size() != m_resolution) {
+        m_offscreen.target.reset();
+        m_offscreen.texture.reset(new GLTexture(m_source->hasAlphaChannel() ? GL_RGBA8 : GL_RGB8, m_resolution));
+        m_offscreen.target.reset(new GLRenderTarget(*m_offscreen.texture));
+    }
+    return m_offscreen.target.data();
+}
+
+void ScreenCastStream::paintCursor(GLRenderTarget *target)
+{
+    auto cursor = Cursors::self()->currentCursor();
+    if (cursor->image().isNull()) {
+        return;
+    }
+
+    GLRenderTarget::pushRenderTarget(target);
+
+    QRect r(QPoint(), m_resolution);
+    auto shader = ShaderManager::instance()->pushShader(ShaderTrait::MapTexture);
+
+    QMatrix4x4 mvp;
+    mvp.ortho(r);
+    shader->setUniform(GLShader::ModelViewProjectionMatrix, mvp);
+
+    if (!m_cursor.texture || m_cursor.lastKey != cursor->image().cacheKey()) {
+        m_cursor.texture.reset(new GLTexture(cursor->image()));
+        m_cursor.lastKey = cursor->image().cacheKey();
+    }
+
+    m_cursor.texture->setYInverted(false);
+    m_cursor.texture->bind();
+    const auto cursorRect = cursorGeometry(cursor);
+    mvp.translate(cursorRect.left(), r.height() - cursorRect.top() - cursor->image().height() * m_cursor.scale);
+    shader->setUniform(GLShader::ModelViewProjectionMatrix, mvp);
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    m_cursor.texture->render(cursorRect, cursorRect, true);
+    glDisable(GL_BLEND);
+    m_cursor.texture->unbind();
+    m_cursor.lastRect = cursorRect;
+
+    ShaderManager::instance()->popShader();
+    GLRenderTarget::popRenderTarget();
+}
+
 QRect ScreenCastStream::cursorGeometry(Cursor *cursor) const
 {
     if (!m_cursor.texture) {
@@ -629,11 +725,24 @@ void ScreenCastStream::sendCursorData(Cursor *cursor, spa_meta_cursor *spa_meta_
     uint8_t *bitmap_data = SPA_MEMBER (spa_meta_bitmap, spa_meta_bitmap->offset, uint8_t);
     QImage dest(bitmap_data, std::min(m_cursor.bitmapSize.width(), image.width()), std::min(m_cursor.bitmapSize.height(), image.height()), QImage::Format_RGBA8888_Premultiplied);
     dest.setDevicePixelRatio(m_cursor.scale);
-    dest.fill(Qt::transparent);
 
-    if (!image.isNull()) {
-        QPainter painter(&dest);
-        painter.drawImage(QPoint(), image);
+    // Cursor images are usually ARGB32, which only differs from the bitmap in the order of
+    // the red and blue channels.
+    const bool premultiplied = image.format() == QImage::Format_ARGB32_Premultiplied;
+    if ((premultiplied || image.format() == QImage::Format_ARGB32) && Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+            && qFuzzyCompare(image.devicePixelRatio(), m_cursor.scale)) {
+        convertPixels(image.constBits(), image.bytesPerLine(), dest.bits(), dest.bytesPerLine(),
+                      dest.size(), PixelConversion::SwapRedBlue);
+        if (!premultiplied) {
+            convertPixels(dest.bits(), dest.bytesPerLine(), dest.bits(), dest.bytesPerLine(),
+                          dest.size(), PixelConversion::Premultiply);
+        }
+    } else {
+        dest.fill(Qt::transparent);
+        if (!image.isNull()) {
+            QPainter painter(&dest);
+            painter.drawImage(QPoint(), image);
+        }
     }
 
     spa_meta_bitmap->format = SPA_VIDEO_FORMAT_RGBA;
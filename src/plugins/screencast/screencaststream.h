@@ -16,8 +16,12 @@
 #include <QHash>
 #include <QObject>
 #include <QSharedPointer>
+#include <QElapsedTimer>
 #include <QSize>
 #include <QSocketNotifier>
+#include <QTimer>
+
+#include <chrono>
 
 #include <pipewire/pipewire.h>
 #include <spa/param/format-utils.h>
@@ -30,6 +34,7 @@ namespace KWin
 class Cursor;
 class DmaBufTexture;
 class EGLNativeFence;
+class GLRenderTarget;
 class GLTexture;
 class PipeWireCore;
 class ScreenCastSource;
@@ -76,6 +81,8 @@ private:
     void newStreamParams();
     void tryEnqueue(pw_buffer *buffer);
     void enqueue();
+    void scheduleFrame();
+    std::chrono::nanoseconds frameInterval() const;
     spa_pod* buildFormat(struct spa_pod_builder *b, enum spa_video_format format, struct spa_rectangle *resolution,
                          struct spa_fraction *defaultFramerate, struct spa_fraction *minFramerate, struct spa_fraction *maxFramerate,
                          uint64_t *modifiers, int modifier_count);
@@ -91,7 +98,7 @@ private:
     QSize m_resolution;
     bool m_stopped = false;
 
-    spa_video_info_raw videoFormat;
+    spa_video_info_raw videoFormat = {};
     bool m_hasModifier = false;
     QString m_error;
 
@@ -105,9 +112,31 @@ private:
         QScopedPointer<GLTexture> texture;
     } m_cursor;
     QRect cursorGeometry(Cursor *cursor) const;
+    bool isCursorEmbedded() const;
+    void paintCursor(GLRenderTarget *target);
+
+    /**
+     * Returns the offscreen target that frames are composed in before they are copied into
+     * memfd buffers. The target is kept for the lifetime of the stream and only reallocated
+     * when the resolution changes.
+     */
+    GLRenderTarget *offscreenTarget();
+    struct {
+        QScopedPointer<GLTexture> texture;
+        QScopedPointer<GLRenderTarget> target;
+    } m_offscreen;
 
     QHash<struct pw_buffer *, QSharedPointer<DmaBufTexture>> m_dmabufDataForPwBuffer;
 
+    /**
+     * Damage of every buffer, i.e. the region that has changed since the buffer was last
+     * filled. Only that region is copied when the buffer is reused.
+     */
+    QHash<struct pw_buffer *, QRegion> m_bufferDamage;
+    QRegion m_pendingDamage;
+    QTimer m_frameTimer;
+    QElapsedTimer m_lastFrameTime;
+
     pw_buffer *m_pendingBuffer = nullptr;
     QSocketNotifier *m_pendingNotifier = nullptr;
     EGLNativeFence *m_pendingFence = nullptr;
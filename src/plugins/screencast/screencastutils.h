@@ -8,21 +8,31 @@
 
 #include "deepin_kwinglplatform.h"
 #include "deepin_kwingltexture.h"
+#include "deepin_kwinglutils.h"
+#include "kwinpixelconversion_p.h"
+
+#include <QImage>
+#include <QRegion>
+
+#include <vector>
 
 namespace KWin
 {
 
-// in-place vertical mirroring
-static void mirrorVertically(uchar *data, int height, int stride)
+// Pixels are read back as 32 bit BGRA where possible, GLES only guarantees RGBA. The
+// conversion to the layout of the stream happens on the cpu, where it is a lot cheaper
+// than the generic packing paths drivers use for GL_BGR.
+static GLenum grabFormat()
+{
+    return GLPlatform::instance()->isGLES() ? GL_RGBA : GL_BGRA;
+}
+
+static PixelConversion grabConversion(bool hasAlphaChannel)
 {
-    const int halfHeight = height / 2;
-    std::vector<uchar> temp(stride);
-    for (int y = 0; y < halfHeight; ++y) {
-        auto cur = &data[y * stride], dest = &data[(height - y - 1) * stride];
-        memcpy(temp.data(), cur, stride);
-        memcpy(cur, dest, stride);
-        memcpy(dest, temp.data(), stride);
+    if (GLPlatform::instance()->isGLES()) {
+        return hasAlphaChannel ? PixelConversion::SwapRedBlue : PixelConversion::PackSwapRedBlue;
     }
+    return hasAlphaChannel ? PixelConversion::Copy : PixelConversion::PackRgb;
 }
 
 static void grabTexture(GLTexture *texture, QImage *image)
@@ -35,22 +45,57 @@ static void grabTexture(GLTexture *texture, QImage *image)
         glPixelStorei(GL_PACK_INVERT_MESA, GL_TRUE);
     }
 
+    const PixelConversion conversion = grabConversion(image->hasAlphaChannel());
+    std::vector<uchar> staging;
+    uchar *pixels = image->bits();
+    int bufferSize = image->sizeInBytes();
+    if (conversion != PixelConversion::Copy) {
+        staging.resize(size_t(image->width()) * image->height() * 4);
+        pixels = staging.data();
+        bufferSize = staging.size();
+    }
+
     texture->bind();
     if (GLPlatform::instance()->isGLES()) {
-        glReadPixels(0, 0, image->width(), image->height(), image->hasAlphaChannel() ? GL_BGRA : GL_BGR, GL_UNSIGNED_BYTE, (GLvoid*)image->bits());
+        glReadPixels(0, 0, image->width(), image->height(), grabFormat(), GL_UNSIGNED_BYTE, pixels);
     } else if (GLPlatform::instance()->glVersion() >= kVersionNumber(4, 5)) {
-        glGetTextureImage(texture->texture(), 0, image->hasAlphaChannel() ? GL_BGRA : GL_BGR, GL_UNSIGNED_BYTE, image->sizeInBytes(), image->bits());
+        glGetTextureImage(texture->texture(), 0, grabFormat(), GL_UNSIGNED_BYTE, bufferSize, pixels);
     } else {
-        glGetTexImage(texture->target(), 0, image->hasAlphaChannel() ? GL_BGRA : GL_BGR, GL_UNSIGNED_BYTE, image->bits());
+        glGetTexImage(texture->target(), 0, grabFormat(), GL_UNSIGNED_BYTE, pixels);
     }
 
     if (invertNeededAndSupported) {
         if (!prev) {
             glPixelStorei(GL_PACK_INVERT_MESA, prev);
         }
-    } else if (texture->isYInverted()) {
-        mirrorVertically(image->bits(), image->height(), image->bytesPerLine());
     }
+
+    const bool flip = texture->isYInverted() && !invertNeededAndSupported;
+    if (conversion != PixelConversion::Copy || flip) {
+        convertPixels(pixels, image->width() * 4, image->bits(), image->bytesPerLine(), image->size(), conversion, flip);
+    }
+}
+
+// Copies the given region of the texture attached to @p target into the same area of @p image.
+static void grabTextureRegion(GLTexture *texture, GLRenderTarget *target, QImage *image, const QRegion &region)
+{
+    Q_ASSERT(texture->size() == image->size());
+    const int bytesPerPixel = image->hasAlphaChannel() ? 4 : 3;
+    const PixelConversion conversion = grabConversion(image->hasAlphaChannel());
+    const QRect frame(QPoint(), image->size());
+    std::vector<uchar> rows;
+
+    GLRenderTarget::pushRenderTarget(target);
+    for (const QRect &rect : region & frame) {
+        rows.resize(size_t(rect.width()) * rect.height() * 4);
+
+        const int y = texture->isYInverted() ? image->height() - rect.y() - rect.height() : rect.y();
+        glReadPixels(rect.x(), y, rect.width(), rect.height(), grabFormat(), GL_UNSIGNED_BYTE, rows.data());
+
+        convertPixels(rows.data(), rect.width() * 4, image->scanLine(rect.y()) + rect.x() * bytesPerPixel,
+                      image->bytesPerLine(), rect.size(), conversion, texture->isYInverted());
+    }
+    GLRenderTarget::popRenderTarget();
 }
 
 } // namespace KWin
@@ -35,13 +35,20 @@ QSize WindowScreenCastSource::textureSize() const
     return m_window->clientGeometry().size();
 }
 
+WindowScreenCastSource::~WindowScreenCastSource()
+{
+}
+
 void WindowScreenCastSource::render(QImage *image)
 {
-    GLTexture offscreenTexture(hasAlphaChannel() ? GL_RGBA8 : GL_RGB8, textureSize());
-    GLRenderTarget offscreenTarget(offscreenTexture);
+    if (!m_offscreenTexture || m_offscreenTexture->size() != textureSize()) {
+        m_offscreenTarget.reset();
+        m_offscreenTexture.reset(new GLTexture(hasAlphaChannel() ? GL_RGBA8 : GL_RGB8, textureSize()));
+        m_offscreenTarget.reset(new GLRenderTarget(*m_offscreenTexture));
+    }
 
-    render(&offscreenTarget);
-    grabTexture(&offscreenTexture, image);
+    render(m_offscreenTarget.data());
+    grabTexture(m_offscreenTexture.data(), image);
 }
 
 void WindowScreenCastSource::render(GLRenderTarget *target)
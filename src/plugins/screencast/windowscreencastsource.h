@@ -9,10 +9,12 @@
 #include "screencastsource.h"
 
 #include <QPointer>
+#include <QScopedPointer>
 
 namespace KWin
 {
 
+class GLTexture;
 class Toplevel;
 
 class WindowScreenCastSource : public ScreenCastSource
@@ -21,6 +23,7 @@ class WindowScreenCastSource : public ScreenCastSource
 
 public:
     explicit WindowScreenCastSource(Toplevel *window, QObject *parent = nullptr);
+    ~WindowScreenCastSource() override;
 
     bool hasAlphaChannel() const override;
     QSize textureSize() const override;
@@ -30,6 +33,8 @@ public:
 
 private:
     QPointer<Toplevel> m_window;
+    QScopedPointer<GLTexture> m_offscreenTexture;
+    QScopedPointer<GLRenderTarget> m_offscreenTarget;
 };
 
 } // namespace KWin
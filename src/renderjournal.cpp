@@ -6,9 +6,23 @@
 
 #include "renderjournal.h"
 
+#include <cmath>
+
 namespace KWin
 {
 
+// The weight of the most recent frame in the cost model, about the last ten frames matter.
+static const double s_costSmoothing = 0.2;
+// How many mean deviations are added on top of the mean render time.
+static const double s_deviationFactor = 3.0;
+// The cost model isn't trusted until it has seen this many frames.
+static const int s_minimumCostSamples = 4;
+
+static std::chrono::nanoseconds currentTimestamp()
+{
+    return std::chrono::steady_clock::now().time_since_epoch();
+}
+
 RenderJournal::RenderJournal()
 {
 }
@@ -16,15 +30,104 @@ RenderJournal::RenderJournal()
 void RenderJournal::beginFrame()
 {
     m_timer.start();
+    m_frameWorkload = Workload::Idle;
+
+    const std::chrono::nanoseconds now = currentTimestamp();
+    FrameTimings &frame = m_timeline[m_writeSequence % s_timelineSize];
+    frame = FrameTimings();
+    frame.sequence = ++m_writeSequence;
+    frame.stages[int(Stage::Composite)] = m_compositeTimestamp != std::chrono::nanoseconds::zero() ? m_compositeTimestamp : now;
+    frame.stages[int(Stage::RenderBegin)] = now;
+    m_compositeTimestamp = std::chrono::nanoseconds::zero();
+
+    // Frames that were never presented must not hold back the presentation cursor forever.
+    if (m_writeSequence - m_presentSequence > s_timelineSize) {
+        m_presentSequence = m_writeSequence - s_timelineSize;
+    }
 }
 
 void RenderJournal::endFrame()
 {
-    std::chrono::nanoseconds duration(m_timer.nsecsElapsed());
+    add(std::chrono::nanoseconds(m_timer.nsecsElapsed()), m_frameWorkload);
+    markStage(Stage::RenderEnd);
+}
+
+void RenderJournal::setWorkload(Workload workload)
+{
+    m_frameWorkload = workload;
+}
+
+RenderJournal::Workload RenderJournal::workload() const
+{
+    return m_lastWorkload;
+}
+
+void RenderJournal::add(std::chrono::nanoseconds duration, Workload workload)
+{
     if (m_log.count() >= m_size) {
         m_log.dequeue();
     }
     m_log.enqueue(duration);
+
+    CostModel &model = m_costModels[int(workload)];
+    const double sample = duration.count();
+    if (model.sampleCount == 0) {
+        model.mean = sample;
+        model.deviation = 0;
+    } else {
+        const double error = sample - model.mean;
+        model.mean += s_costSmoothing * error;
+        model.deviation += s_costSmoothing * (std::abs(error) - model.deviation);
+    }
+    model.sampleCount++;
+    m_lastWorkload = workload;
+}
+
+void RenderJournal::markStage(Stage stage)
+{
+    if (stage == Stage::Composite) {
+        m_compositeTimestamp = currentTimestamp();
+        return;
+    }
+    if (m_writeSequence == 0) {
+        return;
+    }
+    m_timeline[(m_writeSequence - 1) % s_timelineSize].stages[int(stage)] = currentTimestamp();
+}
+
+void RenderJournal::notifyFramePresented(std::chrono::nanoseconds timestamp)
+{
+    if (m_presentSequence == m_writeSequence) {
+        return;
+    }
+    m_timeline[m_presentSequence % s_timelineSize].stages[int(Stage::Presented)] = timestamp;
+    m_presentSequence++;
+}
+
+void RenderJournal::notifyFrameFailed()
+{
+    if (m_presentSequence == m_writeSequence) {
+        return;
+    }
+    m_timeline[m_presentSequence % s_timelineSize].failed = true;
+    m_presentSequence++;
+}
+
+void RenderJournal::discardPendingFrames()
+{
+    m_presentSequence = m_writeSequence;
+}
+
+QVector<RenderJournal::FrameTimings> RenderJournal::timeline() const
+{
+    const quint64 count = std::min<quint64>(m_writeSequence, s_timelineSize);
+
+    QVector<FrameTimings> result;
+    result.reserve(count);
+    for (quint64 sequence = m_writeSequence - count; sequence < m_writeSequence; ++sequence) {
+        result.append(m_timeline[sequence % s_timelineSize]);
+    }
+    return result;
 }
 
 std::chrono::nanoseconds RenderJournal::minimum() const
@@ -53,4 +156,13 @@ std::chrono::nanoseconds RenderJournal::average() const
     return result / m_log.count();
 }
 
+std::chrono::nanoseconds RenderJournal::predict(Workload workload) const
+{
+    const CostModel &model = m_costModels[int(workload)];
+    if (model.sampleCount < s_minimumCostSamples) {
+        return maximum();
+    }
+    return std::chrono::nanoseconds(qint64(model.mean + s_deviationFactor * model.deviation));
+}
+
 } // namespace KWin
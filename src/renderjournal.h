@@ -10,6 +10,10 @@
 
 #include <QElapsedTimer>
 #include <QQueue>
+#include <QVector>
+
+#include <array>
+#include <chrono>
 
 namespace KWin
 {
@@ -17,10 +21,56 @@ namespace KWin
 /**
  * The RenderJournal class measures how long it takes to render frames and estimates how
  * long it will take to render the next frame.
+ *
+ * Besides the total frame duration, the journal keeps a per-stage timeline of the most
+ * recent frames in a fixed-size ring buffer. Recording a stage is a clock read and a store,
+ * so the timeline is always on and can be fetched from a running session.
+ *
+ * Render times are also fed into a cost model that is kept separately for every workload,
+ * so frames with running effects don't inflate the estimate for idle frames and vice versa.
  */
 class KWIN_EXPORT RenderJournal
 {
 public:
+    /**
+     * The stages of a compositing cycle that are recorded in the frame timeline.
+     */
+    enum class Stage {
+        Composite, ///< Compositor::composite() was entered
+        RenderBegin, ///< the scene started rendering the frame
+        PrePaint, ///< effects finished the pre-paint pass
+        Paint, ///< the effect chain and the scene finished painting
+        RenderEnd, ///< the scene finished rendering the frame
+        Submit, ///< the render backend handed the frame to the display
+        Presented, ///< the frame has been presented, e.g. on page flip
+        Count,
+    };
+
+    /**
+     * The timeline of a single frame. Timestamps are sourced from the monotonic clock;
+     * a stage that has not been reached is zero.
+     */
+    struct FrameTimings
+    {
+        quint64 sequence = 0;
+        std::array<std::chrono::nanoseconds, int(Stage::Count)> stages{};
+        bool failed = false;
+
+        std::chrono::nanoseconds at(Stage stage) const
+        {
+            return stages[int(stage)];
+        }
+    };
+
+    /**
+     * The kinds of frames that get a cost model of their own.
+     */
+    enum class Workload {
+        Idle, ///< the scene is painted without transformations
+        Effects, ///< a fullscreen effect is active or the screen or windows are transformed
+        Count,
+    };
+
     RenderJournal();
 
     /**
@@ -33,6 +83,50 @@ public:
      */
     void endFrame();
 
+    /**
+     * Tags the frame currently being rendered with the given @a workload. Frames are
+     * tagged Workload::Idle unless specified otherwise.
+     */
+    void setWorkload(Workload workload);
+
+    /**
+     * Returns the workload of the most recently rendered frame.
+     */
+    Workload workload() const;
+
+    /**
+     * Adds a frame with the given @a workload that took @a duration to render. endFrame()
+     * calls this function with the measured render time.
+     */
+    void add(std::chrono::nanoseconds duration, Workload workload);
+
+    /**
+     * Records that the frame currently being rendered has reached the given @a stage.
+     * Stage::Composite can be recorded before beginFrame(), it is attached to the next frame.
+     */
+    void markStage(Stage stage);
+
+    /**
+     * Marks the oldest frame that is waiting for presentation as presented at @a timestamp.
+     */
+    void notifyFramePresented(std::chrono::nanoseconds timestamp);
+
+    /**
+     * Marks the oldest frame that is waiting for presentation as failed.
+     */
+    void notifyFrameFailed();
+
+    /**
+     * Forgets about all frames that are waiting for presentation, e.g. when the render
+     * loop has been invalidated.
+     */
+    void discardPendingFrames();
+
+    /**
+     * Returns the recorded frame timelines, ordered from the oldest to the newest frame.
+     */
+    QVector<FrameTimings> timeline() const;
+
     /**
      * Returns the maximum estimated amount of time that it takes to render a single frame.
      */
@@ -48,10 +142,36 @@ public:
      */
     std::chrono::nanoseconds average() const;
 
+    /**
+     * Returns the predicted amount of time that it takes to render a frame with the given
+     * @a workload. The prediction is the exponentially weighted moving average of the render
+     * time plus a multiple of its mean deviation. If the workload has too few samples, the
+     * maximum() of the recent frames is returned instead.
+     */
+    std::chrono::nanoseconds predict(Workload workload) const;
+
 private:
+    static constexpr int s_timelineSize = 256;
+
+    struct CostModel
+    {
+        double mean = 0;
+        double deviation = 0;
+        int sampleCount = 0;
+    };
+
     QElapsedTimer m_timer;
     QQueue<std::chrono::nanoseconds> m_log;
     int m_size = 15;
+
+    std::array<CostModel, int(Workload::Count)> m_costModels;
+    Workload m_frameWorkload = Workload::Idle;
+    Workload m_lastWorkload = Workload::Idle;
+
+    std::array<FrameTimings, s_timelineSize> m_timeline;
+    std::chrono::nanoseconds m_compositeTimestamp = std::chrono::nanoseconds::zero();
+    quint64 m_writeSequence = 0;
+    quint64 m_presentSequence = 0;
 };
 
 } // namespace KWin
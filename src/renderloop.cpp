@@ -28,6 +28,7 @@ RenderLoopPrivate::RenderLoopPrivate(RenderLoop *q)
     : q(q)
 {
     compositeTimer.setSingleShot(true);
+    compositeTimer.setTimerType(Qt::PreciseTimer);
     QObject::connect(&compositeTimer, &QTimer::timeout, q, [this]() { dispatch(); });
 }
 
@@ -41,8 +42,19 @@ void RenderLoopPrivate::scheduleRepaint()
     } else {
         presentMode = SyncMode::Fixed;
     }
-    const std::chrono::nanoseconds vblankInterval(1'000'000'000'000ull / refreshRate);
+    latencyPolicy = options->latencyPolicy();
+    renderTimeEstimator = options->renderTimeEstimator();
+
     const std::chrono::nanoseconds currentTime(std::chrono::steady_clock::now().time_since_epoch());
+    const std::chrono::nanoseconds nextRenderTimestamp = computeNextRenderTimestamp(currentTime);
+
+    const std::chrono::nanoseconds waitInterval = nextRenderTimestamp - currentTime;
+    compositeTimer.start(std::chrono::duration_cast<std::chrono::milliseconds>(waitInterval));
+}
+
+std::chrono::nanoseconds RenderLoopPrivate::computeNextRenderTimestamp(std::chrono::nanoseconds currentTime)
+{
+    const std::chrono::nanoseconds vblankInterval(1'000'000'000'000ull / refreshRate);
 
     // Estimate when the next presentation will occur. Note that this is a prediction.
     nextPresentationTimestamp = lastPresentationTimestamp + vblankInterval;
@@ -52,48 +64,77 @@ void RenderLoopPrivate::scheduleRepaint()
     }
 
     // Estimate when it's a good time to perform the next compositing cycle.
-    const std::chrono::nanoseconds safetyMargin = std::chrono::milliseconds(3);
-
     std::chrono::nanoseconds renderTime;
-    switch (options->latencyPolicy()) {
-    case LatencyExteremelyLow:
-        renderTime = std::chrono::nanoseconds(long(vblankInterval.count() * 0.1));
-        break;
-    case LatencyLow:
-        renderTime = std::chrono::nanoseconds(long(vblankInterval.count() * 0.25));
-        break;
-    case LatencyMedium:
-        renderTime = std::chrono::nanoseconds(long(vblankInterval.count() * 0.5));
-        break;
-    case LatencyHigh:
-        renderTime = std::chrono::nanoseconds(long(vblankInterval.count() * 0.75));
-        break;
-    case LatencyExtremelyHigh:
-        renderTime = std::chrono::nanoseconds(long(vblankInterval.count() * 0.9));
-        break;
-    }
-
-    switch (options->renderTimeEstimator()) {
-    case RenderTimeEstimatorMinimum:
-        renderTime = std::max(renderTime, renderJournal.minimum());
-        break;
-    case RenderTimeEstimatorMaximum:
-        renderTime = std::max(renderTime, renderJournal.maximum());
-        break;
-    case RenderTimeEstimatorAverage:
-        renderTime = std::max(renderTime, renderJournal.average());
-        break;
+    if (renderTimeEstimator == RenderTimeEstimatorPredictive) {
+        // Start as late as the cost model of the expected workload allows. The latency
+        // policy isn't applied, the learned safety margin takes its place.
+        renderTime = renderJournal.predict(renderJournal.workload()) + safetyMargin;
+    } else {
+        switch (latencyPolicy) {
+        case LatencyExteremelyLow:
+            renderTime = std::chrono::nanoseconds(long(vblankInterval.count() * 0.1));
+            break;
+        case LatencyLow:
+            renderTime = std::chrono::nanoseconds(long(vblankInterval.count() * 0.25));
+            break;
+        case LatencyMedium:
+            renderTime = std::chrono::nanoseconds(long(vblankInterval.count() * 0.5));
+            break;
+        case LatencyHigh:
+            renderTime = std::chrono::nanoseconds(long(vblankInterval.count() * 0.75));
+            break;
+        case LatencyExtremelyHigh:
+            renderTime = std::chrono::nanoseconds(long(vblankInterval.count() * 0.9));
+            break;
+        }
+
+        switch (renderTimeEstimator) {
+        case RenderTimeEstimatorMinimum:
+            renderTime = std::max(renderTime, renderJournal.minimum());
+            break;
+        case RenderTimeEstimatorMaximum:
+            renderTime = std::max(renderTime, renderJournal.maximum());
+            break;
+        case RenderTimeEstimatorAverage:
+            renderTime = std::max(renderTime, renderJournal.average());
+            break;
+        case RenderTimeEstimatorPredictive:
+            break;
+        }
+        renderTime += initialSafetyMargin;
     }
 
-    std::chrono::nanoseconds nextRenderTimestamp = nextPresentationTimestamp - renderTime - safetyMargin;
+    std::chrono::nanoseconds nextRenderTimestamp = nextPresentationTimestamp - renderTime;
 
     // If we can't render the frame before the deadline, start compositing immediately.
-    if (nextRenderTimestamp < currentTime) {
+    scheduledInTime = nextRenderTimestamp >= currentTime;
+    if (!scheduledInTime) {
         nextRenderTimestamp = currentTime;
     }
 
-    const std::chrono::nanoseconds waitInterval = nextRenderTimestamp - currentTime;
-    compositeTimer.start(std::chrono::duration_cast<std::chrono::milliseconds>(waitInterval));
+    return nextRenderTimestamp;
+}
+
+void RenderLoopPrivate::updateSafetyMargin(std::chrono::nanoseconds presentationTimestamp)
+{
+    if (renderTimeEstimator != RenderTimeEstimatorPredictive || presentMode != SyncMode::Fixed) {
+        return;
+    }
+
+    const std::chrono::nanoseconds vblankInterval(1'000'000'000'000ull / refreshRate);
+    if (presentationTimestamp > nextPresentationTimestamp + vblankInterval / 2) {
+        // The frame has missed the vblank it was scheduled for, back off quickly. Frames
+        // that were started too late to begin with say nothing about the margin.
+        if (!scheduledInTime) {
+            return;
+        }
+        safetyMargin = std::min(safetyMargin * 2, vblankInterval / 2);
+        safetyMarginHold = refreshRate / 1000;
+    } else if (safetyMarginHold > 0) {
+        safetyMarginHold--;
+    } else {
+        safetyMargin = std::max(safetyMargin - safetyMargin / 32, minimumSafetyMargin);
+    }
 }
 
 void RenderLoopPrivate::delayScheduleRepaint()
@@ -113,6 +154,7 @@ void RenderLoopPrivate::notifyFrameFailed()
 {
     Q_ASSERT(pendingFrameCount > 0);
     pendingFrameCount--;
+    renderJournal.notifyFrameFailed();
 
     if (!inhibitCount) {
         maybeScheduleRepaint();
@@ -133,6 +175,8 @@ void RenderLoopPrivate::notifyFrameCompleted(std::chrono::nanoseconds timestamp)
                   static_cast<long long>(lastPresentationTimestamp.count()));
         lastPresentationTimestamp = std::chrono::steady_clock::now().time_since_epoch();
     }
+    renderJournal.notifyFramePresented(lastPresentationTimestamp);
+    updateSafetyMargin(lastPresentationTimestamp);
 
     if (!inhibitCount) {
         maybeScheduleRepaint();
@@ -158,6 +202,7 @@ void RenderLoopPrivate::invalidate()
 {
     pendingReschedule = false;
     pendingFrameCount = 0;
+    renderJournal.discardPendingFrames();
     compositeTimer.stop();
 }
 
@@ -202,6 +247,11 @@ void RenderLoop::endFrame()
     d->renderJournal.endFrame();
 }
 
+RenderJournal *RenderLoop::renderJournal() const
+{
+    return &d->renderJournal;
+}
+
 int RenderLoop::refreshRate() const
 {
     return d->refreshRate;
@@ -14,6 +14,7 @@ namespace KWin
 {
 
 class RenderLoopPrivate;
+class RenderJournal;
 class Item;
 
 /**
@@ -58,6 +59,11 @@ public:
      */
     void endFrame();
 
+    /**
+     * Returns the journal that records the timings of the frames rendered by this loop.
+     */
+    RenderJournal *renderJournal() const;
+
     /**
      * Returns the refresh rate at which the output is being updated, in millihertz.
      */
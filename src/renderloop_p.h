@@ -7,6 +7,7 @@
 #pragma once
 
 #include "renderloop.h"
+#include "options.h"
 #include "renderjournal.h"
 
 #include <QTimer>
@@ -27,6 +28,13 @@ public:
     void scheduleRepaint();
     void maybeScheduleRepaint();
 
+    /**
+     * Predicts the next presentation timestamp and returns the time when compositing
+     * should start so the frame is ready by then, but not any sooner than necessary.
+     */
+    std::chrono::nanoseconds computeNextRenderTimestamp(std::chrono::nanoseconds currentTime);
+    void updateSafetyMargin(std::chrono::nanoseconds presentationTimestamp);
+
     void notifyFrameFailed();
     void notifyFrameCompleted(std::chrono::nanoseconds timestamp);
 
@@ -42,6 +50,17 @@ public:
     bool pendingRepaint = false;
     RenderLoop::VrrPolicy vrrPolicy = RenderLoop::VrrPolicy::Never;
     Item *fullscreenItem = nullptr;
+    LatencyPolicy latencyPolicy = Options::defaultLatencyPolicy();
+    RenderTimeEstimator renderTimeEstimator = Options::defaultRenderTimeEstimator();
+
+    // The predictive estimator learns the margin between the end of rendering and the
+    // presentation deadline. It grows when a frame misses its vblank, is held for about a
+    // second and then slowly decays while frames keep making it in time.
+    static constexpr std::chrono::nanoseconds initialSafetyMargin = std::chrono::milliseconds(3);
+    static constexpr std::chrono::nanoseconds minimumSafetyMargin = std::chrono::milliseconds(1);
+    std::chrono::nanoseconds safetyMargin = initialSafetyMargin;
+    int safetyMarginHold = 0;
+    bool scheduledInTime = true;
 
     enum class SyncMode {
         Fixed,
@@ -70,6 +70,7 @@
 #include "x11client.h"
 #include "deleted.h"
 #include "effects.h"
+#include "renderjournal.h"
 #include "renderloop.h"
 #include "shadow.h"
 #include "wayland_server.h"
@@ -258,8 +259,12 @@ void Scene::paintScreen(const QRegion &damage, const QRegion &repaint,
 
     effects->prePaintScreen(pdata, m_expectedPresentTimestamp);
     region = pdata.paint;
+    renderLoop->renderJournal()->markStage(RenderJournal::Stage::PrePaint);
 
     int mask = pdata.mask;
+    if (effectsImpl->hasActiveFullScreenEffect() || (mask & (PAINT_SCREEN_TRANSFORMED | PAINT_SCREEN_WITH_TRANSFORMED_WINDOWS))) {
+        renderLoop->renderJournal()->setWorkload(RenderJournal::Workload::Effects);
+    }
     if (mask & (PAINT_SCREEN_TRANSFORMED | PAINT_SCREEN_WITH_TRANSFORMED_WINDOWS)) {
         // Region painting is not possible with transformations,
         // because screen damage doesn't match transformed positions.
@@ -278,6 +283,7 @@ void Scene::paintScreen(const QRegion &damage, const QRegion &repaint,
 
     ScreenPaintData data(projection, screen);
     effects->paintScreen(mask, region, data);
+    renderLoop->renderJournal()->markStage(RenderJournal::Stage::Paint);
 
     Q_EMIT frameRendered();
 
@@ -339,6 +345,8 @@ void Scene::paintGenericScreen(int orig_mask, const ScreenPaintData &)
         if (!w->isPaintingEnabled()) {
             continue;
         }
+        // windows can be transformed arbitrarily, so we can't tell whether they are occluded
+        markWindowPainted(w, false);
         phase2.append({w, infiniteRegion(), data.clip, data.mask,});
     }
 
@@ -447,6 +455,23 @@ void Scene::paintSimpleScreen(int orig_mask, const QRegion &region)
         fullRepaint = (dirtyArea == displayRegion);
     }
 
+    // Find the windows whose visible part on this output is completely covered by opaque
+    // windows above them, regardless of the damage of this frame. Such windows are not
+    // painted at all, so neither their render nodes are built nor their textures updated.
+    // Their damage is kept and uploaded once they become visible again.
+    const QRect outputGeometry = painted_screen ? painted_screen->geometry() : geometry();
+    QRegion opaqueAbove;
+    for (int i = phase2data.count() - 1; i >= 0; --i) {
+        Phase2Data &data = phase2data[i];
+        const WindowItem *windowItem = data.window->windowItem();
+        const QRect visibleRect = windowItem->mapToGlobal(windowItem->boundingRect()) & outputGeometry;
+        data.occluded = !visibleRect.isEmpty() && (QRegion(visibleRect) - opaqueAbove).isEmpty();
+        markWindowPainted(data.window, data.occluded);
+        if (!(data.mask & PAINT_WINDOW_TRANSLUCENT)) {
+            opaqueAbove |= data.clip;
+        }
+    }
+
     QRegion allclips, upperTranslucentDamage;
     upperTranslucentDamage = repaint_region;
 
@@ -500,6 +525,11 @@ void Scene::paintSimpleScreen(int orig_mask, const QRegion &region)
         paintedArea |= data->region;
         data->region = paintedArea;
 
+        if (data->occluded) {
+            ++m_culledWindowCount;
+            ++m_totalCulledWindowCount;
+            continue;
+        }
         paintWindow(data->window, data->mask, data->region);
     }
 
@@ -567,6 +597,48 @@ void Scene::clearStackingOrder()
     stacking_order.clear();
 }
 
+const QHash<Toplevel *, bool> &Scene::paintedWindows() const
+{
+    return m_paintedWindows;
+}
+
+int Scene::culledWindowCount() const
+{
+    return m_culledWindowCount;
+}
+
+quint64 Scene::totalCulledWindowCount() const
+{
+    return m_totalCulledWindowCount;
+}
+
+void Scene::resetPaintedWindows()
+{
+    m_paintedWindows.clear();
+    m_culledWindowCount = 0;
+}
+
+void Scene::markWindowPainted(Window *window, bool occluded)
+{
+    Toplevel *toplevel = window->window();
+    if (painted_screen && !toplevel->isOnOutput(painted_screen)) {
+        return;
+    }
+    // effects can paint the screen several times, a window is occluded only if it was every time
+    auto it = m_paintedWindows.find(toplevel);
+    if (it == m_paintedWindows.end()) {
+        m_paintedWindows.insert(toplevel, occluded);
+    } else {
+        *it = *it && occluded;
+    }
+}
+
+void Scene::markWindowDrawn(Toplevel *window)
+{
+    // a drawn window is visible, no matter what the occlusion pass decided
+    m_paintedWindows.insert(window, false);
+}
+
 void Scene::paintWindow(Window* w, int mask, const QRegion &_region)
 {
     // no painting outside visible screen (and no transformations)
@@ -601,6 +673,7 @@ void Scene::finalDrawWindow(EffectWindowImpl* w, int mask, const QRegion &region
     if (waylandServer() && waylandServer()->isScreenLocked() && !w->window()->isLockScreen() && !w->window()->isInputMethod()) {
         return;
     }
+    markWindowDrawn(w->window());
     w->sceneWindow()->performPaint(mask, region, data);
 }
 
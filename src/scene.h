@@ -191,6 +191,27 @@ public:
 
     static QMatrix4x4 createProjectionMatrix(const QRect &rect);
 
+    /**
+     * Returns the windows that have been painted on the output during the last paint() call,
+     * mapped to whether they were completely covered by opaque windows above them.
+     */
+    const QHash<Toplevel *, bool> &paintedWindows() const;
+    /**
+     * Records that @a window has been drawn in the frame that is being painted outside of the
+     * stacking order, e.g. as a preview or as a thumbnail, so it keeps getting frame callbacks.
+     */
+    void markWindowDrawn(Toplevel *window);
+    /**
+     * Returns the number of windows that have been skipped by the occlusion culling pass
+     * during the last paint() call.
+     */
+    int culledWindowCount() const;
+    /**
+     * Returns the number of windows that have been skipped by the occlusion culling pass
+     * since the scene has been created.
+     */
+    quint64 totalCulledWindowCount() const;
+
 Q_SIGNALS:
     void frameRendered();
 
@@ -201,6 +222,10 @@ protected:
     virtual Window *createWindow(Toplevel *toplevel) = 0;
     void createStackingOrder(const QList<Toplevel *> &toplevels);
     void clearStackingOrder();
+    // forgets the windows painted on the previous output, called at the start of paint()
+    void resetPaintedWindows();
+    // records that the window has been painted on painted_screen
+    void markWindowPainted(Window *window, bool occluded);
     // shared implementation, starts painting the screen
     void paintScreen(const QRegion &damage, const QRegion &repaint,
                      QRegion *updateRegion, QRegion *validRegion, RenderLoop *renderLoop,
@@ -242,6 +267,8 @@ protected:
         QRegion region;
         QRegion clip;
         int mask = 0;
+        // completely covered by opaque windows above, the window is not painted
+        bool occluded = false;
     };
     // The region which actually has been painted by paintScreen() and should be
     // copied from the buffer to the screen. I.e. the region returned from Scene::paintScreen().
@@ -264,6 +291,9 @@ private:
 
     std::chrono::milliseconds m_expectedPresentTimestamp = std::chrono::milliseconds::zero();
     QHash< Toplevel*, Window* > m_windows;
+    QHash<Toplevel *, bool> m_paintedWindows;
+    int m_culledWindowCount = 0;
+    quint64 m_totalCulledWindowCount = 0;
     QMap<AbstractOutput *, QRegion> m_repaints;
     QRect m_geometry;
     // how many times finalPaintScreen() has been called
@@ -0,0 +1,26 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "overlaycandidatefilter.h"
+
+namespace KWin
+{
+
+OverlayCandidateFilter::OverlayCandidateFilter(const QRect &geometry, const QRegion &covered)
+    : m_geometry(geometry)
+    , m_above(covered)
+{
+}
+
+bool OverlayCandidateFilter::offer(const QRect &geometry, bool opaque)
+{
+    const bool candidate = opaque && m_geometry.contains(geometry) && !m_above.intersects(geometry);
+    m_above += geometry;
+    return candidate;
+}
+
+} // namespace KWin
@@ -0,0 +1,43 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QRect>
+#include <QRegion>
+
+namespace KWin
+{
+
+/**
+ * The OverlayCandidateFilter decides which surfaces of a frame can be put on overlay planes.
+ * An overlay plane is stacked above the primary plane, so only opaque surfaces which lie
+ * within the output and which nothing painted on the primary plane covers qualify.
+ *
+ * The items are offered in reverse paint order, i.e. from top to bottom.
+ */
+class OverlayCandidateFilter
+{
+public:
+    /**
+     * Creates a filter for an output with the given @p geometry. @p covered is painted on
+     * top of all items, e.g. the software cursor.
+     */
+    explicit OverlayCandidateFilter(const QRect &geometry, const QRegion &covered = QRegion());
+
+    /**
+     * Offers the next item, which is painted in @p geometry. Returns @c true if the item can
+     * be put on an overlay plane, which requires it to be @p opaque.
+     */
+    bool offer(const QRect &geometry, bool opaque);
+
+private:
+    QRect m_geometry;
+    QRegion m_above;
+};
+
+} // namespace KWin
@@ -25,6 +25,7 @@
 #include "composite.h"
 #include "effects.h"
 #include "lanczosfilter.h"
+#include "overlaycandidatefilter.h"
 #include "main.h"
 #include "overlaywindow.h"
 #include "renderloop.h"
@@ -35,8 +36,11 @@
 #include "windowitem.h"
 #include "abstract_output.h"
 #include "splitmanage.h"
+#include <algorithm>
 #include <cmath>
 #include <cstddef>
+#include <cstring>
+#include <tuple>
 
 #include <QGraphicsScale>
 #include <QPainter>
@@ -69,6 +73,10 @@ SceneOpenGL::SceneOpenGL(OpenGLBackend *backend, QObject *parent)
         glGenVertexArrays(1, &vao);
         glBindVertexArray(vao);
     }
+
+    connect(kwinApp()->platform(), &Platform::outputDisabled, this, [this](AbstractOutput *output) {
+        m_overlays.remove(output);
+    });
 }
 
 SceneOpenGL *SceneOpenGL::createScene(OpenGLBackend *backend, QObject *parent)
@@ -197,6 +205,7 @@ void SceneOpenGL::paint(AbstractOutput *output, const QRegion &damage, const QLi
                         RenderLoop *renderLoop)
 {
     painted_screen = output;
+    resetPaintedWindows();
     // actually paint the frame, flushed with the NEXT frame
     createStackingOrder(toplevels);
 
@@ -216,6 +225,7 @@ void SceneOpenGL::paint(AbstractOutput *output, const QRegion &damage, const QLi
     renderLoop->beginFrame();
 
     SurfaceItem *fullscreenSurface = nullptr;
+    Window *fullscreenWindow = nullptr;
     for (int i = stacking_order.count() - 1; i >=0; i--) {
         Window *window = stacking_order[i];
         Toplevel *toplevel = window->window();
@@ -242,16 +252,23 @@ void SceneOpenGL::paint(AbstractOutput *output, const QRegion &damage, const QLi
                 break;
             }
             fullscreenSurface = topMost;
+            fullscreenWindow = window;
             break;
         }
     }
     renderLoop->setFullscreenSurface(fullscreenSurface);
 
+    // overlay planes show surfaces the way they are, so they have the same requirements as direct scanout
+    const bool directScanoutAllowed = m_backend->directScanoutAllowed(output) && !static_cast<EffectsHandlerImpl*>(effects)->blocksDirectScanout();
     bool directScanout = false;
-    if (m_backend->directScanoutAllowed(output) && !static_cast<EffectsHandlerImpl*>(effects)->blocksDirectScanout()) {
+    if (directScanoutAllowed) {
         directScanout = m_backend->scanout(output, fullscreenSurface);
     }
     if (directScanout) {
+        m_overlays.remove(output);
+        markWindowPainted(fullscreenWindow, false);
+        renderLoop->endFrame();
+    } else if (directScanoutAllowed && presentOverlays(output, damage.intersected(geo))) {
         renderLoop->endFrame();
     } else {
         // prepare rendering makescontext current on the output
@@ -270,6 +287,9 @@ void SceneOpenGL::paint(AbstractOutput *output, const QRegion &damage, const QLi
         paintCursor(output, valid);
 
         renderLoop->endFrame();
+        if (output) {
+            updateOverlays(output, directScanoutAllowed);
+        }
 
         GLVertexBuffer::streamingBuffer()->endOfFrame();
         m_backend->endFrame(output, valid, update);
@@ -279,6 +299,131 @@ void SceneOpenGL::paint(AbstractOutput *output, const QRegion &damage, const QLi
     clearStackingOrder();
 }
 
+// collects the visible items of the subtree in the order in which they are painted
+static void collectPaintOrder(Item *item, QVector<Item *> &items)
+{
+    const QList<Item *> sortedChildItems = item->sortedChildItems();
+    for (Item *childItem : sortedChildItems) {
+        if (childItem->z() >= 0) {
+            break;
+        }
+        if (childItem->isVisible()) {
+            collectPaintOrder(childItem, items);
+        }
+    }
+    items.append(item);
+    for (Item *childItem : sortedChildItems) {
+        if (childItem->z() < 0) {
+            continue;
+        }
+        if (childItem->isVisible()) {
+            collectPaintOrder(childItem, items);
+        }
+    }
+}
+
+static bool hasRepaints(Item *item, AbstractOutput *output, const QVector<SurfaceItem *> &excludedItems)
+{
+    auto surfaceItem = qobject_cast<SurfaceItem *>(item);
+    if (!(surfaceItem && excludedItems.contains(surfaceItem)) && !item->repaints(output).isEmpty()) {
+        return true;
+    }
+    const QList<Item *> childItems = item->childItems();
+    return std::any_of(childItems.constBegin(), childItems.constEnd(), [output, &excludedItems](Item *childItem) {
+        return hasRepaints(childItem, output, excludedItems);
+    });
+}
+
+QVector<SurfaceItem *> SceneOpenGL::overlayCandidates(AbstractOutput *output) const
+{
+    // An overlay plane is stacked above the primary plane, so only opaque surfaces which
+    // nothing is painted on top of can be put on one.
+    QVector<SurfaceItem *> candidates;
+    // the software cursor is painted on the primary plane on top of all windows
+    QRegion cursorRegion;
+    if (output->usesSoftwareCursor() && !Cursors::self()->isCursorHidden()) {
+        cursorRegion = Cursors::self()->currentCursor()->geometry();
+    }
+    OverlayCandidateFilter filter(output->geometry(), cursorRegion);
+    for (int i = stacking_order.count() - 1; i >= 0; --i) {
+        Window *window = stacking_order[i];
+        Toplevel *toplevel = window->window();
+        if (!toplevel->isOnOutput(output) || !window->isVisible()) {
+            continue;
+        }
+        QVector<Item *> items;
+        collectPaintOrder(window->windowItem(), items);
+        for (int j = items.count() - 1; j >= 0; --j) {
+            Item *item = items[j];
+            const QRect geometry = item->mapToGlobal(item->rect());
+            auto surfaceItem = qobject_cast<SurfaceItem *>(item);
+            SurfacePixmap *pixmap = surfaceItem ? surfaceItem->pixmap() : nullptr;
+            const bool opaque = pixmap && toplevel->opacity() == 1.0
+                && (!pixmap->hasAlphaChannel() || surfaceItem->opaque().contains(surfaceItem->rect()));
+            if (filter.offer(geometry, opaque)) {
+                candidates.append(surfaceItem);
+            }
+        }
+    }
+    return candidates;
+}
+
+void SceneOpenGL::updateOverlays(AbstractOutput *output, bool allowed)
+{
+    const QVector<SurfaceItem *> surfaces = m_backend->assignOverlays(output, allowed ? overlayCandidates(output) : QVector<SurfaceItem *>());
+    if (surfaces.isEmpty()) {
+        m_overlays.remove(output);
+        return;
+    }
+    OverlayState &state = m_overlays[output];
+    state.surfaces.clear();
+    state.region = QRegion();
+    for (SurfaceItem *surfaceItem : surfaces) {
+        state.surfaces.append(surfaceItem);
+        state.region += surfaceItem->mapToGlobal(surfaceItem->rect());
+    }
+}
+
+bool SceneOpenGL::presentOverlays(AbstractOutput *output, const QRegion &damage)
+{
+    // If only the surfaces on overlay planes changed since the last frame, the previous frame
+    // can be presented again with new overlay buffers, without rendering anything. Their damage
+    // stays with the items, so that the primary plane gets updated once it's repainted.
+    const auto it = m_overlays.constFind(output);
+    if (it == m_overlays.constEnd() || !damage.isEmpty()) {
+        return false;
+    }
+    QVector<SurfaceItem *> surfaces;
+    for (const QPointer<SurfaceItem> &surfaceItem : it->surfaces) {
+        if (!surfaceItem) {
+            return false;
+        }
+        surfaces.append(surfaceItem);
+    }
+    // the surfaces must not have moved and nothing must have been put on top of them
+    const QVector<SurfaceItem *> candidates = overlayCandidates(output);
+    for (SurfaceItem *surfaceItem : qAsConst(surfaces)) {
+        if (!candidates.contains(surfaceItem) || !it->region.contains(surfaceItem->mapToGlobal(surfaceItem->rect()))) {
+            return false;
+        }
+    }
+    for (Window *window : qAsConst(stacking_order)) {
+        if (window->window()->isOnOutput(output) && hasRepaints(window->windowItem(), output, surfaces)) {
+            return false;
+        }
+    }
+    if (m_backend->assignOverlays(output, surfaces).count() != surfaces.count()) {
+        return false;
+    }
+    if (!m_backend->presentOverlays(output)) {
+        return false;
+    }
+    for (Window *window : qAsConst(stacking_order)) {
+        markWindowPainted(window, false);
+    }
+    return true;
+}
+
 QMatrix4x4 SceneOpenGL::transformation(int mask, const ScreenPaintData &data) const
 {
     QMatrix4x4 matrix;
@@ -511,6 +656,7 @@ void SceneOpenGL::finalDrawWindow(EffectWindowImpl* w, int mask, const QRegion &
     if (waylandServer() && waylandServer()->isScreenLocked() && !w->window()->isLockScreen() && !w->window()->isInputMethod()) {
         return;
     }
+    markWindowDrawn(w->window());
     performPaintWindow(w, mask, region, data);
 }
 
@@ -661,15 +807,18 @@ void OpenGLWindow::createRenderNode(Item *item, RenderContext *context)
         WindowQuadList quads = clipQuads(item, context);
         if (!quads.isEmpty()) {
             auto renderer = static_cast<const SceneOpenGLDecorationRenderer *>(decorationItem->renderer());
-            context->renderNodes.append(RenderNode{
-                .texture = renderer->texture(),
-                .quads = quads,
-                .transformMatrix = context->transforms.top(),
-                .opacity = context->paintData.opacity(),
-                .hasAlpha = true,
-                .coordinateType = UnnormalizedCoordinates,
-                .typ1 = 0,
-            });
+            const auto batches = renderer->mapToAtlas(quads);
+            for (const auto &batch : batches) {
+                context->renderNodes.append(RenderNode{
+                    .texture = batch.first,
+                    .quads = batch.second,
+                    .transformMatrix = context->transforms.top(),
+                    .opacity = context->paintData.opacity(),
+                    .hasAlpha = true,
+                    .coordinateType = UnnormalizedCoordinates,
+                    .typ1 = 0,
+                });
+            }
         }
     } else if (auto surfaceItem = qobject_cast<SurfaceItem *>(item)) {
         WindowQuadList quads = clipQuads(item, context);
@@ -1386,6 +1535,391 @@ QSharedPointer<GLTexture> DecorationShadowTextureCache::getTexture(SceneOpenGLSh
     return d.texture;
 }
 
+//****************************************
+// SceneOpenGL::DecorationAtlas
+//****************************************
+static const int s_decorationAtlasSize = 2048;
+static const int s_decorationAtlasInitialHeight = 128;
+static const int s_decorationTileLength = 32;
+
+/**
+ * Returns a 64 bit hash of the pixels of @p image. It is good enough to tell tiles apart,
+ * so the atlas doesn't need to keep a copy of every tile to compare against.
+ */
+static quint64 hashTile(const QImage &image)
+{
+    // the body and the finalizer of MurmurHash3, one 64 bit block at a time
+    auto rotate = [](quint64 value, int shift) {
+        return (value << shift) | (value >> (64 - shift));
+    };
+    auto mix = [](quint64 value) {
+        value ^= value >> 33;
+        value *= 0xff51afd7ed558ccdull;
+        value ^= value >> 33;
+        value *= 0xc4ceb9fe1a85ec53ull;
+        value ^= value >> 33;
+        return value;
+    };
+
+    quint64 hash = quint64(image.width()) << 32 | quint64(image.height());
+    const int lineSize = image.width() * image.depth() / 8;
+    for (int y = 0; y < image.height(); ++y) {
+        const uchar *line = image.constScanLine(y);
+        for (int x = 0; x < lineSize; x += sizeof(quint64)) {
+            quint64 block = 0;
+            memcpy(&block, line + x, std::min<int>(sizeof(quint64), lineSize - x));
+            block *= 0x87c37b91114253d5ull;
+            block = rotate(block, 31);
+            block *= 0x4cf5ad432745937full;
+            hash ^= block;
+            hash = rotate(hash, 27) * 5 + 0x52dce729;
+        }
+    }
+    return mix(hash ^ quint64(image.height()) * lineSize);
+}
+
+/**
+ * Stores the tiles of all decorations in shared textures. Tiles with the same contents, e.g. the
+ * borders and the buttons of inactive windows, are stored only once. The tiles are packed into
+ * shelves of equally sized slots, uploads are collected until flush(). Pages start small and
+ * grow in height as shelves are added.
+ */
+class DecorationAtlas
+{
+public:
+    DecorationAtlas(const DecorationAtlas&) = delete;
+    static DecorationAtlas &instance();
+
+    /**
+     * Returns the tile showing @p image, or -1 if it doesn't fit into the atlas.
+     */
+    int acquire(const QImage &image);
+    void release(int tile);
+    GLTexture *texture(int tile) const;
+    QPoint position(int tile) const;
+    /**
+     * Changes whenever the atlas is cleared, which invalidates all tiles.
+     */
+    int generation() const;
+    void flush();
+    void clear();
+
+private:
+    DecorationAtlas() = default;
+    struct Shelf {
+        int y = 0;
+        int height = 0;
+        int slotWidth = 0;
+        int usedWidth = 0;
+        QVector<int> freeSlots;
+    };
+    struct Page {
+        QSharedPointer<GLTexture> texture;
+        QVector<Shelf> shelves;
+        int usedHeight = 0;
+        int tileCount = 0;
+    };
+    struct Tile {
+        quint64 hash = 0;
+        QSize size;
+        bool uploadPending = false;
+        int page = -1;
+        int shelf = -1;
+        QPoint position;
+        int refCount = 0;
+    };
+    struct Upload {
+        int tile;
+        int page;
+        QPoint position;
+        int slotWidth;
+        QImage image;
+    };
+    bool allocate(const QSize &size, Tile &tile);
+    bool allocateInShelf(int page, int shelf, Tile &tile);
+    int pageHeight(int requiredHeight) const;
+    QSharedPointer<GLTexture> createPage(int height) const;
+    bool growPage(int page, int requiredHeight);
+
+    QVector<Page> m_pages;
+    QVector<Tile> m_tiles;
+    QVector<int> m_freeTiles;
+    QMultiHash<quint64, int> m_lookup;
+    QVector<Upload> m_uploads;
+    int m_pageSize = 0;
+    int m_generation = 0;
+};
+
+DecorationAtlas &DecorationAtlas::instance()
+{
+    static DecorationAtlas s_instance;
+    return s_instance;
+}
+
+int DecorationAtlas::acquire(const QImage &image)
+{
+    const quint64 hash = hashTile(image);
+    for (auto it = m_lookup.constFind(hash); it != m_lookup.constEnd() && it.key() == hash; ++it) {
+        Tile &tile = m_tiles[it.value()];
+        if (tile.size != image.size()) {
+            continue;
+        }
+        // the image is still around until the tile has been uploaded, so compare it while
+        // that's cheap
+        if (tile.uploadPending) {
+            const int id = it.value();
+            auto upload = std::find_if(m_uploads.cbegin(), m_uploads.cend(), [id](const Upload &upload) {
+                return upload.tile == id;
+            });
+            if (upload != m_uploads.cend() && upload->image != image) {
+                continue;
+            }
+        }
+        ++tile.refCount;
+        return it.value();
+    }
+
+    Tile tile;
+    if (!allocate(image.size(), tile)) {
+        return -1;
+    }
+    tile.hash = hash;
+    tile.size = image.size();
+    tile.uploadPending = true;
+    tile.refCount = 1;
+
+    int id;
+    if (!m_freeTiles.isEmpty()) {
+        id = m_freeTiles.takeLast();
+        m_tiles[id] = tile;
+    } else {
+        id = m_tiles.count();
+        m_tiles.append(tile);
+    }
+    m_lookup.insert(hash, id);
+    const Shelf &shelf = m_pages[tile.page].shelves[tile.shelf];
+    m_uploads.append(Upload{id, tile.page, tile.position, shelf.slotWidth, image});
+    return id;
+}
+
+void DecorationAtlas::release(int id)
+{
+    Tile &tile = m_tiles[id];
+    if (--tile.refCount > 0) {
+        return;
+    }
+    m_lookup.remove(tile.hash, id);
+
+    // the slot may be handed out again before the next flush
+    if (tile.uploadPending) {
+        m_uploads.erase(std::remove_if(m_uploads.begin(), m_uploads.end(), [id](const Upload &upload) {
+            return upload.tile == id;
+        }), m_uploads.end());
+    }
+
+    Page &page = m_pages[tile.page];
+    page.shelves[tile.shelf].freeSlots.append(tile.position.x());
+    if (--page.tileCount == 0) {
+        page = Page();
+    }
+    tile = Tile();
+    m_freeTiles.append(id);
+}
+
+GLTexture *DecorationAtlas::texture(int tile) const
+{
+    return m_pages[m_tiles[tile].page].texture.data();
+}
+
+QPoint DecorationAtlas::position(int tile) const
+{
+    return m_tiles[tile].position;
+}
+
+int DecorationAtlas::generation() const
+{
+    return m_generation;
+}
+
+bool DecorationAtlas::allocate(const QSize &size, Tile &tile)
+{
+    if (!m_pageSize) {
+        GLint maxTextureSize = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+        m_pageSize = std::min(s_decorationAtlasSize, int(maxTextureSize));
+    }
+
+    // the middle tiles of a part are longer than the others
+    const int padding = 2 * DecorationRenderer::TexturePad;
+    const int slotWidth = size.width() <= s_decorationTileLength + padding
+        ? s_decorationTileLength + padding
+        : 2 * s_decorationTileLength + padding;
+    if (slotWidth > m_pageSize || size.height() > m_pageSize) {
+        return false;
+    }
+
+    for (int i = 0; i < m_pages.count(); ++i) {
+        const Page &page = m_pages[i];
+        for (int j = 0; j < page.shelves.count(); ++j) {
+            const Shelf &shelf = page.shelves[j];
+            if (shelf.height == size.height() && shelf.slotWidth == slotWidth && allocateInShelf(i, j, tile)) {
+                return true;
+            }
+        }
+    }
+
+    Shelf shelf;
+    shelf.height = size.height();
+    shelf.slotWidth = slotWidth;
+    for (int i = 0; i < m_pages.count(); ++i) {
+        Page &page = m_pages[i];
+        if (!page.texture || page.usedHeight + shelf.height > m_pageSize) {
+            continue;
+        }
+        if (page.usedHeight + shelf.height > page.texture->height() && !growPage(i, page.usedHeight + shelf.height)) {
+            continue;
+        }
+        shelf.y = page.usedHeight;
+        page.usedHeight += shelf.height;
+        page.shelves.append(shelf);
+        return allocateInShelf(i, page.shelves.count() - 1, tile);
+    }
+
+    Page page;
+    page.texture = createPage(pageHeight(shelf.height));
+    page.usedHeight = shelf.height;
+    page.shelves.append(shelf);
+
+    int pageIndex = std::find_if(m_pages.cbegin(), m_pages.cend(), [](const Page &candidate) {
+        return !candidate.texture;
+    }) - m_pages.cbegin();
+    if (pageIndex == m_pages.count()) {
+        m_pages.append(page);
+    } else {
+        m_pages[pageIndex] = page;
+    }
+    return allocateInShelf(pageIndex, 0, tile);
+}
+
+bool DecorationAtlas::allocateInShelf(int pageIndex, int shelfIndex, Tile &tile)
+{
+    Page &page = m_pages[pageIndex];
+    Shelf &shelf = page.shelves[shelfIndex];
+    int x;
+    if (!shelf.freeSlots.isEmpty()) {
+        x = shelf.freeSlots.takeLast();
+    } else if (shelf.usedWidth + shelf.slotWidth <= m_pageSize) {
+        x = shelf.usedWidth;
+        shelf.usedWidth += shelf.slotWidth;
+    } else {
+        return false;
+    }
+    tile.page = pageIndex;
+    tile.shelf = shelfIndex;
+    tile.position = QPoint(x, shelf.y);
+    ++page.tileCount;
+    return true;
+}
+
+int DecorationAtlas::pageHeight(int requiredHeight) const
+{
+    // without framebuffer objects the contents can't be copied to a larger texture
+    if (!GLRenderTarget::supported()) {
+        return m_pageSize;
+    }
+    int height = s_decorationAtlasInitialHeight;
+    while (height < requiredHeight) {
+        height *= 2;
+    }
+    return std::min(height, m_pageSize);
+}
+
+QSharedPointer<GLTexture> DecorationAtlas::createPage(int height) const
+{
+    auto texture = QSharedPointer<GLTexture>::create(GL_RGBA8, m_pageSize, height);
+    texture->setYInverted(true);
+    texture->setWrapMode(GL_CLAMP_TO_EDGE);
+    texture->clear();
+    return texture;
+}
+
+bool DecorationAtlas::growPage(int pageIndex, int requiredHeight)
+{
+    Page &page = m_pages[pageIndex];
+    const int height = pageHeight(requiredHeight);
+    if (height <= page.texture->height()) {
+        return false;
+    }
+
+    GLRenderTarget renderTarget(*page.texture);
+    if (!renderTarget.valid()) {
+        return false;
+    }
+    QSharedPointer<GLTexture> texture = createPage(height);
+    GLRenderTarget::pushRenderTarget(&renderTarget);
+    texture->bind();
+    glCopyTexSubImage2D(texture->target(), 0, 0, 0, 0, 0, page.texture->width(), page.texture->height());
+    texture->unbind();
+    GLRenderTarget::popRenderTarget();
+
+    // pending uploads look up the texture of the page when they are flushed
+    page.texture = texture;
+    return true;
+}
+
+void DecorationAtlas::flush()
+{
+    std::sort(m_uploads.begin(), m_uploads.end(), [](const Upload &a, const Upload &b) {
+        return std::make_tuple(a.page, a.position.y(), a.position.x()) < std::make_tuple(b.page, b.position.y(), b.position.x());
+    });
+
+    for (int i = 0; i < m_uploads.count();) {
+        // neighbouring slots of a shelf are uploaded together
+        int j = i + 1;
+        while (j < m_uploads.count()
+               && m_uploads[j].page == m_uploads[i].page
+               && m_uploads[j].position.y() == m_uploads[i].position.y()
+               && m_uploads[j].position.x() == m_uploads[j - 1].position.x() + m_uploads[j - 1].slotWidth) {
+            ++j;
+        }
+
+        const Upload &first = m_uploads[i];
+        GLTexture *texture = m_pages[first.page].texture.data();
+        if (j == i + 1) {
+            texture->update(first.image, first.position);
+        } else {
+            const Upload &last = m_uploads[j - 1];
+            QImage image(last.position.x() + last.image.width() - first.position.x(), first.image.height(),
+                         QImage::Format_ARGB32_Premultiplied);
+            image.fill(Qt::transparent);
+            for (int k = i; k < j; ++k) {
+                const QImage &source = m_uploads[k].image;
+                const int offset = (m_uploads[k].position.x() - first.position.x()) * 4;
+                for (int y = 0; y < source.height(); ++y) {
+                    memcpy(image.scanLine(y) + offset, source.constScanLine(y), source.width() * 4);
+                }
+            }
+            texture->update(image, first.position);
+        }
+        i = j;
+    }
+    for (const Upload &upload : qAsConst(m_uploads)) {
+        m_tiles[upload.tile].uploadPending = false;
+    }
+    m_uploads.clear();
+}
+
+void DecorationAtlas::clear()
+{
+    m_pages.clear();
+    m_tiles.clear();
+    m_freeTiles.clear();
+    m_lookup.clear();
+    m_uploads.clear();
+    m_pageSize = 0;
+    ++m_generation;
+}
+
 SceneOpenGL::~SceneOpenGL()
 {
     if (init_ok) {
@@ -1398,6 +1932,7 @@ SceneOpenGL::~SceneOpenGL()
     SceneOpenGL::EffectFrame::cleanup();
     // SceneOpenGL2 被销毁时（可能发生在切换为2D模式）应该清理窗口阴影的材质缓存，否则在多次切换3D/2D后会导致窗口阴影绘制出现异常
     DecorationShadowTextureCache::instance().clear();
+    DecorationAtlas::instance().clear();
 }
 
 SceneOpenGLShadow::SceneOpenGLShadow(Toplevel *toplevel)
@@ -1504,7 +2039,6 @@ bool SceneOpenGLShadow::prepareBackend()
 
 SceneOpenGLDecorationRenderer::SceneOpenGLDecorationRenderer(Decoration::DecoratedClientImpl *client)
     : DecorationRenderer(client)
-    , m_texture()
 {
 }
 
@@ -1513,6 +2047,9 @@ SceneOpenGLDecorationRenderer::~SceneOpenGLDecorationRenderer()
     if (Scene *scene = Compositor::self()->scene()) {
         scene->makeOpenGLContextCurrent();
     }
+    for (Strip &strip : m_strips) {
+        releaseTiles(strip);
+    }
 }
 
 static void clamp_row(int left, int width, int right, const uint32_t *src, uint32_t *dest)
@@ -1567,143 +2104,273 @@ static void clamp(QImage &image, const QRect &viewport)
 
 void SceneOpenGLDecorationRenderer::render(const QRegion &region)
 {
+    DecorationAtlas &atlas = DecorationAtlas::instance();
+    if (m_atlasGeneration != atlas.generation()) {
+        // the tiles have been dropped together with the atlas
+        for (Strip &strip : m_strips) {
+            strip = Strip();
+        }
+        m_atlasGeneration = atlas.generation();
+        resizeStrips();
+    }
     if (areImageSizesDirty()) {
-        resizeTexture();
+        resizeStrips();
         resetImageSizesDirty();
     }
 
-    if (!m_texture) {
-        // for invalid sizes we get no texture, see BUG 361551
-        return;
-    }
-
     QRect left, top, right, bottom;
     client()->client()->layoutDecorationRects(left, top, right, bottom);
 
     const qreal devicePixelRatio = effectiveDevicePixelRatio();
-    const int topHeight = std::ceil(top.height() * devicePixelRatio);
-    const int bottomHeight = std::ceil(bottom.height() * devicePixelRatio);
-    const int leftWidth = std::ceil(left.width() * devicePixelRatio);
-
-    const QPoint topPosition(0, 0);
-    const QPoint bottomPosition(0, topPosition.y() + topHeight + (2 * TexturePad));
-    const QPoint leftPosition(0, bottomPosition.y() + bottomHeight + (2 * TexturePad));
-    const QPoint rightPosition(0, leftPosition.y() + leftWidth + (2 * TexturePad));
-
     const QRect dirtyRect = region.boundingRect();
 
-    renderPart(top.intersected(dirtyRect), top, topPosition, devicePixelRatio);
-    renderPart(bottom.intersected(dirtyRect), bottom, bottomPosition, devicePixelRatio);
-    renderPart(left.intersected(dirtyRect), left, leftPosition, devicePixelRatio, true);
-    renderPart(right.intersected(dirtyRect), right, rightPosition, devicePixelRatio, true);
+    renderPart(DecorationPart::Top, top.intersected(dirtyRect), top, devicePixelRatio);
+    renderPart(DecorationPart::Bottom, bottom.intersected(dirtyRect), bottom, devicePixelRatio);
+    renderPart(DecorationPart::Left, left.intersected(dirtyRect), left, devicePixelRatio, true);
+    renderPart(DecorationPart::Right, right.intersected(dirtyRect), right, devicePixelRatio, true);
+
+    atlas.flush();
 }
 
-void SceneOpenGLDecorationRenderer::renderPart(const QRect &rect, const QRect &partRect,
-                                               const QPoint &textureOffset,
+void SceneOpenGLDecorationRenderer::renderPart(DecorationPart part, const QRect &rect, const QRect &partRect,
                                                qreal devicePixelRatio, bool rotated)
 {
-    if (!rect.isValid()) {
-        return;
+    Strip &strip = m_strips[int(part)];
+
+    // the dirty range along the part in device pixels
+    int dirtyStart = 0;
+    int dirtyEnd = 0;
+    if (rect.isValid()) {
+        if (rotated) {
+            dirtyStart = std::floor((rect.y() - partRect.y()) * devicePixelRatio);
+            dirtyEnd = std::ceil((rect.y() + rect.height() - partRect.y()) * devicePixelRatio);
+        } else {
+            dirtyStart = std::floor((rect.x() - partRect.x()) * devicePixelRatio);
+            dirtyEnd = std::ceil((rect.x() + rect.width() - partRect.x()) * devicePixelRatio);
+        }
     }
-    // We allow partial decoration updates and it might just so happen that the
-    // dirty region is completely contained inside the decoration part, i.e.
-    // the dirty region doesn't touch any of the decoration's edges. In that
-    // case, we should **not** pad the dirty region.
-    const QMargins padding = texturePadForPart(rect, partRect);
-    int verticalPadding = padding.top() + padding.bottom();
-    int horizontalPadding = padding.left() + padding.right();
 
-    QSize imageSize = rect.size() * devicePixelRatio;
-    if (rotated) {
-        imageSize = QSize(imageSize.height(), imageSize.width());
+    auto isDirty = [dirtyStart, dirtyEnd](const Tile &tile) {
+        // tiles that are not in the atlas yet have to be rendered as well
+        return tile.id == -1 || (tile.start < dirtyEnd && tile.start + tile.length > dirtyStart);
+    };
+
+    for (int first = 0; first < strip.tiles.count(); ++first) {
+        if (!isDirty(strip.tiles[first])) {
+            continue;
+        }
+        int last = first;
+        while (last + 1 < strip.tiles.count() && isDirty(strip.tiles[last + 1])) {
+            ++last;
+        }
+        renderTiles(strip, first, last, partRect, devicePixelRatio, rotated);
+        first = last;
     }
-    QSize paddedImageSize = imageSize;
-    paddedImageSize.rheight() += verticalPadding;
-    paddedImageSize.rwidth() += horizontalPadding;
-    QImage image(paddedImageSize, QImage::Format_ARGB32_Premultiplied);
+}
+
+void SceneOpenGLDecorationRenderer::renderTiles(Strip &strip, int first, int last, const QRect &partRect,
+                                                qreal devicePixelRatio, bool rotated)
+{
+    const int p = TexturePad;
+    const int start = strip.tiles[first].start;
+    const int end = strip.tiles[last].start + strip.tiles[last].length;
+
+    QImage image(end - start + 2 * p, strip.thickness + 2 * p, QImage::Format_ARGB32_Premultiplied);
     image.setDevicePixelRatio(devicePixelRatio);
     image.fill(Qt::transparent);
 
-    QRect padClip = QRect(padding.left(), padding.top(), imageSize.width(), imageSize.height());
+    // The pad columns show the neighbouring pixels so the tiles can be sampled up to their edges.
+    // Only at the ends of the part they are filled by copying from the neighbour row.
+    const int viewportStart = start == 0 ? p : 0;
+    const int viewportEnd = end == strip.length ? image.width() - p : image.width();
+    const QRect viewport(viewportStart, p, viewportEnd - viewportStart, strip.thickness);
+
+    const int paintStart = std::floor((start - p) / devicePixelRatio);
+    const int paintEnd = std::ceil((end + p) / devicePixelRatio);
+    QRect paintRect = rotated
+        ? QRect(partRect.x(), partRect.y() + paintStart, partRect.width(), paintEnd - paintStart)
+        : QRect(partRect.x() + paintStart, partRect.y(), paintEnd - paintStart, partRect.height());
+    paintRect &= partRect;
+
     QPainter painter(&image);
     const qreal inverseScale = 1.0 / devicePixelRatio;
     painter.scale(inverseScale, inverseScale);
     painter.setRenderHint(QPainter::Antialiasing);
-    painter.setClipRect(padClip);
-    painter.translate(padding.left(), padding.top());
+    painter.setClipRect(viewport);
+    painter.translate(p - start, p);
     if (rotated) {
-        painter.translate(0, imageSize.height());
+        painter.translate(0, strip.thickness);
         painter.rotate(-90);
     }
     painter.scale(devicePixelRatio, devicePixelRatio);
-    painter.translate(-rect.topLeft());
-    renderToPainter(&painter, rect);
+    painter.translate(-partRect.topLeft());
+    renderToPainter(&painter, paintRect);
     painter.end();
 
-    // fill padding pixels by copying from the neighbour row
-    clamp(image, padClip);
-
-    QPoint dirtyOffset = (rect.topLeft() - partRect.topLeft()) * devicePixelRatio;
-    if (padding.top() == 0) {
-        dirtyOffset.ry() += TexturePad;
-    }
-    if (padding.left() == 0) {
-        dirtyOffset.rx() += TexturePad;
+    clamp(image, viewport);
+    image.setDevicePixelRatio(1);
+
+    DecorationAtlas &atlas = DecorationAtlas::instance();
+    for (int i = first; i <= last; ++i) {
+        Tile &tile = strip.tiles[i];
+        const int previous = tile.id;
+        // acquire before releasing, so a tile that didn't change is neither evicted nor uploaded
+        tile.id = atlas.acquire(image.copy(tile.start - start, 0, tile.length + 2 * p, image.height()));
+        if (previous != -1) {
+            atlas.release(previous);
+        }
     }
-    m_texture->update(image, textureOffset + dirtyOffset);
 }
 
-const QMargins SceneOpenGLDecorationRenderer::texturePadForPart(
-        const QRect &rect, const QRect &partRect)
+void SceneOpenGLDecorationRenderer::resizeStrips()
 {
-    QMargins result = QMargins(0, 0, 0, 0);
-    if (rect.top() == partRect.top()) {
-        result.setTop(TexturePad);
-    }
-    if (rect.bottom() == partRect.bottom()) {
-        result.setBottom(TexturePad);
-    }
-    if (rect.left() == partRect.left()) {
-        result.setLeft(TexturePad);
-    }
-    if (rect.right() == partRect.right()) {
-        result.setRight(TexturePad);
+    QRect left, top, right, bottom;
+    client()->client()->layoutDecorationRects(left, top, right, bottom);
+
+    // the parts are laid out as in DecorationItem::buildQuads()
+    const qreal devicePixelRatio = effectiveDevicePixelRatio();
+    const int topHeight = std::ceil(top.height() * devicePixelRatio);
+    const int bottomHeight = std::ceil(bottom.height() * devicePixelRatio);
+    const int leftWidth = std::ceil(left.width() * devicePixelRatio);
+
+    const int topOffset = 0;
+    const int bottomOffset = topOffset + topHeight + (2 * TexturePad);
+    const int leftOffset = bottomOffset + bottomHeight + (2 * TexturePad);
+    const int rightOffset = leftOffset + leftWidth + (2 * TexturePad);
+
+    const QRect rects[] = {left, top, right, bottom};
+    const int offsets[] = {leftOffset, topOffset, rightOffset, bottomOffset};
+
+    for (int i = 0; i < int(DecorationPart::Count); ++i) {
+        QSize size = rects[i].isValid() ? rects[i].size() * devicePixelRatio : QSize();
+        if (i == int(DecorationPart::Left) || i == int(DecorationPart::Right)) {
+            size.transpose();
+        }
+
+        Strip &strip = m_strips[i];
+        if (strip.offset == offsets[i] && strip.length == size.width() && strip.thickness == size.height()) {
+            continue;
+        }
+        releaseTiles(strip);
+        strip.offset = offsets[i];
+        strip.length = size.width();
+        strip.thickness = size.height();
+        if (size.isEmpty()) {
+            continue;
+        }
+
+        // The tiles are anchored at both ends of the part, so the corners and the buttons of
+        // decorations with different sizes end up in identical tiles.
+        const int anchored = strip.length / (2 * s_decorationTileLength) * s_decorationTileLength;
+        for (int start = 0; start < anchored; start += s_decorationTileLength) {
+            strip.tiles.append(Tile{-1, start, s_decorationTileLength});
+        }
+        if (strip.length > 2 * anchored) {
+            strip.tiles.append(Tile{-1, anchored, strip.length - 2 * anchored});
+        }
+        for (int start = strip.length - anchored; start < strip.length; start += s_decorationTileLength) {
+            strip.tiles.append(Tile{-1, start, s_decorationTileLength});
+        }
     }
-    return result;
 }
 
-static int align(int value, int align)
+void SceneOpenGLDecorationRenderer::releaseTiles(Strip &strip)
 {
-    return (value + align - 1) & ~(align - 1);
+    DecorationAtlas &atlas = DecorationAtlas::instance();
+    // the tiles are gone already if the atlas has been cleared in the meantime
+    if (m_atlasGeneration == atlas.generation()) {
+        for (const Tile &tile : qAsConst(strip.tiles)) {
+            if (tile.id != -1) {
+                atlas.release(tile.id);
+            }
+        }
+    }
+    strip.tiles.clear();
 }
 
-void SceneOpenGLDecorationRenderer::resizeTexture()
+QVector<QPair<GLTexture *, WindowQuadList>> SceneOpenGLDecorationRenderer::mapToAtlas(const WindowQuadList &quads) const
 {
-    QRect left, top, right, bottom;
-    client()->client()->layoutDecorationRects(left, top, right, bottom);
-    QSize size;
+    QVector<QPair<GLTexture *, WindowQuadList>> batches;
+    const DecorationAtlas &atlas = DecorationAtlas::instance();
+    if (m_atlasGeneration != atlas.generation()) {
+        return batches;
+    }
 
-    size.rwidth() = qMax(qMax(top.width(), bottom.width()),
-                         qMax(left.height(), right.height()));
-    size.rheight() = top.height() + bottom.height() +
-                     left.width() + right.width();
-    size *= effectiveDevicePixelRatio();
+    const int p = TexturePad;
+    for (const WindowQuad &quad : quads) {
+        // the texture coordinates across the parts tell which part the quad belongs to
+        const qreal center = (quad[0].v() + quad[2].v()) / 2;
+        const Strip *strip = nullptr;
+        for (const Strip &candidate : m_strips) {
+            if (center >= candidate.offset && center < candidate.offset + candidate.thickness + 2 * p) {
+                strip = &candidate;
+                break;
+            }
+        }
+        if (!strip) {
+            continue;
+        }
 
-    size.rheight() += 4 * (2 * TexturePad);
-    size.rwidth() += 2 * TexturePad;
-    size.rwidth() = align(size.width(), 128);
+        // the texture coordinates along the part change with x for horizontal parts and with y
+        // for the rotated ones
+        const bool horizontal = quad[0].u() != quad[1].u();
+        const WindowVertex &end = horizontal ? quad[1] : quad[3];
+        const qreal u0 = quad[0].u();
+        const qreal u1 = end.u();
+        if (u0 == u1) {
+            continue;
+        }
 
-    if (m_texture && m_texture->size() == size)
-        return;
+        for (const Tile &tile : strip->tiles) {
+            const qreal tileStart = p + tile.start;
+            const qreal tileEnd = tileStart + tile.length;
+            if (tile.id == -1 || tileEnd <= std::min(u0, u1) || tileStart >= std::max(u0, u1)) {
+                continue;
+            }
 
-    if (!size.isEmpty()) {
-        m_texture.reset(new GLTexture(GL_RGBA8, size.width(), size.height()));
-        m_texture->setYInverted(true);
-        m_texture->setWrapMode(GL_CLAMP_TO_EDGE);
-        m_texture->clear();
-    } else {
-        m_texture.reset();
+            WindowQuad subQuad = quad;
+            if (tileStart > std::min(u0, u1) || tileEnd < std::max(u0, u1)) {
+                const qreal from = (std::max(tileStart, std::min(u0, u1)) - u0) / (u1 - u0);
+                const qreal to = (std::min(tileEnd, std::max(u0, u1)) - u0) / (u1 - u0);
+                if (horizontal) {
+                    const qreal x1 = qBound(quad.left(), quad[0].x() + std::min(from, to) * (end.x() - quad[0].x()), quad.right());
+                    const qreal x2 = qBound(quad.left(), quad[0].x() + std::max(from, to) * (end.x() - quad[0].x()), quad.right());
+                    if (x1 >= x2) {
+                        continue;
+                    }
+                    subQuad = quad.makeSubQuad(x1, quad.top(), x2, quad.bottom());
+                } else {
+                    const qreal y1 = qBound(quad.top(), quad[0].y() + std::min(from, to) * (end.y() - quad[0].y()), quad.bottom());
+                    const qreal y2 = qBound(quad.top(), quad[0].y() + std::max(from, to) * (end.y() - quad[0].y()), quad.bottom());
+                    if (y1 >= y2) {
+                        continue;
+                    }
+                    subQuad = quad.makeSubQuad(quad.left(), y1, quad.right(), y2);
+                }
+            }
+
+            const QPoint position = atlas.position(tile.id);
+            WindowQuad mapped;
+            for (int i = 0; i < 4; ++i) {
+                mapped[i] = WindowVertex(subQuad[i].x(), subQuad[i].y(),
+                                         subQuad[i].u() - tile.start + position.x(),
+                                         subQuad[i].v() - strip->offset + position.y());
+            }
+
+            GLTexture *texture = atlas.texture(tile.id);
+            auto it = std::find_if(batches.begin(), batches.end(), [texture](const QPair<GLTexture *, WindowQuadList> &batch) {
+                return batch.first == texture;
+            });
+            if (it == batches.end()) {
+                WindowQuadList list;
+                list.append(mapped);
+                batches.append(qMakePair(texture, list));
+            } else {
+                it->second.append(mapped);
+            }
+        }
     }
+    return batches;
 }
 
 } // namespace
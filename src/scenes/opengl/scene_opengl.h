@@ -19,6 +19,8 @@
 
 #include "deepin_kwinglutils.h"
 
+#include <QPointer>
+
 namespace KWin
 {
 class LanczosFilter;
@@ -77,6 +79,15 @@ private:
     void doPaintBackground(const QVector< float >& vertices);
     void updateProjectionMatrix(const QRect &geometry);
     void performPaintWindow(EffectWindowImpl* w, int mask, const QRegion &region, WindowPaintData& data);
+    QVector<SurfaceItem *> overlayCandidates(AbstractOutput *output) const;
+    void updateOverlays(AbstractOutput *output, bool allowed);
+    bool presentOverlays(AbstractOutput *output, const QRegion &damage);
+
+    struct OverlayState {
+        // the surfaces on overlay planes, their area on the primary plane may be outdated
+        QVector<QPointer<SurfaceItem>> surfaces;
+        QRegion region;
+    };
 
     bool init_ok = true;
     OpenGLBackend *m_backend;
@@ -86,6 +97,7 @@ private:
     QMatrix4x4 m_projectionMatrix;
     QMatrix4x4 m_screenProjectionMatrix;
     GLuint vao = 0;
+    QHash<AbstractOutput *, OverlayState> m_overlays;
 };
 
 class OpenGLWindow final : public Scene::Window
@@ -206,18 +218,33 @@ public:
 
     void render(const QRegion &region) override;
 
-    GLTexture *texture() {
-        return m_texture.data();
-    }
-    GLTexture *texture() const {
-        return m_texture.data();
-    }
+    /**
+     * The decoration parts are cut into tiles, which are stored in textures shared by all
+     * decorations. This maps @p quads, whose texture coordinates refer to the layout of the
+     * parts used by the DecorationItem, to the tiles and groups them by texture.
+     */
+    QVector<QPair<GLTexture *, WindowQuadList>> mapToAtlas(const WindowQuadList &quads) const;
 
 private:
-    void renderPart(const QRect &rect, const QRect &partRect, const QPoint &textureOffset, qreal devicePixelRatio, bool rotated = false);
-    static const QMargins texturePadForPart(const QRect &rect, const QRect &partRect);
-    void resizeTexture();
-    QScopedPointer<GLTexture> m_texture;
+    struct Tile {
+        int id = -1;
+        // the range along the part in device pixels
+        int start = 0;
+        int length = 0;
+    };
+    struct Strip {
+        // the vertical offset of the part in the layout used by the DecorationItem
+        int offset = 0;
+        int length = 0;
+        int thickness = 0;
+        QVector<Tile> tiles;
+    };
+    void renderPart(DecorationPart part, const QRect &rect, const QRect &partRect, qreal devicePixelRatio, bool rotated = false);
+    void renderTiles(Strip &strip, int first, int last, const QRect &partRect, qreal devicePixelRatio, bool rotated);
+    void resizeStrips();
+    void releaseTiles(Strip &strip);
+    Strip m_strips[int(DecorationPart::Count)];
+    int m_atlasGeneration = 0;
 };
 
 } // namespace
@@ -73,6 +73,7 @@ void SceneQPainter::paint(AbstractOutput *output, const QRegion &damage, const Q
 {
     Q_ASSERT(kwinApp()->platform()->isPerScreenRenderingEnabled());
     painted_screen = output;
+    resetPaintedWindows();
 
     createStackingOrder(toplevels);
 
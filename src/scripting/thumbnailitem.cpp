@@ -14,6 +14,7 @@
 #include "scene.h"
 #include "screens.h"
 #include "scripting_logging.h"
+#include "thumbnailtexturecache.h"
 #include "virtualdesktops.h"
 #include "workspace.h"
 
@@ -62,6 +63,9 @@ void ThumbnailTextureProvider::setTexture(const QSharedPointer<GLTexture> &nativ
                                                                 nativeTexture->size(),
                                                                 QQuickWindow::TextureHasAlphaChannel));
         m_texture->setFiltering(QSGTexture::Linear);
+        if (nativeTexture->filter() == GL_LINEAR_MIPMAP_LINEAR) {
+            m_texture->setMipmapFiltering(QSGTexture::Linear);
+        }
         m_texture->setHorizontalWrapMode(QSGTexture::ClampToEdge);
         m_texture->setVerticalWrapMode(QSGTexture::ClampToEdge);
     }
@@ -232,7 +236,7 @@ QSGNode *ThumbnailItemBase::updatePaintNode(QSGNode *oldNode, QQuickItem::Update
     }
     node->setTexture(m_provider->texture());
 
-    if (m_offscreenTexture && m_offscreenTexture->isYInverted()) {
+    if (m_offscreenTexture && (m_offscreenTexture->isYInverted() || m_mirrorOffscreenTexture)) {
         node->setTextureCoordinatesTransform(QSGImageNode::MirrorVertically);
     } else {
         node->setTextureCoordinatesTransform(QSGImageNode::NoTransform);
@@ -400,31 +404,16 @@ void WindowThumbnailItem::updateOffscreenTexture()
     m_devicePixelRatio = window()->devicePixelRatio();
     textureSize *= m_devicePixelRatio;
 
-    if (!m_offscreenTexture || m_offscreenTexture->size() != textureSize) {
-        m_offscreenTexture.reset(new GLTexture(GL_RGBA8, textureSize));
-        m_offscreenTexture->setFilter(GL_LINEAR);
-        m_offscreenTexture->setWrapMode(GL_CLAMP_TO_EDGE);
-        m_offscreenTarget.reset(new GLRenderTarget(*m_offscreenTexture));
-    }
-
-    GLRenderTarget::pushRenderTarget(m_offscreenTarget.data());
-    glClearColor(0.0, 0.0, 0.0, 0.0);
-    glClear(GL_COLOR_BUFFER_BIT);
-
-    QMatrix4x4 projectionMatrix;
-    projectionMatrix.ortho(geometry.x(), geometry.x() + geometry.width(),
-                           geometry.y(), geometry.y() + geometry.height(), -1, 1);
-
-    EffectWindowImpl *effectWindow = m_client->effectWindow();
-    WindowPaintData data(effectWindow);
-    data.setProjectionMatrix(projectionMatrix);
-
     // The thumbnail must be rendered using kwin's opengl context as VAOs are not
     // shared across contexts. Unfortunately, this also introduces a latency of 1
     // frame, which is not ideal, but it is acceptable for things such as thumbnails.
-    const int mask = Scene::PAINT_WINDOW_TRANSFORMED;
-    effectWindow->sceneWindow()->performPaint(mask, infiniteRegion(), data);
-    GLRenderTarget::popRenderTarget();
+    ThumbnailTextureCache *cache = ThumbnailTextureCache::self();
+    const QSharedPointer<GLTexture> texture = cache ? cache->texture(m_client, textureSize) : QSharedPointer<GLTexture>();
+    if (!texture) {
+        return;
+    }
+    m_offscreenTexture = texture;
+    m_mirrorOffscreenTexture = true;
 
     // The fence is needed to avoid the case where qtquick renderer starts using
     // the texture while all rendering commands to it haven't completed yet.
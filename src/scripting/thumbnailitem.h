@@ -79,6 +79,11 @@ protected:
     QScopedPointer<GLRenderTarget> m_offscreenTarget;
     GLsync m_acquireFence = 0;
     qreal m_devicePixelRatio = 1;
+    /**
+     * Set if the offscreen texture has the orientation of the compositor textures, e.g. when
+     * it is shared with the ThumbnailTextureCache.
+     */
+    bool m_mirrorOffscreenTexture = false;
 
 private:
     void updateFrameRenderingConnection();
@@ -10,10 +10,51 @@
 #include "workspace.h"
 #include "screens.h"
 #include "abstract_output.h"
+#include "main.h"
+#include "platform.h"
+
+#include <algorithm>
 
 #define SPLITOUTLINE_WIDTH 14
 namespace KWin {
 
+static bool isSpecialWindowEx(AbstractClient *client)
+{
+    return client->isSpecialWindow() || client->isTooltip() || client->isPopupMenu();
+}
+
+void SplitSpatialIndex::invalidate()
+{
+    m_dirty = true;
+}
+
+const QVector<AbstractClient *> &SplitSpatialIndex::clients(int desktop, AbstractOutput *output)
+{
+    static const QVector<AbstractClient *> s_empty;
+    if (m_dirty) {
+        rebuild();
+    }
+    auto it = m_buckets.constFind(qMakePair(desktop, output));
+    return it != m_buckets.constEnd() ? *it : s_empty;
+}
+
+void SplitSpatialIndex::rebuild()
+{
+    for (auto it = m_buckets.begin(); it != m_buckets.end(); ++it) {
+        it->clear();
+    }
+    if (Workspace::self()) {
+        const QList<Toplevel *> &stackingOrder = Workspace::self()->stackingOrder();
+        for (int i = stackingOrder.size() - 1; i >= 0; i--) {
+            AbstractClient *c = qobject_cast<AbstractClient *>(stackingOrder[i]);
+            if (!c || !c->output() || isSpecialWindowEx(c))
+                continue;
+            m_buckets[qMakePair(c->desktop(), c->output())].append(c);
+        }
+    }
+    m_dirty = false;
+}
+
 void SplitGroup::clearGroup(AbstractClient *client, QString cscreen)
 {
     QList<EffectScreen *> list = effects->screens();
@@ -363,6 +404,20 @@ QList<AbstractClient *> SplitGroup::getCacheList(QString screen)
     return list;
 }
 
+bool SplitGroup::updateOutlineInputs(QString screen, const QVector<SplitOutlineInput> &inputs)
+{
+    auto it = m_outlineInputs.find(screen);
+    if (it != m_outlineInputs.end() && *it == inputs)
+        return false;
+    m_outlineInputs[screen] = inputs;
+    return true;
+}
+
+void SplitGroup::clearOutlineInputs(QString screen)
+{
+    m_outlineInputs.remove(screen);
+}
+
 /*****************************************************/
 
 SplitManage *SplitManage::_instance = nullptr;
@@ -376,6 +431,30 @@ SplitManage *SplitManage::instance()
 
 SplitManage::SplitManage()
 {
+    if (!Workspace::self())
+        return;
+
+    connect(Workspace::self(), &Workspace::stackingOrderChanged, this, [this] {
+        m_spatialIndex.invalidate();
+    });
+    connect(Workspace::self(), &Workspace::clientAdded, this, &SplitManage::watchClient);
+    connect(Workspace::self(), &Workspace::clientRemoved, this, [this] {
+        m_spatialIndex.invalidate();
+    });
+    for (AbstractClient *client : Workspace::self()->allClientList()) {
+        watchClient(client);
+    }
+}
+
+void SplitManage::watchClient(AbstractClient *client)
+{
+    m_spatialIndex.invalidate();
+    connect(client, &AbstractClient::desktopChanged, this, [this] {
+        m_spatialIndex.invalidate();
+    });
+    connect(client, &Toplevel::screenChanged, this, [this] {
+        m_spatialIndex.invalidate();
+    });
 }
 
 SplitManage::~SplitManage()
@@ -459,17 +538,12 @@ void SplitManage::setSplitLineStateEx(int desktop, QString screen, bool flag, bo
 bool SplitManage::isHaveAboveWin(int desktop, QString screen)
 {
     QSet<AbstractClient *> list = getObj(desktop) ? getObj(desktop)->getActiveList(screen) : QSet<AbstractClient *>();
-    QList<Toplevel *> stacklist = Workspace::self()->stackingOrder();
-    for (int i = stacklist.size() - 1; i >=0 ; i--) {
-        AbstractClient *c = qobject_cast<AbstractClient*>(stacklist[i]);
-        if (!c || isSpecialWindowEx(c) || c->isMinimized() || c->desktop() != desktop || c->output()->name() != screen)
+    AbstractOutput *output = kwinApp()->platform()->findOutput(screen);
+    for (AbstractClient *c : m_spatialIndex.clients(desktop, output)) {
+        if (c->isMinimized())
             continue;
-        if (list.contains(c))
-            return false;
-        else if (c->keepAbove())
-            return true;
-        else
-            return true;
+        // the topmost window decides, either it belongs to the split group or it covers it
+        return !list.contains(c);
     }
     return false;
 }
@@ -482,6 +556,8 @@ void SplitManage::updateSplitRect(int desktop, QString screen, int pos, bool isT
     QRect hrect = getObj(desktop)->getShowRect(screen);
     QRect vrect = getObj(desktop)->getShowRect(screen, false);
     QRect rect = workspace()->clientArea(MaximizeArea, Cursors::self()->mouse()->pos(), desktop);
+    // the outline is moved by hand, it has to be recomputed even if no window changed
+    getObj(desktop)->clearOutlineInputs(screen);
     if (isTopDown) {
         hrect.moveTop(pos - 7);
         getObj(desktop)->setShowRect(screen, hrect);
@@ -814,10 +890,15 @@ void SplitManage::checkOcclusion(AbstractClient *client, QString screen)
     QSet<AbstractClient *> tmpList = getObj(client->desktop()) ? getObj(client->desktop())->getActiveList(screen) : QSet<AbstractClient *>();
     tmpList.remove(client);
 
-    QList<Toplevel *> list = Workspace::self()->stackingOrder();
-    for (int i = list.size() - 1; i >=0 ; i--) {
-        AbstractClient *c = qobject_cast<AbstractClient*>(list[i]);
-        if (!c || client == c || isSpecialWindowEx(c) || c->isMinimized() || c->desktop() != client->desktop() || c->output()->name() != screen)
+    // windows outside of the area covered by the split windows can't occlude any of them
+    QRect splitBounds;
+    for (AbstractClient *tmpc : qAsConst(tmpList)) {
+        splitBounds |= tmpc->moveResizeGeometry();
+    }
+
+    AbstractOutput *output = kwinApp()->platform()->findOutput(screen);
+    for (AbstractClient *c : m_spatialIndex.clients(client->desktop(), output)) {
+        if (client == c || c->isMinimized())
             continue;
         if (tmpList.size() == 0)
                 break;
@@ -827,6 +908,8 @@ void SplitManage::checkOcclusion(AbstractClient *client, QString screen)
                 getObj(c->desktop())->cacheTmpSplitClient(c, screen);
         } else if (c->quickTileMode() == QuickTileMode(QuickTileFlag::None)) {
             QRect rect = c->frameGeometry();
+            if (!rect.intersects(splitBounds))
+                continue;
             QSetIterator<AbstractClient *> tmpit(tmpList);
             while(tmpit.hasNext()) {
                 AbstractClient *tmpc = tmpit.next();
@@ -921,6 +1004,19 @@ void SplitManage::updateSplitOutlineRect(int desktop, QString screen)
         return;
 
     QSet<AbstractClient *> activeSplitList = getObj(desktop)->getActiveList(screen);
+
+    // only recompute the outline if one of the split windows changed
+    QVector<SplitOutlineInput> inputs;
+    inputs.reserve(activeSplitList.size());
+    for (AbstractClient *client : qAsConst(activeSplitList)) {
+        inputs.append(SplitOutlineInput{client, client->moveResizeGeometry(), client->quickTileMode()});
+    }
+    std::sort(inputs.begin(), inputs.end(), [](const SplitOutlineInput &a, const SplitOutlineInput &b) {
+        return a.client < b.client;
+    });
+    if (!getObj(desktop)->updateOutlineInputs(screen, inputs))
+        return;
+
     if (activeSplitList.size() < 2) {
         getObj(desktop)->setShowRect(screen, QRect());
         getObj(desktop)->setShowRect(screen, QRect(), false);
@@ -984,10 +1080,6 @@ void SplitManage::updateSplitOutlineRect(int desktop, QString screen)
         getObj(desktop)->setShowRectH(screen, left2len + right2len, false);
         getObj(desktop)->setShowRectW(screen, top2len + bottom2len);
     }
-
-    QRect hRect, vRect;
-    getObj(desktop)->getHVArea(screen, hRect, vRect);
-    qCritical() << ">>>>>>>>>>>>>>>>" << __LINE__ << hRect << vRect;
 }
 
 void SplitManage::cacheSplitWin(AbstractClient *client, QString screen)
@@ -1337,7 +1429,7 @@ bool SplitManage::isSplitSplicing(AbstractClient *client, AbstractClient *target
 
 bool SplitManage::isSpecialWindowEx(AbstractClient *client)
 {
-    return client->isSpecialWindow() || client->isTooltip() || client->isPopupMenu();
+    return KWin::isSpecialWindowEx(client);
 }
 
 void SplitManage::setSplitMode(int desktop, QString screen, int mode)
@@ -12,11 +12,49 @@
 #include <QObject>
 #include <QRect>
 #include <QSet>
+#include <QVector>
 
 #include "abstract_client.h"
 
 namespace KWin {
 
+class AbstractOutput;
+
+/**
+ * The geometry a split outline is computed from, see SplitManage::updateSplitOutlineRect.
+ */
+struct SplitOutlineInput
+{
+    AbstractClient *client;
+    QRect geometry;
+    QuickTileMode mode;
+
+    bool operator==(const SplitOutlineInput &other) const
+    {
+        return client == other.client && geometry == other.geometry && mode == other.mode;
+    }
+};
+
+/**
+ * Buckets the clients that take part in split screen queries by desktop and output,
+ * each bucket in stacking order with the topmost client first.
+ *
+ * The buckets are rebuilt lazily after the stacking order or a client's desktop or output
+ * changed, queries in between don't walk the whole stacking order.
+ */
+class SplitSpatialIndex
+{
+public:
+    void invalidate();
+    const QVector<AbstractClient *> &clients(int desktop, AbstractOutput *output);
+
+private:
+    void rebuild();
+
+    QHash<QPair<int, AbstractOutput *>, QVector<AbstractClient *>> m_buckets;
+    bool m_dirty = true;
+};
+
 class SplitGroup
 {
 public:
@@ -58,6 +96,9 @@ public:
     SplitLocationMode getNormalLocation(QString screen);
     SplitLocationMode getTempLocation(QString screen);
 
+    bool updateOutlineInputs(QString screen, const QVector<SplitOutlineInput> &inputs);
+    void clearOutlineInputs(QString screen);
+
 private:
     QHash<QString, SplitLocationMode>       m_splitWinLocation;
     QHash<QString, SplitLocationMode>       m_tmpsplitWinLocation;
@@ -75,6 +116,7 @@ private:
     QHash<QString, QRect> m_hRect;
     QHash<QString, QRect> m_vRect;
     QHash<QString, bool>  m_splitLineState;
+    QHash<QString, QVector<SplitOutlineInput>> m_outlineInputs;
 };
 
 class SplitManage : public QObject
@@ -135,6 +177,7 @@ private:
     bool isSplitSplicing(AbstractClient *client, AbstractClient *target, bool isUseClientScr);
     void checkSplitMode(int desktop, QString screen, SplitLocationMode location, QSet<AbstractClient *> &list);
     SplitGroup *getObj(int desktop);
+    void watchClient(AbstractClient *client);
 
 private:
     static SplitManage *_instance;
@@ -146,6 +189,7 @@ private:
 
     QRect           m_initGeometry;
     QHash<int, SplitGroup*> m_splitGroupManage;
+    SplitSpatialIndex m_spatialIndex;
 };
 
 }
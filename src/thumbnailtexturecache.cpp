@@ -0,0 +1,235 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#include "thumbnailtexturecache.h"
+#include "composite.h"
+#include "effects.h"
+#include "renderbackend.h"
+#include "scene.h"
+#include "toplevel.h"
+
+#include <deepin_kwingltexture.h>
+#include <deepin_kwinglutils.h>
+
+namespace KWin
+{
+
+static const int s_maxMipLevels = 4;
+static const int s_evictionInterval = 5000; // ms
+
+ThumbnailTextureCache *ThumbnailTextureCache::s_self = nullptr;
+
+/**
+ * Halves the size of the window until a further step would make it smaller than the
+ * requested size, so the thumbnail is never upscaled when it is painted.
+ */
+static QSize thumbnailSize(const QSize &visibleSize, const QSize &requestedSize)
+{
+    const QSize minimumSize = visibleSize.scaled(requestedSize.boundedTo(visibleSize), Qt::KeepAspectRatio)
+                                  .expandedTo(QSize(1, 1));
+    QSize size = visibleSize;
+    while (size.width() / 2 >= minimumSize.width() && size.height() / 2 >= minimumSize.height()) {
+        size /= 2;
+    }
+    return size;
+}
+
+static int mipLevels(const QSize &size)
+{
+    int levels = 1;
+    int extent = qMax(size.width(), size.height());
+    while (extent > 1 && levels < s_maxMipLevels) {
+        extent /= 2;
+        ++levels;
+    }
+    return levels;
+}
+
+ThumbnailTextureCache::ThumbnailTextureCache(QObject *parent)
+    : QObject(parent)
+{
+    connect(Compositor::self(), &Compositor::aboutToToggleCompositing, this, [this]() {
+        Scene *scene = Compositor::self()->scene();
+        if (scene && scene->makeOpenGLContextCurrent()) {
+            clear();
+            scene->doneOpenGLContextCurrent();
+        }
+    });
+
+    m_evictionTimer.setInterval(s_evictionInterval);
+    connect(&m_evictionTimer, &QTimer::timeout, this, &ThumbnailTextureCache::evictUnused);
+}
+
+ThumbnailTextureCache::~ThumbnailTextureCache()
+{
+    s_self = nullptr;
+}
+
+ThumbnailTextureCache *ThumbnailTextureCache::self()
+{
+    Compositor *compositor = Compositor::self();
+    if (!compositor || !compositor->scene() || compositor->backend()->compositingType() != OpenGLCompositing) {
+        return nullptr;
+    }
+    if (!s_self) {
+        s_self = new ThumbnailTextureCache(compositor);
+    }
+    return s_self;
+}
+
+QSharedPointer<GLTexture> ThumbnailTextureCache::texture(Toplevel *window, const QSize &size)
+{
+    const QSize visibleSize = window->visibleGeometry().size();
+    if (visibleSize.isEmpty() || size.isEmpty()) {
+        return QSharedPointer<GLTexture>();
+    }
+
+    auto it = m_entries.find(window);
+    if (it == m_entries.end()) {
+        it = m_entries.insert(window, Entry());
+        watch(window);
+    }
+    Entry &entry = *it;
+    entry.lastUsed.start();
+    if (!m_evictionTimer.isActive()) {
+        m_evictionTimer.start();
+    }
+
+    const QSize textureSize = thumbnailSize(visibleSize, size);
+    if (!entry.texture || entry.visibleSize != visibleSize
+            || entry.texture->width() < textureSize.width() || entry.texture->height() < textureSize.height()) {
+        entry.renderTarget.reset();
+        const int levels = mipLevels(textureSize);
+        entry.texture.reset(new GLTexture(GL_RGBA8, textureSize, levels));
+        entry.texture->setFilter(levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        entry.texture->setWrapMode(GL_CLAMP_TO_EDGE);
+        entry.renderTarget.reset(new GLRenderTarget(*entry.texture));
+        entry.visibleSize = visibleSize;
+        entry.dirty = true;
+    }
+
+    if (entry.dirty && !render(window, entry)) {
+        return QSharedPointer<GLTexture>();
+    }
+    // the window is shown through its thumbnail, so it has to keep getting frame callbacks
+    Compositor::self()->scene()->markWindowDrawn(window);
+    return entry.texture;
+}
+
+bool ThumbnailTextureCache::render(Toplevel *window, Entry &entry)
+{
+    EffectWindowImpl *effectWindow = window->effectWindow();
+    if (!effectWindow || !effectWindow->sceneWindow() || !entry.renderTarget->valid()) {
+        return false;
+    }
+
+    // The thumbnail can be requested while a frame is being painted.
+    const bool scissorEnabled = glIsEnabled(GL_SCISSOR_TEST);
+    glDisable(GL_SCISSOR_TEST);
+
+    GLRenderTarget::pushRenderTarget(entry.renderTarget.data());
+    glClearColor(0.0, 0.0, 0.0, 0.0);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    const QRect geometry = window->visibleGeometry();
+    QMatrix4x4 projectionMatrix;
+    projectionMatrix.ortho(geometry.x(), geometry.x() + geometry.width(),
+                           geometry.y() + geometry.height(), geometry.y(), -1, 1);
+
+    WindowPaintData data(effectWindow);
+    data.setProjectionMatrix(projectionMatrix);
+    effectWindow->sceneWindow()->performPaint(Scene::PAINT_WINDOW_TRANSFORMED, infiniteRegion(), data);
+    GLRenderTarget::popRenderTarget();
+
+    if (scissorEnabled) {
+        glEnable(GL_SCISSOR_TEST);
+    }
+
+    if (entry.texture->filter() == GL_LINEAR_MIPMAP_LINEAR) {
+        entry.texture->bind();
+        entry.texture->generateMipmaps();
+        entry.texture->unbind();
+    }
+
+    entry.dirty = false;
+    return true;
+}
+
+void ThumbnailTextureCache::watch(Toplevel *window)
+{
+    connect(window, &Toplevel::damaged, this, &ThumbnailTextureCache::invalidate, Qt::UniqueConnection);
+    connect(window, &Toplevel::frameGeometryChanged, this, &ThumbnailTextureCache::invalidate, Qt::UniqueConnection);
+    connect(window, &Toplevel::windowClosed, this, &ThumbnailTextureCache::remove, Qt::UniqueConnection);
+    connect(window, &QObject::destroyed, this, [this, window]() {
+        destroy(window);
+    });
+}
+
+void ThumbnailTextureCache::invalidate(Toplevel *window)
+{
+    auto it = m_entries.find(window);
+    if (it != m_entries.end()) {
+        it->dirty = true;
+    }
+}
+
+void ThumbnailTextureCache::remove(Toplevel *window)
+{
+    disconnect(window, nullptr, this, nullptr);
+    destroy(window);
+}
+
+void ThumbnailTextureCache::destroy(Toplevel *window)
+{
+    auto it = m_entries.find(window);
+    if (it == m_entries.end()) {
+        return;
+    }
+    // the textures can only be deleted while the context of the compositor is current
+    Scene *scene = Compositor::self() ? Compositor::self()->scene() : nullptr;
+    if (scene && scene->makeOpenGLContextCurrent()) {
+        m_entries.erase(it);
+        scene->doneOpenGLContextCurrent();
+    } else {
+        m_released.append(*it);
+        m_entries.erase(it);
+        m_evictionTimer.start();
+    }
+}
+
+void ThumbnailTextureCache::evictUnused()
+{
+    Scene *scene = Compositor::self()->scene();
+    if (!scene || !scene->makeOpenGLContextCurrent()) {
+        return;
+    }
+    m_released.clear();
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        if (it->lastUsed.hasExpired(s_evictionInterval)) {
+            disconnect(it.key(), nullptr, this, nullptr);
+            it = m_entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    scene->doneOpenGLContextCurrent();
+
+    if (m_entries.isEmpty()) {
+        m_evictionTimer.stop();
+    }
+}
+
+void ThumbnailTextureCache::clear()
+{
+    for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+        disconnect(it.key(), nullptr, this, nullptr);
+    }
+    m_entries.clear();
+    m_released.clear();
+    m_evictionTimer.stop();
+}
+
+} // namespace KWin
@@ -0,0 +1,88 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#pragma once
+
+#include <deepin_kwinglobals.h>
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QSharedPointer>
+#include <QSize>
+#include <QTimer>
+#include <QVector>
+
+namespace KWin
+{
+
+class GLRenderTarget;
+class GLTexture;
+class Toplevel;
+
+/**
+ * The ThumbnailTextureCache keeps a downscaled, mipmapped copy of the contents of windows
+ * that are shown at preview scale, e.g. in the multitask view or in window thumbnails.
+ *
+ * A thumbnail is rendered again only after the window has been damaged or resized, so an
+ * overview with dozens of windows samples small textures instead of the full resolution
+ * window textures every frame. Thumbnails that have not been requested for a while are
+ * released.
+ *
+ * The textures use the same orientation as the textures of the compositor, i.e. they are
+ * not y-inverted.
+ */
+class KWIN_EXPORT ThumbnailTextureCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    ~ThumbnailTextureCache() override;
+
+    /**
+     * Returns the cache of the running compositor, or @c nullptr if the compositor is not
+     * using OpenGL.
+     */
+    static ThumbnailTextureCache *self();
+
+    /**
+     * Returns a thumbnail of the visible geometry of @p window that is at least as large as
+     * @p size, rendering it if needed. The OpenGL context of the compositor must be current.
+     */
+    QSharedPointer<GLTexture> texture(Toplevel *window, const QSize &size);
+
+    /**
+     * Releases all thumbnails. The OpenGL context of the compositor must be current.
+     */
+    void clear();
+
+private:
+    explicit ThumbnailTextureCache(QObject *parent);
+
+    struct Entry
+    {
+        QSharedPointer<GLTexture> texture;
+        QSharedPointer<GLRenderTarget> renderTarget;
+        QSize visibleSize;
+        QElapsedTimer lastUsed;
+        bool dirty = true;
+    };
+
+    void watch(Toplevel *window);
+    void invalidate(Toplevel *window);
+    void remove(Toplevel *window);
+    void destroy(Toplevel *window);
+    void evictUnused();
+    bool render(Toplevel *window, Entry &entry);
+
+    QHash<Toplevel *, Entry> m_entries;
+    // entries removed while the context couldn't be made current, freed by evictUnused()
+    QVector<Entry> m_released;
+    QTimer m_evictionTimer;
+    static ThumbnailTextureCache *s_self;
+};
+
+} // namespace KWin
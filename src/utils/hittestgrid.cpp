@@ -0,0 +1,138 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "hittestgrid.h"
+
+#include <algorithm>
+
+namespace KWin
+{
+
+// Outputs are split into at most this many cells in either direction, small enough that a
+// cell rarely holds more than a few windows and large enough that the grid stays cheap to
+// rebuild when a window moves.
+static const int s_gridSize = 16;
+
+// Windows that changed their bounds are tested for every point until the grid is rebuilt.
+// Usually that's the single window that is being moved or resized.
+static const int s_maxMovedWindows = 8;
+
+void HitTestGrid::build(const QVector<QRect> &outputs, const QVector<QRect> &bounds)
+{
+    clear();
+    m_bounds = bounds;
+
+    int cellCount = 0;
+    for (const QRect &geometry : outputs) {
+        if (geometry.isEmpty()) {
+            continue;
+        }
+        Output output;
+        output.geometry = geometry;
+        output.cellSize = QSize((geometry.width() + s_gridSize - 1) / s_gridSize,
+                                (geometry.height() + s_gridSize - 1) / s_gridSize);
+        output.columns = (geometry.width() + output.cellSize.width() - 1) / output.cellSize.width();
+        output.firstCell = cellCount;
+        const int rows = (geometry.height() + output.cellSize.height() - 1) / output.cellSize.height();
+        cellCount += output.columns * rows;
+        m_outputs.append(output);
+    }
+
+    // The entries of all cells are stored in one array, the cells are ranges in it.
+    m_cellOffsets.fill(0, cellCount + 1);
+    for (const QRect &rect : bounds) {
+        forEachCell(rect, [this](int cell) {
+            ++m_cellOffsets[cell + 1];
+        });
+    }
+    for (int cell = 0; cell < cellCount; ++cell) {
+        m_cellOffsets[cell + 1] += m_cellOffsets[cell];
+    }
+
+    m_cellEntries.resize(m_cellOffsets.last());
+    QVector<int> next = m_cellOffsets;
+    for (int i = 0; i < bounds.count(); ++i) {
+        forEachCell(bounds[i], [this, &next, i](int cell) {
+            m_cellEntries[next[cell]++] = i;
+        });
+    }
+
+    // Points outside of all outputs, e.g. while the pointer is being confined, are rare.
+    m_offscreenEntries.reserve(bounds.count());
+    for (int i = 0; i < bounds.count(); ++i) {
+        m_offscreenEntries.append(i);
+    }
+}
+
+void HitTestGrid::clear()
+{
+    m_outputs.clear();
+    m_bounds.clear();
+    m_cellOffsets.clear();
+    m_cellEntries.clear();
+    m_offscreenEntries.clear();
+    m_movedEntries.clear();
+}
+
+bool HitTestGrid::move(int index, const QRect &bounds)
+{
+    Q_ASSERT(index >= 0 && index < m_bounds.count());
+    auto it = std::lower_bound(m_movedEntries.begin(), m_movedEntries.end(), index);
+    if (it == m_movedEntries.end() || *it != index) {
+        if (m_movedEntries.count() == s_maxMovedWindows) {
+            return false;
+        }
+        m_movedEntries.insert(it, index);
+    }
+    m_bounds[index] = bounds;
+    return true;
+}
+
+template<typename Visitor>
+void HitTestGrid::forEachCell(const QRect &bounds, Visitor visitor) const
+{
+    for (const Output &output : m_outputs) {
+        const QRect rect = bounds & output.geometry;
+        if (rect.isEmpty()) {
+            continue;
+        }
+        const QPoint topLeft = rect.topLeft() - output.geometry.topLeft();
+        const QPoint bottomRight = rect.bottomRight() - output.geometry.topLeft();
+        const int firstColumn = topLeft.x() / output.cellSize.width();
+        const int lastColumn = bottomRight.x() / output.cellSize.width();
+        const int firstRow = topLeft.y() / output.cellSize.height();
+        const int lastRow = bottomRight.y() / output.cellSize.height();
+        for (int row = firstRow; row <= lastRow; ++row) {
+            for (int column = firstColumn; column <= lastColumn; ++column) {
+                visitor(output.firstCell + row * output.columns + column);
+            }
+        }
+    }
+}
+
+HitTestGrid::Cell HitTestGrid::cellAt(const QPoint &pos) const
+{
+    for (const Output &output : m_outputs) {
+        if (!output.geometry.contains(pos)) {
+            continue;
+        }
+        const QPoint local = pos - output.geometry.topLeft();
+        const int cell = output.firstCell + (local.y() / output.cellSize.height()) * output.columns
+            + local.x() / output.cellSize.width();
+        return Cell{m_cellEntries.constData() + m_cellOffsets[cell],
+                    m_cellEntries.constData() + m_cellOffsets[cell + 1]};
+    }
+    return Cell{m_offscreenEntries.constData(), m_offscreenEntries.constData() + m_offscreenEntries.count()};
+}
+
+int HitTestGrid::candidateCount(const QPoint &pos) const
+{
+    const Cell cell = cellAt(pos);
+    return cell.end - cell.begin;
+}
+
+} // namespace KWin
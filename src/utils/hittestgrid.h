@@ -0,0 +1,115 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QPoint>
+#include <QRect>
+#include <QVector>
+
+namespace KWin
+{
+
+/**
+ * The HitTestGrid class finds the windows whose bounds contain a point without testing all
+ * windows. Every output is split into a grid of cells and every cell lists the windows that
+ * intersect it, in the order in which they have to be tested.
+ *
+ * The grid knows nothing about windows except for their bounds, which must contain every
+ * point the window accepts input at. Whether a window under the point really accepts
+ * input is decided by the caller.
+ */
+class HitTestGrid
+{
+public:
+    /**
+     * Rebuilds the grid for windows with the given @p bounds on the given @p outputs. The
+     * bounds are listed in the order in which the windows are tested, e.g. top-most first.
+     */
+    void build(const QVector<QRect> &outputs, const QVector<QRect> &bounds);
+    void clear();
+
+    /**
+     * Changes the bounds of the window at @p index without rebuilding the grid, e.g. while
+     * the window is being moved or resized. Until the next build() the window is tested
+     * for every point. Returns @c false if too many windows have changed since the grid has
+     * been built, the grid has to be rebuilt then.
+     */
+    bool move(int index, const QRect &bounds);
+
+    /**
+     * Returns the index of the first window whose bounds contain @p pos and which is
+     * accepted by @p accept, or @c -1 if there is none.
+     */
+    template<typename Predicate>
+    int find(const QPoint &pos, Predicate accept) const
+    {
+        const Cell cell = cellAt(pos);
+        if (m_movedEntries.isEmpty()) {
+            for (const int *it = cell.begin; it != cell.end; ++it) {
+                if (m_bounds[*it].contains(pos) && accept(*it)) {
+                    return *it;
+                }
+            }
+            return -1;
+        }
+
+        // Both the cell and the moved windows are sorted by index, merge them so that the
+        // windows are still tested in order.
+        const int *it = cell.begin;
+        const int *moved = m_movedEntries.constBegin();
+        const int *movedEnd = m_movedEntries.constEnd();
+        while (it != cell.end || moved != movedEnd) {
+            int index;
+            if (moved == movedEnd || (it != cell.end && *it < *moved)) {
+                index = *it++;
+            } else {
+                if (it != cell.end && *it == *moved) {
+                    ++it;
+                }
+                index = *moved++;
+            }
+            if (m_bounds[index].contains(pos) && accept(index)) {
+                return index;
+            }
+        }
+        return -1;
+    }
+
+    /**
+     * Returns the number of windows listed in the cell that contains @p pos.
+     */
+    int candidateCount(const QPoint &pos) const;
+
+private:
+    struct Output
+    {
+        QRect geometry;
+        QSize cellSize;
+        int columns = 0;
+        int firstCell = 0;
+    };
+    struct Cell
+    {
+        const int *begin;
+        const int *end;
+    };
+
+    Cell cellAt(const QPoint &pos) const;
+    template<typename Visitor>
+    void forEachCell(const QRect &bounds, Visitor visitor) const;
+
+    QVector<Output> m_outputs;
+    QVector<QRect> m_bounds;
+    QVector<int> m_cellOffsets;
+    QVector<int> m_cellEntries;
+    QVector<int> m_offscreenEntries;
+    // windows whose bounds changed since the grid has been built, sorted by index
+    QVector<int> m_movedEntries;
+};
+
+} // namespace KWin
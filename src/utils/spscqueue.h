@@ -0,0 +1,109 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <memory>
+
+namespace KWin
+{
+
+/**
+ * The SpscQueue class is a bounded ring buffer that passes values from one producer thread
+ * to one consumer thread without locking.
+ *
+ * Only the producer may call push(), only the consumer may call peek() and pop().
+ */
+template<typename T>
+class SpscQueue
+{
+public:
+    /**
+     * Creates a queue that holds up to @p capacity values, rounded up to a power of two.
+     */
+    explicit SpscQueue(quint32 capacity)
+        : m_capacity(roundedCapacity(capacity))
+        , m_buffer(new T[m_capacity])
+    {
+    }
+
+    quint32 capacity() const
+    {
+        return m_capacity;
+    }
+
+    /**
+     * Appends @p value and returns @c true, or returns @c false if the queue is full.
+     */
+    bool push(const T &value)
+    {
+        const quint32 tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == m_capacity) {
+            return false;
+        }
+        m_buffer[tail & (m_capacity - 1)] = value;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Returns the oldest value without removing it, or @c nullptr if the queue is empty.
+     */
+    T *peek()
+    {
+        const quint32 head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &m_buffer[head & (m_capacity - 1)];
+    }
+
+    /**
+     * Moves the oldest value to @p value and returns @c true, or returns @c false if the
+     * queue is empty.
+     */
+    bool pop(T &value)
+    {
+        T *front = peek();
+        if (!front) {
+            return false;
+        }
+        value = std::move(*front);
+        m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Returns whether the queue is empty. The answer can be outdated by the time it is used
+     * unless the calling thread is the only one changing the queue at that time.
+     */
+    bool isEmpty() const
+    {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+private:
+    static quint32 roundedCapacity(quint32 capacity)
+    {
+        quint32 rounded = 1;
+        while (rounded < capacity) {
+            rounded *= 2;
+        }
+        return rounded;
+    }
+
+    const quint32 m_capacity;
+    std::unique_ptr<T[]> m_buffer;
+    // the consumer owns the head, the producer owns the tail
+    alignas(64) std::atomic<quint32> m_head{0};
+    alignas(64) std::atomic<quint32> m_tail{0};
+};
+
+} // namespace KWin
@@ -74,6 +74,15 @@ namespace KWin
 extern int screen_number;
 extern bool is_multihead;
 
+template <typename Key, typename T>
+static void removeFromIndex(QHash<Key, T *> &index, const Key &key, T *value)
+{
+    auto it = index.find(key);
+    if (it != index.end() && *it == value) {
+        index.erase(it);
+    }
+}
+
 X11EventFilterContainer::X11EventFilterContainer(X11EventFilter *filter)
     : m_filter(filter)
 {
@@ -804,6 +813,13 @@ void Workspace::addClient(X11Client *c)
     }
     m_x11Clients.append(c);
     m_allClients.append(c);
+    m_x11ClientsByWindow.insert(c->window(), c);
+    m_x11ClientsByWrapper.insert(c->wrapperId(), c);
+    m_x11ClientsByFrame.insert(c->frameId(), c);
+    if (c->inputId() != XCB_WINDOW_NONE) {
+        m_x11ClientsByInput.insert(c->inputId(), c);
+    }
+    m_toplevelsByInternalId.insert(c->internalId(), c);
     addToStack(c);
     markXStackingOrderAsDirty();
     updateClientArea(); // This cannot be in manage(), because the client got added only now
@@ -825,6 +841,8 @@ void Workspace::addClient(X11Client *c)
 void Workspace::addUnmanaged(Unmanaged* c)
 {
     m_unmanaged.append(c);
+    m_unmanagedByWindow.insert(c->window(), c);
+    m_toplevelsByInternalId.insert(c->internalId(), c);
     markXStackingOrderAsDirty();
 }
 
@@ -842,6 +860,10 @@ void Workspace::removeX11Client(X11Client *c)
     Q_ASSERT(m_x11Clients.contains(c));
     // TODO: if marked client is removed, notify the marked list
     m_x11Clients.removeAll(c);
+    removeFromIndex(m_x11ClientsByWindow, c->window(), c);
+    removeFromIndex(m_x11ClientsByWrapper, c->wrapperId(), c);
+    removeFromIndex(m_x11ClientsByFrame, c->frameId(), c);
+    removeFromIndex(m_x11ClientsByInput, c->inputId(), c);
     Group* group = findGroup(c->window());
     if (group != nullptr)
         group->lostLeader();
@@ -852,6 +874,8 @@ void Workspace::removeUnmanaged(Unmanaged* c)
 {
     Q_ASSERT(m_unmanaged.contains(c));
     m_unmanaged.removeAll(c);
+    removeFromIndex(m_unmanagedByWindow, c->window(), c);
+    removeFromIndex(m_toplevelsByInternalId, c->internalId(), static_cast<Toplevel *>(c));
     Q_EMIT unmanagedRemoved(c);
     markXStackingOrderAsDirty();
 }
@@ -901,6 +925,7 @@ void Workspace::addShellClient(AbstractClient *client)
         }
     }
     m_allClients.append(client);
+    m_toplevelsByInternalId.insert(client->internalId(), client);
     addToStack(client);
 
     markXStackingOrderAsDirty();
@@ -937,6 +962,7 @@ void Workspace::removeShellClient(AbstractClient *client)
 void Workspace::removeAbstractClient(AbstractClient *client)
 {
     m_allClients.removeAll(client);
+    removeFromIndex(m_toplevelsByInternalId, client->internalId(), static_cast<Toplevel *>(client));
     if (client == delayfocus_client) {
         cancelDelayFocus();
     }
@@ -2013,34 +2039,42 @@ Unmanaged *Workspace::findUnmanaged(std::function<bool (const Unmanaged*)> func)
 
 Unmanaged *Workspace::findUnmanaged(xcb_window_t w) const
 {
-    return findUnmanaged([w](const Unmanaged *u) {
-        return u->window() == w;
-    });
+    if (w == XCB_WINDOW_NONE) {
+        return nullptr;
+    }
+    return m_unmanagedByWindow.value(w);
 }
 
 X11Client *Workspace::findClient(Predicate predicate, xcb_window_t w) const
 {
+    if (w == XCB_WINDOW_NONE) {
+        return nullptr;
+    }
     switch (predicate) {
     case Predicate::WindowMatch:
-        return findClient([w](const X11Client *c) {
-            return c->window() == w;
-        });
+        return m_x11ClientsByWindow.value(w);
     case Predicate::WrapperIdMatch:
-        return findClient([w](const X11Client *c) {
-            return c->wrapperId() == w;
-        });
+        return m_x11ClientsByWrapper.value(w);
     case Predicate::FrameIdMatch:
-        return findClient([w](const X11Client *c) {
-            return c->frameId() == w;
-        });
+        return m_x11ClientsByFrame.value(w);
     case Predicate::InputIdMatch:
-        return findClient([w](const X11Client *c) {
-            return c->inputId() == w;
-        });
+        return m_x11ClientsByInput.value(w);
     }
     return nullptr;
 }
 
+void Workspace::updateClientInputId(X11Client *c, xcb_window_t oldInputId)
+{
+    if (m_x11ClientsByWindow.value(c->window()) != c) {
+        // not managed yet, addClient() picks up the input window
+        return;
+    }
+    removeFromIndex(m_x11ClientsByInput, oldInputId, c);
+    if (c->inputId() != XCB_WINDOW_NONE) {
+        m_x11ClientsByInput.insert(c->inputId(), c);
+    }
+}
+
 Toplevel *Workspace::findToplevel(std::function<bool (const Toplevel*)> func) const
 {
     if (auto *ret = Toplevel::findInList(m_allClients, func)) {
@@ -2057,9 +2091,7 @@ Toplevel *Workspace::findToplevel(std::function<bool (const Toplevel*)> func) co
 
 Toplevel *Workspace::findToplevel(const QUuid &internalId) const
 {
-    return findToplevel([internalId] (const KWin::Toplevel* l) -> bool {
-        return internalId == l->internalId();
-    });
+    return m_toplevelsByInternalId.value(internalId);
 }
 
 void Workspace::forEachToplevel(std::function<void (Toplevel *)> func)
@@ -2193,6 +2225,7 @@ void Workspace::updateTabbox()
 void Workspace::addInternalClient(InternalClient *client)
 {
     m_internalClients.append(client);
+    m_toplevelsByInternalId.insert(client->internalId(), client);
     addToStack(client);
 
     setupClientConnections(client);
@@ -2213,6 +2246,7 @@ void Workspace::addInternalClient(InternalClient *client)
 void Workspace::removeInternalClient(InternalClient *client)
 {
     m_internalClients.removeOne(client);
+    removeFromIndex(m_toplevelsByInternalId, client->internalId(), static_cast<Toplevel *>(client));
 
     markXStackingOrderAsDirty();
     updateStackingOrder(true);
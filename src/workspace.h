@@ -18,7 +18,9 @@
 #include "sm.h"
 #include "utils/common.h"
 // Qt
+#include <QHash>
 #include <QTimer>
+#include <QUuid>
 #include <QVector>
 // std
 #include <functional>
@@ -132,6 +134,14 @@ public:
      * @see findClient(std::function<bool (const X11Client *)>)
      */
     X11Client *findClient(Predicate predicate, xcb_window_t w) const;
+    /**
+     * Updates the lookup table used by findClient(Predicate::InputIdMatch, xcb_window_t)
+     * after the input window of @p c has been created, destroyed or replaced.
+     *
+     * @param c The client whose input window changed
+     * @param oldInputId The previous input window of @p c, or @c XCB_WINDOW_NONE
+     */
+    void updateClientInputId(X11Client *c, xcb_window_t oldInputId);
     void forEachClient(std::function<void (X11Client *)> func);
     void forEachAbstractClient(std::function<void (AbstractClient*)> func);
     Unmanaged *findUnmanaged(std::function<bool (const Unmanaged*)> func) const;
@@ -321,6 +331,10 @@ public:
      */
     const QList<Toplevel *> &stackingOrder() const;
     QList<Toplevel *> xStackingOrder() const;
+    /**
+     * Returns a number that changes whenever the list returned by xStackingOrder() is rebuilt.
+     */
+    uint xStackingOrderSerial() const;
     QList<X11Client *> ensureStackingOrder(const QList<X11Client *> &clients) const;
     QList<AbstractClient*> ensureStackingOrder(const QList<AbstractClient*> &clients) const;
 
@@ -722,6 +736,15 @@ private:
     QList<Deleted *> deleted;
     QList<InternalClient *> m_internalClients;
 
+    // Lookup tables for findClient(Predicate, xcb_window_t), findUnmanaged(xcb_window_t) and
+    // findToplevel(const QUuid &), X events are dispatched through them.
+    QHash<xcb_window_t, X11Client *> m_x11ClientsByWindow;
+    QHash<xcb_window_t, X11Client *> m_x11ClientsByWrapper;
+    QHash<xcb_window_t, X11Client *> m_x11ClientsByFrame;
+    QHash<xcb_window_t, X11Client *> m_x11ClientsByInput;
+    QHash<xcb_window_t, Unmanaged *> m_unmanagedByWindow;
+    QHash<QUuid, Toplevel *> m_toplevelsByInternalId;
+
     QList<Toplevel *> unconstrained_stacking_order; // Topmost last
     QList<Toplevel *> stacking_order; // Topmost last
     QVector<xcb_window_t> manual_overlays; //Topmost last
@@ -730,6 +753,7 @@ private:
     QList<Toplevel *> x_stacking; // From XQueryTree()
     std::unique_ptr<Xcb::Tree> m_xStackingQueryTree;
     bool m_xStackingDirty = false;
+    uint m_xStackingSerial = 0;
     QList<AbstractClient*> should_get_focus; // Last is most recent
     QList<AbstractClient*> attention_chain;
     QList<WindowState*> m_windowStates;
@@ -24,6 +24,8 @@
 #include <xcb/xfixes.h>
 
 #include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
 #include <unistd.h>
 
 #include <xwayland_logging.h>
@@ -33,8 +35,17 @@ namespace KWin
 namespace Xwl
 {
 
-// in Bytes: equals 64KB
-static const uint32_t s_incrChunkSize = 63 * 1024;
+// in Bytes: first chunk read from a Wayland source, it doubles until the
+// source is drained or the largest property the X server accepts is reached
+static const int s_minChunkSize = 64 * 1024;
+// in Bytes: upper bound for a single property, X servers usually accept 16MB
+static const int s_maxChunkSize = 4 * 1024 * 1024;
+// number of chunks read ahead of an incremental requestor before the
+// Wayland source is no longer read
+static const int s_maxQueuedChunks = 2;
+// in Bytes: requested size of the pipe buffers, the default of 64KB
+// makes every transfer a ping-pong of small reads and writes
+static const int s_pipeSize = 1024 * 1024;
 
 Transfer::Transfer(xcb_atom_t selection, qint32 fd, xcb_timestamp_t timestamp, QObject *parent)
     : QObject(parent)
@@ -42,6 +53,15 @@ Transfer::Transfer(xcb_atom_t selection, qint32 fd, xcb_timestamp_t timestamp, Q
     , m_fd(fd)
     , m_timestamp(timestamp)
 {
+    // all reads and writes are driven by socket notifiers, never block the compositor
+    const int flags = fcntl(m_fd, F_GETFL);
+    if (flags != -1) {
+        fcntl(m_fd, F_SETFL, flags | O_NONBLOCK);
+    }
+#ifdef F_SETPIPE_SZ
+    // fails for anything but pipes or beyond the user's limit, the default size is fine then
+    fcntl(m_fd, F_SETPIPE_SZ, s_pipeSize);
+#endif
 }
 
 void Transfer::createSocketNotifier(QSocketNotifier::Type type)
@@ -85,6 +105,9 @@ TransferWltoX::TransferWltoX(xcb_atom_t selection, xcb_selection_request_event_t
     : Transfer(selection, fd, 0, parent)
     , m_request(request)
 {
+    // the maximum request length is in units of four bytes, leave room for the request header
+    const int maxRequestSize = xcb_get_maximum_request_length(kwinApp()->x11Connection()) * 4;
+    m_maxChunkSize = qBound(s_minChunkSize, maxRequestSize - 1024, s_maxChunkSize);
 }
 
 TransferWltoX::~TransferWltoX()
@@ -109,21 +132,27 @@ int TransferWltoX::flushSourceData()
     Q_ASSERT(!m_chunks.isEmpty());
     xcb_connection_t *xcbConn = kwinApp()->x11Connection();
 
+    // only the part of the chunk that has been read already
     xcb_change_property(xcbConn,
                         XCB_PROP_MODE_REPLACE,
                         m_request->requestor,
                         m_request->property,
                         m_request->target,
                         8,
-                        m_chunks.first().first.size(),
-                        m_chunks.first().first.data());
+                        m_chunks.first().second,
+                        m_chunks.first().first.constData());
     xcb_flush(xcbConn);
 
     m_propertyIsSet = true;
     resetTimeout();
 
     const auto rm = m_chunks.takeFirst();
-    return rm.first.size();
+    return rm.second;
+}
+
+bool TransferWltoX::isChunkFull(int index) const
+{
+    return m_chunks.at(index).second == m_chunks.at(index).first.size();
 }
 
 void TransferWltoX::startIncr()
@@ -138,7 +167,7 @@ void TransferWltoX::startIncr()
                                   XCB_CW_EVENT_MASK, mask);
 
     // spec says to make the available space larger
-    const uint32_t chunkSpace = 1024 + s_incrChunkSize;
+    const uint32_t chunkSpace = 1024 + m_maxChunkSize;
     xcb_change_property(xcbConn,
                         XCB_PROP_MODE_REPLACE,
                         m_request->requestor,
@@ -150,66 +179,116 @@ void TransferWltoX::startIncr()
     setIncr(true);
     // first data will be flushed after the property has been deleted
     // again by the requestor
-    m_flushPropertyOnDelete = true;
     m_propertyIsSet = true;
     Q_EMIT selectionNotify(m_request, true);
 }
 
-void TransferWltoX::readWlSource()
+void TransferWltoX::finishIncr()
 {
-    if (m_chunks.size() == 0 ||
-            m_chunks.last().second == s_incrChunkSize) {
-        // append new chunk
-        auto next = QPair<QByteArray, int>();
-        next.first.resize(s_incrChunkSize);
-        next.second = 0;
-        m_chunks.append(next);
-    }
+    xcb_connection_t *xcbConn = kwinApp()->x11Connection();
 
-    const auto oldLen = m_chunks.last().second;
-    const auto avail = s_incrChunkSize - m_chunks.last().second;
-    Q_ASSERT(avail > 0);
+    uint32_t mask[] = {0};
+    xcb_change_window_attributes (xcbConn,
+                                  m_request->requestor,
+                                  XCB_CW_EVENT_MASK, mask);
 
-    ssize_t readLen = read(fd(), m_chunks.last().first.data() + oldLen, avail);
-    if (readLen == -1) {
-        qCWarning(KWIN_XWL) << "Error reading in Wl data.";
+    // a zero-length property marks the end of an incremental transfer
+    xcb_change_property(xcbConn,
+                        XCB_PROP_MODE_REPLACE,
+                        m_request->requestor,
+                        m_request->property,
+                        m_request->target,
+                        8, 0, nullptr);
+    xcb_flush(xcbConn);
+    endTransfer();
+}
 
-        // TODO: cleanup X side?
-        endTransfer();
-        return;
-    }
-    m_chunks.last().second = oldLen + readLen;
+void TransferWltoX::readWlSource()
+{
+    // drain the pipe, the source fd is non-blocking
+    while (true) {
+        if (m_chunks.isEmpty() || isChunkFull(m_chunks.size() - 1)) {
+            // append new chunk, incremental transfers use chunks as large as
+            // the X server allows to keep the number of round trips low
+            auto next = QPair<QByteArray, int>();
+            next.first.resize(incr() ? m_maxChunkSize : s_minChunkSize);
+            next.second = 0;
+            m_chunks.append(next);
+        }
 
-    if (readLen == 0) {
-        // at the fd end - complete transfer now
-        m_chunks.last().first.resize(m_chunks.last().second);
+        auto &chunk = m_chunks.last();
+        const auto avail = chunk.first.size() - chunk.second;
+        Q_ASSERT(avail > 0);
 
-        if (incr()) {
-            // incremental transfer is to be completed now
-            m_flushPropertyOnDelete = true;
-            if (!m_propertyIsSet) {
-                // flush if target's property is not set at the moment
-                flushSourceData();
+        const ssize_t readLen = read(fd(), chunk.first.data() + chunk.second, avail);
+        if (readLen == -1) {
+            if (errno == EINTR) {
+                continue;
             }
-            clearSocketNotifier();
-        } else {
-            // non incremental transfer is to be completed now,
-            // data can be transferred to X client via a single property set
-            flushSourceData();
-            Q_EMIT selectionNotify(m_request, true);
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // pipe drained, wait for the source to write more
+                break;
+            }
+            qCWarning(KWIN_XWL) << "Error reading in Wl data.";
+
+            // TODO: cleanup X side?
             endTransfer();
+            return;
         }
-    } else if (m_chunks.last().second == s_incrChunkSize) {
-        // first chunk full, but not yet at fd end -> go incremental
-        if (incr()) {
-            m_flushPropertyOnDelete = true;
-            if (!m_propertyIsSet) {
-                // flush if target's property is not set at the moment
+        chunk.second += readLen;
+
+        if (readLen == 0) {
+            // at the fd end - complete transfer now
+            chunk.first.resize(chunk.second);
+            clearSocketNotifier();
+
+            if (incr()) {
+                // incremental transfer is to be completed now, an empty
+                // chunk would terminate it prematurely
+                if (chunk.second == 0) {
+                    m_chunks.removeLast();
+                }
+                if (!m_propertyIsSet) {
+                    // flush if target's property is not set at the moment
+                    if (m_chunks.isEmpty()) {
+                        finishIncr();
+                    } else {
+                        flushSourceData();
+                    }
+                }
+            } else {
+                // non incremental transfer is to be completed now,
+                // data can be transferred to X client via a single property set
                 flushSourceData();
+                Q_EMIT selectionNotify(m_request, true);
+                endTransfer();
             }
-        } else {
-            // starting incremental transfer
+            return;
+        }
+
+        if (chunk.second < chunk.first.size()) {
+            continue;
+        }
+
+        if (!incr()) {
+            if (chunk.first.size() < m_maxChunkSize) {
+                // grow the first chunk, as long as the data fits into a single
+                // property no incremental transfer is needed at all
+                chunk.first.resize(qMin(chunk.first.size() * 2, m_maxChunkSize));
+                continue;
+            }
+            // first chunk full, but not yet at fd end -> go incremental
             startIncr();
+        } else if (!m_propertyIsSet) {
+            // flush if target's property is not set at the moment
+            flushSourceData();
+        }
+
+        if (m_chunks.size() >= s_maxQueuedChunks) {
+            // the requestor can't keep up, stop reading until it deleted
+            // the property so the pipe fills up and throttles the source
+            socketNotifier()->setEnabled(false);
+            break;
         }
     }
     resetTimeout();
@@ -235,28 +314,23 @@ void TransferWltoX::handlePropertyDelete()
     }
     m_propertyIsSet = false;
 
-    if (m_flushPropertyOnDelete) {
-        if (!socketNotifier() && m_chunks.isEmpty()) {
+    if (m_chunks.isEmpty()) {
+        if (!socketNotifier()) {
             // transfer complete
-            xcb_connection_t *xcbConn = kwinApp()->x11Connection();
-
-            uint32_t mask[] = {0};
-            xcb_change_window_attributes (xcbConn,
-                                          m_request->requestor,
-                                          XCB_CW_EVENT_MASK, mask);
-
-            xcb_change_property(xcbConn,
-                                XCB_PROP_MODE_REPLACE,
-                                m_request->requestor,
-                                m_request->property,
-                                m_request->target,
-                                8, 0, nullptr);
-            xcb_flush(xcbConn);
-            m_flushPropertyOnDelete = false;
-            endTransfer();
-        } else if (!m_chunks.isEmpty()) {
-            flushSourceData();
+            finishIncr();
         }
+        return;
+    }
+
+    // a partially read chunk is only sent once the source is at its end,
+    // otherwise it is flushed by readWlSource when it is full
+    if (!socketNotifier() || isChunkFull(0)) {
+        flushSourceData();
+    }
+
+    if (socketNotifier() && !socketNotifier()->isEnabled()) {
+        // there is room again, resume reading from the source
+        socketNotifier()->setEnabled(true);
     }
 }
 
@@ -541,7 +615,10 @@ void TransferXtoWl::dataSourceWrite()
     QByteArray property = m_receiver->data();
 
     ssize_t len = write(fd(), property.constData(), property.size());
-    if (len == -1) {
+    if (len == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        // pipe full, retry once the Wayland client has read from it
+        len = 0;
+    } else if (len == -1) {
         qCWarning(KWIN_XWL) << "X11 to Wayland write error on fd:" << fd();
         endTransfer();
         return;
@@ -120,19 +120,25 @@ Q_SIGNALS:
 
 private:
     void startIncr();
+    void finishIncr();
     void readWlSource();
     int flushSourceData();
     void handlePropertyDelete();
+    bool isChunkFull(int index) const;
 
     xcb_selection_request_event_t *m_request = nullptr;
 
-    /* contains all received data portioned in chunks
-     * TODO: explain second QPair component
+    /* contains all received data portioned in chunks, the first
+     * component is the chunk buffer and the second one the number
+     * of bytes that have been read into it so far
      */
     QVector<QPair<QByteArray, int> > m_chunks;
 
+    /* the largest property the X server accepts in a single request
+     */
+    int m_maxChunkSize;
+
     bool m_propertyIsSet = false;
-    bool m_flushPropertyOnDelete = false;
 
     Q_DISABLE_COPY(TransferWltoX)
 };